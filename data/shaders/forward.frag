@@ -14,21 +14,10 @@
 #endif
 
 #ifdef MULTIPLE_LIGHTS
-uniform Lights
-{
-    int point_light_count;
-#if MAX_POINT_LIGHT_COUNT > 0
-    point_light point[MAX_POINT_LIGHT_COUNT];
-#endif
-    int directional_light_count;
-#if MAX_DIRECTIONAL_LIGHT_COUNT > 0
-    directional_light directional[MAX_DIRECTIONAL_LIGHT_COUNT];
-#endif
-    int spotlight_count;
-#if MAX_SPOTLIGHT_COUNT > 0
-    spotlight spot[MAX_SPOTLIGHT_COUNT];
+#include "light_buffer.glsl"
+#ifdef CLUSTERED_LIGHTS
+#include "light_clusters.glsl"
 #endif
-} lights;
 
 #elif defined(SINGLE_LIGHT)
 
@@ -106,11 +95,22 @@ void main(void)
 
 #ifdef OUTPUT_LIGHTING
 #if defined(MULTIPLE_LIGHTS)
-#if MAX_POINT_LIGHT_COUNT > 0
+#ifdef CLUSTERED_LIGHTS
+    color.rgb += calc_cluster_lights(
+        gl_FragCoord.xy,
+        f_in.position,
+        surface_color.rgb,
+        view_dir,
+        normal,
+        roughness,
+        f0,
+        metallic
+    );
+#else
     for(int i = 0; i < lights.point_light_count; ++i)
     {
         color.rgb += calc_point_light(
-            lights.point[i],
+            get_point_light(i),
             f_in.position,
             surface_color.rgb,
             view_dir,
@@ -120,14 +120,12 @@ void main(void)
             metallic
         );
     }
-#endif
 
-#if MAX_DIRECTIONAL_LIGHT_COUNT > 0
-    for(int i = 0; i < lights.directional_light_count; ++i)
+    for(int i = 0; i < lights.spotlight_count; ++i)
     {
-        directional_light l = lights.directional[i];
-        vec3 c = calc_directional_light(
-            l,
+        color.rgb += calc_spotlight(
+            get_spotlight(i),
+            f_in.position,
             surface_color.rgb,
             view_dir,
             normal,
@@ -135,17 +133,13 @@ void main(void)
             f0,
             metallic
         );
-
-        color.rgb += c;
     }
 #endif
 
-#if MAX_SPOTLIGHT_COUNT > 0
-    for(int i = 0; i < lights.spotlight_count; ++i)
+    for(int i = 0; i < lights.directional_light_count; ++i)
     {
-        color.rgb += calc_spotlight(
-            lights.spot[i],
-            f_in.position,
+        color.rgb += calc_directional_light(
+            get_directional_light(i),
             surface_color.rgb,
             view_dir,
             normal,
@@ -154,7 +148,6 @@ void main(void)
             metallic
         );
     }
-#endif
 
 #elif defined(SINGLE_LIGHT)
 #ifdef POINT_LIGHT
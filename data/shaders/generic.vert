@@ -1,5 +1,5 @@
 /* This is a generic vertex shader, passing the vertex data modified by mvp. */
-#version 400 core
+#version 430 core
 
 #include "generic_vertex_input.glsl"
 
@@ -20,21 +20,51 @@ uniform vec2 uv_scale;
 uniform shadow_map shadow;
 #endif
 
+#ifdef BATCHED
+// Written by lt::geometry_batch and lt::instanced_object, the uniform
+// matrices are applied after these.
+struct batch_transform
+{
+    mat4 m;
+    mat4 n_m;
+};
+
+layout(std430) readonly buffer BatchTransforms
+{
+    batch_transform transforms[];
+} batch;
+
+layout(location = BATCH_DRAW_ID) in uint v_draw_id;
+#endif
+
 void main(void)
 {
-    v_out.position = vec3(m * vec4(v_vertex, 1.0f));
-    gl_Position = mvp * vec4(v_vertex, 1.0f);
+#ifdef BATCHED
+    batch_transform t = batch.transforms[v_draw_id];
+    vec4 vertex = t.m * vec4(get_vertex_position(), 1.0f);
+#else
+    vec4 vertex = vec4(get_vertex_position(), 1.0f);
+#endif
+
+    v_out.position = vec3(m * vertex);
+    gl_Position = mvp * vertex;
 
 #if defined(DIRECTIONAL_SHADOW_MAPPING) || defined(PERSPECTIVE_SHADOW_MAPPING)
-    v_out.light_space_pos = shadow.mvp * vec4(v_vertex, 1.0f);
+    v_out.light_space_pos = shadow.mvp * vertex;
 #endif
 
 #ifdef VERTEX_NORMAL
-    v_out.normal = n_m * v_normal;
+#ifdef BATCHED
+    mat3 normal_m = n_m * mat3(t.n_m);
+#else
+    mat3 normal_m = n_m;
+#endif
+    v_out.normal = normal_m * get_vertex_normal();
 
 #ifdef VERTEX_TANGENT
-    v_out.tangent = n_m * v_tangent.xyz;
-    v_out.bitangent = (cross(v_out.normal, v_out.tangent) * v_tangent.w);
+    vec4 tangent = get_vertex_tangent();
+    v_out.tangent = normal_m * tangent.xyz;
+    v_out.bitangent = (cross(v_out.normal, v_out.tangent) * tangent.w);
 #endif
 #endif
 
@@ -2,8 +2,20 @@
 #define VERTEX_POSITION 0
 #endif
 
+#ifndef VERTEX_POSITION_SCALE
+#define VERTEX_POSITION_SCALE 13
+#endif
+
+#ifndef VERTEX_POSITION_OFFSET
+#define VERTEX_POSITION_OFFSET 14
+#endif
+
 layout(location = VERTEX_POSITION) in vec3 v_vertex;
 
+// Constant attributes set by lt::primitive for decoding quantized positions.
+layout(location = VERTEX_POSITION_SCALE) in vec3 v_position_scale;
+layout(location = VERTEX_POSITION_OFFSET) in vec3 v_position_offset;
+
 out VERTEX_OUT {
     vec3 position;
 #if defined(DIRECTIONAL_SHADOW_MAPPING) || defined(PERSPECTIVE_SHADOW_MAPPING)
@@ -21,11 +33,44 @@ out VERTEX_OUT {
 #endif
 } v_out;
 
+vec3 get_vertex_position()
+{
+    return v_vertex * v_position_scale + v_position_offset;
+}
+
+#if defined(VERTEX_NORMAL_OCTAHEDRAL) || defined(VERTEX_TANGENT_OCTAHEDRAL)
+vec3 decode_octahedral(vec2 e)
+{
+    vec3 v = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    if(v.z < 0.0f)
+    {
+        vec2 s = vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+        v.xy = (1.0f - abs(v.yx)) * s;
+    }
+    return normalize(v);
+}
+#endif
+
 #ifdef VERTEX_NORMAL
+#ifdef VERTEX_NORMAL_OCTAHEDRAL
+layout(location = VERTEX_NORMAL) in vec2 v_normal;
+vec3 get_vertex_normal() { return decode_octahedral(v_normal); }
+#else
 layout(location = VERTEX_NORMAL) in vec3 v_normal;
+vec3 get_vertex_normal() { return v_normal; }
+#endif
 
 #ifdef VERTEX_TANGENT
 layout(location = VERTEX_TANGENT) in vec4 v_tangent;
+#ifdef VERTEX_TANGENT_OCTAHEDRAL
+vec4 get_vertex_tangent()
+{
+    float w = v_tangent.w < 0.0f ? -1.0f : 1.0f;
+    return vec4(decode_octahedral(v_tangent.xy), w);
+}
+#else
+vec4 get_vertex_tangent() { return v_tangent; }
+#endif
 #endif
 #endif
 
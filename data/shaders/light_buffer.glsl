@@ -0,0 +1,43 @@
+// Lights written by lt::light_buffer. The struct only contains vec4s, so its
+// layout is the same in std140 and std430.
+#include "light_types.glsl"
+
+struct light_data
+{
+    vec4 color;
+    // w is the cutoff of spotlights
+    vec4 position;
+    // w is the falloff exponent of spotlights
+    vec4 direction;
+};
+
+layout(std430) readonly buffer Lights
+{
+    int point_light_count;
+    int spotlight_count;
+    int directional_light_count;
+    light_data data[];
+} lights;
+
+point_light get_point_light(int i)
+{
+    light_data d = lights.data[i];
+    return point_light(d.color.rgb, d.position.xyz);
+}
+
+spotlight get_spotlight(int i)
+{
+    light_data d = lights.data[lights.point_light_count + i];
+    return spotlight(
+        d.color.rgb, d.position.xyz, d.direction.xyz,
+        d.position.w, d.direction.w
+    );
+}
+
+directional_light get_directional_light(int i)
+{
+    light_data d = lights.data[
+        lights.point_light_count + lights.spotlight_count + i
+    ];
+    return directional_light(d.color.rgb, d.direction.xyz);
+}
@@ -0,0 +1,84 @@
+// Per-cluster light lists written by lt::light_clusters. Each cluster stores
+// its light count followed by indices into the light buffer, where indices
+// past the point lights refer to spotlights.
+#include "light_buffer.glsl"
+
+layout(std430)
+#ifndef WRITE_CLUSTERS
+readonly
+#endif
+buffer LightClusters
+{
+    uint data[];
+} light_clusters;
+
+uniform uvec3 cluster_grid;
+uniform vec2 cluster_tile_size;
+// x is the near plane, y converts log(depth/near) to slices
+uniform vec2 cluster_depth;
+
+// depth is the positive view space distance along the view direction.
+uint get_cluster(vec2 frag_coord, float depth)
+{
+    uvec2 tile = min(
+        uvec2(max(frag_coord / cluster_tile_size, vec2(0))),
+        cluster_grid.xy - 1u
+    );
+    float slice = log(max(depth / cluster_depth.x, 1.0f)) * cluster_depth.y;
+    uint z = min(uint(slice), cluster_grid.z - 1u);
+    return tile.x + cluster_grid.x * (tile.y + cluster_grid.y * z);
+}
+
+uint get_cluster_offset(uint cluster)
+{
+    return cluster * uint(MAX_CLUSTER_LIGHTS + 1);
+}
+
+#ifndef WRITE_CLUSTERS
+vec3 calc_cluster_lights(
+    vec2 frag_coord,
+    vec3 pos,
+    vec3 surface_color,
+    vec3 view_dir,
+    vec3 normal,
+    float roughness,
+    float f0,
+    float metallic
+){
+    uint offset = get_cluster_offset(get_cluster(frag_coord, -pos.z));
+    uint count = light_clusters.data[offset];
+    vec3 lighting = vec3(0);
+
+    for(uint i = 1u; i <= count; ++i)
+    {
+        int index = int(light_clusters.data[offset + i]);
+        if(index < lights.point_light_count)
+        {
+            lighting += calc_point_light(
+                get_point_light(index),
+                pos,
+                surface_color,
+                view_dir,
+                normal,
+                roughness,
+                f0,
+                metallic
+            );
+        }
+        else
+        {
+            lighting += calc_spotlight(
+                get_spotlight(index - lights.point_light_count),
+                pos,
+                surface_color,
+                view_dir,
+                normal,
+                roughness,
+                f0,
+                metallic
+            );
+        }
+    }
+    return lighting;
+}
+#endif
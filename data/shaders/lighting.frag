@@ -1,12 +1,17 @@
 /* This shader is meant to be used with lighting.vert. */
-#version 400 core
+#version 430 core
 
 #include "light_types.glsl"
 #include "generic_fragment_input.glsl"
 #include "deferred_input.glsl"
 #include "shadow.glsl"
 
-#ifdef POINT_LIGHT
+#ifdef CLUSTERED_LIGHTS
+#include "light_clusters.glsl"
+#elif defined(LIGHT_BUFFER)
+#include "light_buffer.glsl"
+uniform int light_index;
+#elif defined(POINT_LIGHT)
 uniform point_light light;
 #elif defined(SPOTLIGHT)
 uniform spotlight light;
@@ -35,7 +40,21 @@ void main(void)
     vec3 pos = decode_position(uv);
     vec3 view_dir = normalize(-pos);
 
-#ifdef POINT_LIGHT
+#ifdef CLUSTERED_LIGHTS
+    vec3 lighting = calc_cluster_lights(
+        gl_FragCoord.xy,
+        pos,
+        surface_color,
+        view_dir,
+        normal,
+        roughness,
+        f0,
+        metallic
+    );
+#elif defined(POINT_LIGHT)
+#ifdef LIGHT_BUFFER
+    point_light light = get_point_light(light_index);
+#endif
     vec3 lighting = calc_point_light(
         light,
         pos,
@@ -64,6 +83,9 @@ void main(void)
     );
 #endif
 #elif defined(SPOTLIGHT)
+#ifdef LIGHT_BUFFER
+    spotlight light = get_spotlight(light_index);
+#endif
     vec3 lighting = calc_spotlight(
         light,
         pos,
@@ -92,6 +114,9 @@ void main(void)
 #endif
 
 #elif defined(DIRECTIONAL_LIGHT)
+#ifdef LIGHT_BUFFER
+    directional_light light = get_directional_light(light_index);
+#endif
     vec3 lighting = calc_directional_light(
         light,
         surface_color,
@@ -0,0 +1,82 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LT_BOUNDS_HH
+#define LT_BOUNDS_HH
+#include "api.hh"
+#include "math.hh"
+
+namespace lt
+{
+
+// Axis-aligned bounding box. A default-constructed box is empty, which is
+// used to signify unknown bounds.
+class LT_API aabb
+{
+public:
+    aabb();
+    aabb(vec3 min, vec3 max);
+
+    void expand(vec3 p);
+    void expand(const aabb& other);
+
+    bool is_empty() const;
+
+    vec3 get_min() const;
+    vec3 get_max() const;
+    vec3 get_center() const;
+    vec3 get_extent() const;
+
+    // Returns the bounding box of this box transformed by 'transform'.
+    aabb transform(const mat4& transform) const;
+
+    bool contains(const aabb& other) const;
+    bool intersects(const aabb& other) const;
+    bool intersects_sphere(vec3 center, float radius) const;
+
+    // 'inv_dir' is the reciprocal of the ray direction. Returns the entry
+    // distance in 't' when hit.
+    bool intersects_ray(vec3 origin, vec3 inv_dir, float& t) const;
+
+    float surface_area() const;
+
+private:
+    vec3 min, max;
+};
+
+// Set of planes extracted from a view-projection matrix. Works for both
+// perspective and orthographic projections, including infinite perspective.
+class LT_API frustum
+{
+public:
+    // Default frustum contains everything.
+    frustum();
+    explicit frustum(const mat4& view_projection);
+
+    bool intersects(const aabb& box) const;
+    bool intersects(vec3 center, float radius) const;
+
+private:
+    // Planes in the order left, right, bottom, top, near, far. xyz is the
+    // normal pointing inwards, w is the distance.
+    vec4 planes[6];
+};
+
+} // namespace lt
+
+#endif
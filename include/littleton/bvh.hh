@@ -0,0 +1,126 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LT_BVH_HH
+#define LT_BVH_HH
+#include "api.hh"
+#include "bounds.hh"
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+namespace lt
+{
+
+class object;
+class model;
+
+// Dynamic bounding volume hierarchy over objects, in world space. Leaves
+// store slightly enlarged bounds, so that objects moving a little don't
+// need to touch the tree at all. Objects with unknown bounds can't be placed
+// in the tree and are simply returned by every query.
+class LT_API object_bvh
+{
+public:
+    object_bvh();
+    ~object_bvh();
+
+    void insert(object* obj);
+    void remove(object* obj);
+    void clear();
+
+    // Recomputes the world space bounds of the objects whose global
+    // transform generation or model has changed since the last refit, and
+    // moves the ones that have left their leaf bounds. Returns immediately
+    // if no transform or model has changed since the last refit, see
+    // transformable::get_global_revision(). Changes inside a model aren't
+    // noticed, remove and insert the object again for those.
+    void refit();
+
+    // Fraction of the object size by which leaf bounds are enlarged.
+    void set_margin(float margin = 0.1f);
+    float get_margin() const;
+
+    // The queries append candidates whose leaf bounds pass the test to
+    // 'result'. The candidates may be slightly conservative, test the exact
+    // bounds afterwards if it matters.
+    void query(const frustum& f, std::vector<object*>& result) const;
+    void query(vec3 center, float radius, std::vector<object*>& result) const;
+    void query(const aabb& box, std::vector<object*>& result) const;
+
+    // Returns candidates hit by the ray, sorted by the entry distance. 'dir'
+    // need not be normalized; distances are in units of its length.
+    void query(
+        vec3 origin,
+        vec3 dir,
+        std::vector<object*>& result,
+        float max_distance = INFINITY
+    ) const;
+
+    size_t size() const;
+    // Height of the tree, zero when there's at most one leaf.
+    unsigned get_height() const;
+
+private:
+    static constexpr int NONE = -1;
+
+    struct node
+    {
+        aabb bounds;
+        int parent;
+        int left, right;
+        int height;
+        // Only set for leaves.
+        object* obj;
+
+        bool is_leaf() const;
+    };
+
+    int allocate_node();
+    void free_node(int index);
+
+    bool get_world_bounds(object* obj, aabb& bounds) const;
+    void insert_leaf(int leaf);
+    void remove_leaf(int leaf);
+    int balance(int index);
+
+    template<typename F>
+    void traverse(F&& test, std::vector<object*>& result) const;
+
+    std::vector<node> nodes;
+    int root;
+    int free_list;
+    float margin;
+
+    // What the bounds of an object were last computed from.
+    struct entry
+    {
+        // NONE for objects with unknown bounds.
+        int leaf;
+        uint64_t generation;
+        const model* mod;
+    };
+
+    std::unordered_map<object*, entry> entries;
+    std::vector<object*> unbounded;
+    uint64_t refit_revision;
+};
+
+} // namespace lt
+
+#endif
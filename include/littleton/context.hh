@@ -20,8 +20,10 @@
 #define LT_CONTEXT_HH
 #include "api.hh"
 #include "glheaders.hh"
+#include "gl_state.hh"
 #include "math.hh"
 #include <unordered_map>
+#include <map>
 #include <string>
 
 namespace lt
@@ -58,7 +60,22 @@ public:
     // FT_Library* ft = static_cast<FT_Library*>(ctx.freetype());
     void* freetype() const;
 
+    // Cached GL state of this context, use it instead of setting the state
+    // directly.
+    gl_state& get_state();
+
+    // A small id for a set of shader definitions, equal sets get the same
+    // id. Ids start from 1 and are never reused, so they can key shader
+    // caches without comparing the definitions themselves.
+    unsigned get_definitions_id(
+        const std::map<std::string, std::string>& definitions
+    );
+
 protected:
+    // SDL is not initialized when use_sdl is false, as it can fail without a
+    // display.
+    explicit context(bool use_sdl);
+
     void get(
         GLenum pname,
         size_t size,
@@ -70,11 +87,15 @@ protected:
 
 private:
     static unsigned& instances();
+    static unsigned& sdl_instances();
 
     void init();
     void deinit();
 
+    bool use_sdl;
     std::string vendor, renderer;
+    gl_state state;
+    std::map<std::map<std::string, std::string>, unsigned> definitions_ids;
 
     mutable std::unordered_map<
         GLenum /*param*/,
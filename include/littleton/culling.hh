@@ -0,0 +1,89 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LT_CULLING_HH
+#define LT_CULLING_HH
+#include "api.hh"
+#include "bounds.hh"
+#include "math.hh"
+#include <vector>
+#include <cstdint>
+
+namespace lt
+{
+
+class object;
+class object_scene;
+
+// The objects of an object_scene that are visible from at least one of a set
+// of frustums. This is the shared culling stage of the methods drawing
+// objects; build it once and iterate it instead of object_scene::get_objects().
+class LT_API visible_set
+{
+public:
+    struct entry
+    {
+        object* obj;
+        // Cached global transform of the object.
+        mat4 transform;
+        // Bit i is set if vertex group i is visible. Groups past the 64th
+        // are never culled individually.
+        uint64_t group_mask;
+
+        bool is_group_visible(size_t i) const;
+    };
+
+    visible_set();
+
+    // Culls objects against the union of the given frustums. Objects without
+    // a model are skipped entirely and objects with unknown bounds are always
+    // visible. The bounding volume hierarchy of 'objects' is refitted first
+    // if anything has moved, see object_scene::update_bounds().
+    void update(
+        object_scene* objects,
+        const std::vector<frustum>& frustums
+    );
+
+    // Shortcut for a single view-projection matrix.
+    void update(object_scene* objects, const mat4& view_projection);
+
+    // Culls against a sphere instead, e.g. the range of a point light.
+    void update(object_scene* objects, vec3 center, float radius);
+
+    void clear();
+    size_t size() const;
+
+    using const_iterator = std::vector<entry>::const_iterator;
+
+    const_iterator begin() const;
+    const_iterator cbegin() const;
+
+    const_iterator end() const;
+    const_iterator cend() const;
+
+private:
+    template<typename F>
+    void update_impl(F&& test);
+
+    std::vector<entry> entries;
+    std::vector<object*> candidates;
+};
+
+} // namespace lt
+
+#endif
@@ -0,0 +1,114 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LT_DRAW_QUEUE_HH
+#define LT_DRAW_QUEUE_HH
+#include "api.hh"
+#include "culling.hh"
+#include "shader.hh"
+#include "math.hh"
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+namespace lt
+{
+
+class material;
+class primitive;
+class multishader;
+
+// Sorted list of the vertex group draws of a visible_set. Draws are ordered by
+// shader variant, material, mesh and finally front-to-back depth, so that
+// consecutive draws share as much state as possible.
+class LT_API draw_queue
+{
+public:
+    struct command
+    {
+        uint64_t key;
+        // Null when the queue was built without a multishader.
+        shader* s;
+        const material* mat;
+        const primitive* mesh;
+        // Points into the visible_set the queue was built from, so it's only
+        // valid until that set is updated.
+        const visible_set::entry* e;
+    };
+
+    draw_queue();
+
+    // Collects the visible vertex groups and sorts them. The shader variant of
+    // each group is resolved from 'ms' with the 'common' definitions extended
+    // by the material and mesh. Without a multishader only the meshes and
+    // depth are considered, which suits depth-only passes. Depth is measured
+    // as the distance from 'viewer'.
+    void build(
+        const visible_set& visible,
+        vec3 viewer,
+        multishader* ms = nullptr,
+        const shader::definition_map& common = {},
+        bool potentially_transparent_only = false
+    );
+
+    // Binds the shader and applies the material only when they differ from
+    // those of the previous command, then calls
+    // f(const command& c, unsigned& texture_index, bool shader_changed).
+    // The callback issues the actual draw call. Uniforms that are the same
+    // for all draws need only be set when 'shader_changed' is true.
+    template<typename F>
+    void execute(F&& f) const;
+
+    void clear();
+    size_t size() const;
+
+    using const_iterator = std::vector<command>::const_iterator;
+
+    const_iterator begin() const;
+    const_iterator cbegin() const;
+
+    const_iterator end() const;
+    const_iterator cend() const;
+
+private:
+    struct sort_item
+    {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    unsigned get_id(
+        std::unordered_map<const void*, unsigned>& ids,
+        const void* ptr
+    );
+
+    std::vector<command> commands;
+    std::vector<command> unsorted;
+    std::vector<sort_item> items;
+    std::vector<sort_item> tmp;
+
+    std::unordered_map<const void*, unsigned> shader_ids;
+    std::unordered_map<const void*, unsigned> material_ids;
+    std::unordered_map<const void*, unsigned> mesh_ids;
+};
+
+} // namespace lt
+
+#include "draw_queue.tcc"
+
+#endif
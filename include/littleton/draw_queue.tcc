@@ -0,0 +1,55 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "draw_queue.hh"
+#include "material.hh"
+
+namespace lt
+{
+
+template<typename F>
+void draw_queue::execute(F&& f) const
+{
+    const shader* prev_shader = nullptr;
+    const material* prev_material = nullptr;
+    unsigned material_texture_count = 0;
+
+    for(const command& c: commands)
+    {
+        bool shader_changed = c.s != prev_shader;
+        if(shader_changed)
+        {
+            c.s->bind();
+            prev_shader = c.s;
+        }
+
+        if(c.s && (shader_changed || c.mat != prev_material))
+        {
+            material_texture_count = 0;
+            c.mat->apply(c.s, material_texture_count);
+            prev_material = c.mat;
+        }
+
+        // Textures bound by the callback go after the material's, which are
+        // still bound if the material didn't change.
+        unsigned texture_index = material_texture_count;
+        f(c, texture_index, shader_changed);
+    }
+}
+
+} // namespace lt
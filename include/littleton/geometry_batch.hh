@@ -0,0 +1,185 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LT_GEOMETRY_BATCH_HH
+#define LT_GEOMETRY_BATCH_HH
+#include "api.hh"
+#include "glheaders.hh"
+#include "resource.hh"
+#include "shader.hh"
+#include "primitive.hh"
+#include "gpu_buffer.hh"
+#include "bounds.hh"
+#include "math.hh"
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+namespace lt
+{
+
+class object;
+class material;
+class multishader;
+
+// Merges the vertex groups of static objects into shared vertex and index
+// buffers, one arena per vertex format. The transforms of the draws are kept
+// in a storage buffer, so each material bucket of an arena is submitted with
+// a single glMultiDrawElementsIndirect. Shaders must be built with the
+// definitions from update_definitions(), which make generic.vert read the
+// model transform of each draw from the BatchTransforms block. The model and
+// normal matrices given to the shader are then applied on top of it.
+class LT_API geometry_batch: public glresource
+{
+public:
+    // Vertex attribute of the draw index, after the user attributes.
+    static constexpr unsigned DRAW_ID_INDEX = 15;
+    // Storage block binding point of the BatchTransforms block.
+    static constexpr unsigned TRANSFORM_BINDING = 3;
+
+    explicit geometry_batch(context& ctx);
+    geometry_batch(const geometry_batch& other) = delete;
+    ~geometry_batch();
+
+    // Merges the models of 'objects', replacing the previous contents. The
+    // objects are referenced, so they must outlive the batch or be removed
+    // with a new build().
+    void build(const std::vector<object*>& objects);
+
+    // Re-reads the transforms of the objects. Batched objects are meant to
+    // stay still, but this can be called if they do move.
+    void update_transforms();
+
+    void clear();
+    size_t draw_count() const;
+
+    // Determines the visible draws like visible_set::update() does. Draws
+    // with unknown bounds are always visible. Culls are kept per 'view', any
+    // pointer identifying the caller such as the method or render target.
+    // draw() and execute() submit the draws found visible by the latest cull
+    // of the same view, so views can be culled in any order. Each view has
+    // its own indirect buffer.
+    void cull(
+        const std::vector<frustum>& frustums,
+        const void* view = nullptr
+    );
+    void cull(const mat4& view_projection, const void* view = nullptr);
+    void cull(vec3 center, float radius, const void* view = nullptr);
+
+    static void update_definitions(shader::definition_map& def);
+
+    // Draws all visible geometry with 's', which must already be bound.
+    // Materials are ignored, which suits depth-only passes.
+    void draw(shader* s, const void* view = nullptr) const;
+
+    // Binds the shader variant of 'ms' for each material bucket and applies
+    // the material, then calls
+    // f(shader* s, unsigned& texture_index, bool shader_changed) before
+    // submitting the bucket. As with draw_queue, uniforms that are the same
+    // for all draws need only be set when 'shader_changed' is true.
+    template<typename F>
+    void execute(
+        multishader* ms,
+        const shader::definition_map& common,
+        bool potentially_transparent_only,
+        F&& f,
+        const void* view = nullptr
+    ) const;
+
+private:
+    // Layout required by glMultiDrawElementsIndirect
+    struct draw_command
+    {
+        GLuint count;
+        GLuint instance_count;
+        GLuint first_index;
+        GLint base_vertex;
+        GLuint base_instance;
+    };
+
+    struct draw
+    {
+        object* obj;
+        const material* mat;
+        unsigned arena;
+        draw_command command;
+        aabb local_bounds;
+        aabb bounds;
+        mat4 position_decode;
+    };
+
+    // Contiguous range of draws sharing an arena and a material.
+    struct bucket
+    {
+        unsigned arena;
+        const material* mat;
+        size_t first_draw;
+        size_t draw_count;
+    };
+
+    struct arena
+    {
+        // The mesh references the buffers, so it's declared after them in
+        // order to be destroyed first.
+        std::vector<std::unique_ptr<gpu_buffer>> buffers;
+        std::unique_ptr<primitive> mesh;
+    };
+
+    // Range of the visible commands in the indirect buffer of a view.
+    struct visible_range
+    {
+        size_t offset;
+        size_t count;
+    };
+
+    struct view_data
+    {
+        GLuint indirect_buf;
+        std::vector<visible_range> buckets;
+        std::vector<visible_range> arenas;
+    };
+
+    template<typename F>
+    void cull_impl(F&& test, const void* view);
+    const view_data* find_view(const void* view) const;
+
+    static unsigned attribute_size(const gpu_buffer_accessor& accessor);
+
+    void bind_transforms(shader* s) const;
+    void draw_range(
+        const arena& a,
+        const view_data& v,
+        const visible_range& range
+    ) const;
+
+    std::vector<draw> draws;
+    std::vector<bucket> buckets;
+    std::vector<arena> arenas;
+    std::unique_ptr<gpu_buffer> draw_ids;
+
+    // Scratch space of cull_impl().
+    std::vector<draw_command> visible_commands;
+    std::unordered_map<const void*, view_data> views;
+    GLuint transform_buf;
+};
+
+} // namespace lt
+
+#include "geometry_batch.tcc"
+
+#endif
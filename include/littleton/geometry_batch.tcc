@@ -0,0 +1,70 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "geometry_batch.hh"
+#include "material.hh"
+#include "multishader.hh"
+
+namespace lt
+{
+
+template<typename F>
+void geometry_batch::execute(
+    multishader* ms,
+    const shader::definition_map& common,
+    bool potentially_transparent_only,
+    F&& f,
+    const void* view
+) const
+{
+    const view_data* v = find_view(view);
+    if(!v) return;
+
+    shader::definition_map def(common);
+    update_definitions(def);
+    unsigned pass_key = ms->get_pass_key(def);
+
+    const shader* prev_shader = nullptr;
+    for(size_t i = 0; i < buckets.size(); ++i)
+    {
+        const bucket& b = buckets[i];
+        const visible_range& range = v->buckets[i];
+        if(range.count == 0 || !b.mat) continue;
+        if(!b.mat->potentially_transparent() && potentially_transparent_only)
+            continue;
+
+        const arena& a = arenas[b.arena];
+        shader* s = ms->get(pass_key, b.mat, a.mesh.get());
+
+        bool shader_changed = s != prev_shader;
+        if(shader_changed)
+        {
+            s->bind();
+            bind_transforms(s);
+            prev_shader = s;
+        }
+
+        unsigned texture_index = 0;
+        b.mat->apply(s, texture_index);
+        f(s, texture_index, shader_changed);
+
+        draw_range(a, *v, range);
+    }
+}
+
+} // namespace lt
@@ -0,0 +1,127 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LT_GL_STATE_HH
+#define LT_GL_STATE_HH
+#include "api.hh"
+#include "glheaders.hh"
+#include "math.hh"
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+
+namespace lt
+{
+
+// Shadows the GL state that methods change, so that setting a value that is
+// already current skips the GL call. Every value starts out unknown, so the
+// first call always reaches GL. Littleton changes the tracked state only
+// through here; call invalidate() after changing it with GL calls yourself.
+class LT_API gl_state
+{
+public:
+    struct stats
+    {
+        // Calls made through the cache.
+        unsigned calls;
+        // Calls skipped because the value was already set.
+        unsigned redundant;
+    };
+
+    gl_state();
+    gl_state(const gl_state& other) = delete;
+
+    void set_capability(GLenum cap, bool enabled);
+    void enable(GLenum cap);
+    void disable(GLenum cap);
+
+    void blend_func(GLenum sfactor, GLenum dfactor);
+    void depth_func(GLenum func);
+    void depth_mask(bool write);
+    void color_mask(bool r, bool g, bool b, bool a);
+    // Per draw buffer, these always reach GL and make the values for all
+    // buffers unknown.
+    void blend_func(GLuint buf, GLenum sfactor, GLenum dfactor);
+    void color_mask(GLuint buf, bool r, bool g, bool b, bool a);
+    void stencil_func(GLenum func, GLint ref, GLuint mask);
+    void stencil_op(GLenum sfail, GLenum dpfail, GLenum dppass);
+    void stencil_mask(GLuint mask);
+    void front_face(GLenum mode);
+    void viewport(glm::ivec2 offset, glm::uvec2 size);
+
+    void use_program(GLuint program);
+    void bind_vertex_array(GLuint vao);
+    // GL_FRAMEBUFFER binds both the read and the draw framebuffer.
+    void bind_framebuffer(GLenum target, GLuint fbo);
+    // Also makes 'unit' the active texture unit.
+    void bind_texture(GLuint unit, GLenum target, GLuint tex);
+    void bind_sampler(GLuint unit, GLuint sampler);
+
+    // These return -1 when the binding is unknown. get_framebuffer() takes
+    // GL_READ_FRAMEBUFFER or GL_DRAW_FRAMEBUFFER.
+    GLint get_program() const;
+    GLint get_framebuffer(GLenum target) const;
+    GLint get_texture(GLuint unit, GLenum target) const;
+
+    // Call these when deleting objects, GL unbinds them and may reuse the
+    // names.
+    void forget_texture(GLuint tex);
+    void forget_sampler(GLuint sampler);
+    void forget_vertex_array(GLuint vao);
+    void forget_framebuffer(GLuint fbo);
+
+    // Marks all state unknown.
+    void invalidate();
+
+    // Ends the frame for get_frame_stats(). window::present() calls this,
+    // call it yourself with a headless_context.
+    void next_frame();
+    // Counts of the latest finished frame.
+    stats get_frame_stats() const;
+
+private:
+    template<typename T>
+    bool update(std::optional<T>& current, const T& value);
+
+    std::unordered_map<GLenum, bool> capabilities;
+    std::optional<glm::uvec2> blend;
+    std::optional<GLenum> depth;
+    std::optional<bool> depth_write;
+    std::optional<glm::bvec4> color_write;
+    std::optional<glm::uvec3> stencil;
+    std::optional<glm::uvec3> stencil_ops;
+    std::optional<GLuint> stencil_write;
+    std::optional<GLenum> winding;
+    std::optional<glm::ivec4> view;
+
+    std::optional<GLuint> program;
+    std::optional<GLuint> vao;
+    std::optional<GLuint> read_fbo;
+    std::optional<GLuint> draw_fbo;
+    std::optional<GLuint> active_unit;
+    // Keyed by unit << 32 | target.
+    std::unordered_map<uint64_t, GLuint> textures;
+    std::unordered_map<GLuint, GLuint> samplers;
+
+    stats counts;
+    stats frame_counts;
+};
+
+} // namespace lt
+
+#endif
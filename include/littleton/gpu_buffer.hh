@@ -21,6 +21,7 @@
 #include "api.hh"
 #include "glheaders.hh"
 #include "resource.hh"
+#include <memory>
 #include <vector>
 
 namespace lt
@@ -48,7 +49,7 @@ public:
     // Only useful if you need to bind several at once for some reason
     void bind(unsigned index) const;
 
-    // Creates a lazily loaded buffer. Takes ownership of the pointers.
+    // Creates a lazily loaded buffer. The data is copied.
     static gpu_buffer* create(
         context& ctx,
         GLenum target,
@@ -57,6 +58,34 @@ public:
         GLenum usage = GL_STATIC_DRAW
     );
 
+    // Takes the data without copying it. If the buffer is not evictable, the
+    // data is released after the first upload and the buffer can't be loaded
+    // again once unloaded.
+    static gpu_buffer* create(
+        context& ctx,
+        GLenum target,
+        std::vector<uint8_t>&& data,
+        GLenum usage = GL_STATIC_DRAW,
+        bool evictable = true
+    );
+
+    // Shares data owned by something else, such as a mapped file. Use the
+    // aliasing constructor of std::shared_ptr to point inside it.
+    static gpu_buffer* create(
+        context& ctx,
+        GLenum target,
+        size_t size,
+        std::shared_ptr<const void> data,
+        GLenum usage = GL_STATIC_DRAW,
+        bool evictable = true
+    );
+
+    // Bytes kept in CPU memory for loading the buffer again. Shared data is
+    // counted in full by each buffer using it.
+    virtual size_t get_cpu_memory_usage() const;
+    // Zero when not loaded, doesn't load the buffer.
+    size_t get_gpu_memory_usage() const;
+
     template<typename T>
     std::vector<T> read() const;
 
@@ -0,0 +1,87 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LT_HEADLESS_CONTEXT_HH
+#define LT_HEADLESS_CONTEXT_HH
+#include "api.hh"
+#include "context.hh"
+#include "framebuffer.hh"
+#include "math.hh"
+#include <memory>
+#include <vector>
+
+namespace lt
+{
+
+// A context without a window or a display, for rendering on servers and
+// build machines. Everything is drawn into get_framebuffer(), which takes the
+// place of the window as the final render target.
+class LT_API headless_context: public context
+{
+public:
+    enum backend
+    {
+        // EGL if it works, OSMesa otherwise.
+        AUTO = 0,
+        // Surfaceless EGL, through EGL_EXT_platform_device when available.
+        EGL,
+        // Always renders on the CPU. Requires a GLEW built with GLEW_OSMESA.
+        OSMESA
+    };
+
+    struct params
+    {
+        glm::uvec2 size = glm::uvec2(640, 480);
+        bool srgb = true;
+        unsigned samples = 0;
+        backend api = AUTO;
+        // Picks a software EGL device such as llvmpipe over the GPU.
+        bool software = false;
+    };
+
+    headless_context(const params& p);
+    headless_context(const headless_context& other) = delete;
+    headless_context(headless_context&& other) = delete;
+    ~headless_context();
+
+    framebuffer& get_framebuffer();
+    backend get_backend() const;
+
+    // Waits until all rendering is done.
+    void finish();
+
+    // Reads the color buffer as tightly packed RGBA8, bottom row first like
+    // OpenGL does. dst must fit size.x * size.y * 4 bytes. Multisampled
+    // buffers are resolved first.
+    void read_pixels(void* dst);
+    std::vector<uint8_t> read_pixels();
+
+private:
+    struct platform;
+
+    void init_egl(const params& p);
+    void init_osmesa(const params& p);
+
+    std::unique_ptr<platform> plat;
+    backend api;
+    std::unique_ptr<framebuffer> target;
+    std::unique_ptr<framebuffer> resolve;
+};
+
+} // namespace lt
+#endif
@@ -0,0 +1,117 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LT_INSTANCED_OBJECT_HH
+#define LT_INSTANCED_OBJECT_HH
+#include "api.hh"
+#include "glheaders.hh"
+#include "resource.hh"
+#include "shader.hh"
+#include "bounds.hh"
+#include "math.hh"
+#include <vector>
+#include <cstdint>
+
+namespace lt
+{
+
+class model;
+class primitive;
+class multishader;
+class transformable_node;
+
+// Draws one model at many transforms, each vertex group with a single
+// instanced draw call. The transforms of the instances are read from nodes
+// into the same BatchTransforms block that geometry_batch uses, and an
+// instanced vertex attribute picks the transform of each visible instance.
+// Shaders must therefore be built with geometry_batch::update_definitions().
+class LT_API instanced_object: public glresource
+{
+public:
+    explicit instanced_object(context& ctx, const model* mod = nullptr);
+    instanced_object(const instanced_object& other) = delete;
+    ~instanced_object();
+
+    // As with object::set_model(), 'mod' must outlive this object or be
+    // unset before its destruction.
+    void set_model(const model* mod = nullptr);
+    const model* get_model() const;
+
+    // The nodes are referenced, so they must outlive this object or be
+    // removed before their destruction.
+    void add_instance(const transformable_node* node);
+    void remove_instance(const transformable_node* node);
+    void clear_instances();
+    size_t instance_count() const;
+
+    void set_instances(const std::vector<const transformable_node*>& nodes);
+    const std::vector<const transformable_node*>& get_instances() const;
+
+    // Re-reads the transforms of all instances. Culling already re-uploads
+    // the instances whose node generation changed, so this is rarely needed.
+    void update_transforms();
+
+    // Determines the visible instances like visible_set::update() does.
+    // Instances of a model with unknown bounds are always visible. Only the
+    // instances found visible by the latest cull are drawn. Instances that
+    // moved since the previous cull are refreshed first.
+    void cull(const std::vector<frustum>& frustums);
+    void cull(const mat4& view_projection);
+    void cull(vec3 center, float radius);
+
+    size_t visible_count() const;
+
+    // Draws all visible instances with 's', which must already be bound.
+    // Materials are ignored, which suits depth-only passes.
+    void draw(shader* s) const;
+
+    // Same as geometry_batch::execute(), but with one call per vertex group
+    // of the model.
+    template<typename F>
+    void execute(
+        multishader* ms,
+        const shader::definition_map& common,
+        bool potentially_transparent_only,
+        F&& f
+    ) const;
+
+private:
+    template<typename F>
+    void cull_impl(F&& test);
+
+    void refresh_transforms();
+    void bind_transforms(shader* s) const;
+    void draw_group(const primitive* mesh) const;
+
+    const model* mod;
+    std::vector<const transformable_node*> nodes;
+    std::vector<aabb> bounds;
+    // Node generations the uploaded transforms were read at.
+    std::vector<uint64_t> generations;
+    std::vector<uint32_t> visible;
+    bool transforms_outdated;
+
+    GLuint transform_buf;
+    GLuint visible_buf;
+};
+
+} // namespace lt
+
+#include "instanced_object.tcc"
+
+#endif
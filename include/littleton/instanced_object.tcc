@@ -0,0 +1,69 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "instanced_object.hh"
+#include "geometry_batch.hh"
+#include "material.hh"
+#include "model.hh"
+#include "multishader.hh"
+
+namespace lt
+{
+
+template<typename F>
+void instanced_object::execute(
+    multishader* ms,
+    const shader::definition_map& common,
+    bool potentially_transparent_only,
+    F&& f
+) const
+{
+    if(!mod || visible.empty()) return;
+
+    shader::definition_map def(common);
+    geometry_batch::update_definitions(def);
+    unsigned pass_key = ms->get_pass_key(def);
+
+    const shader* prev_shader = nullptr;
+    for(const model::vertex_group& group: *mod)
+    {
+        if(!group.mat || !group.mesh) continue;
+        if(
+            !group.mat->potentially_transparent() &&
+            potentially_transparent_only
+        ) continue;
+
+        shader* s = ms->get(pass_key, group.mat, group.mesh);
+
+        bool shader_changed = s != prev_shader;
+        if(shader_changed)
+        {
+            s->bind();
+            bind_transforms(s);
+            prev_shader = s;
+        }
+
+        unsigned texture_index = 0;
+        group.mat->apply(s, texture_index);
+        f(s, texture_index, shader_changed);
+
+        draw_group(group.mesh);
+    }
+}
+
+} // namespace lt
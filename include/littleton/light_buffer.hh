@@ -0,0 +1,112 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LT_LIGHT_BUFFER_HH
+#define LT_LIGHT_BUFFER_HH
+#include "api.hh"
+#include "glheaders.hh"
+#include "resource.hh"
+#include "math.hh"
+#include <vector>
+#include <string>
+
+namespace lt
+{
+
+class light_scene;
+class shader;
+
+// Shader storage buffer containing the lights of a light_scene, in the layout
+// of light_buffer.glsl. The storage is allocated once and split into
+// segments that are written in turn, with fences guarding segments that may
+// still be read by earlier draws. When persistent mapping is available, the
+// lights are written directly into the mapped buffer.
+class LT_API light_buffer: public glresource
+{
+public:
+    // Each update() uses up one segment, so the segment count should cover
+    // the updates of a couple of frames.
+    explicit light_buffer(context& ctx, unsigned segment_count = 3);
+    light_buffer(const light_buffer& other) = delete;
+    ~light_buffer();
+
+    // Writes the lights, transformed by 'view', into the next segment. Lights
+    // flagged in the 'skip' vectors are left out, the vectors may also be
+    // empty.
+    void update(
+        light_scene* lights,
+        const mat4& view,
+        const std::vector<bool>& skip_point_lights = {},
+        const std::vector<bool>& skip_spotlights = {},
+        const std::vector<bool>& skip_directional_lights = {}
+    );
+
+    // Binds the latest segment to the given storage block binding point.
+    void bind(unsigned bind_point = 0) const;
+
+    // Binds the latest segment and points the block of 's' to it.
+    void set(
+        shader* s,
+        unsigned bind_point = 0,
+        const std::string& block_name = "Lights"
+    ) const;
+
+    unsigned get_point_light_count() const;
+    unsigned get_spotlight_count() const;
+    unsigned get_directional_light_count() const;
+
+private:
+    struct header
+    {
+        int32_t point_light_count;
+        int32_t spotlight_count;
+        int32_t directional_light_count;
+        int32_t padding;
+    };
+
+    // Spotlights store the cutoff in position.w and the falloff exponent in
+    // direction.w.
+    struct light_data
+    {
+        vec4 color;
+        vec4 position;
+        vec4 direction;
+    };
+
+    void reserve(size_t light_count);
+    void release();
+
+    GLuint buf;
+    uint8_t* mapping;
+    std::vector<uint8_t> staging;
+    std::vector<GLsync> fences;
+
+    size_t capacity;
+    size_t segment_size;
+    unsigned segment_count;
+    unsigned segment;
+    bool written;
+
+    unsigned point_light_count;
+    unsigned spotlight_count;
+    unsigned directional_light_count;
+};
+
+} // namespace lt
+
+#endif
@@ -0,0 +1,100 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LT_LIGHT_CLUSTERS_HH
+#define LT_LIGHT_CLUSTERS_HH
+#include "api.hh"
+#include "glheaders.hh"
+#include "resource.hh"
+#include "shader.hh"
+#include "math.hh"
+
+namespace lt
+{
+
+class resource_pool;
+class multishader;
+class sampler;
+class camera;
+class gbuffer;
+class light_buffer;
+
+// Bins the point lights and spotlights of a light_buffer into a froxel grid,
+// that is, the view frustum split into screen tiles and exponentially
+// distributed depth slices. Shaders including light_clusters.glsl can then
+// evaluate only the lights reaching the cluster of the fragment.
+class LT_API light_clusters: public glresource
+{
+public:
+    // The depth slices are distributed between the near plane and max_depth
+    // or the far plane, whichever is closer. The last slice extends to
+    // infinity. Lights beyond max_cluster_lights are dropped from a cluster.
+    light_clusters(
+        resource_pool& pool,
+        uvec3 grid_size = uvec3(16, 9, 24),
+        unsigned max_cluster_lights = 256,
+        float max_depth = 1000.0f
+    );
+    light_clusters(const light_clusters& other) = delete;
+    ~light_clusters();
+
+    // Assigns the lights of the latest light_buffer update to clusters. The
+    // lights must be in the view space of 'cam'. The radius of a light is
+    // the distance where its brightness falls below 'cutoff', so 'cutoff'
+    // must be positive for any culling to happen. If 'depth' is given, only
+    // clusters containing geometry in it are filled.
+    void build(
+        const light_buffer& lights,
+        const camera* cam,
+        uvec2 size,
+        float cutoff,
+        const gbuffer* depth = nullptr
+    );
+
+    // Binds the clusters to the given storage block binding point and sets
+    // the lookup uniforms of 's'.
+    void set(shader* s, unsigned bind_point = 1) const;
+
+    void update_definitions(shader::definition_map& def) const;
+
+    uvec3 get_grid_size() const;
+    unsigned get_max_cluster_lights() const;
+
+private:
+    void set_grid(shader* s) const;
+    void reserve();
+    void release();
+
+    multishader* cluster_shader;
+    const sampler& fb_sampler;
+
+    uvec3 grid_size;
+    unsigned max_cluster_lights;
+    float max_depth;
+
+    GLuint clusters_buf;
+    GLuint active_buf;
+
+    // Parameters of the latest build()
+    vec2 tile_size;
+    vec2 depth_info;
+};
+
+} // namespace lt
+
+#endif
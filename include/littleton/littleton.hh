@@ -21,28 +21,43 @@
 
 #include "about.hh"
 #include "animated.hh"
+#include "bounds.hh"
+#include "bvh.hh"
 #include "camera.hh"
 #include "common_resources.hh"
 #include "context.hh"
+#include "culling.hh"
 #include "doublebuffer.hh"
+#include "draw_queue.hh"
 #include "environment_map.hh"
 #include "font.hh"
 #include "framebuffer.hh"
 #include "framebuffer_pool.hh"
 #include "gbuffer.hh"
+#include "geometry_batch.hh"
+#include "gl_state.hh"
 #include "glheaders.hh"
 #include "gpu_buffer.hh"
+#include "headless_context.hh"
+#include "instanced_object.hh"
 #include "light.hh"
+#include "light_buffer.hh"
+#include "light_clusters.hh"
 #include "loaders.hh"
 #include "loaner.hh"
 #include "material.hh"
 #include "math.hh"
+#include "mesh_optimizer.hh"
 #include "model.hh"
 #include "multishader.hh"
 #include "object.hh"
 #include "pipeline.hh"
 #include "primitive.hh"
+#include "profiler.hh"
+#include "readback_queue.hh"
+#include "render_graph.hh"
 #include "render_target.hh"
+#include "residency_manager.hh"
 #include "resource.hh"
 #include "resource_pool.hh"
 #include "sampler.hh"
@@ -55,11 +70,15 @@
 #include "simple_pipeline.hh"
 #include "spherical_gaussians.hh"
 #include "sprite.hh"
+#include "staging_ring.hh"
 #include "stencil_handler.hh"
 #include "texture.hh"
+#include "texture_compression.hh"
 #include "timer.hh"
+#include "transform_arena.hh"
 #include "transformable.hh"
 #include "uniform.hh"
+#include "vertex_packing.hh"
 #include "window.hh"
 
 #include "method/apply_sg.hh"
@@ -19,6 +19,7 @@
 #ifndef LT_LOADERS_HH
 #define LT_LOADERS_HH
 #include "api.hh"
+#include "vertex_packing.hh"
 #include <string>
 #include <unordered_map>
 
@@ -29,10 +30,36 @@ class resource_pool;
 class scene_graph;
 
 // GLTF files may have several scenes; return them by name.
+// optimize_index_order reorders the primitives whose tangents are generated
+// for vertex cache efficiency and reduced overdraw. Primitives with only the
+// common attributes are interleaved into a buffer of their own in the given
+// format. Unless the textures and buffers are evictable, their CPU copies are
+// dropped once uploaded and they can't be loaded again after unloading.
 LT_API std::unordered_map<std::string, scene_graph> load_gltf(
     resource_pool& pool,
     const std::string& path,
     const std::string& data_prefix = "",
+    bool ignore_duplicates = true,
+    bool optimize_index_order = true,
+    const vertex_format& format = vertex_format(),
+    bool evictable = true
+);
+
+// Writes the given scenes and every resource they use into a single file
+// that load_baked_scene() can use without any parsing. Vertex, index and
+// texture data (including all mipmap levels) is read back from the GPU, so
+// this requires a current context. Only 2D textures are supported.
+LT_API void save_baked_scene(
+    const resource_pool& pool,
+    const std::unordered_map<std::string, scene_graph>& scenes,
+    const std::string& path
+);
+
+// Maps a file written by save_baked_scene(). Resources upload directly from
+// the mapping when they are loaded. Throws if the file is malformed.
+LT_API std::unordered_map<std::string, scene_graph> load_baked_scene(
+    resource_pool& pool,
+    const std::string& path,
     bool ignore_duplicates = true
 );
 
@@ -37,6 +37,10 @@ public:
     void update_definitions(shader::definition_map& def) const;
     void apply(shader* s, unsigned& texture_index) const;
 
+    // Materials with equal feature keys produce the same definitions in
+    // update_definitions().
+    uint32_t get_feature_key() const;
+
     bool potentially_transparent() const;
 
     using sampler_tex = std::pair<const sampler*, const texture*>;
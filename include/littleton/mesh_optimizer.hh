@@ -0,0 +1,83 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LT_MESH_OPTIMIZER_HH
+#define LT_MESH_OPTIMIZER_HH
+#include "api.hh"
+#include "math.hh"
+#include <cstdint>
+#include <vector>
+
+namespace lt
+{
+
+// Per-vertex data of one attribute. A stride of zero means that the data is
+// tightly packed.
+struct LT_API vertex_stream
+{
+    vertex_stream(const void* data, size_t size, size_t stride = 0);
+
+    const void* data;
+    size_t size;
+    size_t stride;
+};
+
+// Merges bitwise identical vertices of unindexed triangle data. Returns the
+// new index buffer, and remap receives the original index of each unique
+// vertex. Use remap_vertices() to compact the vertex data accordingly.
+LT_API std::vector<uint32_t> weld_vertices(
+    size_t vertex_count,
+    const std::vector<vertex_stream>& streams,
+    std::vector<uint32_t>& remap
+);
+
+// Replaces data with data[remap[0]], data[remap[1]], ...
+template<typename T>
+void remap_vertices(std::vector<T>& data, const std::vector<uint32_t>& remap);
+
+// Reorders triangles to improve post-transform vertex cache hit rate, using
+// Tom Forsyth's linear-speed vertex cache optimization.
+LT_API void optimize_vertex_cache(
+    std::vector<uint32_t>& indices,
+    size_t vertex_count
+);
+
+// Sorts clusters of triangles so that outwards-facing ones are drawn first,
+// reducing overdraw. Clusters are only split where the vertex cache
+// efficiency stays within threshold times that of the current order, so this
+// should be run after optimize_vertex_cache().
+LT_API void optimize_overdraw(
+    std::vector<uint32_t>& indices,
+    const vec3* positions,
+    size_t vertex_count,
+    float threshold = 1.05f
+);
+
+// Reorders vertices to the order they are first referenced in and removes
+// unreferenced ones. Updates indices and returns the remap for
+// remap_vertices().
+LT_API std::vector<uint32_t> optimize_vertex_fetch(
+    std::vector<uint32_t>& indices,
+    size_t vertex_count
+);
+
+} // namespace lt
+
+#include "mesh_optimizer.tcc"
+
+#endif
@@ -0,0 +1,33 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "mesh_optimizer.hh"
+
+namespace lt
+{
+
+template<typename T>
+void remap_vertices(std::vector<T>& data, const std::vector<uint32_t>& remap)
+{
+    std::vector<T> result(remap.size());
+    for(size_t i = 0; i < remap.size(); ++i)
+        result[i] = data[remap[i]];
+    data.swap(result);
+}
+
+} // namespace lt
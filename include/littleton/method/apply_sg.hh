@@ -65,6 +65,8 @@ public:
         const options& opt = {}
     );
 
+    void set_gbuffer(gbuffer& buf);
+
     void execute() override;
 
 private:
@@ -53,6 +53,8 @@ public:
         const options& opt = {}
     );
 
+    void set_src(texture* src);
+
     void execute() override;
 
 protected:
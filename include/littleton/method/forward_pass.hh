@@ -22,6 +22,8 @@
 #include "../pipeline.hh"
 #include "../stencil_handler.hh"
 #include "../scene.hh"
+#include "../light_buffer.hh"
+#include "../light_clusters.hh"
 
 namespace lt
 {
@@ -47,6 +49,12 @@ LT_OPTIONS(forward_pass)
     bool render_opaque = true;
     // Whether to render transparent objects.
     bool render_transparent = true;
+    // If true, unshadowed point lights and spotlights are binned into a
+    // froxel grid and each fragment only evaluates the lights of its
+    // cluster. Ignored for cubemap targets.
+    bool clustered = false;
+    // Brightness at which the range of a light ends when clustering.
+    float cutoff = 5/256.0f;
 };
 
 class shadow_method;
@@ -80,6 +88,8 @@ private:
     multishader* cubemap_forward_shader;
 
     gbuffer* gbuf;
+    light_buffer light_buf;
+    light_clusters clusters;
 };
 
 } // namespace lt::method
@@ -24,6 +24,8 @@
 #include "../sampler.hh"
 #include "../scene.hh"
 #include "../stencil_handler.hh"
+#include "../light_buffer.hh"
+#include "../light_clusters.hh"
 #include "shadow_method.hh"
 
 namespace lt
@@ -56,6 +58,11 @@ LT_OPTIONS(lighting_pass)
 
     // If true, highlights the light volumes by drawing them slightly brighter
     bool visualize_light_volumes = false;
+
+    // If true, unshadowed point lights and spotlights are binned into a
+    // froxel grid and shaded in a single full-screen pass instead of one
+    // light volume each. Lights are only culled with a positive cutoff.
+    bool clustered = false;
 };
 
 class shadow_method;
@@ -74,6 +81,8 @@ public:
         const options& opt = {}
     );
 
+    void set_gbuffer(gbuffer& buf);
+
     void execute() override;
 
 private:
@@ -84,6 +93,8 @@ private:
 
     const primitive& quad;
     const sampler& fb_sampler;
+    light_buffer light_buf;
+    light_clusters clusters;
 };
 
 } // namespace lt::method
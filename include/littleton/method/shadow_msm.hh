@@ -190,6 +190,9 @@ private:
     shader* depth_shader;
     shader* cubemap_depth_shader;
     shader* perspective_depth_shader;
+    shader* batched_depth_shader;
+    shader* batched_cubemap_depth_shader;
+    shader* batched_perspective_depth_shader;
 
     shader* vertical_blur_shader;
     shader* horizontal_blur_shader;
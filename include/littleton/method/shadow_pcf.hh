@@ -207,6 +207,9 @@ private:
     shader* depth_shader;
     shader* cubemap_depth_shader;
     shader* perspective_depth_shader;
+    shader* batched_depth_shader;
+    shader* batched_cubemap_depth_shader;
+    shader* batched_perspective_depth_shader;
     const texture& shadow_noise_2d;
     const texture& shadow_noise_3d;
     const texture& kernel;
@@ -63,6 +63,8 @@ public:
         const options& opt = {}
     );
 
+    void set_gbuffer(gbuffer& buf);
+
     void execute() override;
 
 protected:
@@ -49,6 +49,8 @@ public:
         const options& opt = {}
     );
 
+    void set_src(texture* src);
+
     void execute() override;
 
 private:
@@ -19,6 +19,7 @@
 #ifndef LT_MODEL_HH
 #define LT_MODEL_HH
 #include "api.hh"
+#include "bounds.hh"
 #include <vector>
 #include <cstddef>
 
@@ -30,6 +31,8 @@ class primitive;
 class LT_API model
 {
 public:
+    model();
+
     struct vertex_group
     {
         const material* mat;
@@ -44,6 +47,13 @@ public:
     void remove_vertex_group(size_t i);
     const vertex_group& operator[](size_t i) const;
 
+    // Union of the bounding boxes of the vertex groups. The bounds are
+    // gathered when vertex groups are added or removed, so set the bounding
+    // boxes of the primitives before adding them. If any primitive has
+    // unknown bounds, so does the whole model.
+    bool is_bounded() const;
+    const aabb& get_bounding_box() const;
+
     using iterator = std::vector<vertex_group>::iterator;
     using const_iterator = std::vector<vertex_group>::const_iterator;
 
@@ -56,7 +66,11 @@ public:
     const_iterator cend() const;
 
 private:
+    void update_bounds();
+
     std::vector<vertex_group> groups;
+    aabb bounds;
+    bool bounded;
 }; 
 
 } // namespace lt
@@ -29,6 +29,9 @@
 namespace lt
 {
 
+class material;
+class primitive;
+
 class LT_API multishader: public glresource
 {
 public:
@@ -57,7 +60,35 @@ public:
 
     shader* get(const shader::definition_map& definitions = {}) const;
 
+    // Registers the definitions shared by all draws of a pass, returning a
+    // key for the get() below. Call once per pass, not per draw.
+    unsigned get_pass_key(const shader::definition_map& definitions) const;
+
+    // Returns the variant for the pass definitions extended by the
+    // definitions of the material and mesh, either of which may be null.
+    // Variants are cached by the feature keys of the material and mesh, so
+    // no definition maps are built after the first lookup.
+    shader* get(
+        unsigned pass_key,
+        const material* mat,
+        const primitive* mesh
+    ) const;
+
 private:
+    struct variant_key
+    {
+        unsigned pass;
+        uint32_t material;
+        uint64_t mesh;
+
+        bool operator==(const variant_key& other) const;
+    };
+
+    struct variant_key_hash
+    {
+        size_t operator()(const variant_key& key) const;
+    };
+
     shader::source source;
 
     std::vector<std::string> include_path;
@@ -68,6 +99,14 @@ private:
         std::unique_ptr<shader>,
         boost::hash<shader::definition_map>
     > cache;
+
+    mutable std::vector<shader::definition_map> passes;
+    mutable std::unordered_map<
+        shader::definition_map,
+        unsigned,
+        boost::hash<shader::definition_map>
+    > pass_keys;
+    mutable std::unordered_map<variant_key, shader*, variant_key_hash> variants;
 };
 
 } // namespace lt
@@ -36,12 +36,14 @@ public:
 };
 
 class render_target;
+class profiler;
 class LT_API target_method: public pipeline_method
 {
 public:
     explicit target_method(render_target& target);
 
     render_target& get_target();
+    void set_target(render_target& target);
 
     // Call this from the deriving method with target_method::execute().
     // You can also bind the target yourself if you want to.
@@ -112,12 +114,34 @@ public:
     ~pipeline();
 
     void execute();
+    // Waits for the GPU to finish each method, use execute(profiler&) to
+    // measure without stalling.
     void execute(std::vector<double>& timing);
+    // Measures each method as a scope of the profiler, which is active
+    // during the call. Call profiler::next_frame() yourself.
+    void execute(profiler& prof);
 
     std::string get_name(size_t i) const;
     std::string get_name() const override;
+
+    // Number of shaders compiled by method i during the latest execute().
+    // Compiling in the middle of a frame causes a hitch, so this should stay
+    // at zero once every shader variant has been used.
+    unsigned get_shader_compile_count(size_t i) const;
+    // Number of shaders compiled by all methods during the latest execute().
+    unsigned get_shader_compile_count() const;
+    // Number of execute() calls that have compiled any shaders.
+    unsigned get_hitch_count() const;
+
 private:
+    // Records the compiles since 'compile_count' and checks for GL errors.
+    void finish_method(unsigned i, unsigned compile_count);
+
     std::vector<pipeline_method*> methods;
+    // Cached for the profiler, get_name() demangles every time.
+    std::vector<std::string> method_names;
+    std::vector<unsigned> shader_compiles;
+    unsigned hitch_count;
 };
 
 } // namespace lt
@@ -23,6 +23,7 @@
 #include "resource.hh"
 #include "shader.hh"
 #include "gpu_buffer.hh"
+#include "bounds.hh"
 #include <map>
 
 namespace lt
@@ -31,6 +32,7 @@ namespace lt
 class LT_API gpu_buffer_accessor
 {
 friend class primitive;
+friend class geometry_batch;
 public:
     gpu_buffer_accessor();
 
@@ -40,13 +42,22 @@ public:
         GLenum type = GL_FLOAT,
         bool normalized = false,
         size_t stride = 0,
-        size_t offset = 0
+        size_t offset = 0,
+        bool octahedral = false
     );
     ~gpu_buffer_accessor();
 
     bool is_valid() const;
     size_t get_element_count() const;
 
+    const gpu_buffer* get_buffer() const;
+    unsigned get_components() const;
+    GLenum get_type() const;
+    bool is_normalized() const;
+    size_t get_stride() const;
+    size_t get_offset() const;
+    bool is_octahedral() const;
+
 private:
     void setup_vertex_attrib(unsigned index) const;
     
@@ -56,10 +67,14 @@ private:
     bool normalized;
     size_t stride;
     size_t offset;
+    // Unit vectors in octahedral mapping, decoded by shaders as defined in
+    // primitive::update_definitions().
+    bool octahedral;
 };
 
 class LT_API primitive: public resource, public glresource
 {
+friend class geometry_batch;
 public:
     struct attribute
     {
@@ -77,6 +92,9 @@ public:
     static const attribute UV2;
     static const attribute UV3;
     static constexpr unsigned USER_INDEX = 7;
+    // Constant attributes that decode quantized positions.
+    static constexpr unsigned POSITION_SCALE_INDEX = 13;
+    static constexpr unsigned POSITION_OFFSET_INDEX = 14;
 
     explicit primitive(context& ctx);
     primitive(
@@ -91,10 +109,32 @@ public:
 
     void update_definitions(shader::definition_map& def) const;
 
+    // Id of the definitions that update_definitions() adds, from
+    // context::get_definitions_id(). Primitives have equal feature keys
+    // exactly when their definitions are equal.
+    uint64_t get_feature_key() const;
+
+    size_t get_index_count() const;
+    const gpu_buffer_accessor& get_index() const;
+    const std::map<attribute, gpu_buffer_accessor>& get_attributes() const;
+
     GLuint get_vao() const;
     void draw() const;
+    void draw_instanced(size_t instance_count) const;
     GLenum get_mode() const;
 
+    // Object-space bounds of the vertex positions, used for culling. Empty
+    // bounds mean that they are unknown and the primitive is never culled.
+    void set_bounding_box(const aabb& bounds);
+    const aabb& get_bounding_box() const;
+
+    // Quantized positions are multiplied by scale and offset by offset in
+    // the vertex shader. get_position_decode() gives the same as a matrix.
+    void set_position_decode(vec3 scale, vec3 offset);
+    vec3 get_position_scale() const;
+    vec3 get_position_offset() const;
+    mat4 get_position_decode() const;
+
     // Creates a lazily loaded buffer. Takes ownership of the pointers.
     static primitive* create(
         context& ctx,
@@ -113,12 +153,19 @@ protected:
     ) const;
 
     void basic_unload() const;
+    void update_feature_key() const;
+    void set_position_decode_attributes() const;
 
     mutable GLuint vao;
     mutable size_t index_count;
     mutable GLenum mode;
     mutable gpu_buffer_accessor index;
     mutable std::map<attribute, gpu_buffer_accessor> attribs;
+    mutable uint64_t feature_key;
+    mutable shader::definition_map feature_definitions;
+    aabb bounds;
+    vec3 position_scale;
+    vec3 position_offset;
 };
 
 } // namespace lt
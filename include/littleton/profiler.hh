@@ -0,0 +1,149 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LT_PROFILER_HH
+#define LT_PROFILER_HH
+#include "api.hh"
+#include "glheaders.hh"
+#include "resource.hh"
+#include "timer.hh"
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lt
+{
+
+// Records the CPU and GPU time of nested, named scopes per frame. GPU times
+// come from timestamp queries that are only read once the GPU has passed
+// them, at least 'latency' frames later, so profiling never waits for the
+// GPU. Frames whose queries are still unavailable when their queries are
+// needed again lose their GPU times instead.
+//
+// pipeline::execute(profiler&) makes the profiler active and measures each
+// method. Methods can measure parts of themselves with profiler::scope.
+class LT_API profiler: public glresource
+{
+public:
+    // Milliseconds over the recorded frames in which the scope ran. Multiple
+    // runs of a scope during a frame are summed.
+    struct stats
+    {
+        double min;
+        double avg;
+        double p99;
+        double last;
+    };
+
+    struct scope_stats
+    {
+        // Names of the enclosing scopes and this one, separated by '/'.
+        std::string path;
+        unsigned depth;
+        unsigned frames;
+        stats cpu;
+        // All zero if no GPU times were recorded.
+        stats gpu;
+    };
+
+    // Measures the enclosing block with the active profiler. Does nothing
+    // when no profiler is active.
+    class LT_API scope
+    {
+    public:
+        explicit scope(const char* name);
+        scope(const scope& other) = delete;
+        ~scope();
+
+    private:
+        profiler* prof;
+    };
+
+    profiler(context& ctx, unsigned latency = 3, unsigned history = 120);
+    profiler(const profiler& other) = delete;
+    ~profiler();
+
+    void begin(const std::string& name);
+    void end();
+
+    // Call once per frame after the last scope has ended.
+    void next_frame();
+
+    // Ordered by the first appearance of each scope.
+    std::vector<scope_stats> get_stats() const;
+
+    // Writes the recorded frames in Chrome's trace event format, loadable in
+    // chrome://tracing and Perfetto. GPU times are shown as a separate thread.
+    void write_trace(const std::string& path) const;
+
+    static profiler* get_active();
+    static void set_active(profiler* prof);
+
+private:
+    struct event
+    {
+        unsigned key;
+        // Nanoseconds since the profiler was created.
+        uint64_t cpu_start;
+        uint64_t cpu_end;
+        // Nanoseconds in the CPU clock, zero if not measured.
+        uint64_t gpu_start;
+        uint64_t gpu_end;
+    };
+
+    struct frame
+    {
+        std::vector<event> events;
+        std::vector<GLuint> queries;
+        // Index of the latest timestamp issued. Queries complete in issue
+        // order, so its availability covers the whole frame.
+        size_t last_query;
+        bool pending;
+    };
+
+    struct key_info
+    {
+        std::string path;
+        std::string name;
+        unsigned depth;
+    };
+
+    static profiler*& active();
+
+    uint64_t now() const;
+    void collect(frame& f, bool available);
+
+    std::vector<frame> frames;
+    unsigned current;
+    std::vector<unsigned> open;
+
+    std::vector<key_info> keys;
+    std::unordered_map<std::string, unsigned> key_indices;
+
+    unsigned history;
+    std::deque<std::vector<event>> recorded;
+
+    time_point start_time;
+    // GPU timestamp matching start_time.
+    int64_t gpu_start_time;
+};
+
+} // namespace lt
+
+#endif
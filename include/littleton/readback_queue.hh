@@ -0,0 +1,167 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LT_READBACK_QUEUE_HH
+#define LT_READBACK_QUEUE_HH
+#include "api.hh"
+#include "glheaders.hh"
+#include "resource.hh"
+#include "math.hh"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace lt
+{
+
+class render_target;
+class texture;
+
+// Reads pixels back from render targets and textures without stalling the
+// pipeline. Each read goes into a slot of a pixel pack buffer and is fenced;
+// poll() picks up the reads the GPU has finished. Copying the data out of the
+// slot and converting it happens on background threads, and the results are
+// handed out by the following poll()s.
+//
+// Must only be used from the GL thread, callbacks are called from poll().
+class LT_API readback_queue: public glresource
+{
+public:
+    enum conversion
+    {
+        // The data is given as it was read.
+        NONE = 0,
+        // Normalized to RGBA with 8-bit unsigned components.
+        RGBA8,
+        // RGBA with 32-bit float components.
+        RGBA32F
+    };
+
+    struct result
+    {
+        uint64_t id;
+        glm::uvec3 dimensions;
+        GLenum format;
+        GLenum type;
+        // Tightly packed rows, bottom row first.
+        std::vector<uint8_t> data;
+    };
+
+    using callback = std::function<void(result& res)>;
+
+    readback_queue(
+        context& ctx,
+        size_t slot_size,
+        unsigned slot_count = 3,
+        unsigned thread_count = 1
+    );
+    readback_queue(const readback_queue& other) = delete;
+    ~readback_queue();
+
+    // Starts reading an attachment of the target. Returns an id for
+    // take(), or zero if all slots are in use. If cb is given, it receives
+    // the result instead. Throws if the data doesn't fit in a slot or can't
+    // be converted.
+    uint64_t read(
+        render_target& target,
+        callback cb = callback(),
+        conversion conv = NONE,
+        GLenum attachment = GL_COLOR_ATTACHMENT0
+    );
+
+    // Same as above, for a mipmap level of a texture. Cubemaps and
+    // multisampled textures are not supported.
+    uint64_t read(
+        const texture& tex,
+        callback cb = callback(),
+        conversion conv = NONE,
+        unsigned level = 0
+    );
+
+    // Hands finished reads to their callbacks, or keeps them for take(). If
+    // 'wait' is set, blocks until every read has finished.
+    void poll(bool wait = false);
+
+    // Moves out the result of a read made without a callback. Returns false
+    // if it hasn't been finished by poll() yet.
+    bool take(uint64_t id, result& res);
+
+    // Reads that haven't been handed out by poll() yet.
+    size_t get_pending_count() const;
+    size_t get_slot_size() const;
+
+private:
+    enum slot_state
+    {
+        FREE = 0,
+        // Being written by the GPU.
+        READING,
+        // Being copied out by a background thread.
+        COPYING
+    };
+
+    struct request
+    {
+        result res;
+        callback cb;
+        conversion conv;
+        unsigned slot;
+        size_t size;
+        GLsync fence;
+        // Points to the mapped slot, or null when data already holds the
+        // copied bytes.
+        const uint8_t* src;
+    };
+
+    uint64_t begin(
+        GLenum format,
+        GLenum type,
+        glm::uvec3 dimensions,
+        callback cb,
+        conversion conv,
+        unsigned& slot,
+        size_t& offset
+    );
+    void worker();
+
+    GLuint buf;
+    uint8_t* mapping;
+    size_t slot_size;
+    std::vector<slot_state> slots;
+    uint64_t id_counter;
+
+    std::deque<request> in_flight;
+    std::unordered_map<uint64_t, result> results;
+
+    mutable std::mutex mutex;
+    std::condition_variable job_cv;
+    std::condition_variable done_cv;
+    std::deque<request> jobs;
+    std::vector<request> finished;
+    unsigned converting;
+    bool quit;
+    std::vector<std::thread> workers;
+};
+
+} // namespace lt
+
+#endif
@@ -0,0 +1,207 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LT_RENDER_GRAPH_HH
+#define LT_RENDER_GRAPH_HH
+#include "api.hh"
+#include "pipeline.hh"
+#include "framebuffer.hh"
+#include "math.hh"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lt
+{
+
+class framebuffer_pool;
+class gpu_buffer;
+class texture;
+
+// Runs passes that declare the resources they read and write. Each frame,
+// passes that are disabled or whose results are never used are skipped
+// before any of their resources are touched, transient framebuffers are
+// taken from the pool only for the span of passes that use them so that
+// framebuffers with matching specifications are shared, and memory barriers
+// are issued between compute passes and the passes reading their results.
+//
+// Passes run in the order they were added, so add writers before readers.
+class LT_API render_graph: public pipeline_method
+{
+public:
+    using resource_id = unsigned;
+
+    // How a pass accesses a resource. Decides the barrier needed after a
+    // compute pass has written it.
+    enum access
+    {
+        FRAMEBUFFER = 0,
+        TEXTURE,
+        IMAGE,
+        STORAGE_BUFFER,
+        UNIFORM_BUFFER,
+        VERTEX_BUFFER
+    };
+
+    class LT_API pass_context
+    {
+    public:
+        // Return null if the resource was not produced this frame, e.g.
+        // because its writer was disabled.
+        render_target* get_target(resource_id id) const;
+        framebuffer* get_framebuffer(resource_id id) const;
+        texture* get_texture(
+            resource_id id,
+            GLenum attachment = GL_COLOR_ATTACHMENT0
+        ) const;
+        gpu_buffer* get_buffer(resource_id id) const;
+
+    private:
+        friend class render_graph;
+        explicit pass_context(const render_graph& graph);
+
+        const render_graph* graph;
+    };
+
+    using execute_callback = std::function<void(const pass_context&)>;
+
+    class LT_API pass
+    {
+    public:
+        pass& read(resource_id id, access how = TEXTURE);
+        // Optional reads don't keep the writer alive, the pass must then
+        // handle a null resource.
+        pass& read_optional(resource_id id, access how = TEXTURE);
+        pass& write(resource_id id, access how = FRAMEBUFFER);
+
+        // Marks the writes as incoherent (compute shaders, image stores),
+        // later readers get a glMemoryBarrier for their access.
+        pass& compute();
+        // Keeps the pass even if none of its writes are used.
+        pass& side_effects();
+        // Evaluated each frame, the pass is skipped when it returns false.
+        pass& enable_if(std::function<bool()> condition);
+
+        const std::string& get_name() const;
+        // Whether the pass ran during the latest execute().
+        bool is_active() const;
+
+    private:
+        friend class render_graph;
+        pass(render_graph& graph, const std::string& name, execute_callback cb);
+
+        struct use
+        {
+            resource_id id;
+            access how;
+            bool optional;
+        };
+
+        render_graph* graph;
+        std::string name;
+        execute_callback callback;
+        std::function<bool()> condition;
+        std::vector<use> reads;
+        std::vector<use> writes;
+        bool is_compute;
+        bool has_side_effects;
+        bool active;
+    };
+
+    explicit render_graph(framebuffer_pool& pool);
+    render_graph(const render_graph& other) = delete;
+    ~render_graph();
+
+    // A framebuffer that only lives while the graph executes.
+    resource_id create_framebuffer(
+        glm::uvec2 size,
+        const framebuffer::target_specification_map& target_specifications,
+        unsigned samples = 0
+    );
+
+    // Resources owned by the caller. Writes to outputs are always kept.
+    resource_id import(render_target& target, bool output = true);
+    resource_id import(texture& tex, bool output = false);
+    resource_id import(gpu_buffer& buf, bool output = false);
+    void set_output(resource_id id, bool output = true);
+
+    // The returned reference stays valid for the lifetime of the graph.
+    pass& add_pass(const std::string& name, execute_callback cb);
+    // Adds an existing method. The target_method overload declares a write
+    // to 'target' and points the method at it while it runs, so methods can
+    // draw into transient framebuffers. 'bind_inputs' is called before the
+    // method runs to hand it the resources it reads, which must also be
+    // declared on the returned pass:
+    //
+    //     graph.add_method(tm, out, [&](const render_graph::pass_context& c){
+    //         tm.set_src(c.get_texture(hdr));
+    //     }).read(hdr);
+    pass& add_method(pipeline_method& method);
+    pass& add_method(
+        target_method& method,
+        resource_id target,
+        execute_callback bind_inputs = {}
+    );
+
+    void execute() override;
+
+    // Number of passes that ran during the latest execute().
+    unsigned get_active_pass_count() const;
+    // Number of framebuffers taken from the pool during the latest
+    // execute(). Less than the number of used transient framebuffers when
+    // they were able to share.
+    unsigned get_transient_framebuffer_count() const;
+
+private:
+    enum resource_type
+    {
+        TRANSIENT = 0,
+        IMPORTED_TARGET,
+        IMPORTED_TEXTURE,
+        IMPORTED_BUFFER
+    };
+
+    struct resource
+    {
+        resource_type type;
+        bool output;
+        glm::uvec2 size;
+        framebuffer::target_specification_map target_specifications;
+        unsigned samples;
+        void* external;
+        // Null for transient framebuffers outside of their lifetime.
+        framebuffer* fb;
+        // Barrier bits already issued since the last incoherent write.
+        GLbitfield synced;
+    };
+
+    resource_id add_resource(resource_type type, void* external, bool output);
+    const resource& get_resource(resource_id id) const;
+    void cull();
+    void release_all();
+
+    framebuffer_pool* pool;
+    std::vector<resource> resources;
+    std::vector<std::unique_ptr<pass>> passes;
+    unsigned transient_count;
+};
+
+} // namespace lt
+
+#endif
@@ -47,17 +47,16 @@ public:
 
     GLuint get_fbo() const;
 
-    static GLint get_current_read_fbo();
-    static GLint get_current_write_fbo();
-    static void reinstate_current_fbo();
+    // -1 when unknown.
+    GLint get_current_read_fbo() const;
+    GLint get_current_write_fbo() const;
+    // Rebinds the cached framebuffers after binding others directly.
+    void reinstate_current_fbo() const;
 
 protected:
     GLuint fbo;
     GLenum target;
     glm::uvec3 dimensions;
-
-    static GLint current_read_fbo;
-    static GLint current_write_fbo;
 };
 
 } // namespace lt
@@ -0,0 +1,195 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LT_RESIDENCY_MANAGER_HH
+#define LT_RESIDENCY_MANAGER_HH
+#include "api.hh"
+#include "resource.hh"
+#include "glheaders.hh"
+#include "staging_ring.hh"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace lt
+{
+
+class texture;
+class gpu_buffer;
+class primitive;
+
+// Resources which can prepare their data outside of the GL thread implement
+// this to be streamed in by a residency_manager.
+class LT_API streamable
+{
+public:
+    virtual ~streamable();
+
+    // Called from a background thread. Must not use GL.
+    virtual void prepare() const = 0;
+
+    // Called from the GL thread once the resource is loaded and prepare()
+    // has finished. Uploads as much of the prepared data as fits in the
+    // staging ring. Returns the number of bytes uploaded and sets 'done' once
+    // everything has been uploaded.
+    virtual size_t upload(staging_ring& staging, bool& done) const = 0;
+
+    // GPU memory taken by the resource while it is loaded.
+    virtual size_t get_memory_usage() const = 0;
+};
+
+// Keeps the managed resources within a GPU memory budget. Every load() of a
+// managed resource marks it used during the current frame, and the least
+// recently used ones are unloaded when the budget is exceeded. Streamable
+// resources are prepared by background threads and uploaded a bit at a time
+// during update(), so that they don't stall the frame that needs them.
+//
+// The manager must be destroyed before the resources it manages, and it
+// must only be used from the GL thread.
+class LT_API residency_manager: public glresource
+{
+public:
+    residency_manager(
+        context& ctx,
+        size_t budget,
+        unsigned thread_count = 1
+    );
+    residency_manager(const residency_manager& other) = delete;
+    ~residency_manager();
+
+    // Creates a managed 2D texture whose mipmaps are decoded in the
+    // background and uploaded smallest first. It samples as grey until the
+    // first level has been uploaded.
+    texture* create_texture(const std::string& path, bool srgb = false);
+
+    // Creates a managed buffer whose contents are written by 'read' in the
+    // background. Loading the buffer before that has finished waits for it.
+    gpu_buffer* create_gpu_buffer(
+        GLenum target,
+        size_t size,
+        std::function<void(uint8_t* data)> read
+    );
+
+    // Starts managing a resource. 'size' is the GPU memory it takes when
+    // loaded, it is ignored for streamable resources. The resource is only
+    // loaded by request() once its managed dependencies are resident.
+    void add(
+        const resource* res,
+        size_t size = 0,
+        const std::vector<const resource*>& dependencies = {}
+    );
+    // Same as above, with the buffers of the primitive as dependencies.
+    void add(const primitive* prim);
+    void remove(const resource* res);
+    bool contains(const resource* res) const;
+
+    // Makes the resource resident during upcoming update()s without waiting
+    // for it to be used. Does nothing if it is already resident or on its way.
+    void request(const resource* res);
+
+    // Used by streamable resources from load_impl() when they can't wait
+    // for update(). Prepares the resource on this thread unless a background
+    // thread already is.
+    void finish(const resource* res);
+
+    // Used by streamable resources from unload_impl(). Waits for ongoing
+    // preparation and forgets about queued work.
+    void cancel(const resource* res);
+
+    // Call once per frame. Uploads prepared data up to the upload limit,
+    // evicts resources not used during this frame when over the budget and
+    // starts the next frame.
+    void update();
+
+    uint64_t get_frame() const;
+
+    void set_budget(size_t budget);
+    size_t get_budget() const;
+
+    // GPU memory taken by the loaded managed resources, as of the last
+    // update().
+    size_t get_usage() const;
+
+    // Bytes uploaded per update(). Streamable resources are staged through
+    // a ring of pixel buffers with room for this much per frame, so that
+    // their uploads don't block. Resources which aren't streamable are loaded
+    // all at once regardless. The limit is at least 1 MiB, so that a row of
+    // the largest texture fits in.
+    void set_upload_limit(size_t upload_limit);
+    size_t get_upload_limit() const;
+
+private:
+    enum entry_state
+    {
+        IDLE = 0,
+        QUEUED,
+        PREPARING,
+        PENDING,
+        RESIDENT
+    };
+
+    struct entry
+    {
+        const streamable* stream;
+        size_t size;
+        std::vector<const resource*> dependencies;
+        entry_state state;
+        std::exception_ptr error;
+    };
+
+    void worker();
+    void request_locked(const resource* res);
+    void cancel_locked(
+        std::unique_lock<std::mutex>& lock,
+        const resource* res,
+        entry& e
+    );
+    bool is_ready(const resource* res) const;
+    size_t get_memory_usage(const entry& e) const;
+    void evict();
+
+    size_t budget;
+    size_t usage;
+    size_t upload_limit;
+    uint64_t frame;
+    std::unique_ptr<staging_ring> staging;
+
+    std::unordered_map<const resource*, entry> entries;
+    // Resources waiting to be loaded or uploaded by update().
+    std::deque<const resource*> pending;
+
+    // Guards the states of the entries and the jobs.
+    mutable std::mutex mutex;
+    std::condition_variable job_cv;
+    std::condition_variable done_cv;
+    std::deque<const resource*> jobs;
+    std::vector<const resource*> finished;
+    std::vector<std::thread> workers;
+    bool quit;
+};
+
+} // namespace lt
+
+#endif
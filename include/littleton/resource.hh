@@ -19,10 +19,13 @@
 #ifndef LT_RESOURCE_HH
 #define LT_RESOURCE_HH
 #include "api.hh"
+#include <cstdint>
 
 namespace lt
 {
 
+class residency_manager;
+
 // Only useful for lazily loadable resources.
 // Since OpenGL should only be used from the main thread, this class doesn't
 // concern itself with thread safety.
@@ -56,14 +59,23 @@ public:
     // it is marked for unloading.
     void unlink() const;
 
+    // Non-null if the resource is managed by a residency_manager.
+    residency_manager* get_residency_manager() const;
+    // The residency_manager frame during which load() was last called.
+    uint64_t get_last_use() const;
+
 protected:
     virtual void load_impl() const;
     virtual void unload_impl() const;
 
 private:
+    friend class residency_manager;
+
     mutable bool loaded;
     mutable bool do_unload;
     mutable unsigned references;
+    mutable residency_manager* residency;
+    mutable uint64_t last_use;
 };
 
 class context;
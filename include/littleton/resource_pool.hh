@@ -159,6 +159,19 @@ public:
 
     void load_all();
     void unload_all();
+
+    // Memory held by the textures and buffers of this pool, not counting the
+    // parent pool. CPU memory is what is kept for loading them again.
+    struct memory_usage
+    {
+        size_t texture_count;
+        size_t texture_cpu_bytes;
+        size_t texture_gpu_bytes;
+        size_t buffer_count;
+        size_t buffer_cpu_bytes;
+        size_t buffer_gpu_bytes;
+    };
+    memory_usage get_memory_usage() const;
 };
 #undef generic_resource_alias_decl
 } // namespace lt
@@ -62,6 +62,8 @@ public:
     void set_comparison_mode(GLint comparison_mode);
     void set_lod_bias(GLint lod_bias);
 
+    GLuint get_sampler() const;
+
     // Returns the index
     GLint bind(const texture& tex, unsigned index = 0) const;
 
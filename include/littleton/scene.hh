@@ -22,6 +22,7 @@
 #include "math.hh"
 #include "timer.hh"
 #include "spherical_gaussians.hh"
+#include "bvh.hh"
 #include <vector>
 #include <map>
 
@@ -29,6 +30,8 @@ namespace lt
 {
 
 class object;
+class geometry_batch;
+class instanced_object;
 class camera;
 class light;
 class directional_light;
@@ -62,7 +65,12 @@ public:
     void set_cameras(const std::vector<camera*>& cameras);
     const std::vector<camera*>& get_cameras() const;
 
+    // Brings the cached global transforms of the cameras up to date. This is
+    // also done by update_all() of composite scenes.
+    void update_transforms();
+
     // Glue for composite_scene convenience functions, do not call directly.
+    void update_impl(duration delta);
     void clear_impl();
 
 private:
@@ -83,13 +91,41 @@ public:
     void set_objects(const std::vector<object*>& objects);
     const std::vector<object*>& get_objects() const;
 
+    // Updates the hierarchy after objects have moved or changed models, only
+    // the changed objects are refitted. Culling calls this before querying
+    // the hierarchy, but it does nothing until something moves again.
+    void update_bounds();
+    const object_bvh& get_bvh() const;
+
+    // Batched static geometry, drawn alongside the objects. Objects merged
+    // into a batch should not be added as objects too.
+    void add_batch(geometry_batch* batch);
+    void remove_batch(geometry_batch* batch);
+    void clear_batches();
+    const std::vector<geometry_batch*>& get_batches() const;
+
+    // Instanced models, drawn alongside the objects. The instance nodes
+    // should not be added as objects too.
+    void add_instanced_object(instanced_object* obj);
+    void remove_instanced_object(instanced_object* obj);
+    void clear_instanced_objects();
+    const std::vector<instanced_object*>& get_instanced_objects() const;
+
     // Glue for composite_scene convenience functions, do not call directly.
     void add_impl(object* obj);
+    void add_impl(geometry_batch* batch);
+    void add_impl(instanced_object* obj);
     void remove_impl(object* obj);
+    void remove_impl(geometry_batch* batch);
+    void remove_impl(instanced_object* obj);
+    void update_impl(duration delta);
     void clear_impl();
 
 private:
     std::vector<object*> objects;
+    std::vector<geometry_batch*> batches;
+    std::vector<instanced_object*> instanced_objects;
+    object_bvh bvh;
 };
 
 class LT_API sprite_scene
@@ -158,6 +194,10 @@ public:
     size_t light_count() const;
     std::vector<light*> get_lights() const;
 
+    // Brings the cached global transforms of the point lights and spotlights
+    // up to date. This is also done by update_all() of composite scenes.
+    void update_transforms();
+
     // Glue for composite_scene convenience functions, do not call directly.
     void add_impl(point_light* pl);
     void remove_impl(point_light* pl);
@@ -165,6 +205,7 @@ public:
     void remove_impl(spotlight* sp);
     void add_impl(directional_light* dl);
     void remove_impl(directional_light* dl);
+    void update_impl(duration delta);
     void clear_impl();
 
 private:
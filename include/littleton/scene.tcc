@@ -114,6 +114,8 @@ void composite_scene<Scenes...>::clear_internal(S* base, Rest*... rest)
 {
     if constexpr(has_clear_impl<S>::value)
         base->clear_impl();
+
+    clear_internal(rest...);
 }
 
 template<typename... Scenes>
@@ -132,6 +134,8 @@ void composite_scene<Scenes...>::update_internal(
 ){
     if constexpr(has_update_impl<S>::value)
         base->update_impl(delta);
+
+    update_internal(delta, rest...);
 }
 
 template<typename... Scenes>
@@ -21,8 +21,10 @@
 #include "api.hh"
 #include "object.hh"
 #include "scene.hh"
+#include "instanced_object.hh"
 #include <unordered_map>
 #include <string>
+#include <memory>
 
 namespace lt
 {
@@ -51,10 +53,29 @@ public:
 
     void add_to_scene(object_scene* o);
 
+    // Like add_to_scene(), but objects whose model is shared by at least
+    // 'min_instances' objects are added through an instanced_object instead.
+    // The instanced objects are owned by the graph and reused by later calls.
+    void add_to_scene_instanced(
+        object_scene* o,
+        context& ctx,
+        size_t min_instances = 2
+    );
+
     void merge(const scene_graph& other);
 
+    using const_iterator =
+        std::unordered_map<std::string, object>::const_iterator;
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
 private:
     std::unordered_map<std::string, object> objects;
+    std::unordered_map<
+        const model*,
+        std::unique_ptr<instanced_object>
+    > instanced_objects;
 };
 
 } // namespace lt
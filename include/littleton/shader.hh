@@ -111,7 +111,11 @@ public:
     );
 
     void bind() const;
-    static void unbind();
+    void unbind() const;
+
+    // Number of shader programs built so far, whether compiled from source
+    // or loaded from a binary.
+    static unsigned get_compile_count();
 
     void write_binary(const std::string& path) const;
 
@@ -128,6 +132,20 @@ public:
         const T* value
     );
 
+    // Same as above, but the uniform is found by the hash in the handle.
+    template<typename T>
+    void set(
+        const uniform_handle<T>& handle,
+        const typename uniform_handle<T>::value_type& value
+    );
+
+    template<typename T>
+    void set(
+        const uniform_handle<T>& handle,
+        size_t count,
+        const typename uniform_handle<T>::value_type* value
+    );
+
     bool block_exists(const std::string& name) const;
     uniform_block_type get_block_type(const std::string& name) const;
 
@@ -182,17 +200,29 @@ protected:
         GLuint location;
         GLint size;
         GLenum type;
+        // The value last set, empty if unknown. Setting the same value again
+        // is skipped.
+        std::vector<uint8_t> value;
     };
 
+    template<typename T>
+    void set_value(
+        uniform_data& data,
+        const char* name,
+        size_t count,
+        const T* value
+    );
+
     struct uniform_block_data
     {
         GLuint index;
         uniform_block_type type;
     };
 
-    static GLuint current_program;
+    static unsigned compile_count;
     mutable GLuint program;
     mutable std::unordered_map<std::string, uniform_data> uniforms;
+    mutable std::unordered_map<uint64_t, uniform_data*> uniform_hashes;
     mutable std::unordered_map<std::string, uniform_block_data> uniform_blocks;
     mutable std::unordered_map<std::string, GLuint /*index*/> storage_blocks;
 };
@@ -1,4 +1,5 @@
 #include <stdexcept>
+#include <cstring>
 #include "shader.hh"
 
 namespace lt
@@ -23,13 +24,7 @@ void shader::set(const std::string& name, const T& value)
     auto it = uniforms.find(name);
     if(it == uniforms.end()) return;
 
-    uniform_data& data = it->second;
-
-    if(!uniform_is_compatible<T>(data.type, data.size))
-        throw std::runtime_error("Wrong type for "+name);
-
-    bind();
-    uniform_set_value<T>(data.location, 1, &value);
+    set_value(it->second, name.c_str(), 1, &value);
 }
 
 template<typename T>
@@ -42,13 +37,56 @@ void shader::set(
     auto it = uniforms.find(name);
     if(it == uniforms.end()) return;
 
-    uniform_data& data = it->second;
+    set_value(it->second, name.c_str(), count, value);
+}
+
+template<typename T>
+void shader::set(
+    const uniform_handle<T>& handle,
+    const typename uniform_handle<T>::value_type& value
+){
+    load();
+    auto it = uniform_hashes.find(handle.get_hash());
+    if(it == uniform_hashes.end()) return;
+
+    set_value(*it->second, handle.get_name(), 1, &value);
+}
 
+template<typename T>
+void shader::set(
+    const uniform_handle<T>& handle,
+    size_t count,
+    const typename uniform_handle<T>::value_type* value
+){
+    load();
+    auto it = uniform_hashes.find(handle.get_hash());
+    if(it == uniform_hashes.end()) return;
+
+    set_value(*it->second, handle.get_name(), count, value);
+}
+
+template<typename T>
+void shader::set_value(
+    uniform_data& data,
+    const char* name,
+    size_t count,
+    const T* value
+){
     if(!uniform_is_compatible<T>(data.type, data.size, count))
-        throw std::runtime_error("Wrong type for "+name);
+        throw std::runtime_error("Wrong type for " + std::string(name));
+
+    // The program keeps its uniform values, so unchanged ones needn't be
+    // sent again.
+    size_t bytes = data.size * sizeof(T);
+    const uint8_t* begin = reinterpret_cast<const uint8_t*>(value);
+    if(
+        data.value.size() == bytes &&
+        memcmp(data.value.data(), begin, bytes) == 0
+    ) return;
 
     bind();
     uniform_set_value<T>(data.location, data.size, value);
+    data.value.assign(begin, begin + bytes);
 }
 
 } // namespace lt
@@ -0,0 +1,79 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LT_STAGING_RING_HH
+#define LT_STAGING_RING_HH
+#include "api.hh"
+#include "glheaders.hh"
+#include "resource.hh"
+#include <vector>
+
+namespace lt
+{
+
+// Pixel unpack buffer for uploading texture data without stalling. The
+// storage is split into segments that are filled in turn, one per frame,
+// with fences guarding segments that may still be read by earlier uploads.
+// Unlike light_buffer, a segment that is still in use is skipped over
+// instead of waited for. When persistent mapping is available, data is
+// copied directly into the mapped buffer.
+class LT_API staging_ring: public glresource
+{
+public:
+    staging_ring(
+        context& ctx,
+        size_t segment_size,
+        unsigned segment_count = 3
+    );
+    staging_ring(const staging_ring& other) = delete;
+    ~staging_ring();
+
+    // Copies 'size' bytes into the current segment. On success, 'offset' is
+    // to be given to the texture upload functions in place of a pointer while
+    // the ring is bound. Fails if there is not enough room left.
+    bool stage(const void* data, size_t size, size_t& offset);
+
+    // Bytes that can still be staged during this frame.
+    size_t get_available();
+    size_t get_segment_size() const;
+
+    // Binds the ring as GL_PIXEL_UNPACK_BUFFER.
+    void bind() const;
+    void unbind() const;
+
+    // Fences the uploads staged during this frame and moves on to the next
+    // segment. Call once per frame.
+    void next_frame();
+
+private:
+    bool acquire();
+
+    GLuint buf;
+    uint8_t* mapping;
+    std::vector<GLsync> fences;
+
+    size_t segment_size;
+    unsigned segment_count;
+    unsigned segment;
+    size_t used;
+    bool acquired;
+};
+
+} // namespace lt
+
+#endif
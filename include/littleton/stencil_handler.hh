@@ -24,6 +24,8 @@
 namespace lt
 {
 
+class gl_state;
+
 // To be used by methods for providing an interface for managing what is
 // written to the stencil buffer and what is passed.
 class LT_API stencil_handler
@@ -44,10 +46,10 @@ public:
 
     // These should only be used by the owner of the handler, such as a method
     // deriving from it or one that holds it.
-    void stencil_disable();
-    void stencil_draw();
-    void stencil_cull();
-    void stencil_draw_cull();
+    void stencil_disable(gl_state& state);
+    void stencil_draw(gl_state& state);
+    void stencil_cull(gl_state& state);
+    void stencil_draw_cull(gl_state& state);
 
 private:
     GLenum func;
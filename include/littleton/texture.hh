@@ -23,6 +23,7 @@
 #include "resource.hh"
 #include "math.hh"
 #include <string>
+#include <vector>
 
 namespace lt
 {
@@ -72,6 +73,9 @@ public:
 
     void generate_mipmaps();
 
+    // KTX and DDS files are recognized by their contents and uploaded with
+    // their own mipmaps. Unlike other images, they are not flipped
+    // vertically.
     static texture* create(
         context& ctx,
         const std::string& path,
@@ -79,6 +83,25 @@ public:
         GLenum target = GL_TEXTURE_2D
     );
 
+    // Creates a lazily loaded 2D texture from the contents of a KTX or DDS
+    // file. The data is copied.
+    static texture* create_from_container(
+        context& ctx,
+        const void* data,
+        size_t size,
+        bool srgb = false
+    );
+
+    // Takes the file contents without copying them. If the texture is not
+    // evictable, they are released after the first upload and the texture
+    // can't be loaded again once unloaded.
+    static texture* create_from_container(
+        context& ctx,
+        std::vector<uint8_t>&& data,
+        bool srgb = false,
+        bool evictable = true
+    );
+
     static texture* create(
         context& ctx,
         glm::uvec2 size,
@@ -101,6 +124,25 @@ public:
         const void* data = nullptr
     );
 
+    // Like above, but takes the data without copying it. The same
+    // evictability rules apply as with create_from_container().
+    static texture* create(
+        context& ctx,
+        glm::uvec3 dimensions,
+        GLint internal_format,
+        GLenum type,
+        unsigned samples,
+        GLenum target,
+        std::vector<uint8_t>&& data,
+        bool evictable = true
+    );
+
+    // Bytes kept in CPU memory for loading the texture again.
+    virtual size_t get_cpu_memory_usage() const;
+    // An estimate of the base level size, zero when not loaded. Doesn't load
+    // the texture.
+    size_t get_gpu_memory_usage() const;
+
     template<typename T>
     std::vector<T> read() const;
 
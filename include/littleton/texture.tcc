@@ -1,3 +1,5 @@
+#include "context.hh"
+
 namespace lt
 {
 
@@ -8,7 +10,7 @@ std::vector<T> texture::read() const
     size_t texels = dimensions.x * dimensions.y * dimensions.z;
     size_t data_bytes = texels * get_texel_size();
     std::vector<T> res((data_bytes + sizeof(T) - 1) / sizeof(T));
-    glBindTexture(target, tex);
+    get_context().get_state().bind_texture(0, target, tex);
     glGetTexImage(
         target,
         0,
@@ -0,0 +1,69 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LT_TEXTURE_COMPRESSION_HH
+#define LT_TEXTURE_COMPRESSION_HH
+#include "api.hh"
+#include "glheaders.hh"
+#include <string>
+#include <vector>
+
+namespace lt
+{
+
+// Block compressed formats that can be encoded on the CPU. Textures in BC6H,
+// BC7 and ETC2 formats can still be loaded from files made by other tools.
+enum class block_format
+{
+    BC1, // RGB, 4 bits per pixel
+    BC3, // RGBA, 8 bits per pixel
+    BC4, // R, 4 bits per pixel
+    BC5 // RG, 8 bits per pixel
+};
+
+// Only BC1 and BC3 have sRGB variants.
+LT_API GLint block_format_to_internal_format(
+    block_format format,
+    bool srgb = false
+);
+
+// Compresses a tightly packed 8-bit image. BC1 and BC3 treat one and two
+// channel images as grey and grey with alpha, like stb_image does, while BC4
+// and BC5 take the first one or two channels as they are.
+LT_API std::vector<uint8_t> compress_image(
+    block_format format,
+    const uint8_t* pixels,
+    unsigned width,
+    unsigned height,
+    unsigned channels
+);
+
+// Decodes an image file, generates all of its mipmaps and writes them
+// compressed into a KTX file. 'flip' matches the orientation of
+// texture::create(), but glTF textures must not be flipped.
+LT_API void compress_texture_file(
+    const std::string& input_path,
+    const std::string& output_path,
+    block_format format,
+    bool srgb = false,
+    bool flip = true
+);
+
+} // namespace lt
+
+#endif
@@ -0,0 +1,95 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LT_TRANSFORM_ARENA_HH
+#define LT_TRANSFORM_ARENA_HH
+#include "api.hh"
+#include "math.hh"
+#include <vector>
+#include <cstdint>
+
+namespace lt
+{
+
+class transformable_node;
+
+// Structure-of-arrays storage of the transforms of many nodes. Local
+// transforms are mirrored here whenever a node changes, and the world
+// matrices of all changed nodes are then computed in one pass over the
+// arrays, ordered so that parents always precede their children. The local
+// matrices are built four nodes at a time with SSE where available. Member
+// nodes read their global transform and generation from the arena, so
+// mostly act as handles into it.
+class LT_API transform_arena
+{
+public:
+    transform_arena();
+    transform_arena(const transform_arena& other) = delete;
+    ~transform_arena();
+
+    // Adds the node along with its ancestors, which must not belong to
+    // another arena.
+    void add(transformable_node* node);
+
+    // Removes the node along with its descendants in the arena.
+    void remove(transformable_node* node);
+    void clear();
+    size_t size() const;
+
+    // Recomputes the world matrices of the changed nodes and their
+    // descendants. Reading a global transform does this implicitly.
+    void update();
+
+    const mat4& get_world(const transformable_node* node);
+    uint64_t get_generation(const transformable_node* node);
+
+    // Glue for transformable and transformable_node, do not call directly.
+    void set_local(
+        uint32_t index,
+        vec3 position,
+        quat orientation,
+        vec3 scaling
+    );
+    void reparent(transformable_node* node);
+
+private:
+    void push(transformable_node* node, int32_t parent);
+    void rebuild();
+    void update_local();
+
+    // Local transforms, padded to a multiple of four entries.
+    std::vector<float> px, py, pz;
+    std::vector<float> qx, qy, qz, qw;
+    std::vector<float> sx, sy, sz;
+
+    // Null for removed nodes until the next rebuild.
+    std::vector<transformable_node*> nodes;
+    std::vector<int32_t> parents;
+    std::vector<uint8_t> dirty;
+    std::vector<uint64_t> generations;
+    // Padded like the local transforms.
+    std::vector<mat4> local;
+    std::vector<mat4> world;
+
+    bool order_outdated;
+    bool any_dirty;
+};
+
+} // namespace lt
+
+#endif
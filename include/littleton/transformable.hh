@@ -20,15 +20,20 @@
 #define LT_TRANSFORMABLE_HH
 #include "api.hh"
 #include "math.hh"
+#include <atomic>
+#include <cstdint>
 
 namespace lt
 {
 
+class transform_arena;
 class LT_API transformable
 {
+friend class transform_arena;
 public:
     transformable();
     transformable(const transformable& other);
+    transformable& operator=(const transformable& other);
 
     void rotate(
         float angle,
@@ -73,6 +78,11 @@ public:
     void set_transform(const glm::mat4& transform);
     glm::mat4 get_transform() const;
 
+    // Incremented whenever the local transform or parent of any node, or the
+    // model of any object, changes. Caches over many nodes compare it to skip
+    // their update when nothing has changed.
+    static uint64_t get_global_revision();
+
     void lookat(
         glm::vec3 pos,
         glm::vec3 up = glm::vec3(0,1,0),
@@ -87,16 +97,53 @@ public:
     );
 
 protected:
+    // Must be called whenever the local transform changes.
+    void local_changed();
+    // Must be called whenever anything get_global_revision() covers changes.
+    static void global_changed();
+
     glm::quat orientation;
     glm::vec3 position, scaling;
+    // Incremented whenever the local transform changes.
+    uint64_t revision;
+
+    // Set while the transform is mirrored in an arena, see transform_arena.
+    transform_arena* arena;
+    uint32_t arena_index;
+
+private:
+    static std::atomic<uint64_t> global_revision;
 };
 
 class LT_API transformable_node: public transformable
 {
+friend class transform_arena;
 public:
     transformable_node(transformable_node* parent = nullptr);
+    transformable_node(const transformable_node& other);
+    ~transformable_node();
+
+    transformable_node& operator=(const transformable_node& other);
+
+    // The global transform is cached. It's recomputed only when the local
+    // transform of this node has changed or the parent's generation differs
+    // from the one the cache was built against, so a clean chain only costs
+    // a walk up the parents. Refreshing the cache writes to this node and
+    // its parents, so a chain must not be read from several threads at once
+    // unless update_global_transform() has already been called for it.
+    const glm::mat4& get_global_transform() const;
 
-    glm::mat4 get_global_transform() const;
+    // Changes whenever the global transform is recomputed. Generations are
+    // unique across all nodes.
+    uint64_t get_generation() const;
+
+    // Brings the cached global transform up to date. Scenes do this once
+    // per frame in update_all(), so that passes only read the cache. Nodes in
+    // a transform_arena update the whole arena instead.
+    void update_global_transform() const;
+
+    // The arena the node belongs to, if any.
+    transform_arena* get_arena() const;
 
     glm::vec3 get_global_position() const;
     glm::quat get_global_orientation() const;
@@ -126,6 +173,23 @@ public:
 
 protected:
     transformable_node* parent;
+
+private:
+    void update_decomposition() const;
+
+    mutable glm::mat4 global_transform;
+    mutable glm::vec3 global_scaling;
+    mutable glm::quat global_orientation;
+    mutable const transformable_node* cached_parent;
+    mutable uint64_t cached_revision;
+    mutable uint64_t cached_parent_generation;
+    mutable uint64_t generation;
+    mutable uint64_t decomposed_generation;
+
+    static uint64_t next_generation();
+
+    // Atomic, so that separate chains can be refreshed concurrently.
+    static std::atomic<uint64_t> generation_counter;
 };
 
 } // namespace lt
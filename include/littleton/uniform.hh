@@ -23,10 +23,45 @@
 #include "math.hh"
 #include <unordered_map>
 #include <string>
+#include <cstdint>
 
 namespace lt
 {
 
+// FNV-1a hash of a uniform name. Being constexpr, the names of handles made
+// from string literals are hashed at compile time.
+constexpr uint64_t hash_uniform_name(const char* name)
+{
+    uint64_t hash = 14695981039346656037ull;
+    while(*name)
+    {
+        hash ^= (uint8_t)*name++;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Typed name of a uniform for shader::set(). Setting through a handle looks
+// the uniform up by the precomputed hash instead of hashing and comparing
+// strings. The name isn't copied, so it must outlive the handle; usually it's
+// a string literal and the handle is a static constant.
+template<typename T>
+class uniform_handle
+{
+public:
+    using value_type = T;
+
+    constexpr uniform_handle(const char* name)
+    : name(name), hash(hash_uniform_name(name)) {}
+
+    constexpr const char* get_name() const { return name; }
+    constexpr uint64_t get_hash() const { return hash; }
+
+private:
+    const char* name;
+    uint64_t hash;
+};
+
 template<typename T>
 bool uniform_is_compatible(GLenum type, GLint size, size_t count = 1);
 
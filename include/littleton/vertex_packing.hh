@@ -0,0 +1,112 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LT_VERTEX_PACKING_HH
+#define LT_VERTEX_PACKING_HH
+#include "api.hh"
+#include "math.hh"
+#include "primitive.hh"
+#include <map>
+#include <vector>
+
+namespace lt
+{
+
+// Storage formats of the attributes written by packed_vertices.
+struct LT_API vertex_format
+{
+    enum unit_vector_encoding
+    {
+        FLOAT32 = 0,
+        // Four 16-bit normalized integers.
+        SNORM16,
+        // Octahedral mapping in normalized 10:10:10:2 integers, the 2-bit
+        // component holds the bitangent sign of tangents.
+        OCTAHEDRAL
+    };
+
+    vertex_format(
+        bool quantize_position = false,
+        unit_vector_encoding normal_encoding = FLOAT32,
+        bool half_uv = false
+    );
+
+    // Positions are stored as 16-bit normalized integers relative to their
+    // bounding box.
+    bool quantize_position;
+    // Used for both normals and tangents.
+    unit_vector_encoding normal_encoding;
+    // UVs are stored as half floats.
+    bool half_uv;
+};
+
+// Interleaves the vertex attributes of a primitive into a single buffer.
+class LT_API packed_vertices
+{
+public:
+    packed_vertices(
+        const vertex_format& format,
+        size_t vertex_count,
+        const vec3* position,
+        const vec3* normal = nullptr,
+        const vec4* tangent = nullptr,
+        const vec2* uv = nullptr
+    );
+
+    const std::vector<uint8_t>& get_data() const;
+    // Moves the data out, leaving this empty. The layout stays usable.
+    std::vector<uint8_t> take_data();
+    size_t get_stride() const;
+
+    // Returns the accessors of the attributes once the data is in buf.
+    std::map<primitive::attribute, gpu_buffer_accessor> get_attributes(
+        const gpu_buffer& buf
+    ) const;
+
+    // Sets the position decoding of a primitive using these attributes.
+    void apply(primitive& prim) const;
+
+private:
+    struct layout
+    {
+        primitive::attribute attrib;
+        unsigned components;
+        GLenum type;
+        bool normalized;
+        bool octahedral;
+        size_t offset;
+    };
+
+    size_t add_layout(
+        const primitive::attribute& attrib,
+        unsigned components,
+        GLenum type,
+        bool normalized,
+        bool octahedral = false
+    );
+
+    std::vector<layout> layouts;
+    std::vector<uint8_t> data;
+    size_t stride;
+    vec3 position_scale;
+    vec3 position_offset;
+};
+
+} // namespace lt
+
+#endif
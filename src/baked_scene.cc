@@ -0,0 +1,1064 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "loaders.hh"
+#include "resource_pool.hh"
+#include "scene_graph.hh"
+#include "primitive.hh"
+#include "texture.hh"
+#include "material.hh"
+#include "model.hh"
+#include "object.hh"
+#include "math.hh"
+#include "helpers.hh"
+#include "context.hh"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+// Baked scenes consist of a header, tables of the records below, a string
+// table and finally a blob of vertex, index and texture data. All offsets
+// are in bytes from the start of the file, except blob offsets, which are
+// relative to the start of the blob. Indices to other records are -1 when
+// unset.
+
+namespace
+{
+using namespace lt;
+
+const char BAKED_MAGIC[8] = {'L', 'T', 'B', 'A', 'K', 'E', 'D', '\0'};
+const uint32_t BAKED_VERSION = 1;
+const uint32_t BAKED_BYTE_ORDER = 0x01020304;
+// The blob starts at a page boundary, so that mapped data can be handed to
+// GL as-is.
+const uint64_t BLOB_ALIGNMENT = 4096;
+const uint64_t DATA_ALIGNMENT = 16;
+
+struct baked_table
+{
+    uint64_t offset;
+    uint64_t count;
+};
+
+struct baked_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t header_size;
+    baked_table samplers;
+    baked_table textures;
+    baked_table levels;
+    baked_table buffers;
+    baked_table primitives;
+    baked_table attributes;
+    baked_table materials;
+    baked_table models;
+    baked_table groups;
+    baked_table scenes;
+    baked_table objects;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    uint64_t blob_offset;
+    uint64_t blob_size;
+};
+
+struct baked_string
+{
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct baked_range
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct baked_sampler
+{
+    baked_string name;
+    int32_t mag;
+    int32_t min;
+    int32_t extension;
+    int32_t comparison_mode;
+    float anisotropy;
+    float border_color[4];
+};
+
+struct baked_texture
+{
+    baked_string name;
+    uint32_t internal_format;
+    uint32_t type;
+    uint32_t compressed;
+    uint32_t width;
+    uint32_t height;
+    uint32_t first_level;
+    uint32_t level_count;
+};
+
+struct baked_buffer
+{
+    baked_string name;
+    uint32_t target;
+    uint32_t padding;
+    baked_range data;
+};
+
+struct baked_accessor
+{
+    int32_t buffer;
+    uint32_t components;
+    uint32_t type;
+    uint32_t normalized;
+    uint32_t octahedral;
+    uint32_t padding;
+    uint64_t stride;
+    uint64_t offset;
+};
+
+struct baked_attribute
+{
+    baked_string name;
+    uint32_t index;
+    uint32_t padding;
+    baked_accessor accessor;
+};
+
+struct baked_primitive
+{
+    baked_string name;
+    uint32_t mode;
+    uint32_t first_attribute;
+    uint32_t attribute_count;
+    uint32_t padding;
+    uint64_t index_count;
+    baked_accessor index;
+    float bounds_min[3];
+    float bounds_max[3];
+    float position_scale[3];
+    float position_offset[3];
+};
+
+struct baked_sampler_tex
+{
+    int32_t sampler;
+    int32_t texture;
+};
+
+struct baked_material
+{
+    baked_string name;
+    float color_factor[4];
+    baked_sampler_tex color_texture;
+    float metallic_factor;
+    float roughness_factor;
+    baked_sampler_tex metallic_roughness_texture;
+    float normal_factor;
+    baked_sampler_tex normal_texture;
+    float ior;
+    float emission_factor[3];
+    baked_sampler_tex emission_texture;
+};
+
+struct baked_model
+{
+    baked_string name;
+    uint32_t first_group;
+    uint32_t group_count;
+};
+
+struct baked_group
+{
+    int32_t material;
+    int32_t primitive;
+};
+
+struct baked_scene
+{
+    baked_string name;
+    uint32_t first_object;
+    uint32_t object_count;
+};
+
+// Parents always precede their children within a scene.
+struct baked_object
+{
+    baked_string name;
+    int32_t parent;
+    int32_t model;
+    float position[3];
+    float orientation[4];
+    float scaling[3];
+};
+
+template<typename T>
+std::map<const T*, std::string> reverse_names(
+    const generic_resource_pool<T>& pool
+){
+    std::map<const T*, std::string> names;
+    for(auto it = pool.cbegin(); it != pool.cend(); ++it)
+        names[it->second.get()] = it->first;
+    return names;
+}
+
+template<typename T>
+void write_floats(float* dst, const T& v)
+{
+    for(unsigned i = 0; i < T::length(); ++i) dst[i] = v[i];
+}
+
+class baked_writer
+{
+public:
+    baked_writer(const resource_pool& pool)
+    :   sampler_names(reverse_names<sampler>(pool)),
+        texture_names(reverse_names<texture>(pool)),
+        buffer_names(reverse_names<gpu_buffer>(pool)),
+        primitive_names(reverse_names<primitive>(pool)),
+        material_names(reverse_names<material>(pool)),
+        model_names(reverse_names<model>(pool))
+    {
+    }
+
+    void add_scene(const std::string& name, const scene_graph& graph)
+    {
+        // Sorted for a deterministic output
+        std::map<std::string, const object*> sorted;
+        for(const auto& pair: graph) sorted[pair.first] = &pair.second;
+
+        std::map<const transformable_node*, std::string> graph_names;
+        for(const auto& pair: sorted) graph_names[pair.second] = pair.first;
+
+        baked_scene& s = scenes.emplace_back();
+        s.name = add_string(name);
+        s.first_object = objects.size();
+
+        std::map<const transformable_node*, int32_t> indices;
+        for(const auto& pair: sorted)
+            add_object(pair.second, graph_names, indices);
+
+        s.object_count = objects.size() - s.first_object;
+    }
+
+    void write(const std::string& path)
+    {
+        baked_header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, BAKED_MAGIC, sizeof(BAKED_MAGIC));
+        header.version = BAKED_VERSION;
+        header.byte_order = BAKED_BYTE_ORDER;
+        header.header_size = sizeof(baked_header);
+
+        uint64_t offset = sizeof(baked_header);
+        header.samplers = place(samplers, offset);
+        header.textures = place(textures, offset);
+        header.levels = place(levels, offset);
+        header.buffers = place(buffers, offset);
+        header.primitives = place(primitives, offset);
+        header.attributes = place(attributes, offset);
+        header.materials = place(materials, offset);
+        header.models = place(models, offset);
+        header.groups = place(groups, offset);
+        header.scenes = place(scenes, offset);
+        header.objects = place(objects, offset);
+        header.strings_offset = offset;
+        header.strings_size = strings.size();
+        offset += strings.size();
+        header.blob_offset = align(offset, BLOB_ALIGNMENT);
+        header.blob_size = blob.size();
+
+        std::vector<uint8_t> file(header.blob_offset + blob.size(), 0);
+        memcpy(file.data(), &header, sizeof(header));
+        copy(file, header.samplers, samplers);
+        copy(file, header.textures, textures);
+        copy(file, header.levels, levels);
+        copy(file, header.buffers, buffers);
+        copy(file, header.primitives, primitives);
+        copy(file, header.attributes, attributes);
+        copy(file, header.materials, materials);
+        copy(file, header.models, models);
+        copy(file, header.groups, groups);
+        copy(file, header.scenes, scenes);
+        copy(file, header.objects, objects);
+        std::copy(
+            strings.begin(), strings.end(),
+            file.begin() + header.strings_offset
+        );
+        std::copy(blob.begin(), blob.end(), file.begin() + header.blob_offset);
+
+        if(!write_binary_file(path, file.data(), file.size()))
+            throw std::runtime_error("Unable to write " + path);
+    }
+
+private:
+    static uint64_t align(uint64_t offset, uint64_t alignment)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    template<typename T>
+    static baked_table place(const std::vector<T>& table, uint64_t& offset)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        offset = align(offset, 8);
+        baked_table t{offset, table.size()};
+        offset += table.size() * sizeof(T);
+        return t;
+    }
+
+    template<typename T>
+    static void copy(
+        std::vector<uint8_t>& file,
+        baked_table t,
+        const std::vector<T>& table
+    ){
+        if(table.size())
+            memcpy(file.data() + t.offset, table.data(), t.count * sizeof(T));
+    }
+
+    baked_string add_string(const std::string& str)
+    {
+        baked_string s{(uint32_t)strings.size(), (uint32_t)str.size()};
+        strings.insert(strings.end(), str.begin(), str.end());
+        return s;
+    }
+
+    baked_range add_blob(const void* data, size_t size)
+    {
+        baked_range r{align(blob.size(), DATA_ALIGNMENT), size};
+        blob.resize(r.offset + size);
+        memcpy(blob.data() + r.offset, data, size);
+        return r;
+    }
+
+    // Resources not found from the pool get a generated name.
+    template<typename T>
+    baked_string add_name(
+        const std::map<const T*, std::string>& names,
+        const T* res,
+        const char* kind,
+        size_t index
+    ){
+        auto it = names.find(res);
+        if(it != names.end()) return add_string(it->second);
+        return add_string(
+            std::string("baked_") + kind + "_" + std::to_string(index)
+        );
+    }
+
+    int32_t add(const sampler* smp)
+    {
+        if(!smp) return -1;
+        auto it = sampler_indices.find(smp);
+        if(it != sampler_indices.end()) return it->second;
+
+        baked_sampler s;
+        memset(&s, 0, sizeof(s));
+        s.name = add_name(sampler_names, smp, "sampler", samplers.size());
+
+        GLuint so = smp->get_sampler();
+        glGetSamplerParameteriv(so, GL_TEXTURE_MAG_FILTER, &s.mag);
+        glGetSamplerParameteriv(so, GL_TEXTURE_MIN_FILTER, &s.min);
+        glGetSamplerParameteriv(so, GL_TEXTURE_WRAP_S, &s.extension);
+        glGetSamplerParameteriv(
+            so, GL_TEXTURE_COMPARE_MODE, &s.comparison_mode
+        );
+        glGetSamplerParameterfv(so, GL_TEXTURE_BORDER_COLOR, s.border_color);
+        s.anisotropy = 1.0f;
+        if(GLEW_EXT_texture_filter_anisotropic)
+            glGetSamplerParameterfv(
+                so, GL_TEXTURE_MAX_ANISOTROPY_EXT, &s.anisotropy
+            );
+
+        samplers.push_back(s);
+        return sampler_indices[smp] = samplers.size() - 1;
+    }
+
+    int32_t add(const texture* tex)
+    {
+        if(!tex) return -1;
+        auto it = texture_indices.find(tex);
+        if(it != texture_indices.end()) return it->second;
+
+        if(tex->get_target() != GL_TEXTURE_2D)
+            throw std::runtime_error("Only 2D textures can be baked");
+
+        baked_texture t;
+        memset(&t, 0, sizeof(t));
+        t.name = add_name(texture_names, tex, "texture", textures.size());
+        t.internal_format = tex->get_internal_format();
+        t.type = tex->get_type();
+        t.width = tex->get_size().x;
+        t.height = tex->get_size().y;
+        t.first_level = levels.size();
+
+        gl_state& state = tex->get_context().get_state();
+        state.bind_texture(0, GL_TEXTURE_2D, tex->get_texture());
+        GLint level_count = 0;
+        glGetTexParameteriv(
+            GL_TEXTURE_2D, GL_TEXTURE_IMMUTABLE_LEVELS, &level_count
+        );
+        GLint compressed = 0;
+        glGetTexLevelParameteriv(
+            GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed
+        );
+        t.level_count = std::max(level_count, 1);
+        t.compressed = compressed;
+
+        // All mipmap levels are stored so that loading needs no generation.
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        std::vector<uint8_t> data;
+        for(unsigned level = 0; level < t.level_count; ++level)
+        {
+            if(compressed)
+            {
+                GLint size = 0;
+                glGetTexLevelParameteriv(
+                    GL_TEXTURE_2D, level,
+                    GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size
+                );
+                data.resize(size);
+                glGetCompressedTexImage(GL_TEXTURE_2D, level, data.data());
+            }
+            else
+            {
+                uvec2 size = max(tex->get_size() >> level, uvec2(1));
+                data.resize(size.x * size.y * tex->get_texel_size());
+                glGetTexImage(
+                    GL_TEXTURE_2D, level, tex->get_external_format(),
+                    t.type, data.data()
+                );
+            }
+            levels.push_back(add_blob(data.data(), data.size()));
+        }
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        state.bind_texture(0, GL_TEXTURE_2D, 0);
+
+        if(glGetError() != GL_NO_ERROR)
+            throw std::runtime_error("Failed to read a texture for baking");
+
+        textures.push_back(t);
+        return texture_indices[tex] = textures.size() - 1;
+    }
+
+    int32_t add(const gpu_buffer* buf)
+    {
+        if(!buf) return -1;
+        auto it = buffer_indices.find(buf);
+        if(it != buffer_indices.end()) return it->second;
+
+        baked_buffer b;
+        memset(&b, 0, sizeof(b));
+        b.name = add_name(buffer_names, buf, "buffer", buffers.size());
+        b.target = buf->get_target();
+
+        // Binding element array buffers must not affect any vertex array.
+        buf->get_context().get_state().bind_vertex_array(0);
+        std::vector<uint8_t> data = buf->read<uint8_t>();
+        b.data = add_blob(data.data(), data.size());
+
+        buffers.push_back(b);
+        return buffer_indices[buf] = buffers.size() - 1;
+    }
+
+    baked_accessor add(const gpu_buffer_accessor& accessor)
+    {
+        baked_accessor a;
+        memset(&a, 0, sizeof(a));
+        a.buffer = add(accessor.get_buffer());
+        a.components = accessor.get_components();
+        a.type = accessor.get_type();
+        a.normalized = accessor.is_normalized();
+        a.octahedral = accessor.is_octahedral();
+        a.stride = accessor.get_stride();
+        a.offset = accessor.get_offset();
+        return a;
+    }
+
+    int32_t add(const primitive* prim)
+    {
+        if(!prim) return -1;
+        auto it = primitive_indices.find(prim);
+        if(it != primitive_indices.end()) return it->second;
+
+        baked_primitive p;
+        memset(&p, 0, sizeof(p));
+        p.name = add_name(
+            primitive_names, prim, "primitive", primitives.size()
+        );
+        p.mode = prim->get_mode();
+        p.index_count = prim->get_index_count();
+        p.index = add(prim->get_index());
+        p.first_attribute = attributes.size();
+        for(const auto& pair: prim->get_attributes())
+        {
+            baked_attribute a;
+            memset(&a, 0, sizeof(a));
+            a.name = add_string(pair.first.name);
+            a.index = pair.first.index;
+            a.accessor = add(pair.second);
+            attributes.push_back(a);
+        }
+        p.attribute_count = attributes.size() - p.first_attribute;
+
+        const aabb& bounds = prim->get_bounding_box();
+        write_floats(p.bounds_min, bounds.get_min());
+        write_floats(p.bounds_max, bounds.get_max());
+        write_floats(p.position_scale, prim->get_position_scale());
+        write_floats(p.position_offset, prim->get_position_offset());
+
+        primitives.push_back(p);
+        return primitive_indices[prim] = primitives.size() - 1;
+    }
+
+    baked_sampler_tex add(const material::sampler_tex& st)
+    {
+        return {add(st.first), add(st.second)};
+    }
+
+    int32_t add(const material* mat)
+    {
+        if(!mat) return -1;
+        auto it = material_indices.find(mat);
+        if(it != material_indices.end()) return it->second;
+
+        baked_material m;
+        memset(&m, 0, sizeof(m));
+        m.name = add_name(material_names, mat, "material", materials.size());
+        write_floats(m.color_factor, mat->color_factor);
+        m.color_texture = add(mat->color_texture);
+        m.metallic_factor = mat->metallic_factor;
+        m.roughness_factor = mat->roughness_factor;
+        m.metallic_roughness_texture = add(mat->metallic_roughness_texture);
+        m.normal_factor = mat->normal_factor;
+        m.normal_texture = add(mat->normal_texture);
+        m.ior = mat->ior;
+        write_floats(m.emission_factor, mat->emission_factor);
+        m.emission_texture = add(mat->emission_texture);
+
+        materials.push_back(m);
+        return material_indices[mat] = materials.size() - 1;
+    }
+
+    int32_t add(const model* mod)
+    {
+        if(!mod) return -1;
+        auto it = model_indices.find(mod);
+        if(it != model_indices.end()) return it->second;
+
+        // Groups are gathered first, since adding them may add other models'
+        // records in between.
+        std::vector<baked_group> mod_groups;
+        for(const model::vertex_group& group: *mod)
+            mod_groups.push_back({add(group.mat), add(group.mesh)});
+
+        baked_model m;
+        memset(&m, 0, sizeof(m));
+        m.name = add_name(model_names, mod, "model", models.size());
+        m.first_group = groups.size();
+        m.group_count = mod_groups.size();
+        groups.insert(groups.end(), mod_groups.begin(), mod_groups.end());
+
+        models.push_back(m);
+        return model_indices[mod] = models.size() - 1;
+    }
+
+    int32_t add_object(
+        const object* obj,
+        const std::map<const transformable_node*, std::string>& graph_names,
+        std::map<const transformable_node*, int32_t>& indices
+    ){
+        auto it = indices.find(obj);
+        if(it != indices.end()) return it->second;
+
+        // Parents outside of the graph are dropped.
+        const transformable_node* parent = obj->get_parent();
+        int32_t parent_index = -1;
+        if(parent && graph_names.count(parent))
+        {
+            parent_index = add_object(
+                static_cast<const object*>(parent), graph_names, indices
+            );
+        }
+
+        baked_object o;
+        memset(&o, 0, sizeof(o));
+        o.name = add_string(graph_names.at(obj));
+        o.parent = parent_index;
+        o.model = add(obj->get_model());
+        write_floats(o.position, obj->get_position());
+        quat q = obj->get_orientation();
+        o.orientation[0] = q.x;
+        o.orientation[1] = q.y;
+        o.orientation[2] = q.z;
+        o.orientation[3] = q.w;
+        write_floats(o.scaling, obj->get_scaling());
+
+        objects.push_back(o);
+        int32_t index = objects.size() - 1 - scenes.back().first_object;
+        return indices[obj] = index;
+    }
+
+    std::map<const sampler*, std::string> sampler_names;
+    std::map<const texture*, std::string> texture_names;
+    std::map<const gpu_buffer*, std::string> buffer_names;
+    std::map<const primitive*, std::string> primitive_names;
+    std::map<const material*, std::string> material_names;
+    std::map<const model*, std::string> model_names;
+
+    std::map<const sampler*, int32_t> sampler_indices;
+    std::map<const texture*, int32_t> texture_indices;
+    std::map<const gpu_buffer*, int32_t> buffer_indices;
+    std::map<const primitive*, int32_t> primitive_indices;
+    std::map<const material*, int32_t> material_indices;
+    std::map<const model*, int32_t> model_indices;
+
+    std::vector<baked_sampler> samplers;
+    std::vector<baked_texture> textures;
+    std::vector<baked_range> levels;
+    std::vector<baked_buffer> buffers;
+    std::vector<baked_primitive> primitives;
+    std::vector<baked_attribute> attributes;
+    std::vector<baked_material> materials;
+    std::vector<baked_model> models;
+    std::vector<baked_group> groups;
+    std::vector<baked_scene> scenes;
+    std::vector<baked_object> objects;
+    std::vector<char> strings;
+    std::vector<uint8_t> blob;
+};
+
+// Uploads all mipmap levels directly from the mapped file once needed.
+class mapped_texture: public texture
+{
+public:
+    mapped_texture(
+        context& ctx,
+        const baked_texture& t,
+        std::vector<baked_range> levels,
+        const uint8_t* blob,
+        std::shared_ptr<mapped_file> file
+    ):  texture(ctx), compressed(t.compressed), levels(std::move(levels)),
+        blob(blob), file(std::move(file))
+    {
+        this->internal_format = t.internal_format;
+        this->type = t.type;
+        this->target = GL_TEXTURE_2D;
+        this->dimensions = uvec3(t.width, t.height, 1);
+    }
+
+protected:
+    void load_impl() const override
+    {
+        glGenTextures(1, &tex);
+        gl_state& state = get_context().get_state();
+        GLint prev_tex = state.get_texture(0, GL_TEXTURE_2D);
+        state.bind_texture(0, GL_TEXTURE_2D, tex);
+
+        glTexStorage2D(
+            GL_TEXTURE_2D, levels.size(), internal_format,
+            dimensions.x, dimensions.y
+        );
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        GLenum external_format =
+            internal_format_to_external_format(internal_format);
+        for(unsigned level = 0; level < levels.size(); ++level)
+        {
+            uvec2 size = max(uvec2(dimensions) >> level, uvec2(1));
+            const uint8_t* data = blob + levels[level].offset;
+            if(compressed)
+                glCompressedTexSubImage2D(
+                    GL_TEXTURE_2D, level, 0, 0, size.x, size.y,
+                    internal_format, levels[level].size, data
+                );
+            else
+                glTexSubImage2D(
+                    GL_TEXTURE_2D, level, 0, 0, size.x, size.y,
+                    external_format, type, data
+                );
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        if(prev_tex > 0) state.bind_texture(0, GL_TEXTURE_2D, prev_tex);
+
+        if(glGetError() != GL_NO_ERROR)
+            throw std::runtime_error("Failed to create a baked texture");
+    }
+
+    void unload_impl() const override
+    {
+        basic_unload();
+    }
+
+private:
+    bool compressed;
+    std::vector<baked_range> levels;
+    const uint8_t* blob;
+    std::shared_ptr<mapped_file> file;
+};
+
+class baked_reader
+{
+public:
+    baked_reader(const std::string& path)
+    : path(path), file(new mapped_file(path))
+    {
+        const uint8_t* data = file->get_data();
+        check(file->get_size() >= sizeof(baked_header), "truncated header");
+        memcpy(&header, data, sizeof(header));
+        check(
+            !memcmp(header.magic, BAKED_MAGIC, sizeof(BAKED_MAGIC)),
+            "not a baked scene"
+        );
+        check(header.version == BAKED_VERSION, "unsupported version");
+        check(header.byte_order == BAKED_BYTE_ORDER, "wrong byte order");
+        check(header.header_size == sizeof(baked_header), "wrong header");
+        check(
+            fits(header.strings_offset, header.strings_size, file->get_size()),
+            "string table out of bounds"
+        );
+        check(
+            fits(header.blob_offset, header.blob_size, file->get_size()),
+            "data out of bounds"
+        );
+        strings = (const char*)data + header.strings_offset;
+        blob = data + header.blob_offset;
+    }
+
+    template<typename T>
+    const T* table(const baked_table& t) const
+    {
+        check(
+            t.offset % alignof(T) == 0 &&
+            t.count <= file->get_size() / sizeof(T) &&
+            fits(t.offset, t.count * sizeof(T), file->get_size()),
+            "table out of bounds"
+        );
+        return (const T*)(file->get_data() + t.offset);
+    }
+
+    std::string string(baked_string s) const
+    {
+        check(fits(s.offset, s.size, header.strings_size), "bad string");
+        return std::string(strings + s.offset, s.size);
+    }
+
+    const uint8_t* data(baked_range r) const
+    {
+        check(fits(r.offset, r.size, header.blob_size), "bad data range");
+        return blob + r.offset;
+    }
+
+    void check_index(int32_t index, uint64_t count) const
+    {
+        check(index >= -1 && index < (int64_t)count, "bad index");
+    }
+
+    void check(bool condition, const char* what) const
+    {
+        if(!condition)
+            throw std::runtime_error(
+                "Corrupt baked scene " + path + ": " + what
+            );
+    }
+
+    static bool fits(uint64_t offset, uint64_t size, uint64_t total)
+    {
+        return offset <= total && size <= total - offset;
+    }
+
+    std::string path;
+    std::shared_ptr<mapped_file> file;
+    baked_header header;
+    const char* strings;
+    const uint8_t* blob;
+};
+
+vec3 read_vec3(const float* v)
+{
+    return vec3(v[0], v[1], v[2]);
+}
+
+vec4 read_vec4(const float* v)
+{
+    return vec4(v[0], v[1], v[2], v[3]);
+}
+
+}
+
+namespace lt
+{
+
+void save_baked_scene(
+    const resource_pool& pool,
+    const std::unordered_map<std::string, scene_graph>& scenes,
+    const std::string& path
+){
+    baked_writer writer(pool);
+
+    std::map<std::string, const scene_graph*> sorted;
+    for(const auto& pair: scenes) sorted[pair.first] = &pair.second;
+    for(const auto& pair: sorted) writer.add_scene(pair.first, *pair.second);
+
+    writer.write(path);
+}
+
+std::unordered_map<std::string, scene_graph> load_baked_scene(
+    resource_pool& pool,
+    const std::string& path,
+    bool ignore_duplicates
+){
+    context& ctx = pool.get_context();
+    baked_reader r(path);
+    const baked_header& h = r.header;
+
+    // Samplers
+    const baked_sampler* samplers = r.table<baked_sampler>(h.samplers);
+    std::vector<const sampler*> sampler_refs(h.samplers.count);
+    for(size_t i = 0; i < h.samplers.count; ++i)
+    {
+        const baked_sampler& s = samplers[i];
+        std::string name = r.string(s.name);
+        if(ignore_duplicates && pool.contains_sampler(name))
+        {
+            sampler_refs[i] = pool.get_sampler(name);
+            continue;
+        }
+        sampler_refs[i] = pool.add_sampler(name, new sampler(
+            ctx,
+            (interpolation)s.mag,
+            (interpolation)s.min,
+            s.extension,
+            (unsigned)s.anisotropy,
+            read_vec4(s.border_color),
+            s.comparison_mode
+        ));
+    }
+
+    // Textures
+    const baked_texture* textures = r.table<baked_texture>(h.textures);
+    const baked_range* levels = r.table<baked_range>(h.levels);
+    std::vector<const texture*> texture_refs(h.textures.count);
+    for(size_t i = 0; i < h.textures.count; ++i)
+    {
+        const baked_texture& t = textures[i];
+        std::string name = r.string(t.name);
+        if(ignore_duplicates && pool.contains_texture(name))
+        {
+            texture_refs[i] = pool.get_texture(name);
+            continue;
+        }
+
+        r.check(
+            t.level_count > 0 &&
+            r.fits(t.first_level, t.level_count, h.levels.count),
+            "bad texture levels"
+        );
+        std::vector<baked_range> tex_levels(
+            levels + t.first_level, levels + t.first_level + t.level_count
+        );
+        for(const baked_range& level: tex_levels) r.data(level);
+
+        texture_refs[i] = pool.add_texture(
+            name, new mapped_texture(ctx, t, tex_levels, r.blob, r.file)
+        );
+    }
+
+    // Buffers
+    const baked_buffer* buffers = r.table<baked_buffer>(h.buffers);
+    std::vector<const gpu_buffer*> buffer_refs(h.buffers.count);
+    for(size_t i = 0; i < h.buffers.count; ++i)
+    {
+        const baked_buffer& b = buffers[i];
+        std::string name = r.string(b.name);
+        if(ignore_duplicates && pool.contains_gpu_buffer(name))
+        {
+            buffer_refs[i] = pool.get_gpu_buffer(name);
+            continue;
+        }
+        // Uploads directly from the mapped file once needed.
+        buffer_refs[i] = pool.add_gpu_buffer(name, gpu_buffer::create(
+            ctx, b.target, b.data.size,
+            std::shared_ptr<const void>(r.file, r.data(b.data))
+        ));
+    }
+
+    auto read_accessor = [&](const baked_accessor& a){
+        r.check_index(a.buffer, h.buffers.count);
+        if(a.buffer < 0) return gpu_buffer_accessor();
+        return gpu_buffer_accessor(
+            *buffer_refs[a.buffer], a.components, a.type, a.normalized,
+            a.stride, a.offset, a.octahedral
+        );
+    };
+
+    // Primitives
+    const baked_primitive* primitives =
+        r.table<baked_primitive>(h.primitives);
+    const baked_attribute* attributes =
+        r.table<baked_attribute>(h.attributes);
+    std::vector<const primitive*> primitive_refs(h.primitives.count);
+    for(size_t i = 0; i < h.primitives.count; ++i)
+    {
+        const baked_primitive& p = primitives[i];
+        std::string name = r.string(p.name);
+        if(ignore_duplicates && pool.contains_primitive(name))
+        {
+            primitive_refs[i] = pool.get_primitive(name);
+            continue;
+        }
+
+        r.check(
+            r.fits(p.first_attribute, p.attribute_count, h.attributes.count),
+            "bad primitive attributes"
+        );
+        std::map<primitive::attribute, gpu_buffer_accessor> attribs;
+        for(size_t j = 0; j < p.attribute_count; ++j)
+        {
+            const baked_attribute& a = attributes[p.first_attribute + j];
+            attribs[{a.index, r.string(a.name)}] = read_accessor(a.accessor);
+        }
+
+        primitive* prim = pool.add_primitive(name, primitive::create(
+            ctx, p.index_count, p.mode, read_accessor(p.index), attribs
+        ));
+        prim->set_bounding_box(
+            aabb(read_vec3(p.bounds_min), read_vec3(p.bounds_max))
+        );
+        prim->set_position_decode(
+            read_vec3(p.position_scale), read_vec3(p.position_offset)
+        );
+        primitive_refs[i] = prim;
+    }
+
+    auto read_sampler_tex = [&](const baked_sampler_tex& st){
+        r.check_index(st.sampler, h.samplers.count);
+        r.check_index(st.texture, h.textures.count);
+        return material::sampler_tex(
+            st.sampler < 0 ? nullptr : sampler_refs[st.sampler],
+            st.texture < 0 ? nullptr : texture_refs[st.texture]
+        );
+    };
+
+    // Materials
+    const baked_material* materials = r.table<baked_material>(h.materials);
+    std::vector<const material*> material_refs(h.materials.count);
+    for(size_t i = 0; i < h.materials.count; ++i)
+    {
+        const baked_material& bm = materials[i];
+        std::string name = r.string(bm.name);
+        if(ignore_duplicates && pool.contains_material(name))
+        {
+            material_refs[i] = pool.get_material(name);
+            continue;
+        }
+
+        material* m = new material;
+        m->color_factor = read_vec4(bm.color_factor);
+        m->color_texture = read_sampler_tex(bm.color_texture);
+        m->metallic_factor = bm.metallic_factor;
+        m->roughness_factor = bm.roughness_factor;
+        m->metallic_roughness_texture =
+            read_sampler_tex(bm.metallic_roughness_texture);
+        m->normal_factor = bm.normal_factor;
+        m->normal_texture = read_sampler_tex(bm.normal_texture);
+        m->ior = bm.ior;
+        m->emission_factor = read_vec3(bm.emission_factor);
+        m->emission_texture = read_sampler_tex(bm.emission_texture);
+        material_refs[i] = pool.add_material(name, m);
+    }
+
+    // Models
+    const baked_model* models = r.table<baked_model>(h.models);
+    const baked_group* groups = r.table<baked_group>(h.groups);
+    std::vector<const model*> model_refs(h.models.count);
+    for(size_t i = 0; i < h.models.count; ++i)
+    {
+        const baked_model& bm = models[i];
+        std::string name = r.string(bm.name);
+        if(ignore_duplicates && pool.contains_model(name))
+        {
+            model_refs[i] = pool.get_model(name);
+            continue;
+        }
+
+        r.check(
+            r.fits(bm.first_group, bm.group_count, h.groups.count),
+            "bad model groups"
+        );
+        model* m = new model;
+        for(size_t j = 0; j < bm.group_count; ++j)
+        {
+            const baked_group& g = groups[bm.first_group + j];
+            r.check_index(g.material, h.materials.count);
+            r.check_index(g.primitive, h.primitives.count);
+            m->add_vertex_group(
+                g.material < 0 ? nullptr : material_refs[g.material],
+                g.primitive < 0 ? nullptr : primitive_refs[g.primitive]
+            );
+        }
+        model_refs[i] = pool.add_model(name, m);
+    }
+
+    // Scenes
+    std::unordered_map<std::string, scene_graph> scenes;
+    const baked_scene* baked_scenes = r.table<baked_scene>(h.scenes);
+    const baked_object* objects = r.table<baked_object>(h.objects);
+    for(size_t i = 0; i < h.scenes.count; ++i)
+    {
+        const baked_scene& s = baked_scenes[i];
+        r.check(
+            r.fits(s.first_object, s.object_count, h.objects.count),
+            "bad scene objects"
+        );
+        scene_graph& graph = scenes[r.string(s.name)];
+
+        std::vector<object*> scene_objects(s.object_count);
+        for(size_t j = 0; j < s.object_count; ++j)
+        {
+            const baked_object& o = objects[s.first_object + j];
+            r.check(o.parent >= -1 && o.parent < (int64_t)j, "bad parent");
+            r.check_index(o.model, h.models.count);
+
+            object obj(
+                o.model < 0 ? nullptr : model_refs[o.model],
+                o.parent < 0 ? nullptr : scene_objects[o.parent]
+            );
+            obj.set_position(read_vec3(o.position));
+            obj.set_orientation(quat(
+                o.orientation[3], o.orientation[0],
+                o.orientation[1], o.orientation[2]
+            ));
+            obj.set_scaling(read_vec3(o.scaling));
+
+            scene_objects[j] = graph.add_object(
+                r.string(o.name), std::move(obj), ignore_duplicates
+            );
+        }
+    }
+
+    return scenes;
+}
+
+} // namespace lt
@@ -0,0 +1,185 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "bounds.hh"
+#include <limits>
+
+namespace lt
+{
+
+aabb::aabb()
+:   min(std::numeric_limits<float>::infinity()),
+    max(-std::numeric_limits<float>::infinity())
+{}
+
+aabb::aabb(vec3 min, vec3 max)
+: min(min), max(max) {}
+
+void aabb::expand(vec3 p)
+{
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+}
+
+void aabb::expand(const aabb& other)
+{
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+}
+
+bool aabb::is_empty() const
+{
+    return min.x > max.x || min.y > max.y || min.z > max.z;
+}
+
+vec3 aabb::get_min() const
+{
+    return min;
+}
+
+vec3 aabb::get_max() const
+{
+    return max;
+}
+
+vec3 aabb::get_center() const
+{
+    return (min + max) * 0.5f;
+}
+
+vec3 aabb::get_extent() const
+{
+    return (max - min) * 0.5f;
+}
+
+// Using method from Arvo, "Transforming Axis-Aligned Bounding Boxes",
+// Graphics Gems, 1990.
+aabb aabb::transform(const mat4& transform) const
+{
+    if(is_empty()) return *this;
+
+    vec3 center = transform * vec4(get_center(), 1);
+    vec3 extent = get_extent();
+    vec3 new_extent(0);
+
+    for(unsigned i = 0; i < 3; ++i)
+        for(unsigned j = 0; j < 3; ++j)
+            new_extent[i] += fabs(transform[j][i]) * extent[j];
+
+    return aabb(center - new_extent, center + new_extent);
+}
+
+bool aabb::contains(const aabb& other) const
+{
+    return glm::all(glm::lessThanEqual(min, other.min)) &&
+           glm::all(glm::greaterThanEqual(max, other.max));
+}
+
+bool aabb::intersects(const aabb& other) const
+{
+    return glm::all(glm::lessThanEqual(min, other.max)) &&
+           glm::all(glm::greaterThanEqual(max, other.min));
+}
+
+bool aabb::intersects_sphere(vec3 center, float radius) const
+{
+    if(is_empty()) return false;
+    vec3 d = glm::clamp(center, min, max) - center;
+    return glm::dot(d, d) <= radius * radius;
+}
+
+bool aabb::intersects_ray(vec3 origin, vec3 inv_dir, float& t) const
+{
+    vec3 t0 = (min - origin) * inv_dir;
+    vec3 t1 = (max - origin) * inv_dir;
+    vec3 t_near = glm::min(t0, t1);
+    vec3 t_far = glm::max(t0, t1);
+
+    float enter = glm::max(glm::max(t_near.x, t_near.y), t_near.z);
+    float exit = glm::min(glm::min(t_far.x, t_far.y), t_far.z);
+
+    if(exit < 0 || enter > exit) return false;
+
+    t = glm::max(enter, 0.0f);
+    return true;
+}
+
+float aabb::surface_area() const
+{
+    if(is_empty()) return 0;
+    vec3 size = max - min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+frustum::frustum()
+{
+    for(vec4& plane: planes) plane = vec4(0, 0, 0, 1);
+}
+
+// Using method from Gribb & Hartmann, "Fast Extraction of Viewing Frustum
+// Planes from the World-View-Projection Matrix", 2001.
+frustum::frustum(const mat4& view_projection)
+{
+    mat4 t = glm::transpose(view_projection);
+
+    planes[0] = t[3] + t[0];
+    planes[1] = t[3] - t[0];
+    planes[2] = t[3] + t[1];
+    planes[3] = t[3] - t[1];
+    planes[4] = t[3] + t[2];
+    planes[5] = t[3] - t[2];
+
+    for(vec4& plane: planes)
+    {
+        // The far plane of an infinite perspective projection has a zero
+        // normal and a positive distance, so it just accepts everything.
+        float len = glm::length(vec3(plane));
+        if(len > 0) plane /= len;
+    }
+}
+
+bool frustum::intersects(const aabb& box) const
+{
+    if(box.is_empty()) return false;
+
+    vec3 min = box.get_min();
+    vec3 max = box.get_max();
+
+    for(const vec4& plane: planes)
+    {
+        // Test the corner furthest along the plane normal.
+        vec3 p(
+            plane.x >= 0 ? max.x : min.x,
+            plane.y >= 0 ? max.y : min.y,
+            plane.z >= 0 ? max.z : min.z
+        );
+        if(glm::dot(vec3(plane), p) + plane.w < 0) return false;
+    }
+    return true;
+}
+
+bool frustum::intersects(vec3 center, float radius) const
+{
+    for(const vec4& plane: planes)
+    {
+        if(glm::dot(vec3(plane), center) + plane.w < -radius) return false;
+    }
+    return true;
+}
+
+} // namespace lt
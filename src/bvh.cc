@@ -0,0 +1,491 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "bvh.hh"
+#include "object.hh"
+#include "model.hh"
+#include "helpers.hh"
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+using namespace lt;
+
+aabb merge(const aabb& a, const aabb& b)
+{
+    aabb result(a);
+    result.expand(b);
+    return result;
+}
+
+}
+
+// The tree is maintained like the dynamic AABB tree of Box2D: leaves are
+// inserted next to the sibling that minimizes the surface area heuristic and
+// the tree is kept balanced with AVL-style rotations.
+namespace lt
+{
+
+bool object_bvh::node::is_leaf() const
+{
+    return left == NONE;
+}
+
+object_bvh::object_bvh()
+: root(NONE), free_list(NONE), margin(0.1f), refit_revision(0) {}
+
+object_bvh::~object_bvh() {}
+
+void object_bvh::insert(object* obj)
+{
+    if(entries.count(obj)) return;
+
+    entry e = {NONE, obj->get_generation(), obj->get_model()};
+    aabb bounds;
+    if(!get_world_bounds(obj, bounds))
+    {
+        sorted_insert(unbounded, obj);
+        entries[obj] = e;
+        return;
+    }
+
+    float m = margin * glm::length(bounds.get_extent());
+    e.leaf = allocate_node();
+    nodes[e.leaf].bounds = aabb(bounds.get_min() - m, bounds.get_max() + m);
+    nodes[e.leaf].obj = obj;
+    insert_leaf(e.leaf);
+    entries[obj] = e;
+}
+
+void object_bvh::remove(object* obj)
+{
+    auto it = entries.find(obj);
+    if(it == entries.end()) return;
+
+    int leaf = it->second.leaf;
+    if(leaf == NONE) sorted_erase(unbounded, obj);
+    else
+    {
+        remove_leaf(leaf);
+        free_node(leaf);
+    }
+    entries.erase(it);
+}
+
+void object_bvh::clear()
+{
+    nodes.clear();
+    root = NONE;
+    free_list = NONE;
+    entries.clear();
+    unbounded.clear();
+    refit_revision = 0;
+}
+
+void object_bvh::refit()
+{
+    // Nothing in any scene has moved, so every cull after the first one in
+    // a frame returns here.
+    uint64_t revision = transformable::get_global_revision();
+    if(revision == refit_revision) return;
+    refit_revision = revision;
+
+    // Unchanged objects only cost a comparison of their generation.
+    std::vector<object*> moved;
+    for(auto& pair: entries)
+    {
+        object* obj = pair.first;
+        entry& e = pair.second;
+        uint64_t generation = obj->get_generation();
+        const model* mod = obj->get_model();
+        if(generation == e.generation && mod == e.mod) continue;
+
+        e.generation = generation;
+        e.mod = mod;
+
+        aabb bounds;
+        bool bounded = get_world_bounds(obj, bounds);
+        if(
+            e.leaf == NONE ? bounded :
+            !bounded || !nodes[e.leaf].bounds.contains(bounds)
+        ) moved.push_back(obj);
+    }
+
+    for(object* obj: moved)
+    {
+        remove(obj);
+        insert(obj);
+    }
+}
+
+void object_bvh::set_margin(float margin)
+{
+    this->margin = margin;
+}
+
+float object_bvh::get_margin() const
+{
+    return margin;
+}
+
+void object_bvh::query(const frustum& f, std::vector<object*>& result) const
+{
+    traverse([&](const aabb& b){ return f.intersects(b); }, result);
+}
+
+void object_bvh::query(
+    vec3 center,
+    float radius,
+    std::vector<object*>& result
+) const
+{
+    traverse(
+        [&](const aabb& b){ return b.intersects_sphere(center, radius); },
+        result
+    );
+}
+
+void object_bvh::query(const aabb& box, std::vector<object*>& result) const
+{
+    traverse([&](const aabb& b){ return b.intersects(box); }, result);
+}
+
+void object_bvh::query(
+    vec3 origin,
+    vec3 dir,
+    std::vector<object*>& result,
+    float max_distance
+) const
+{
+    vec3 inv_dir = 1.0f / dir;
+    std::vector<std::pair<float, object*>> hits;
+
+    std::vector<int> stack;
+    if(root != NONE) stack.push_back(root);
+
+    while(stack.size())
+    {
+        const node& n = nodes[stack.back()];
+        stack.pop_back();
+
+        float t = 0;
+        if(!n.bounds.intersects_ray(origin, inv_dir, t) || t > max_distance)
+            continue;
+
+        if(n.is_leaf()) hits.emplace_back(t, n.obj);
+        else
+        {
+            stack.push_back(n.left);
+            stack.push_back(n.right);
+        }
+    }
+
+    std::sort(
+        hits.begin(),
+        hits.end(),
+        [](const auto& a, const auto& b){ return a.first < b.first; }
+    );
+
+    result.reserve(result.size() + hits.size() + unbounded.size());
+    for(const auto& hit: hits) result.push_back(hit.second);
+    result.insert(result.end(), unbounded.begin(), unbounded.end());
+}
+
+size_t object_bvh::size() const
+{
+    return entries.size();
+}
+
+unsigned object_bvh::get_height() const
+{
+    return root == NONE ? 0 : nodes[root].height;
+}
+
+int object_bvh::allocate_node()
+{
+    int index = free_list;
+    if(index == NONE)
+    {
+        index = nodes.size();
+        nodes.emplace_back();
+    }
+    else free_list = nodes[index].parent;
+
+    node& n = nodes[index];
+    n.bounds = aabb();
+    n.parent = n.left = n.right = NONE;
+    n.height = 0;
+    n.obj = nullptr;
+    return index;
+}
+
+void object_bvh::free_node(int index)
+{
+    nodes[index].parent = free_list;
+    nodes[index].obj = nullptr;
+    free_list = index;
+}
+
+bool object_bvh::get_world_bounds(object* obj, aabb& bounds) const
+{
+    const model* mod = obj->get_model();
+    if(!mod || !mod->is_bounded()) return false;
+
+    bounds = mod->get_bounding_box().transform(obj->get_global_transform());
+    return true;
+}
+
+void object_bvh::insert_leaf(int leaf)
+{
+    if(root == NONE)
+    {
+        root = leaf;
+        nodes[root].parent = NONE;
+        return;
+    }
+
+    aabb leaf_bounds = nodes[leaf].bounds;
+
+    // Find the best sibling
+    int index = root;
+    while(!nodes[index].is_leaf())
+    {
+        const node& n = nodes[index];
+        float area = n.bounds.surface_area();
+        float combined_area = merge(n.bounds, leaf_bounds).surface_area();
+
+        // Cost of creating a new parent for this node and the new leaf
+        float cost = 2.0f * combined_area;
+        // Minimum cost of pushing the leaf further down the tree
+        float inheritance_cost = 2.0f * (combined_area - area);
+
+        auto child_cost = [&](int child){
+            const aabb& b = nodes[child].bounds;
+            float new_area = merge(b, leaf_bounds).surface_area();
+            if(nodes[child].is_leaf()) return new_area + inheritance_cost;
+            return new_area - b.surface_area() + inheritance_cost;
+        };
+
+        float left_cost = child_cost(n.left);
+        float right_cost = child_cost(n.right);
+
+        if(cost < left_cost && cost < right_cost) break;
+
+        index = left_cost < right_cost ? n.left : n.right;
+    }
+
+    int sibling = index;
+    int old_parent = nodes[sibling].parent;
+    int new_parent = allocate_node();
+
+    node& p = nodes[new_parent];
+    p.parent = old_parent;
+    p.bounds = merge(leaf_bounds, nodes[sibling].bounds);
+    p.height = nodes[sibling].height + 1;
+    p.left = sibling;
+    p.right = leaf;
+
+    if(old_parent != NONE)
+    {
+        if(nodes[old_parent].left == sibling)
+            nodes[old_parent].left = new_parent;
+        else nodes[old_parent].right = new_parent;
+    }
+    else root = new_parent;
+
+    nodes[sibling].parent = new_parent;
+    nodes[leaf].parent = new_parent;
+
+    // Walk back up the tree fixing heights and bounds
+    index = nodes[leaf].parent;
+    while(index != NONE)
+    {
+        index = balance(index);
+
+        node& n = nodes[index];
+        n.height = 1 + glm::max(nodes[n.left].height, nodes[n.right].height);
+        n.bounds = merge(nodes[n.left].bounds, nodes[n.right].bounds);
+
+        index = n.parent;
+    }
+}
+
+void object_bvh::remove_leaf(int leaf)
+{
+    if(leaf == root)
+    {
+        root = NONE;
+        return;
+    }
+
+    int parent = nodes[leaf].parent;
+    int grandparent = nodes[parent].parent;
+    int sibling = nodes[parent].left == leaf ?
+        nodes[parent].right : nodes[parent].left;
+
+    free_node(parent);
+
+    if(grandparent == NONE)
+    {
+        root = sibling;
+        nodes[sibling].parent = NONE;
+        return;
+    }
+
+    if(nodes[grandparent].left == parent) nodes[grandparent].left = sibling;
+    else nodes[grandparent].right = sibling;
+    nodes[sibling].parent = grandparent;
+
+    int index = grandparent;
+    while(index != NONE)
+    {
+        index = balance(index);
+
+        node& n = nodes[index];
+        n.height = 1 + glm::max(nodes[n.left].height, nodes[n.right].height);
+        n.bounds = merge(nodes[n.left].bounds, nodes[n.right].bounds);
+
+        index = n.parent;
+    }
+}
+
+// Rotates the taller child of 'ia' up if the children are unbalanced.
+// Returns the index of the node now in the place of 'ia'.
+int object_bvh::balance(int ia)
+{
+    node& a = nodes[ia];
+    if(a.is_leaf() || a.height < 2) return ia;
+
+    int ib = a.left;
+    int ic = a.right;
+    node& b = nodes[ib];
+    node& c = nodes[ic];
+
+    int difference = c.height - b.height;
+
+    if(difference > 1)
+    {// Rotate C up
+        int i_f = c.left;
+        int i_g = c.right;
+        node& f = nodes[i_f];
+        node& g = nodes[i_g];
+
+        c.left = ia;
+        c.parent = a.parent;
+        a.parent = ic;
+
+        if(c.parent != NONE)
+        {
+            if(nodes[c.parent].left == ia) nodes[c.parent].left = ic;
+            else nodes[c.parent].right = ic;
+        }
+        else root = ic;
+
+        if(f.height > g.height)
+        {
+            c.right = i_f;
+            a.right = i_g;
+            g.parent = ia;
+            a.bounds = merge(b.bounds, g.bounds);
+            c.bounds = merge(a.bounds, f.bounds);
+            a.height = 1 + glm::max(b.height, g.height);
+            c.height = 1 + glm::max(a.height, f.height);
+        }
+        else
+        {
+            c.right = i_g;
+            a.right = i_f;
+            f.parent = ia;
+            a.bounds = merge(b.bounds, f.bounds);
+            c.bounds = merge(a.bounds, g.bounds);
+            a.height = 1 + glm::max(b.height, f.height);
+            c.height = 1 + glm::max(a.height, g.height);
+        }
+        return ic;
+    }
+
+    if(difference < -1)
+    {// Rotate B up
+        int i_d = b.left;
+        int i_e = b.right;
+        node& d = nodes[i_d];
+        node& e = nodes[i_e];
+
+        b.left = ia;
+        b.parent = a.parent;
+        a.parent = ib;
+
+        if(b.parent != NONE)
+        {
+            if(nodes[b.parent].left == ia) nodes[b.parent].left = ib;
+            else nodes[b.parent].right = ib;
+        }
+        else root = ib;
+
+        if(d.height > e.height)
+        {
+            b.right = i_d;
+            a.left = i_e;
+            e.parent = ia;
+            a.bounds = merge(c.bounds, e.bounds);
+            b.bounds = merge(a.bounds, d.bounds);
+            a.height = 1 + glm::max(c.height, e.height);
+            b.height = 1 + glm::max(a.height, d.height);
+        }
+        else
+        {
+            b.right = i_e;
+            a.left = i_d;
+            d.parent = ia;
+            a.bounds = merge(c.bounds, d.bounds);
+            b.bounds = merge(a.bounds, e.bounds);
+            a.height = 1 + glm::max(c.height, d.height);
+            b.height = 1 + glm::max(a.height, e.height);
+        }
+        return ib;
+    }
+
+    return ia;
+}
+
+template<typename F>
+void object_bvh::traverse(F&& test, std::vector<object*>& result) const
+{
+    std::vector<int> stack;
+    if(root != NONE) stack.push_back(root);
+
+    while(stack.size())
+    {
+        const node& n = nodes[stack.back()];
+        stack.pop_back();
+
+        if(!test(n.bounds)) continue;
+
+        if(n.is_leaf()) result.push_back(n.obj);
+        else
+        {
+            stack.push_back(n.left);
+            stack.push_back(n.right);
+        }
+    }
+
+    result.insert(result.end(), unbounded.begin(), unbounded.end());
+}
+
+} // namespace lt
@@ -245,6 +245,13 @@ namespace lt
 {
 
 context::context()
+: use_sdl(true)
+{
+    init();
+}
+
+context::context(bool use_sdl)
+: use_sdl(use_sdl)
 {
     init();
 }
@@ -261,6 +268,22 @@ context::~context()
 const std::string& context::get_vendor_name() const { return vendor; }
 const std::string& context::get_renderer() const { return renderer; }
 
+gl_state& context::get_state()
+{
+    return state;
+}
+
+unsigned context::get_definitions_id(
+    const std::map<std::string, std::string>& definitions
+){
+    auto it = definitions_ids.find(definitions);
+    if(it != definitions_ids.end()) return it->second;
+
+    unsigned id = definitions_ids.size() + 1;
+    definitions_ids.emplace(definitions, id);
+    return id;
+}
+
 GLint64 context::operator[](GLenum pname) const
 {
     return get(pname);
@@ -397,15 +420,24 @@ unsigned& context::instances()
     return inst;
 }
 
+unsigned& context::sdl_instances()
+{
+    static unsigned inst = 0;
+    return inst;
+}
+
 void context::init()
 {
-    if(instances()++ == 0)
+    if(use_sdl && sdl_instances()++ == 0)
     {
         if(SDL_Init(SDL_INIT_EVERYTHING))
         {
             throw std::runtime_error(SDL_GetError());
         }
+    }
 
+    if(instances()++ == 0)
+    {
         FT_Library* ft = static_cast<FT_Library*>(freetype());
         FT_Error err = FT_Init_FreeType(ft);
         if(err)
@@ -421,9 +453,9 @@ void context::deinit()
     {
         FT_Library* ft = static_cast<FT_Library*>(freetype());
         FT_Done_FreeType(*ft);
-
-        SDL_Quit();
     }
+
+    if(use_sdl && --sdl_instances() == 0) SDL_Quit();
 }
 
 } // namespace lt
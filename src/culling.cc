@@ -0,0 +1,162 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "culling.hh"
+#include "object.hh"
+#include "model.hh"
+#include "primitive.hh"
+#include "scene.hh"
+#include <algorithm>
+
+namespace lt
+{
+
+bool visible_set::entry::is_group_visible(size_t i) const
+{
+    return i >= 64 || (group_mask >> i) & 1;
+}
+
+visible_set::visible_set() {}
+
+// Performs the exact tests for the candidates returned by the hierarchy.
+template<typename F>
+void visible_set::update_impl(F&& test)
+{
+    entries.clear();
+
+    // Frustums may return the same object more than once. Sorting by address
+    // removes the duplicates and makes the order independent of the tree.
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(
+        std::unique(candidates.begin(), candidates.end()),
+        candidates.end()
+    );
+
+    for(object* obj: candidates)
+    {
+        const model* mod = obj->get_model();
+        if(!mod) continue;
+
+        mat4 m = obj->get_global_transform();
+
+        // Models with unknown bounds can't be culled as a whole, but some of
+        // their groups may still have bounds.
+        bool bounded = mod->is_bounded();
+        if(bounded && !test(mod->get_bounding_box().transform(m))) continue;
+
+        // A single group is already covered by the object test.
+        if(bounded && mod->group_count() <= 1)
+        {
+            entries.push_back({obj, m, ~uint64_t(0)});
+            continue;
+        }
+
+        uint64_t mask = 0;
+        size_t i = 0;
+        for(const model::vertex_group& group: *mod)
+        {
+            if(i >= 64) break;
+            if(group.mesh)
+            {
+                const aabb& bounds = group.mesh->get_bounding_box();
+                if(bounds.is_empty() || test(bounds.transform(m)))
+                    mask |= uint64_t(1) << i;
+            }
+            ++i;
+        }
+
+        if(mask != 0 || mod->group_count() > 64)
+            entries.push_back({obj, m, mask});
+    }
+}
+
+void visible_set::update(
+    object_scene* objects,
+    const std::vector<frustum>& frustums
+){
+    objects->update_bounds();
+    candidates.clear();
+    for(const frustum& f: frustums) objects->get_bvh().query(f, candidates);
+
+    update_impl([&](const aabb& box){
+        for(const frustum& f: frustums)
+            if(f.intersects(box)) return true;
+        return false;
+    });
+}
+
+void visible_set::update(
+    object_scene* objects,
+    const mat4& view_projection
+){
+    frustum f(view_projection);
+    objects->update_bounds();
+    candidates.clear();
+    objects->get_bvh().query(f, candidates);
+
+    update_impl([&](const aabb& box){
+        return f.intersects(box);
+    });
+}
+
+void visible_set::update(
+    object_scene* objects,
+    vec3 center,
+    float radius
+){
+    objects->update_bounds();
+    candidates.clear();
+    objects->get_bvh().query(center, radius, candidates);
+
+    update_impl([&](const aabb& box){
+        return box.intersects_sphere(center, radius);
+    });
+}
+
+void visible_set::clear()
+{
+    entries.clear();
+    candidates.clear();
+}
+
+size_t visible_set::size() const
+{
+    return entries.size();
+}
+
+visible_set::const_iterator visible_set::begin() const
+{
+    return entries.begin();
+}
+
+visible_set::const_iterator visible_set::cbegin() const
+{
+    return entries.cbegin();
+}
+
+visible_set::const_iterator visible_set::end() const
+{
+    return entries.end();
+}
+
+visible_set::const_iterator visible_set::cend() const
+{
+    return entries.cend();
+}
+
+} // namespace lt
@@ -18,6 +18,7 @@
 */
 #include "doublebuffer.hh"
 #include "helpers.hh"
+#include "context.hh"
 #include <stdexcept>
 
 namespace lt
@@ -89,7 +90,11 @@ doublebuffer::target::target(target&& other)
 
 doublebuffer::target::~target()
 {
-    if(fbo != 0) glDeleteFramebuffers(1, &fbo);
+    if(fbo != 0)
+    {
+        get_context().get_state().forget_framebuffer(fbo);
+        glDeleteFramebuffers(1, &fbo);
+    }
 }
 
 void doublebuffer::target::set_depth_stencil(texture* depth_stencil)
@@ -0,0 +1,176 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "draw_queue.hh"
+#include "object.hh"
+#include "model.hh"
+#include "material.hh"
+#include "primitive.hh"
+#include "multishader.hh"
+#include <cstring>
+
+namespace
+{
+using namespace lt;
+
+// Key layout from the most significant bit: 12 bits of shader, 16 bits of
+// material, 16 bits of mesh and 20 bits of depth. Ids that don't fit just
+// alias, which only makes the order slightly less optimal.
+constexpr unsigned SHADER_SHIFT = 52;
+constexpr unsigned MATERIAL_SHIFT = 36;
+constexpr unsigned MESH_SHIFT = 20;
+
+uint64_t quantize_depth(float depth)
+{
+    // The bit patterns of non-negative floats sort like the floats
+    // themselves, so the top bits work as a coarse depth.
+    depth = glm::max(depth, 0.0f);
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return bits >> 11;
+}
+
+}
+
+namespace lt
+{
+
+draw_queue::draw_queue() {}
+
+void draw_queue::build(
+    const visible_set& visible,
+    vec3 viewer,
+    multishader* ms,
+    const shader::definition_map& common,
+    bool potentially_transparent_only
+){
+    commands.clear();
+    unsorted.clear();
+    shader_ids.clear();
+    material_ids.clear();
+    mesh_ids.clear();
+
+    unsigned pass_key = ms ? ms->get_pass_key(common) : 0;
+
+    for(const visible_set::entry& e: visible)
+    {
+        uint64_t depth = quantize_depth(
+            glm::distance(viewer, vec3(e.transform[3]))
+        );
+
+        size_t group_index = 0;
+        for(const model::vertex_group& group: *e.obj->get_model())
+        {
+            if(!e.is_group_visible(group_index++)) continue;
+            if(!group.mesh) continue;
+
+            command c{0, nullptr, nullptr, group.mesh, &e};
+
+            if(ms)
+            {
+                if(!group.mat) continue;
+                if(!group.mat->potentially_transparent() &&
+                   potentially_transparent_only) continue;
+
+                c.mat = group.mat;
+                c.s = ms->get(pass_key, group.mat, group.mesh);
+
+                c.key |= (uint64_t)(get_id(shader_ids, c.s) & 0xFFF)
+                    << SHADER_SHIFT;
+                c.key |= (uint64_t)(get_id(material_ids, c.mat) & 0xFFFF)
+                    << MATERIAL_SHIFT;
+            }
+
+            c.key |= (uint64_t)(get_id(mesh_ids, c.mesh) & 0xFFFF)
+                << MESH_SHIFT;
+            c.key |= depth;
+
+            unsorted.push_back(c);
+        }
+    }
+
+    items.resize(unsorted.size());
+    for(size_t i = 0; i < unsorted.size(); ++i)
+        items[i] = {unsorted[i].key, (uint32_t)i};
+
+    // LSD radix sort with 8-bit digits. Digits shared by every key are
+    // skipped, which is common for the upper bits of small scenes.
+    tmp.resize(items.size());
+    for(unsigned shift = 0; shift < 64 && items.size(); shift += 8)
+    {
+        size_t counts[256] = {0};
+        for(const sort_item& item: items) counts[(item.key >> shift) & 0xFF]++;
+
+        if(counts[(items[0].key >> shift) & 0xFF] == items.size()) continue;
+
+        size_t offset = 0;
+        for(size_t& count: counts)
+        {
+            size_t n = count;
+            count = offset;
+            offset += n;
+        }
+
+        for(const sort_item& item: items)
+            tmp[counts[(item.key >> shift) & 0xFF]++] = item;
+
+        items.swap(tmp);
+    }
+
+    commands.reserve(items.size());
+    for(const sort_item& item: items) commands.push_back(unsorted[item.index]);
+}
+
+void draw_queue::clear()
+{
+    commands.clear();
+}
+
+size_t draw_queue::size() const
+{
+    return commands.size();
+}
+
+draw_queue::const_iterator draw_queue::begin() const
+{
+    return commands.cbegin();
+}
+
+draw_queue::const_iterator draw_queue::cbegin() const
+{
+    return commands.cbegin();
+}
+
+draw_queue::const_iterator draw_queue::end() const
+{
+    return commands.cend();
+}
+
+draw_queue::const_iterator draw_queue::cend() const
+{
+    return commands.cend();
+}
+
+unsigned draw_queue::get_id(
+    std::unordered_map<const void*, unsigned>& ids,
+    const void* ptr
+){
+    return ids.emplace(ptr, ids.size()).first->second;
+}
+
+} // namespace lt
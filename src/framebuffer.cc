@@ -200,7 +200,11 @@ framebuffer::~framebuffer()
         }
     }
 
-    if(fbo != 0) glDeleteFramebuffers(1, &fbo);
+    if(fbo != 0)
+    {
+        get_context().get_state().forget_framebuffer(fbo);
+        glDeleteFramebuffers(1, &fbo);
+    }
 }
 
 const framebuffer::target_specification_map&
@@ -21,6 +21,7 @@
 #include "shader.hh"
 #include "shader_pool.hh"
 #include "primitive.hh"
+#include "context.hh"
 #include <stdexcept>
 
 namespace lt
@@ -214,7 +215,11 @@ gbuffer::gbuffer(gbuffer&& other)
 gbuffer::~gbuffer()
 {
     if(depth_stencil_rbo != 0) glDeleteRenderbuffers(1, &depth_stencil_rbo);
-    if(fbo != 0) glDeleteFramebuffers(1, &fbo);
+    if(fbo != 0)
+    {
+        get_context().get_state().forget_framebuffer(fbo);
+        glDeleteFramebuffers(1, &fbo);
+    }
 }
 
 texture* gbuffer::get_normal() const { return normal; }
@@ -289,8 +294,10 @@ void gbuffer::update_definitions(shader::definition_map& def) const
 
 void gbuffer::clear()
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    glStencilMask(0xFF);
+    // Usually the gbuffer is already bound, the binding is then kept.
+    bool bound = is_bound();
+    if(!bound) glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    get_context().get_state().stencil_mask(0xFF);
     static const float zero[4] = {0};
     static const float neg_infinite[4] = {
         -INFINITY, -INFINITY, -INFINITY, -INFINITY
@@ -311,15 +318,15 @@ void gbuffer::clear()
 
     glClearDepth(1);
     glClearStencil(0);
-    glStencilMask(0xFF);
 
     glClear(GL_DEPTH_BUFFER_BIT|GL_STENCIL_BUFFER_BIT);
-    reinstate_current_fbo();
+    if(!bound) reinstate_current_fbo();
 }
 
 void gbuffer::set_draw(draw_mode mode)
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    bool bound = is_bound();
+    if(!bound) glBindFramebuffer(GL_FRAMEBUFFER, fbo);
     std::vector<unsigned> attachments;
     int index = 0;
 
@@ -478,7 +485,7 @@ void gbuffer::set_draw(draw_mode mode)
 
     this->mode = mode;
 
-    reinstate_current_fbo();
+    if(!bound) reinstate_current_fbo();
 }
 
 gbuffer::draw_mode gbuffer::get_draw() const
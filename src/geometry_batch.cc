@@ -0,0 +1,475 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "geometry_batch.hh"
+#include "object.hh"
+#include "model.hh"
+#include "primitive.hh"
+#include "gpu_buffer.hh"
+#include "helpers.hh"
+#include "context.hh"
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <map>
+
+namespace
+{
+using namespace lt;
+
+// Matches the batch_transform struct of generic.vert
+struct batch_transform
+{
+    mat4 m;
+    mat4 n_m;
+};
+
+// Vertex data of the vertex groups with the same format, gathered before
+// being uploaded.
+struct arena_data
+{
+    GLenum mode;
+    std::vector<std::pair<primitive::attribute, gpu_buffer_accessor>> attribs;
+    std::vector<std::vector<uint8_t>> vertices;
+    std::vector<uint32_t> indices;
+    size_t vertex_count;
+};
+
+}
+
+namespace lt
+{
+
+geometry_batch::geometry_batch(context& ctx)
+: glresource(ctx), transform_buf(0)
+{
+}
+
+geometry_batch::~geometry_batch()
+{
+    clear();
+}
+
+void geometry_batch::build(const std::vector<object*>& objects)
+{
+    clear();
+    gl_state& state = get_context().get_state();
+    state.bind_vertex_array(0);
+
+    std::unordered_map<const gpu_buffer*, std::vector<uint8_t>> contents;
+    auto read = [&](const gpu_buffer* buf) -> const std::vector<uint8_t>& {
+        auto it = contents.find(buf);
+        if(it == contents.end())
+            it = contents.emplace(buf, buf->read<uint8_t>()).first;
+        return it->second;
+    };
+
+    std::map<std::vector<uint64_t>, unsigned> formats;
+    std::vector<arena_data> data;
+
+    for(object* obj: objects)
+    {
+        const model* mod = obj->get_model();
+        if(!mod) continue;
+
+        for(const model::vertex_group& group: *mod)
+        {
+            const primitive* mesh = group.mesh;
+            if(!mesh) continue;
+            mesh->load();
+
+            // Vertex groups can share an arena when their attributes match
+            // in everything but the buffers.
+            std::vector<uint64_t> key{mesh->mode};
+            for(const auto& pair: mesh->attribs)
+            {
+                const gpu_buffer_accessor& a = pair.second;
+                key.push_back(
+                    pair.first.index | (uint64_t)a.components << 8 |
+                    (uint64_t)a.normalized << 16 |
+                    (uint64_t)a.octahedral << 17 | (uint64_t)a.type << 32
+                );
+                key.push_back(std::hash<std::string>()(pair.first.name));
+            }
+
+            auto it = formats.emplace(key, data.size()).first;
+            if(it->second == data.size())
+            {
+                arena_data& ad = data.emplace_back();
+                ad.mode = mesh->mode;
+                ad.attribs.assign(mesh->attribs.begin(), mesh->attribs.end());
+                ad.vertices.resize(ad.attribs.size());
+                ad.vertex_count = 0;
+            }
+            arena_data& ad = data[it->second];
+
+            // Indices are widened to 32 bits, and unindexed meshes get
+            // sequential ones.
+            std::vector<uint32_t> indices(mesh->index_count);
+            if(mesh->index.is_valid())
+            {
+                const gpu_buffer_accessor& index = mesh->index;
+                const std::vector<uint8_t>& src = read(index.buf);
+                unsigned size = gl_type_sizeof(index.type);
+                if(index.offset + indices.size() * size > src.size())
+                    throw std::runtime_error(
+                        "Index accessor reaches past the end of its buffer"
+                    );
+
+                const uint8_t* p = src.data() + index.offset;
+                for(size_t i = 0; i < indices.size(); ++i, p += size)
+                {
+                    if(size == 1) indices[i] = *p;
+                    else if(size == 2)
+                    {
+                        uint16_t v;
+                        memcpy(&v, p, sizeof(v));
+                        indices[i] = v;
+                    }
+                    else memcpy(&indices[i], p, sizeof(uint32_t));
+                }
+            }
+            else
+            {
+                for(size_t i = 0; i < indices.size(); ++i) indices[i] = i;
+            }
+
+            size_t vertex_count = 0;
+            for(uint32_t i: indices)
+                vertex_count = std::max(vertex_count, (size_t)i + 1);
+
+            // Attributes are repacked tightly, which also splits interleaved
+            // buffers.
+            size_t attrib_index = 0;
+            for(const auto& pair: mesh->attribs)
+            {
+                const gpu_buffer_accessor& a = pair.second;
+                const std::vector<uint8_t>& src = read(a.buf);
+                size_t size = attribute_size(a);
+                size_t stride = a.stride == 0 ? size : a.stride;
+
+                if(vertex_count &&
+                   a.offset + (vertex_count-1) * stride + size > src.size())
+                    throw std::runtime_error(
+                        "Vertex attribute " + pair.first.name +
+                        " reaches past the end of its buffer"
+                    );
+
+                std::vector<uint8_t>& dst = ad.vertices[attrib_index++];
+                size_t dst_offset = dst.size();
+                dst.resize(dst_offset + vertex_count * size);
+                for(size_t i = 0; i < vertex_count; ++i)
+                    memcpy(
+                        dst.data() + dst_offset + i * size,
+                        src.data() + a.offset + i * stride,
+                        size
+                    );
+            }
+
+            draw d;
+            d.obj = obj;
+            d.mat = group.mat;
+            d.arena = it->second;
+            d.command = {
+                (GLuint)indices.size(),
+                1,
+                (GLuint)ad.indices.size(),
+                (GLint)ad.vertex_count,
+                0
+            };
+            d.local_bounds = mesh->get_bounding_box();
+            // Quantized positions are decoded by the draw's transform.
+            d.position_decode = mesh->get_position_decode();
+            draws.push_back(d);
+
+            ad.indices.insert(ad.indices.end(), indices.begin(), indices.end());
+            ad.vertex_count += vertex_count;
+        }
+    }
+
+    // Draws sharing an arena and material become contiguous so that they can
+    // be submitted together.
+    std::stable_sort(
+        draws.begin(), draws.end(),
+        [](const draw& a, const draw& b){
+            if(a.arena != b.arena) return a.arena < b.arena;
+            return a.mat < b.mat;
+        }
+    );
+
+    std::vector<GLuint> ids(draws.size());
+    for(size_t i = 0; i < draws.size(); ++i)
+    {
+        draw& d = draws[i];
+        d.command.base_instance = i;
+        ids[i] = i;
+
+        if(buckets.empty() ||
+           buckets.back().arena != d.arena ||
+           buckets.back().mat != d.mat)
+            buckets.push_back({d.arena, d.mat, i, 0});
+        buckets.back().draw_count++;
+    }
+
+    if(draws.empty()) return;
+
+    context& ctx = get_context();
+    draw_ids.reset(new gpu_buffer(
+        ctx, GL_ARRAY_BUFFER, ids.size() * sizeof(GLuint), ids.data()
+    ));
+
+    for(arena_data& ad: data)
+    {
+        arena& a = arenas.emplace_back();
+
+        std::map<primitive::attribute, gpu_buffer_accessor> attributes;
+        for(size_t i = 0; i < ad.attribs.size(); ++i)
+        {
+            const gpu_buffer_accessor& src = ad.attribs[i].second;
+            a.buffers.emplace_back(new gpu_buffer(
+                ctx, GL_ARRAY_BUFFER, ad.vertices[i].size(),
+                ad.vertices[i].data()
+            ));
+            attributes[ad.attribs[i].first] = gpu_buffer_accessor(
+                *a.buffers.back(), src.components, src.type, src.normalized,
+                0, 0, src.octahedral
+            );
+        }
+
+        a.buffers.emplace_back(new gpu_buffer(
+            ctx, GL_ELEMENT_ARRAY_BUFFER,
+            ad.indices.size() * sizeof(uint32_t), ad.indices.data()
+        ));
+        a.mesh.reset(new primitive(
+            ctx,
+            ad.indices.size(),
+            ad.mode,
+            gpu_buffer_accessor(*a.buffers.back(), 1, GL_UNSIGNED_INT),
+            attributes
+        ));
+
+        // The draw index advances once per instance, so with base_instance it
+        // gives the index of the draw.
+        state.bind_vertex_array(a.mesh->get_vao());
+        draw_ids->bind();
+        glVertexAttribIPointer(DRAW_ID_INDEX, 1, GL_UNSIGNED_INT, 0, nullptr);
+        glVertexAttribDivisor(DRAW_ID_INDEX, 1);
+        glEnableVertexAttribArray(DRAW_ID_INDEX);
+        state.bind_vertex_array(0);
+    }
+
+    glGenBuffers(1, &transform_buf);
+    update_transforms();
+    cull(std::vector<frustum>{frustum()});
+}
+
+unsigned geometry_batch::attribute_size(const gpu_buffer_accessor& accessor)
+{
+    switch(accessor.type)
+    {
+    case GL_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_10F_11F_11F_REV:
+        return 4;
+    default:
+        return accessor.components * gl_type_sizeof(accessor.type);
+    }
+}
+
+void geometry_batch::update_transforms()
+{
+    if(!transform_buf) return;
+
+    std::vector<batch_transform> transforms(draws.size());
+    for(size_t i = 0; i < draws.size(); ++i)
+    {
+        draw& d = draws[i];
+        mat4 m = d.obj->get_global_transform();
+        transforms[i] = {m * d.position_decode, glm::inverseTranspose(m)};
+        d.bounds = d.local_bounds.is_empty() ?
+            aabb() : d.local_bounds.transform(m);
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, transform_buf);
+    glBufferData(
+        GL_SHADER_STORAGE_BUFFER,
+        transforms.size() * sizeof(batch_transform),
+        transforms.data(),
+        GL_STATIC_DRAW
+    );
+}
+
+void geometry_batch::clear()
+{
+    draws.clear();
+    buckets.clear();
+    arenas.clear();
+    draw_ids.reset();
+    visible_commands.clear();
+
+    if(transform_buf)
+    {
+        glDeleteBuffers(1, &transform_buf);
+        transform_buf = 0;
+    }
+    for(auto& pair: views)
+        glDeleteBuffers(1, &pair.second.indirect_buf);
+    views.clear();
+}
+
+size_t geometry_batch::draw_count() const
+{
+    return draws.size();
+}
+
+void geometry_batch::cull(
+    const std::vector<frustum>& frustums,
+    const void* view
+){
+    cull_impl([&](const aabb& box){
+        for(const frustum& f: frustums)
+            if(f.intersects(box)) return true;
+        return false;
+    }, view);
+}
+
+void geometry_batch::cull(const mat4& view_projection, const void* view)
+{
+    frustum f(view_projection);
+    cull_impl([&](const aabb& box){ return f.intersects(box); }, view);
+}
+
+void geometry_batch::cull(vec3 center, float radius, const void* view)
+{
+    cull_impl([&](const aabb& box){
+        return box.intersects_sphere(center, radius);
+    }, view);
+}
+
+void geometry_batch::update_definitions(shader::definition_map& def)
+{
+    def["BATCHED"];
+    def["BATCH_DRAW_ID"] = std::to_string(DRAW_ID_INDEX);
+}
+
+void geometry_batch::draw(shader* s, const void* view) const
+{
+    const view_data* v = find_view(view);
+    if(!v) return;
+
+    bind_transforms(s);
+    for(size_t i = 0; i < arenas.size(); ++i)
+        draw_range(arenas[i], *v, v->arenas[i]);
+}
+
+template<typename F>
+void geometry_batch::cull_impl(F&& test, const void* view)
+{
+    if(draws.empty()) return;
+
+    visible_commands.clear();
+
+    auto it = views.find(view);
+    if(it == views.end())
+    {
+        it = views.emplace(view, view_data()).first;
+        glGenBuffers(1, &it->second.indirect_buf);
+    }
+    view_data& v = it->second;
+    v.buckets.assign(buckets.size(), visible_range{0, 0});
+    v.arenas.assign(arenas.size(), visible_range{0, 0});
+
+    // Buckets are sorted by arena, so the visible draws of an arena end up
+    // contiguous too.
+    for(size_t j = 0; j < buckets.size(); ++j)
+    {
+        const bucket& b = buckets[j];
+        visible_range& ar = v.arenas[b.arena];
+        if(ar.count == 0) ar.offset = visible_commands.size();
+
+        visible_range& br = v.buckets[j];
+        br.offset = visible_commands.size();
+        for(size_t i = b.first_draw; i < b.first_draw + b.draw_count; ++i)
+        {
+            const draw& d = draws[i];
+            if(d.bounds.is_empty() || test(d.bounds))
+                visible_commands.push_back(d.command);
+        }
+        br.count = visible_commands.size() - br.offset;
+        ar.count = visible_commands.size() - ar.offset;
+    }
+
+    // The buffer is always sized for every draw, so orphaning it with the
+    // same size lets the driver recycle the storage.
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, v.indirect_buf);
+    glBufferData(
+        GL_DRAW_INDIRECT_BUFFER,
+        draws.size() * sizeof(draw_command),
+        nullptr,
+        GL_STREAM_DRAW
+    );
+    if(visible_commands.empty()) return;
+    glBufferSubData(
+        GL_DRAW_INDIRECT_BUFFER,
+        0,
+        visible_commands.size() * sizeof(draw_command),
+        visible_commands.data()
+    );
+}
+
+const geometry_batch::view_data* geometry_batch::find_view(
+    const void* view
+) const
+{
+    auto it = views.find(view);
+    return it == views.end() ? nullptr : &it->second;
+}
+
+void geometry_batch::bind_transforms(shader* s) const
+{
+    glBindBufferBase(
+        GL_SHADER_STORAGE_BUFFER, TRANSFORM_BINDING, transform_buf
+    );
+    s->set_storage_block("BatchTransforms", TRANSFORM_BINDING);
+}
+
+void geometry_batch::draw_range(
+    const arena& a,
+    const view_data& v,
+    const visible_range& range
+) const
+{
+    if(range.count == 0) return;
+
+    // The arena itself has no position decoding.
+    a.mesh->set_position_decode_attributes();
+    gl_state& state = get_context().get_state();
+    state.bind_vertex_array(a.mesh->get_vao());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, v.indirect_buf);
+    glMultiDrawElementsIndirect(
+        a.mesh->get_mode(),
+        GL_UNSIGNED_INT,
+        (const GLvoid*)(range.offset * sizeof(draw_command)),
+        range.count,
+        0
+    );
+    state.bind_vertex_array(0);
+}
+
+} // namespace lt
@@ -0,0 +1,292 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "gl_state.hh"
+#include <stdexcept>
+
+namespace
+{
+
+uint64_t texture_key(GLuint unit, GLenum target)
+{
+    return (uint64_t)unit << 32 | target;
+}
+
+}
+
+namespace lt
+{
+
+gl_state::gl_state(): counts{0, 0}, frame_counts{0, 0} {}
+
+template<typename T>
+bool gl_state::update(std::optional<T>& current, const T& value)
+{
+    counts.calls++;
+    if(current == value)
+    {
+        counts.redundant++;
+        return false;
+    }
+    current = value;
+    return true;
+}
+
+void gl_state::set_capability(GLenum cap, bool enabled)
+{
+    counts.calls++;
+    auto it = capabilities.find(cap);
+    if(it != capabilities.end() && it->second == enabled)
+    {
+        counts.redundant++;
+        return;
+    }
+
+    if(enabled) glEnable(cap);
+    else glDisable(cap);
+    capabilities[cap] = enabled;
+}
+
+void gl_state::enable(GLenum cap)
+{
+    set_capability(cap, true);
+}
+
+void gl_state::disable(GLenum cap)
+{
+    set_capability(cap, false);
+}
+
+void gl_state::blend_func(GLenum sfactor, GLenum dfactor)
+{
+    if(update(blend, glm::uvec2(sfactor, dfactor)))
+        glBlendFunc(sfactor, dfactor);
+}
+
+void gl_state::depth_func(GLenum func)
+{
+    if(update(depth, func)) glDepthFunc(func);
+}
+
+void gl_state::depth_mask(bool write)
+{
+    if(update(depth_write, write)) glDepthMask(write);
+}
+
+void gl_state::color_mask(bool r, bool g, bool b, bool a)
+{
+    if(update(color_write, glm::bvec4(r, g, b, a)))
+        glColorMask(r, g, b, a);
+}
+
+void gl_state::blend_func(GLuint buf, GLenum sfactor, GLenum dfactor)
+{
+    counts.calls++;
+    glBlendFunci(buf, sfactor, dfactor);
+    blend.reset();
+}
+
+void gl_state::color_mask(GLuint buf, bool r, bool g, bool b, bool a)
+{
+    counts.calls++;
+    glColorMaski(buf, r, g, b, a);
+    color_write.reset();
+}
+
+void gl_state::stencil_func(GLenum func, GLint ref, GLuint mask)
+{
+    if(update(stencil, glm::uvec3(func, ref, mask)))
+        glStencilFunc(func, ref, mask);
+}
+
+void gl_state::stencil_op(GLenum sfail, GLenum dpfail, GLenum dppass)
+{
+    if(update(stencil_ops, glm::uvec3(sfail, dpfail, dppass)))
+        glStencilOp(sfail, dpfail, dppass);
+}
+
+void gl_state::stencil_mask(GLuint mask)
+{
+    if(update(stencil_write, mask)) glStencilMask(mask);
+}
+
+void gl_state::front_face(GLenum mode)
+{
+    if(update(winding, mode)) glFrontFace(mode);
+}
+
+void gl_state::viewport(glm::ivec2 offset, glm::uvec2 size)
+{
+    if(update(view, glm::ivec4(offset, size)))
+        glViewport(offset.x, offset.y, size.x, size.y);
+}
+
+void gl_state::use_program(GLuint program)
+{
+    if(update(this->program, program)) glUseProgram(program);
+}
+
+void gl_state::bind_vertex_array(GLuint vao)
+{
+    if(update(this->vao, vao)) glBindVertexArray(vao);
+}
+
+void gl_state::bind_framebuffer(GLenum target, GLuint fbo)
+{
+    switch(target)
+    {
+    case GL_FRAMEBUFFER:
+        counts.calls++;
+        if(read_fbo == fbo && draw_fbo == fbo)
+        {
+            counts.redundant++;
+            return;
+        }
+        glBindFramebuffer(target, fbo);
+        read_fbo = fbo;
+        draw_fbo = fbo;
+        break;
+    case GL_READ_FRAMEBUFFER:
+        if(update(read_fbo, fbo)) glBindFramebuffer(target, fbo);
+        break;
+    case GL_DRAW_FRAMEBUFFER:
+        if(update(draw_fbo, fbo)) glBindFramebuffer(target, fbo);
+        break;
+    default:
+        throw std::runtime_error("Unknown framebuffer bind target");
+    }
+}
+
+void gl_state::bind_texture(GLuint unit, GLenum target, GLuint tex)
+{
+    counts.calls++;
+    bool same_unit = active_unit == unit;
+    auto it = textures.find(texture_key(unit, target));
+    if(same_unit && it != textures.end() && it->second == tex)
+    {
+        counts.redundant++;
+        return;
+    }
+
+    if(!same_unit)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        active_unit = unit;
+    }
+
+    if(it == textures.end() || it->second != tex)
+    {
+        glBindTexture(target, tex);
+        textures[texture_key(unit, target)] = tex;
+    }
+}
+
+void gl_state::bind_sampler(GLuint unit, GLuint sampler)
+{
+    counts.calls++;
+    auto it = samplers.find(unit);
+    if(it != samplers.end() && it->second == sampler)
+    {
+        counts.redundant++;
+        return;
+    }
+
+    glBindSampler(unit, sampler);
+    samplers[unit] = sampler;
+}
+
+GLint gl_state::get_program() const
+{
+    return program ? (GLint)*program : -1;
+}
+
+GLint gl_state::get_framebuffer(GLenum target) const
+{
+    switch(target)
+    {
+    case GL_READ_FRAMEBUFFER:
+        return read_fbo ? (GLint)*read_fbo : -1;
+    case GL_DRAW_FRAMEBUFFER:
+        return draw_fbo ? (GLint)*draw_fbo : -1;
+    default:
+        throw std::runtime_error("Unknown framebuffer bind target");
+    }
+}
+
+GLint gl_state::get_texture(GLuint unit, GLenum target) const
+{
+    auto it = textures.find(texture_key(unit, target));
+    return it == textures.end() ? -1 : (GLint)it->second;
+}
+
+void gl_state::forget_texture(GLuint tex)
+{
+    for(auto& pair: textures)
+        if(pair.second == tex) pair.second = 0;
+}
+
+void gl_state::forget_sampler(GLuint sampler)
+{
+    for(auto& pair: samplers)
+        if(pair.second == sampler) pair.second = 0;
+}
+
+void gl_state::forget_vertex_array(GLuint vao)
+{
+    if(this->vao == vao) this->vao = 0;
+}
+
+void gl_state::forget_framebuffer(GLuint fbo)
+{
+    if(read_fbo == fbo) read_fbo = 0;
+    if(draw_fbo == fbo) draw_fbo = 0;
+}
+
+void gl_state::invalidate()
+{
+    capabilities.clear();
+    blend.reset();
+    depth.reset();
+    depth_write.reset();
+    color_write.reset();
+    stencil.reset();
+    stencil_ops.reset();
+    stencil_write.reset();
+    winding.reset();
+    view.reset();
+    program.reset();
+    vao.reset();
+    read_fbo.reset();
+    draw_fbo.reset();
+    active_unit.reset();
+    textures.clear();
+    samplers.clear();
+}
+
+void gl_state::next_frame()
+{
+    frame_counts = counts;
+    counts = {0, 0};
+}
+
+gl_state::stats gl_state::get_frame_stats() const
+{
+    return frame_counts;
+}
+
+} // namespace lt
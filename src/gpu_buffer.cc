@@ -96,6 +96,16 @@ void gpu_buffer::bind(unsigned index) const
     glBindBufferBase(target, index, buf);
 }
 
+size_t gpu_buffer::get_cpu_memory_usage() const
+{
+    return 0;
+}
+
+size_t gpu_buffer::get_gpu_memory_usage() const
+{
+    return buf ? size : 0;
+}
+
 class data_gpu_buffer: public gpu_buffer
 {
 public:
@@ -103,33 +113,35 @@ public:
         context& ctx,
         GLenum target,
         size_t size,
-        const void* data,
-        GLenum usage
-    ):  gpu_buffer(ctx)
+        std::shared_ptr<const void> data,
+        GLenum usage,
+        bool evictable
+    ):  gpu_buffer(ctx), data(std::move(data)), usage(usage),
+        evictable(evictable), released(false)
     {
         this->target = target;
         this->size = size;
-        if(data)
-        {
-            this->data = new uint8_t[size];
-            memcpy(this->data, data, size);
-        }
-        else
-        {
-            this->data = nullptr;
-        }
-        this->usage = usage;
     }
 
-    ~data_gpu_buffer()
+    size_t get_cpu_memory_usage() const override
     {
-        if(data) delete [] (uint8_t*)data;
+        return data ? size : 0;
     }
 
 protected:
     void load_impl() const override
     {
-        basic_load(target, size, data, usage);
+        if(released)
+            throw std::runtime_error(
+                "Buffer data was released after upload, can't reload"
+            );
+
+        basic_load(target, size, data.get(), usage);
+        if(!evictable)
+        {
+            data.reset();
+            released = true;
+        }
     }
 
     void unload_impl() const override
@@ -138,8 +150,10 @@ protected:
     }
 
 private:
-    void* data;
+    mutable std::shared_ptr<const void> data;
     GLenum usage;
+    bool evictable;
+    mutable bool released;
 };
 
 gpu_buffer* gpu_buffer::create(
@@ -149,7 +163,42 @@ gpu_buffer* gpu_buffer::create(
     const void* data,
     GLenum usage
 ){
-    return new data_gpu_buffer(ctx, target, size, data, usage);
+    std::shared_ptr<uint8_t> copy;
+    if(data)
+    {
+        copy.reset(new uint8_t[size], std::default_delete<uint8_t[]>());
+        memcpy(copy.get(), data, size);
+    }
+    return new data_gpu_buffer(ctx, target, size, copy, usage, true);
+}
+
+gpu_buffer* gpu_buffer::create(
+    context& ctx,
+    GLenum target,
+    std::vector<uint8_t>&& data,
+    GLenum usage,
+    bool evictable
+){
+    size_t size = data.size();
+    auto owner = std::make_shared<std::vector<uint8_t>>(std::move(data));
+    return new data_gpu_buffer(
+        ctx, target, size,
+        std::shared_ptr<const void>(owner, owner->data()),
+        usage, evictable
+    );
+}
+
+gpu_buffer* gpu_buffer::create(
+    context& ctx,
+    GLenum target,
+    size_t size,
+    std::shared_ptr<const void> data,
+    GLenum usage,
+    bool evictable
+){
+    return new data_gpu_buffer(
+        ctx, target, size, std::move(data), usage, evictable
+    );
 }
 
 void gpu_buffer::basic_load(
@@ -0,0 +1,361 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "headless_context.hh"
+#include "glheaders.hh"
+#include <cstring>
+#include <stdexcept>
+#ifdef LT_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#ifdef LT_HAS_OSMESA
+#include <GL/osmesa.h>
+#endif
+
+namespace
+{
+
+#ifdef LT_HAS_EGL
+bool has_extension(const char* extensions, const char* name)
+{
+    if(!extensions) return false;
+    size_t len = strlen(name);
+    for(const char* s = extensions; (s = strstr(s, name)); s += len)
+    {
+        if(
+            (s == extensions || s[-1] == ' ') &&
+            (s[len] == ' ' || s[len] == 0)
+        ) return true;
+    }
+    return false;
+}
+
+bool try_initialize(EGLDisplay display)
+{
+    return display != EGL_NO_DISPLAY &&
+        eglInitialize(display, nullptr, nullptr);
+}
+
+// Returns an initialized display. Devices are preferred over the surfaceless
+// platform, since they can be told apart by whether they are software
+// renderers.
+EGLDisplay open_egl_display(bool software)
+{
+    auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+        eglGetProcAddress("eglGetPlatformDisplayEXT");
+    auto query_devices = (PFNEGLQUERYDEVICESEXTPROC)
+        eglGetProcAddress("eglQueryDevicesEXT");
+    auto query_device_string = (PFNEGLQUERYDEVICESTRINGEXTPROC)
+        eglGetProcAddress("eglQueryDeviceStringEXT");
+
+    if(get_platform_display && query_devices && query_device_string)
+    {
+        EGLDeviceEXT devices[16];
+        EGLint count = 0;
+        if(!query_devices(16, devices, &count)) count = 0;
+
+        for(EGLint i = 0; i < count; ++i)
+        {
+            bool is_software = has_extension(
+                query_device_string(devices[i], EGL_EXTENSIONS),
+                "EGL_MESA_device_software"
+            );
+            if(is_software != software) continue;
+
+            EGLDisplay display = get_platform_display(
+                EGL_PLATFORM_DEVICE_EXT, devices[i], nullptr
+            );
+            if(try_initialize(display)) return display;
+        }
+    }
+
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    if(get_platform_display)
+    {
+        EGLDisplay display = get_platform_display(
+            EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr
+        );
+        if(try_initialize(display)) return display;
+    }
+#endif
+
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if(try_initialize(display)) return display;
+    return EGL_NO_DISPLAY;
+}
+#endif
+
+}
+
+namespace lt
+{
+
+struct headless_context::platform
+{
+#ifdef LT_HAS_EGL
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext egl_context = EGL_NO_CONTEXT;
+    // Only used if the display doesn't support surfaceless contexts.
+    EGLSurface surface = EGL_NO_SURFACE;
+#endif
+#ifdef LT_HAS_OSMESA
+    OSMesaContext osmesa_context = nullptr;
+    // OSMesa needs a default framebuffer even though nothing is drawn to it.
+    uint8_t osmesa_buffer[4];
+#endif
+
+    void release()
+    {
+#ifdef LT_HAS_EGL
+        if(display != EGL_NO_DISPLAY)
+        {
+            eglMakeCurrent(
+                display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT
+            );
+            if(surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+            if(egl_context != EGL_NO_CONTEXT)
+                eglDestroyContext(display, egl_context);
+            eglTerminate(display);
+            display = EGL_NO_DISPLAY;
+            egl_context = EGL_NO_CONTEXT;
+            surface = EGL_NO_SURFACE;
+        }
+#endif
+#ifdef LT_HAS_OSMESA
+        if(osmesa_context)
+        {
+            OSMesaDestroyContext(osmesa_context);
+            osmesa_context = nullptr;
+        }
+#endif
+    }
+};
+
+headless_context::headless_context(const params& p)
+: context(false), plat(new platform), api(p.api)
+{
+    try
+    {
+        switch(p.api)
+        {
+        case AUTO:
+            try
+            {
+                init_egl(p);
+                api = EGL;
+            }
+            catch(const std::runtime_error&)
+            {
+                plat->release();
+                init_osmesa(p);
+                api = OSMESA;
+            }
+            break;
+        case EGL:
+            init_egl(p);
+            break;
+        case OSMESA:
+            init_osmesa(p);
+            break;
+        }
+
+        // glewInit() insists on a GLX display, so only the GL part is
+        // initialized.
+        glewExperimental = GL_TRUE;
+        GLenum err = glewContextInit();
+        if(err != GLEW_OK)
+        {
+            throw std::runtime_error((const char*)glewGetErrorString(err));
+        }
+
+        context::init_post();
+
+        //Enable generic options
+        if(p.srgb) get_state().enable(GL_FRAMEBUFFER_SRGB);
+        get_state().enable(GL_MULTISAMPLE);
+        get_state().enable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+        GLint color_format = p.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        target.reset(new framebuffer(
+            *this,
+            p.size,
+            {
+                {GL_COLOR_ATTACHMENT0, {color_format}},
+                {GL_DEPTH_STENCIL_ATTACHMENT, {GL_DEPTH24_STENCIL8}}
+            },
+            p.samples
+        ));
+
+        if(p.samples != 0)
+        {
+            resolve.reset(new framebuffer(
+                *this, p.size, {{GL_COLOR_ATTACHMENT0, {color_format}}}
+            ));
+        }
+    }
+    catch(...)
+    {
+        resolve.reset();
+        target.reset();
+        plat->release();
+        throw;
+    }
+}
+
+headless_context::~headless_context()
+{
+    resolve.reset();
+    target.reset();
+    plat->release();
+}
+
+framebuffer& headless_context::get_framebuffer()
+{
+    return *target;
+}
+
+headless_context::backend headless_context::get_backend() const
+{
+    return api;
+}
+
+void headless_context::finish()
+{
+    glFinish();
+}
+
+void headless_context::read_pixels(void* dst)
+{
+    glm::uvec2 size = target->get_size();
+    framebuffer* src = target.get();
+    if(resolve)
+    {
+        target->bind(GL_READ_FRAMEBUFFER);
+        resolve->bind(GL_DRAW_FRAMEBUFFER);
+        glBlitFramebuffer(
+            0, 0, size.x, size.y, 0, 0, size.x, size.y,
+            GL_COLOR_BUFFER_BIT, GL_NEAREST
+        );
+        src = resolve.get();
+    }
+
+    src->bind(GL_READ_FRAMEBUFFER);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, dst);
+}
+
+std::vector<uint8_t> headless_context::read_pixels()
+{
+    glm::uvec2 size = target->get_size();
+    std::vector<uint8_t> pixels(size.x * size.y * 4);
+    read_pixels(pixels.data());
+    return pixels;
+}
+
+void headless_context::init_egl(const params& p)
+{
+#ifdef LT_HAS_EGL
+    plat->display = open_egl_display(p.software);
+    if(plat->display == EGL_NO_DISPLAY)
+        throw std::runtime_error("Unable to open an EGL display");
+
+    if(!eglBindAPI(EGL_OPENGL_API))
+        throw std::runtime_error("EGL doesn't support OpenGL");
+
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint config_count = 0;
+    if(
+        !eglChooseConfig(
+            plat->display, config_attribs, &config, 1, &config_count
+        ) || config_count == 0
+    ) throw std::runtime_error("No suitable EGL config");
+
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION_KHR, GL_MAJOR,
+        EGL_CONTEXT_MINOR_VERSION_KHR, GL_MINOR,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR,
+        EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+        EGL_NONE
+    };
+    plat->egl_context = eglCreateContext(
+        plat->display, config, EGL_NO_CONTEXT, context_attribs
+    );
+    if(plat->egl_context == EGL_NO_CONTEXT)
+        throw std::runtime_error("Unable to create an EGL context");
+
+    if(!has_extension(
+        eglQueryString(plat->display, EGL_EXTENSIONS),
+        "EGL_KHR_surfaceless_context"
+    )){
+        const EGLint surface_attribs[] = {
+            EGL_WIDTH, 1,
+            EGL_HEIGHT, 1,
+            EGL_NONE
+        };
+        plat->surface = eglCreatePbufferSurface(
+            plat->display, config, surface_attribs
+        );
+        if(plat->surface == EGL_NO_SURFACE)
+            throw std::runtime_error("Unable to create an EGL surface");
+    }
+
+    if(!eglMakeCurrent(
+        plat->display, plat->surface, plat->surface, plat->egl_context
+    )) throw std::runtime_error("Unable to make the EGL context current");
+#else
+    (void)p;
+    throw std::runtime_error("Littleton was built without EGL support");
+#endif
+}
+
+void headless_context::init_osmesa(const params& p)
+{
+#ifdef LT_HAS_OSMESA
+    (void)p;
+    const int attribs[] = {
+        OSMESA_FORMAT, OSMESA_RGBA,
+        OSMESA_DEPTH_BITS, 0,
+        OSMESA_STENCIL_BITS, 0,
+        OSMESA_ACCUM_BITS, 0,
+        OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+        OSMESA_CONTEXT_MAJOR_VERSION, GL_MAJOR,
+        OSMESA_CONTEXT_MINOR_VERSION, GL_MINOR,
+        0
+    };
+    plat->osmesa_context = OSMesaCreateContextAttribs(attribs, nullptr);
+    if(!plat->osmesa_context)
+        throw std::runtime_error("Unable to create an OSMesa context");
+
+    if(!OSMesaMakeCurrent(
+        plat->osmesa_context, plat->osmesa_buffer, GL_UNSIGNED_BYTE, 1, 1
+    )) throw std::runtime_error("Unable to make the OSMesa context current");
+#else
+    (void)p;
+    throw std::runtime_error("Littleton was built without OSMesa support");
+#endif
+}
+
+} // namespace lt
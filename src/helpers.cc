@@ -24,6 +24,12 @@
 #include <iomanip>
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace lt
 {
@@ -88,6 +94,58 @@ bool write_binary_file(const std::string& path, const uint8_t* data, size_t byte
     return true;
 }
 
+mapped_file::mapped_file(const std::string& path)
+: data(nullptr), size(0)
+{
+#ifdef _WIN32
+    if(!read_binary_file(path, data, size))
+        throw std::runtime_error("Unable to read " + path);
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) throw std::runtime_error("Unable to open " + path);
+
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("Unable to stat " + path);
+    }
+    size = st.st_size;
+
+    if(size != 0)
+    {
+        void* ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(ptr == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("Unable to map " + path);
+        }
+        data = (uint8_t*)ptr;
+    }
+    // The mapping stays valid after closing the descriptor.
+    close(fd);
+#endif
+}
+
+mapped_file::~mapped_file()
+{
+#ifdef _WIN32
+    delete [] data;
+#else
+    if(data) munmap(data, size);
+#endif
+}
+
+const uint8_t* mapped_file::get_data() const
+{
+    return data;
+}
+
+size_t mapped_file::get_size() const
+{
+    return size;
+}
+
 size_t count_lines(const std::string& str)
 {
     return 1 + std::count(str.begin(), str.end(), '\n');
@@ -127,6 +185,8 @@ GLint internal_format_to_external_format(GLint internal_format)
     case GL_COMPRESSED_RED:
     case GL_COMPRESSED_RED_RGTC1:
     case GL_COMPRESSED_SIGNED_RED_RGTC1:
+    case GL_COMPRESSED_R11_EAC:
+    case GL_COMPRESSED_SIGNED_R11_EAC:
         return GL_RED;
     case GL_RG:
     case GL_RG8:
@@ -138,6 +198,8 @@ GLint internal_format_to_external_format(GLint internal_format)
     case GL_COMPRESSED_RG:
     case GL_COMPRESSED_RG_RGTC2:
     case GL_COMPRESSED_SIGNED_RG_RGTC2:
+    case GL_COMPRESSED_RG11_EAC:
+    case GL_COMPRESSED_SIGNED_RG11_EAC:
         return GL_RG;
     case GL_RGB:
     case GL_SRGB:
@@ -159,6 +221,10 @@ GLint internal_format_to_external_format(GLint internal_format)
     case GL_COMPRESSED_SRGB:
     case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
     case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGB8_ETC2:
+    case GL_COMPRESSED_SRGB8_ETC2:
         return GL_RGB;
     case GL_BGR:
         return GL_BGR;
@@ -178,6 +244,16 @@ GLint internal_format_to_external_format(GLint internal_format)
     case GL_COMPRESSED_RGBA_BPTC_UNORM:
     case GL_COMPRESSED_SRGB_ALPHA:
     case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+    case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+    case GL_COMPRESSED_RGBA8_ETC2_EAC:
+    case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
         return GL_RGBA;
     case GL_BGRA:
         return GL_BGRA;
@@ -260,6 +336,8 @@ unsigned internal_format_channel_count(GLint internal_format)
     case GL_COMPRESSED_RED:
     case GL_COMPRESSED_RED_RGTC1:
     case GL_COMPRESSED_SIGNED_RED_RGTC1:
+    case GL_COMPRESSED_R11_EAC:
+    case GL_COMPRESSED_SIGNED_R11_EAC:
     case GL_RED_INTEGER:
     case GL_R8I:
     case GL_R8UI:
@@ -288,6 +366,8 @@ unsigned internal_format_channel_count(GLint internal_format)
     case GL_COMPRESSED_RG:
     case GL_COMPRESSED_RG_RGTC2:
     case GL_COMPRESSED_SIGNED_RG_RGTC2:
+    case GL_COMPRESSED_RG11_EAC:
+    case GL_COMPRESSED_SIGNED_RG11_EAC:
     case GL_RG_INTEGER:
     case GL_RG8I:
     case GL_RG8UI:
@@ -319,6 +399,10 @@ unsigned internal_format_channel_count(GLint internal_format)
     case GL_COMPRESSED_SRGB:
     case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
     case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGB8_ETC2:
+    case GL_COMPRESSED_SRGB8_ETC2:
     case GL_BGR:
     case GL_RGB_INTEGER:
     case GL_RGB8I:
@@ -346,6 +430,16 @@ unsigned internal_format_channel_count(GLint internal_format)
     case GL_COMPRESSED_RGBA_BPTC_UNORM:
     case GL_COMPRESSED_SRGB_ALPHA:
     case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+    case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+    case GL_COMPRESSED_RGBA8_ETC2_EAC:
+    case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
     case GL_BGRA:
     case GL_RGBA_INTEGER:
     case GL_RGBA8I:
@@ -434,6 +528,104 @@ bool gl_target_is_array(GLenum target)
     }
 }
 
+unsigned internal_format_block_size(GLint internal_format)
+{
+    switch(internal_format)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RED_RGTC1:
+    case GL_COMPRESSED_SIGNED_RED_RGTC1:
+    case GL_COMPRESSED_RGB8_ETC2:
+    case GL_COMPRESSED_SRGB8_ETC2:
+    case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+    case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+    case GL_COMPRESSED_R11_EAC:
+    case GL_COMPRESSED_SIGNED_R11_EAC:
+        return 8;
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_RG_RGTC2:
+    case GL_COMPRESSED_SIGNED_RG_RGTC2:
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+    case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
+    case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+    case GL_COMPRESSED_RGBA8_ETC2_EAC:
+    case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+    case GL_COMPRESSED_RG11_EAC:
+    case GL_COMPRESSED_SIGNED_RG11_EAC:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+GLint internal_format_to_srgb(GLint internal_format)
+{
+    switch(internal_format)
+    {
+    case GL_RGB8:
+        return GL_SRGB8;
+    case GL_RGBA8:
+        return GL_SRGB8_ALPHA8;
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        return GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+        return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+        return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+    case GL_COMPRESSED_RGB8_ETC2:
+        return GL_COMPRESSED_SRGB8_ETC2;
+    case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+        return GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2;
+    case GL_COMPRESSED_RGBA8_ETC2_EAC:
+        return GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC;
+    default:
+        return internal_format;
+    }
+}
+
+GLint image_internal_format(unsigned channels, bool hdr, bool srgb)
+{
+    switch(channels)
+    {
+    case 1:
+        return hdr ? GL_R16F : GL_R8;
+    case 2:
+        return hdr ? GL_RG16F : GL_RG8;
+    case 3:
+        if(srgb) return GL_SRGB8;
+        return hdr ? GL_RGB16F : GL_RGB8;
+    case 4:
+        if(srgb) return GL_SRGB8_ALPHA8;
+        return hdr ? GL_RGBA16F : GL_RGBA8;
+    default:
+        throw std::runtime_error(
+            "Unsupported channel count " + std::to_string(channels)
+        );
+    }
+}
+
+void flip_image_rows(void* data, size_t row_size, unsigned rows)
+{
+    uint8_t* bytes = (uint8_t*)data;
+    for(unsigned i = 0; i < rows / 2; ++i)
+        std::swap_ranges(
+            bytes + i * row_size,
+            bytes + (i + 1) * row_size,
+            bytes + (rows - 1 - i) * row_size
+        );
+}
+
 const char* get_freetype_error(int err)
 {
     #undef FTERRORS_H__
@@ -31,6 +31,23 @@ std::string read_text_file(const std::string& path);
 bool read_binary_file(const std::string& path, uint8_t*& data, size_t& bytes);
 bool write_binary_file(const std::string& path, const uint8_t* data, size_t bytes);
 
+// Read-only mapping of a whole file into memory. Where mapping is not
+// available, the file is read instead. Throws if the file can't be opened.
+class mapped_file
+{
+public:
+    explicit mapped_file(const std::string& path);
+    mapped_file(const mapped_file& other) = delete;
+    ~mapped_file();
+
+    const uint8_t* get_data() const;
+    size_t get_size() const;
+
+private:
+    uint8_t* data;
+    size_t size;
+};
+
 template<typename T, typename Hash = boost::hash<T>>
 std::string append_hash_to_path(
     const std::string& prefix,
@@ -48,6 +65,13 @@ unsigned internal_format_channel_count(GLint internal_format);
 unsigned gl_type_sizeof(GLenum type);
 GLenum get_binding_name(GLenum target);
 bool gl_target_is_array(GLenum target);
+// Bytes per 4x4 block of a block compressed format, 0 for other formats.
+unsigned internal_format_block_size(GLint internal_format);
+// The sRGB variant of the format, or the format itself if there is none.
+GLint internal_format_to_srgb(GLint internal_format);
+// Internal format for an image with the given number of channels, as decoded
+// by stb_image.
+GLint image_internal_format(unsigned channels, bool hdr, bool srgb);
 
 template<typename T>
 void sorted_insert(
@@ -61,6 +85,37 @@ bool sorted_erase(
     const T& value
 );
 
+// Calls f(i) for each i in [0, count) from a pool of threads, one per
+// hardware thread including the caller. The first exception thrown by f is
+// rethrown after all threads have stopped.
+template<typename F>
+void parallel_for(size_t count, F&& f);
+
+// Box filters a tightly packed image into one half its size. Odd sizes are
+// rounded down.
+template<typename T>
+void downsample_image(
+    const T* src,
+    unsigned width,
+    unsigned height,
+    unsigned channels,
+    T* dst
+);
+
+// Fills levels[1] onwards from levels[0] with downsample_image().
+template<typename T>
+void generate_mipmap_levels(
+    std::vector<std::vector<uint8_t>>& levels,
+    unsigned width,
+    unsigned height,
+    unsigned channels
+);
+
+// Reverses the order of the rows in place. Decoded images are flipped with
+// this instead of stb_image's process-wide flip flag, which isn't safe to
+// change while other threads are decoding.
+void flip_image_rows(void* data, size_t row_size, unsigned rows);
+
 const char* get_freetype_error(int err);
 
 } // namespace lt
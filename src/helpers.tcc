@@ -1,6 +1,11 @@
 #include <sstream>
 #include <boost/filesystem.hpp>
 #include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
 
 namespace lt
 {
@@ -44,4 +49,96 @@ bool sorted_erase(
     return false;
 }
 
+template<typename F>
+void parallel_for(size_t count, F&& f)
+{
+    size_t thread_count = std::min(
+        (size_t)std::max(std::thread::hardware_concurrency(), 1u),
+        count
+    );
+    if(thread_count <= 1)
+    {
+        for(size_t i = 0; i < count; ++i) f(i);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto work = [&](){
+        for(size_t i = next++; i < count; i = next++)
+        {
+            try
+            {
+                f(i);
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if(!error) error = std::current_exception();
+                next = count;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(size_t i = 1; i < thread_count; ++i) threads.emplace_back(work);
+    work();
+    for(std::thread& t: threads) t.join();
+
+    if(error) std::rethrow_exception(error);
+}
+
+template<typename T>
+void downsample_image(
+    const T* src,
+    unsigned width,
+    unsigned height,
+    unsigned channels,
+    T* dst
+){
+    unsigned dst_width = std::max(width / 2, 1u);
+    unsigned dst_height = std::max(height / 2, 1u);
+    for(unsigned y = 0; y < dst_height; ++y)
+    for(unsigned x = 0; x < dst_width; ++x)
+    {
+        unsigned x0 = std::min(2*x, width-1);
+        unsigned x1 = std::min(2*x+1, width-1);
+        unsigned y0 = std::min(2*y, height-1);
+        unsigned y1 = std::min(2*y+1, height-1);
+        for(unsigned c = 0; c < channels; ++c)
+        {
+            float sum =
+                (float)src[(y0*width+x0)*channels+c] +
+                (float)src[(y0*width+x1)*channels+c] +
+                (float)src[(y1*width+x0)*channels+c] +
+                (float)src[(y1*width+x1)*channels+c];
+            dst[(y*dst_width+x)*channels+c] = std::is_integral_v<T> ?
+                (T)(sum * 0.25f + 0.5f) : (T)(sum * 0.25f);
+        }
+    }
+}
+
+template<typename T>
+void generate_mipmap_levels(
+    std::vector<std::vector<uint8_t>>& levels,
+    unsigned width,
+    unsigned height,
+    unsigned channels
+){
+    for(unsigned level = 1; level < levels.size(); ++level)
+    {
+        unsigned src_width = std::max(width >> (level-1), 1u);
+        unsigned src_height = std::max(height >> (level-1), 1u);
+        unsigned dst_width = std::max(width >> level, 1u);
+        unsigned dst_height = std::max(height >> level, 1u);
+        levels[level].resize(dst_width * dst_height * channels * sizeof(T));
+        downsample_image(
+            (const T*)levels[level-1].data(), src_width, src_height, channels,
+            (T*)levels[level].data()
+        );
+    }
+}
+
 } // namespace lt
@@ -0,0 +1,260 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "instanced_object.hh"
+#include "geometry_batch.hh"
+#include "transformable.hh"
+#include "model.hh"
+#include "primitive.hh"
+#include "helpers.hh"
+#include "context.hh"
+#include <algorithm>
+
+namespace
+{
+using namespace lt;
+
+// Matches the batch_transform struct of generic.vert
+struct batch_transform
+{
+    mat4 m;
+    mat4 n_m;
+};
+
+}
+
+namespace lt
+{
+
+instanced_object::instanced_object(context& ctx, const model* mod)
+:   glresource(ctx), mod(mod), transforms_outdated(false), transform_buf(0),
+    visible_buf(0)
+{
+}
+
+instanced_object::~instanced_object()
+{
+    if(transform_buf) glDeleteBuffers(1, &transform_buf);
+    if(visible_buf) glDeleteBuffers(1, &visible_buf);
+}
+
+void instanced_object::set_model(const model* mod)
+{
+    this->mod = mod;
+    transforms_outdated = true;
+}
+
+const model* instanced_object::get_model() const
+{
+    return mod;
+}
+
+void instanced_object::add_instance(const transformable_node* node)
+{
+    sorted_insert(nodes, node);
+    transforms_outdated = true;
+}
+
+void instanced_object::remove_instance(const transformable_node* node)
+{
+    if(sorted_erase(nodes, node)) transforms_outdated = true;
+}
+
+void instanced_object::clear_instances()
+{
+    nodes.clear();
+    transforms_outdated = true;
+}
+
+size_t instanced_object::instance_count() const
+{
+    return nodes.size();
+}
+
+void instanced_object::set_instances(
+    const std::vector<const transformable_node*>& nodes
+){
+    this->nodes = nodes;
+    std::sort(this->nodes.begin(), this->nodes.end());
+    transforms_outdated = true;
+}
+
+const std::vector<const transformable_node*>&
+instanced_object::get_instances() const
+{
+    return nodes;
+}
+
+void instanced_object::update_transforms()
+{
+    transforms_outdated = false;
+    visible.clear();
+
+    bool bounded = mod && mod->is_bounded();
+    std::vector<batch_transform> transforms(nodes.size());
+    bounds.resize(nodes.size());
+    generations.resize(nodes.size());
+    for(size_t i = 0; i < nodes.size(); ++i)
+    {
+        mat4 m = nodes[i]->get_global_transform();
+        transforms[i] = {m, glm::inverseTranspose(m)};
+        bounds[i] = bounded ? mod->get_bounding_box().transform(m) : aabb();
+        generations[i] = nodes[i]->get_generation();
+    }
+
+    if(!transform_buf) glGenBuffers(1, &transform_buf);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, transform_buf);
+    glBufferData(
+        GL_SHADER_STORAGE_BUFFER,
+        transforms.size() * sizeof(batch_transform),
+        transforms.data(),
+        GL_DYNAMIC_DRAW
+    );
+}
+
+void instanced_object::cull(const std::vector<frustum>& frustums)
+{
+    cull_impl([&](const aabb& box){
+        for(const frustum& f: frustums)
+            if(f.intersects(box)) return true;
+        return false;
+    });
+}
+
+void instanced_object::cull(const mat4& view_projection)
+{
+    frustum f(view_projection);
+    cull_impl([&](const aabb& box){ return f.intersects(box); });
+}
+
+void instanced_object::cull(vec3 center, float radius)
+{
+    cull_impl([&](const aabb& box){
+        return box.intersects_sphere(center, radius);
+    });
+}
+
+size_t instanced_object::visible_count() const
+{
+    return visible.size();
+}
+
+void instanced_object::draw(shader* s) const
+{
+    if(!mod || visible.empty()) return;
+
+    bind_transforms(s);
+    for(const model::vertex_group& group: *mod)
+        if(group.mesh) draw_group(group.mesh);
+}
+
+template<typename F>
+void instanced_object::cull_impl(F&& test)
+{
+    if(transforms_outdated) update_transforms();
+    else refresh_transforms();
+
+    visible.clear();
+    if(!mod) return;
+
+    for(size_t i = 0; i < nodes.size(); ++i)
+        if(bounds[i].is_empty() || test(bounds[i]))
+            visible.push_back(i);
+
+    if(visible.empty()) return;
+
+    if(!visible_buf) glGenBuffers(1, &visible_buf);
+    glBindBuffer(GL_ARRAY_BUFFER, visible_buf);
+    glBufferData(
+        GL_ARRAY_BUFFER,
+        visible.size() * sizeof(uint32_t),
+        visible.data(),
+        GL_STREAM_DRAW
+    );
+}
+
+void instanced_object::refresh_transforms()
+{
+    if(!transform_buf) return;
+
+    // Consecutive changed instances are uploaded together.
+    bool bounded = mod && mod->is_bounded();
+    std::vector<batch_transform> changed;
+    size_t first = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, transform_buf);
+    for(size_t i = 0; i <= nodes.size(); ++i)
+    {
+        if(i < nodes.size())
+        {
+            uint64_t generation = nodes[i]->get_generation();
+            if(generation != generations[i])
+            {
+                mat4 m = nodes[i]->get_global_transform();
+                if(changed.empty()) first = i;
+                changed.push_back({m, glm::inverseTranspose(m)});
+                bounds[i] = bounded ?
+                    mod->get_bounding_box().transform(m) : aabb();
+                generations[i] = generation;
+                continue;
+            }
+        }
+        if(changed.empty()) continue;
+
+        glBufferSubData(
+            GL_SHADER_STORAGE_BUFFER,
+            first * sizeof(batch_transform),
+            changed.size() * sizeof(batch_transform),
+            changed.data()
+        );
+        changed.clear();
+    }
+}
+
+void instanced_object::bind_transforms(shader* s) const
+{
+    glBindBufferBase(
+        GL_SHADER_STORAGE_BUFFER,
+        geometry_batch::TRANSFORM_BINDING,
+        transform_buf
+    );
+    s->set_storage_block(
+        "BatchTransforms", geometry_batch::TRANSFORM_BINDING
+    );
+}
+
+void instanced_object::draw_group(const primitive* mesh) const
+{
+    // The mesh may be shared with regular objects, so the instance attribute
+    // is only enabled in its vertex array for the duration of the draw.
+    const unsigned index = geometry_batch::DRAW_ID_INDEX;
+    gl_state& state = get_context().get_state();
+    state.bind_vertex_array(mesh->get_vao());
+    glBindBuffer(GL_ARRAY_BUFFER, visible_buf);
+    glVertexAttribIPointer(index, 1, GL_UNSIGNED_INT, 0, nullptr);
+    glVertexAttribDivisor(index, 1);
+    glEnableVertexAttribArray(index);
+
+    mesh->draw_instanced(visible.size());
+
+    state.bind_vertex_array(mesh->get_vao());
+    glDisableVertexAttribArray(index);
+    glVertexAttribDivisor(index, 0);
+    state.bind_vertex_array(0);
+}
+
+} // namespace lt
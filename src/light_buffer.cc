@@ -0,0 +1,248 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "light_buffer.hh"
+#include "context.hh"
+#include "scene.hh"
+#include "light.hh"
+#include "shader.hh"
+#include <cstring>
+
+namespace lt
+{
+
+light_buffer::light_buffer(context& ctx, unsigned segment_count)
+:   glresource(ctx), buf(0), mapping(nullptr), capacity(0), segment_size(0),
+    segment_count(glm::max(segment_count, 1u)), segment(0), written(false),
+    point_light_count(0), spotlight_count(0), directional_light_count(0)
+{
+}
+
+light_buffer::~light_buffer()
+{
+    release();
+}
+
+void light_buffer::update(
+    light_scene* lights,
+    const mat4& view,
+    const std::vector<bool>& skip_point_lights,
+    const std::vector<bool>& skip_spotlights,
+    const std::vector<bool>& skip_directional_lights
+){
+    auto skipped = [](const std::vector<bool>& skip, size_t i){
+        return i < skip.size() && skip[i];
+    };
+
+    reserve(lights->light_count());
+
+    // The commands reading the current segment have all been issued by now,
+    // so fence it and move on to the next one.
+    if(written)
+    {
+        fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        segment = (segment + 1) % segment_count;
+    }
+
+    if(fences[segment])
+    {
+        while(
+            glClientWaitSync(
+                fences[segment], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000
+            ) == GL_TIMEOUT_EXPIRED
+        );
+        glDeleteSync(fences[segment]);
+        fences[segment] = nullptr;
+    }
+
+    uint8_t* dst = mapping ? mapping + segment * segment_size : staging.data();
+    light_data* data = reinterpret_cast<light_data*>(dst + sizeof(header));
+    size_t count = 0;
+
+    point_light_count = 0;
+    const std::vector<point_light*>& point_lights = lights->get_point_lights();
+    for(size_t i = 0; i < point_lights.size(); ++i)
+    {
+        if(skipped(skip_point_lights, i)) continue;
+        point_light* l = point_lights[i];
+
+        light_data& d = data[count++];
+        d.color = vec4(l->get_color(), 0);
+        d.position = view * vec4(l->get_global_position(), 1);
+        d.direction = vec4(0);
+        point_light_count++;
+    }
+
+    spotlight_count = 0;
+    const std::vector<spotlight*>& spotlights = lights->get_spotlights();
+    for(size_t i = 0; i < spotlights.size(); ++i)
+    {
+        if(skipped(skip_spotlights, i)) continue;
+        spotlight* l = spotlights[i];
+
+        light_data& d = data[count++];
+        d.color = vec4(l->get_color(), 0);
+        d.position = vec4(
+            vec3(view * vec4(l->get_global_position(), 1)),
+            cos(glm::radians(l->get_cutoff_angle()))
+        );
+        d.direction = vec4(
+            glm::normalize(vec3(view * vec4(l->get_global_direction(), 0))),
+            l->get_falloff_exponent()
+        );
+        spotlight_count++;
+    }
+
+    directional_light_count = 0;
+    const std::vector<directional_light*>& directional_lights =
+        lights->get_directional_lights();
+    for(size_t i = 0; i < directional_lights.size(); ++i)
+    {
+        if(skipped(skip_directional_lights, i)) continue;
+        directional_light* l = directional_lights[i];
+
+        light_data& d = data[count++];
+        d.color = vec4(l->get_color(), 0);
+        d.position = vec4(0);
+        d.direction = vec4(
+            glm::normalize(vec3(view * vec4(l->get_direction(), 0))),
+            0
+        );
+        directional_light_count++;
+    }
+
+    header h{
+        (int32_t)point_light_count,
+        (int32_t)spotlight_count,
+        (int32_t)directional_light_count,
+        0
+    };
+    memcpy(dst, &h, sizeof(h));
+
+    if(!mapping)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buf);
+        glBufferSubData(
+            GL_SHADER_STORAGE_BUFFER,
+            segment * segment_size,
+            sizeof(header) + count * sizeof(light_data),
+            dst
+        );
+    }
+
+    written = true;
+}
+
+void light_buffer::bind(unsigned bind_point) const
+{
+    glBindBufferRange(
+        GL_SHADER_STORAGE_BUFFER,
+        bind_point,
+        buf,
+        segment * segment_size,
+        segment_size
+    );
+}
+
+void light_buffer::set(
+    shader* s,
+    unsigned bind_point,
+    const std::string& block_name
+) const
+{
+    bind(bind_point);
+    s->set_storage_block(block_name, bind_point);
+}
+
+unsigned light_buffer::get_point_light_count() const
+{
+    return point_light_count;
+}
+
+unsigned light_buffer::get_spotlight_count() const
+{
+    return spotlight_count;
+}
+
+unsigned light_buffer::get_directional_light_count() const
+{
+    return directional_light_count;
+}
+
+void light_buffer::reserve(size_t light_count)
+{
+    if(buf && light_count <= capacity) return;
+
+    // Storage in use by earlier draws is kept alive by the driver, so the old
+    // buffer can be released right away.
+    release();
+
+    capacity = glm::max(next_power_of_two(light_count), 16u);
+
+    size_t alignment = get_context()[GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT];
+    segment_size = sizeof(header) + capacity * sizeof(light_data);
+    segment_size = (segment_size + alignment - 1) / alignment * alignment;
+    size_t size = segment_size * segment_count;
+
+    glGenBuffers(1, &buf);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buf);
+
+    if(GLEW_ARB_buffer_storage)
+    {
+        GLbitfield flags =
+            GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, size, nullptr, flags);
+        mapping = (uint8_t*)glMapBufferRange(
+            GL_SHADER_STORAGE_BUFFER, 0, size, flags
+        );
+    }
+    else
+    {
+        glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+        staging.resize(segment_size);
+    }
+
+    fences.assign(segment_count, nullptr);
+    segment = 0;
+    written = false;
+}
+
+void light_buffer::release()
+{
+    for(GLsync& fence: fences)
+    {
+        if(fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    if(buf)
+    {
+        if(mapping)
+        {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buf);
+            glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+            mapping = nullptr;
+        }
+        glDeleteBuffers(1, &buf);
+        buf = 0;
+    }
+    staging.clear();
+    capacity = 0;
+}
+
+} // namespace lt
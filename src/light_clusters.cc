@@ -0,0 +1,222 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "light_clusters.hh"
+#include "light_buffer.hh"
+#include "resource_pool.hh"
+#include "multishader.hh"
+#include "common_resources.hh"
+#include "sampler.hh"
+#include "gbuffer.hh"
+#include "camera.hh"
+#include "texture.hh"
+
+namespace
+{
+using namespace lt;
+
+constexpr uniform_handle<glm::uvec3> CLUSTER_GRID("cluster_grid");
+constexpr uniform_handle<glm::vec2> CLUSTER_TILE_SIZE("cluster_tile_size");
+constexpr uniform_handle<glm::vec2> CLUSTER_DEPTH("cluster_depth");
+constexpr uniform_handle<glm::vec2> PROJECTION_INFO("projection_info");
+constexpr uniform_handle<glm::vec3> CLIP_INFO("clip_info");
+constexpr uniform_handle<float> CUTOFF("cutoff");
+
+// Must match the local size in light_clusters.comp
+constexpr unsigned ASSIGN_GROUP_SIZE = 64;
+constexpr unsigned MARK_GROUP_SIZE = 8;
+
+}
+
+namespace lt
+{
+
+light_clusters::light_clusters(
+    resource_pool& pool,
+    uvec3 grid_size,
+    unsigned max_cluster_lights,
+    float max_depth
+):  glresource(pool.get_context()),
+    cluster_shader(pool.get_shader(shader::path{"light_clusters.comp"})),
+    fb_sampler(common::ensure_framebuffer_sampler(pool)),
+    grid_size(glm::max(grid_size, uvec3(1))),
+    max_cluster_lights(max_cluster_lights), max_depth(max_depth),
+    clusters_buf(0), active_buf(0), tile_size(1), depth_info(1)
+{
+}
+
+light_clusters::~light_clusters()
+{
+    release();
+}
+
+void light_clusters::build(
+    const light_buffer& lights,
+    const camera* cam,
+    uvec2 size,
+    float cutoff,
+    const gbuffer* depth
+){
+    if(!cluster_shader) return;
+
+    reserve();
+
+    float near = cam->get_near();
+    float far = glm::max(glm::min(cam->get_far(), max_depth), near * 2.0f);
+    tile_size = vec2(size) / vec2(grid_size);
+    depth_info = vec2(near, grid_size.z / log(far / near));
+
+    const texture* depth_tex = nullptr;
+    bool linear_depth = false;
+    if(depth)
+    {
+        linear_depth = depth->get_linear_depth() != nullptr;
+        depth_tex = linear_depth ?
+            depth->get_linear_depth() : depth->get_depth_stencil();
+    }
+
+    shader::definition_map def;
+    update_definitions(def);
+
+    // Flag the clusters that contain any geometry, the rest can be skipped
+    // when assigning lights.
+    if(depth_tex)
+    {
+        GLuint zero = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, active_buf);
+        glClearBufferData(
+            GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER,
+            GL_UNSIGNED_INT, &zero
+        );
+
+        shader::definition_map mark_def(def);
+        mark_def["MARK_ACTIVE"];
+        if(linear_depth) mark_def["LINEAR_DEPTH"];
+
+        shader* s = cluster_shader->get(mark_def);
+        s->bind();
+        set_grid(s);
+        s->set(CLIP_INFO, cam->get_clip_info());
+        fb_sampler.bind(*depth_tex, 0);
+        s->set<int>(linear_depth ? "in_linear_depth" : "in_depth", 0);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, active_buf);
+        s->set_storage_block("ActiveClusters", 0);
+
+        s->compute_dispatch(uvec3(
+            (size.x + MARK_GROUP_SIZE - 1) / MARK_GROUP_SIZE,
+            (size.y + MARK_GROUP_SIZE - 1) / MARK_GROUP_SIZE,
+            1
+        ));
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        def["ACTIVE_CLUSTERS"];
+    }
+
+    shader* s = cluster_shader->get(def);
+    s->bind();
+    set_grid(s);
+    s->set(PROJECTION_INFO, cam->get_projection_info());
+    s->set(CUTOFF, cutoff);
+
+    lights.set(s, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, clusters_buf);
+    s->set_storage_block("LightClusters", 1);
+    if(depth_tex)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, active_buf);
+        s->set_storage_block("ActiveClusters", 2);
+    }
+
+    unsigned cluster_count = grid_size.x * grid_size.y * grid_size.z;
+    s->compute_dispatch(uvec3(
+        (cluster_count + ASSIGN_GROUP_SIZE - 1) / ASSIGN_GROUP_SIZE, 1, 1
+    ));
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void light_clusters::set(shader* s, unsigned bind_point) const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bind_point, clusters_buf);
+    s->set_storage_block("LightClusters", bind_point);
+    set_grid(s);
+}
+
+void light_clusters::update_definitions(shader::definition_map& def) const
+{
+    def["CLUSTERED_LIGHTS"];
+    def["MAX_CLUSTER_LIGHTS"] = std::to_string(max_cluster_lights);
+}
+
+uvec3 light_clusters::get_grid_size() const
+{
+    return grid_size;
+}
+
+unsigned light_clusters::get_max_cluster_lights() const
+{
+    return max_cluster_lights;
+}
+
+void light_clusters::set_grid(shader* s) const
+{
+    s->set(CLUSTER_GRID, grid_size);
+    s->set(CLUSTER_TILE_SIZE, tile_size);
+    s->set(CLUSTER_DEPTH, depth_info);
+}
+
+void light_clusters::reserve()
+{
+    if(clusters_buf) return;
+
+    // Each cluster stores its light count followed by the light indices.
+    size_t cluster_count = grid_size.x * grid_size.y * grid_size.z;
+    glGenBuffers(1, &clusters_buf);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusters_buf);
+    glBufferData(
+        GL_SHADER_STORAGE_BUFFER,
+        cluster_count * (max_cluster_lights + 1) * sizeof(GLuint),
+        nullptr,
+        GL_DYNAMIC_COPY
+    );
+
+    glGenBuffers(1, &active_buf);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, active_buf);
+    glBufferData(
+        GL_SHADER_STORAGE_BUFFER,
+        cluster_count * sizeof(GLuint),
+        nullptr,
+        GL_DYNAMIC_COPY
+    );
+}
+
+void light_clusters::release()
+{
+    if(clusters_buf)
+    {
+        glDeleteBuffers(1, &clusters_buf);
+        clusters_buf = 0;
+    }
+    if(active_buf)
+    {
+        glDeleteBuffers(1, &active_buf);
+        active_buf = 0;
+    }
+}
+
+} // namespace lt
@@ -26,11 +26,16 @@
 #include "object.hh"
 #include "tiny_gltf.h"
 #include "mikktspace.h"
+#include "stb_image.h"
 #include "math.hh"
+#include "mesh_optimizer.hh"
+#include "vertex_packing.hh"
 #include "helpers.hh"
+#include "texture_container.hh"
 #include <stdexcept>
 #include <memory>
 #include <map>
+#include <unordered_set>
 
 namespace
 {
@@ -93,6 +98,19 @@ void load_gltf_node(
     }
 }
 
+// Textures may list a DDS image through MSFT_texture_dds, with the plain
+// source as a fallback for other viewers. The DDS image is preferred.
+int get_texture_source(const tinygltf::Texture& tex)
+{
+    auto it = tex.extensions.find("MSFT_texture_dds");
+    if(it != tex.extensions.end() && it->second.Has("source"))
+    {
+        const tinygltf::Value& source = it->second.Get("source");
+        if(source.IsInt()) return source.Get<int>();
+    }
+    return tex.source;
+}
+
 material::sampler_tex get_material_texture_parameter(
     resource_pool& pool,
     tinygltf::Model& model,
@@ -106,7 +124,7 @@ material::sampler_tex get_material_texture_parameter(
         tinygltf::Parameter& param = it->second;
         tinygltf::Texture& tex = model.textures[param.TextureIndex()];
         tinygltf::Sampler& sampler = model.samplers[tex.sampler];
-        tinygltf::Image& image = model.images[tex.source];
+        tinygltf::Image& image = model.images[get_texture_source(tex)];
         if(scale)
         {
             auto it = param.json_double_value.find("scale");
@@ -147,6 +165,31 @@ glm::vec4 get_material_factor_parameter(
     return fallback;
 }
 
+aabb get_primitive_bounding_box(
+    tinygltf::Model& model,
+    tinygltf::Primitive& p
+){
+    auto it = p.attributes.find("POSITION");
+    if(it == p.attributes.end()) return aabb();
+
+    tinygltf::Accessor& accessor = model.accessors[it->second];
+    if(accessor.minValues.size() < 3 || accessor.maxValues.size() < 3)
+        return aabb();
+
+    return aabb(
+        vec3(
+            accessor.minValues[0],
+            accessor.minValues[1],
+            accessor.minValues[2]
+        ),
+        vec3(
+            accessor.maxValues[0],
+            accessor.maxValues[1],
+            accessor.maxValues[2]
+        )
+    );
+}
+
 template<typename T>
 void ensure_gltf_uniquely_named(
     std::vector<T>& array,
@@ -171,7 +214,7 @@ void set_image_srgb_tag(
     {
         tinygltf::Parameter& param = it->second;
         tinygltf::Texture& tex = model.textures[param.TextureIndex()];
-        tinygltf::Image& image = model.images[tex.source];
+        tinygltf::Image& image = model.images[get_texture_source(tex)];
         image.extras = tinygltf::Value(tinygltf::Value::Object{
             {"useSRGB", tinygltf::Value(value)}
         });
@@ -199,46 +242,33 @@ void add_gltf_srgb_tags(tinygltf::Model& model)
     }
 }
 
-size_t read_index_from_accessor(
+const uint8_t* get_accessor_data(
     tinygltf::Model& model,
-    tinygltf::Accessor& index_accessor,
-    size_t index
+    tinygltf::Accessor& accessor,
+    size_t& stride
 ) {
-    tinygltf::BufferView& view =
-        model.bufferViews[index_accessor.bufferView];
+    tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
     tinygltf::Buffer& buf = model.buffers[view.buffer];
 
-    int stride = index_accessor.ByteStride(view);
-    int offset = view.byteOffset + index_accessor.byteOffset;
-
-    size_t out = 0;
-    memcpy(
-        &out,
-        buf.data.data() + offset + stride * index,
-        gl_type_sizeof(index_accessor.componentType)
-    );
-    return out;
+    stride = accessor.ByteStride(view);
+    return buf.data.data() + view.byteOffset + accessor.byteOffset;
 }
 
-template<typename T>
-void read_from_accessor(
-    tinygltf::Model& model,
-    tinygltf::Accessor& accessor,
-    size_t index,
-    T* out
+template<typename T, typename I>
+void deindex(
+    const uint8_t* indices,
+    size_t index_stride,
+    const uint8_t* data,
+    size_t data_stride,
+    std::vector<T>& result
 ) {
-    tinygltf::BufferView& view =
-        model.bufferViews[accessor.bufferView];
-    tinygltf::Buffer& buf = model.buffers[view.buffer];
-
-    int stride = accessor.ByteStride(view);
-    int offset = view.byteOffset + accessor.byteOffset;
-
-    memcpy(
-        out,
-        buf.data.data() + offset + stride * index,
-        sizeof(T)
-    );
+    // The copies have a fixed size, so they compile down to plain loads.
+    for(size_t i = 0; i < result.size(); ++i)
+    {
+        I index;
+        memcpy(&index, indices + index_stride * i, sizeof(I));
+        memcpy(&result[i], data + data_stride * index, sizeof(T));
+    }
 }
 
 template<typename T>
@@ -249,16 +279,25 @@ std::vector<T> deindex(
 ) {
     std::vector<T> result(index_accessor.count);
 
-    for(unsigned i = 0; i < index_accessor.count; ++i)
-    {
-        size_t index = read_index_from_accessor(model, index_accessor, i);
+    size_t index_stride = 0;
+    const uint8_t* indices = get_accessor_data(
+        model, index_accessor, index_stride
+    );
+    size_t data_stride = 0;
+    const uint8_t* data = get_accessor_data(model, data_accessor, data_stride);
 
-        read_from_accessor(
-            model,
-            data_accessor,
-            index,
-            &result[i]
-        );
+    switch(index_accessor.componentType)
+    {
+    case GL_UNSIGNED_BYTE:
+        deindex<T, uint8_t>(indices, index_stride, data, data_stride, result);
+        break;
+    case GL_UNSIGNED_SHORT:
+        deindex<T, uint16_t>(indices, index_stride, data, data_stride, result);
+        break;
+    default:
+    case GL_UNSIGNED_INT:
+        deindex<T, uint32_t>(indices, index_stride, data, data_stride, result);
+        break;
     }
 
     return result;
@@ -371,6 +410,290 @@ void generate_tangent_space(
 
     genTangSpaceDefault(&ctx);
 }
+
+// Vertex data of a primitive that is interleaved into a buffer of its own
+// instead of using the glTF buffers directly.
+struct repacked_primitive
+{
+    tinygltf::Primitive* p;
+    bool generate_tangents;
+    std::vector<vec3> position;
+    std::vector<vec3> normal;
+    std::vector<vec2> texcoord;
+    std::vector<vec4> tangent;
+    // Empty when the glTF indices are used as-is.
+    std::vector<uint32_t> indices;
+    std::unique_ptr<packed_vertices> packed;
+};
+
+bool needs_generated_tangents(
+    tinygltf::Model& model,
+    tinygltf::Primitive& p
+){
+    // Thanks for being utterly retarded bullshit glTF2!
+    if(
+        !p.attributes.count("POSITION") ||
+        !p.attributes.count("NORMAL") ||
+        !p.attributes.count("TEXCOORD_0") ||
+        p.attributes.count("TANGENT")
+    ) return false;
+
+    // Place some common requirements to avoid overly complex
+    // implementation of generate_tangent_space
+    return
+        p.mode == GL_TRIANGLES &&
+        model.accessors[p.attributes.at("POSITION")].componentType ==
+            GL_FLOAT &&
+        model.accessors[p.attributes.at("NORMAL")].componentType ==
+            GL_FLOAT &&
+        model.accessors[p.attributes.at("TEXCOORD_0")].componentType ==
+            GL_FLOAT;
+}
+
+// Only the common attributes are interleaved, anything else is left in the
+// glTF buffers.
+bool can_repack(tinygltf::Model& model, tinygltf::Primitive& p)
+{
+    const std::map<std::string, int> packable_types = {
+        {"POSITION", TINYGLTF_TYPE_VEC3},
+        {"NORMAL", TINYGLTF_TYPE_VEC3},
+        {"TANGENT", TINYGLTF_TYPE_VEC4},
+        {"TEXCOORD_0", TINYGLTF_TYPE_VEC2}
+    };
+
+    if(p.indices < 0 || !p.attributes.count("POSITION")) return false;
+
+    for(const auto& pair: p.attributes)
+    {
+        auto it = packable_types.find(pair.first);
+        tinygltf::Accessor& accessor = model.accessors[pair.second];
+        if(
+            it == packable_types.end() ||
+            accessor.type != it->second ||
+            accessor.componentType != GL_FLOAT ||
+            accessor.bufferView < 0
+        ) return false;
+    }
+    return true;
+}
+
+template<typename T>
+std::vector<T> read_accessor(
+    tinygltf::Model& model,
+    tinygltf::Primitive& p,
+    const std::string& name
+){
+    auto it = p.attributes.find(name);
+    if(it == p.attributes.end()) return {};
+
+    tinygltf::Accessor& accessor = model.accessors[it->second];
+    size_t stride = 0;
+    const uint8_t* data = get_accessor_data(model, accessor, stride);
+
+    std::vector<T> result(accessor.count);
+    for(size_t i = 0; i < result.size(); ++i)
+        memcpy(&result[i], data + stride * i, sizeof(T));
+    return result;
+}
+
+// Missing tangent data must be generated using MikkTSpace, which fucks up
+// indices, so we basically have to do everything from scratch.
+void generate_vertices(
+    tinygltf::Model& model,
+    repacked_primitive& g,
+    bool optimize_index_order
+){
+    tinygltf::Primitive& p = *g.p;
+    tinygltf::Accessor& indices_accessor = model.accessors[p.indices];
+    tinygltf::Accessor& position_accessor =
+        model.accessors[p.attributes.at("POSITION")];
+    tinygltf::Accessor& normal_accessor =
+        model.accessors[p.attributes.at("NORMAL")];
+    tinygltf::Accessor& texcoord_accessor =
+        model.accessors[p.attributes.at("TEXCOORD_0")];
+
+    g.position = deindex<vec3>(model, indices_accessor, position_accessor);
+    g.normal = deindex<vec3>(model, indices_accessor, normal_accessor);
+    g.texcoord = deindex<vec2>(model, indices_accessor, texcoord_accessor);
+    g.tangent.resize(indices_accessor.count);
+
+    generate_tangent_space(g.position, g.normal, g.texcoord, g.tangent);
+
+    // Weld the triangle soup back into an indexed mesh.
+    std::vector<uint32_t> remap;
+    g.indices = weld_vertices(
+        g.position.size(),
+        {
+            vertex_stream(g.position.data(), sizeof(vec3)),
+            vertex_stream(g.normal.data(), sizeof(vec3)),
+            vertex_stream(g.texcoord.data(), sizeof(vec2)),
+            vertex_stream(g.tangent.data(), sizeof(vec4))
+        },
+        remap
+    );
+
+    if(optimize_index_order)
+    {
+        remap_vertices(g.position, remap);
+        optimize_vertex_cache(g.indices, remap.size());
+        optimize_overdraw(g.indices, g.position.data(), remap.size());
+        std::vector<uint32_t> fetch = optimize_vertex_fetch(
+            g.indices, remap.size()
+        );
+        remap_vertices(g.position, fetch);
+        for(uint32_t& i: fetch) i = remap[i];
+        remap.swap(fetch);
+    }
+    else remap_vertices(g.position, remap);
+
+    remap_vertices(g.normal, remap);
+    remap_vertices(g.texcoord, remap);
+    remap_vertices(g.tangent, remap);
+}
+
+// Only reads the model, so this can be run on several primitives in
+// parallel.
+void repack_primitive(
+    tinygltf::Model& model,
+    repacked_primitive& r,
+    const vertex_format& format,
+    bool optimize_index_order
+){
+    if(r.generate_tangents)
+        generate_vertices(model, r, optimize_index_order);
+    else
+    {
+        r.position = read_accessor<vec3>(model, *r.p, "POSITION");
+        r.normal = read_accessor<vec3>(model, *r.p, "NORMAL");
+        r.texcoord = read_accessor<vec2>(model, *r.p, "TEXCOORD_0");
+        r.tangent = read_accessor<vec4>(model, *r.p, "TANGENT");
+    }
+
+    r.packed.reset(new packed_vertices(
+        format,
+        r.position.size(),
+        r.position.data(),
+        r.normal.empty() ? nullptr : r.normal.data(),
+        r.tangent.empty() ? nullptr : r.tangent.data(),
+        r.texcoord.empty() ? nullptr : r.texcoord.data()
+    ));
+
+    // Only the packed data is needed from here on.
+    r.position = std::vector<vec3>();
+    r.normal = std::vector<vec3>();
+    r.texcoord = std::vector<vec2>();
+    r.tangent = std::vector<vec4>();
+}
+
+gpu_buffer_accessor get_index_accessor(
+    resource_pool& pool,
+    tinygltf::Model& model,
+    tinygltf::Accessor& indices_accessor
+){
+    tinygltf::BufferView& indices_view =
+        model.bufferViews[indices_accessor.bufferView];
+    const gpu_buffer* indices_buf = pool.get_gpu_buffer(indices_view.name);
+
+    return gpu_buffer_accessor(
+        *indices_buf,
+        indices_accessor.type,
+        indices_accessor.componentType,
+        indices_accessor.normalized,
+        indices_accessor.ByteStride(indices_view),
+        indices_accessor.byteOffset
+    );
+}
+
+// Image loader for tinygltf that only keeps the encoded data, so that the
+// images can be decoded in parallel once the whole file is parsed.
+bool defer_image_decoding(
+    tinygltf::Image* image,
+    std::string*,
+    int,
+    int,
+    const unsigned char* bytes,
+    int size,
+    void*
+){
+    image->image.assign(bytes, bytes + size);
+    image->component = 0;
+    return true;
+}
+
+void decode_image(tinygltf::Image& image)
+{
+    // Images referenced by URI are loaded by the texture itself.
+    if(image.bufferView == -1)
+    {
+        image.image.clear();
+        return;
+    }
+
+    // Compressed containers are uploaded as they are, component 0 marks
+    // them.
+    if(is_texture_container(image.image.data(), image.image.size()))
+    {
+        image.component = 0;
+        return;
+    }
+
+    int w, h, comp;
+    unsigned char* data = stbi_load_from_memory(
+        image.image.data(), image.image.size(), &w, &h, &comp, 0
+    );
+    if(!data)
+        throw std::runtime_error("Unable to decode image " + image.name);
+
+    image.width = w;
+    image.height = h;
+    image.component = comp;
+    image.image.assign(data, data + (size_t)w * h * comp);
+    stbi_image_free(data);
+}
+
+material* create_material(
+    resource_pool& pool,
+    tinygltf::Model& model,
+    tinygltf::Material& mat
+){
+    material* m = new material;
+
+    m->color_factor = get_material_factor_parameter(
+        mat.values, "baseColorFactor"
+    );
+    m->color_texture = get_material_texture_parameter(
+        pool, model, mat.values, "baseColorTexture"
+    );
+
+    m->metallic_factor = get_material_factor_parameter(
+        mat.values, "metallicFactor"
+    ).x;
+
+    m->roughness_factor = get_material_factor_parameter(
+        mat.values, "roughnessFactor"
+    ).x;
+
+    m->metallic_roughness_texture = get_material_texture_parameter(
+        pool, model, mat.values, "metallicRoughnessTexture"
+    );
+
+    m->normal_texture = get_material_texture_parameter(
+        pool, model, mat.additionalValues, "normalTexture",
+        &m->normal_factor
+    );
+
+    m->ior = 1.45f;
+
+    m->emission_factor = get_material_factor_parameter(
+        mat.additionalValues, "emissiveFactor", glm::vec4(0)
+    );
+
+    m->emission_texture = get_material_texture_parameter(
+        pool, model, mat.additionalValues, "emissiveTexture"
+    );
+    return m;
+}
+
 }
 
 namespace lt
@@ -380,7 +703,10 @@ std::unordered_map<std::string, scene_graph> load_gltf(
     resource_pool& pool,
     const std::string& path,
     const std::string& data_prefix,
-    bool ignore_duplicates
+    bool ignore_duplicates,
+    bool optimize_index_order,
+    const vertex_format& format,
+    bool evictable
 ){
     std::unordered_map<std::string, scene_graph> scenes;
     context& ctx = pool.get_context();
@@ -388,12 +714,38 @@ std::unordered_map<std::string, scene_graph> load_gltf(
     std::string err;
     tinygltf::Model model;
     tinygltf::TinyGLTF loader;
+    loader.SetImageLoader(defer_image_decoding, nullptr);
 
     if(!loader.LoadBinaryFromFile(&model, &err, path))
     {
         throw std::runtime_error(err);
     }
 
+    // Decode embedded images and repack vertices in parallel, GL objects
+    // are created afterwards on this thread.
+    parallel_for(model.images.size(), [&](size_t i){
+        decode_image(model.images[i]);
+    });
+
+    std::vector<repacked_primitive> repacked;
+    for(tinygltf::Mesh& mesh: model.meshes)
+    {
+        for(tinygltf::Primitive& p: mesh.primitives)
+        {
+            bool generate_tangents = needs_generated_tangents(model, p);
+            if(!generate_tangents && !can_repack(model, p)) continue;
+
+            repacked_primitive& r = repacked.emplace_back();
+            r.p = &p;
+            r.generate_tangents = generate_tangents;
+        }
+    }
+    parallel_for(repacked.size(), [&](size_t i){
+        repack_primitive(
+            model, repacked[i], format, optimize_index_order
+        );
+    });
+
     ensure_gltf_uniquely_named(model.accessors, path+"/unnamed_accessor");
     ensure_gltf_uniquely_named(model.animations, path+"/unnamed_animation");
     ensure_gltf_uniquely_named(model.buffers, path+"/unnamed_buffer");
@@ -466,7 +818,16 @@ std::unordered_map<std::string, scene_graph> load_gltf(
             ) srgb = true;
         }
 
-        if(image.bufferView != -1)
+        if(image.bufferView != -1 && image.component == 0)
+        {// Embedded KTX or DDS
+            pool.add_texture(
+                image.name,
+                texture::create_from_container(
+                    ctx, std::move(image.image), srgb, evictable
+                )
+            );
+        }
+        else if(image.bufferView != -1)
         {// Embedded image
             GLint format;
 
@@ -491,13 +852,13 @@ std::unordered_map<std::string, scene_graph> load_gltf(
                 image.name,
                 texture::create(
                     ctx,
-                    glm::uvec2(image.width, image.height),
+                    glm::uvec3(image.width, image.height, 1),
                     format,
                     GL_UNSIGNED_BYTE,
                     0,
                     GL_TEXTURE_2D,
-                    image.image.size(),
-                    image.image.data()
+                    std::move(image.image),
+                    evictable
                 )
             );
         }
@@ -511,73 +872,112 @@ std::unordered_map<std::string, scene_graph> load_gltf(
     }
 
     // Add materials
-    for(tinygltf::Material& mat: model.materials)
-    {
+    std::vector<std::unique_ptr<material>> materials(model.materials.size());
+    parallel_for(materials.size(), [&](size_t i){
+        tinygltf::Material& mat = model.materials[i];
         if(ignore_duplicates && pool.contains_texture(mat.name))
-            continue;
-
-        material* m = new material;
+            return;
+        materials[i].reset(create_material(pool, model, mat));
+    });
 
-        m->color_factor = get_material_factor_parameter(
-            mat.values, "baseColorFactor"
-        );
-        m->color_texture = get_material_texture_parameter(
-            pool, model, mat.values, "baseColorTexture"
-        );
-
-        m->metallic_factor = get_material_factor_parameter(
-            mat.values, "metallicFactor"
-        ).x;
-
-        m->roughness_factor = get_material_factor_parameter(
-            mat.values, "roughnessFactor"
-        ).x;
+    for(size_t i = 0; i < materials.size(); ++i)
+    {
+        if(materials[i])
+            pool.add_material(model.materials[i].name, materials[i].release());
+    }
 
-        m->metallic_roughness_texture = get_material_texture_parameter(
-            pool, model, mat.values, "metallicRoughnessTexture"
-        );
+    // Vertex data of repacked primitives is not needed from the glTF
+    // buffers, unless some other primitive shares it.
+    std::unordered_set<int> repacked_views, used_views;
+    size_t repacked_index = 0;
+    for(tinygltf::Mesh& mesh: model.meshes)
+    {
+        for(tinygltf::Primitive& p: mesh.primitives)
+        {
+            bool is_repacked =
+                repacked_index < repacked.size() &&
+                repacked[repacked_index].p == &p;
+            if(is_repacked) repacked_index++;
 
-        m->normal_texture = get_material_texture_parameter(
-            pool, model, mat.additionalValues, "normalTexture",
-            &m->normal_factor
-        );
+            for(const auto& pair: p.attributes)
+            {
+                int view = model.accessors[pair.second].bufferView;
+                if(is_repacked) repacked_views.insert(view);
+                else used_views.insert(view);
+            }
+            if(p.indices >= 0)
+                used_views.insert(model.accessors[p.indices].bufferView);
+        }
+    }
 
-        m->ior = 1.45f;
+    auto needs_gpu_buffer = [&](size_t i){
+        // For some reason, the Blender glTF2 plugin exports a targetless
+        // bufferView when using .glb (not when using .gltf). As far as I
+        // know, it seems to be completely unused...
+        if(model.bufferViews[i].target == 0) return false;
+        return !repacked_views.count(i) || used_views.count(i);
+    };
 
-        m->emission_factor = get_material_factor_parameter(
-            mat.additionalValues, "emissiveFactor", glm::vec4(0)
-        );
+    // The views share their glTF buffer instead of copying it, unless most
+    // of it was repacked and would only be kept alive for nothing.
+    std::vector<size_t> used_bytes(model.buffers.size(), 0);
+    for(size_t i = 0; i < model.bufferViews.size(); ++i)
+    {
+        tinygltf::BufferView& view = model.bufferViews[i];
+        if(needs_gpu_buffer(i)) used_bytes[view.buffer] += view.byteLength;
+    }
 
-        m->emission_texture = get_material_texture_parameter(
-            pool, model, mat.additionalValues, "emissiveTexture"
+    std::vector<std::shared_ptr<std::vector<uint8_t>>> shared_buffers(
+        model.buffers.size()
+    );
+    for(size_t i = 0; i < model.buffers.size(); ++i)
+    {
+        std::vector<uint8_t>& data = model.buffers[i].data;
+        if(used_bytes[i] * 2 < data.size()) continue;
+        shared_buffers[i] = std::make_shared<std::vector<uint8_t>>(
+            std::move(data)
         );
-
-        pool.add_material(mat.name, m);
     }
 
     // Load buffers
-    for(tinygltf::BufferView& view: model.bufferViews)
+    for(size_t i = 0; i < model.bufferViews.size(); ++i)
     {
-        tinygltf::Buffer& buf = model.buffers[view.buffer];
-        if(view.target == 0)
+        if(!needs_gpu_buffer(i)) continue;
+
+        tinygltf::BufferView& view = model.bufferViews[i];
+        gpu_buffer* buf = nullptr;
+        if(shared_buffers[view.buffer])
         {
-            // For some reason, the Blender glTF2 plugin exports a targetless
-            // bufferView when using .glb (not when using .gltf). As far as I
-            // know, it seems to be completely unused...
-            continue;
-        }
-        pool.add_gpu_buffer(
-            view.name,
-            gpu_buffer::create(
+            const auto& shared = shared_buffers[view.buffer];
+            buf = gpu_buffer::create(
                 ctx,
                 view.target,
                 view.byteLength,
-                buf.data.data() + view.byteOffset
-            )
-        );
+                std::shared_ptr<const void>(
+                    shared, shared->data() + view.byteOffset
+                ),
+                GL_STATIC_DRAW,
+                evictable
+            );
+        }
+        else
+        {
+            const uint8_t* data =
+                model.buffers[view.buffer].data.data() + view.byteOffset;
+            buf = gpu_buffer::create(
+                ctx,
+                view.target,
+                std::vector<uint8_t>(data, data + view.byteLength),
+                GL_STATIC_DRAW,
+                evictable
+            );
+        }
+        pool.add_gpu_buffer(view.name, buf);
     }
+    shared_buffers.clear();
 
     // Load models
+    repacked_index = 0;
     for(tinygltf::Mesh& mesh: model.meshes)
     {
         lt::model* m = new lt::model();
@@ -590,109 +990,77 @@ std::unordered_map<std::string, scene_graph> load_gltf(
 
             std::map<primitive::attribute, gpu_buffer_accessor> attribs;
 
-            bool use_easy_way = true;
-            // Thanks for being utterly retarded bullshit glTF2!
+            repacked_primitive* r = nullptr;
             if(
-                p.attributes.count("POSITION") &&
-                p.attributes.count("NORMAL") &&
-                p.attributes.count("TEXCOORD_0") &&
-                !p.attributes.count("TANGENT")
-            ) {
-                // Missing tangent data, which must be generated using
-                // MikkTSpace, which fucks up indices, so we basically have to
-                // do everything from scratch.
-
-                tinygltf::Accessor& position_accessor =
-                    model.accessors[p.attributes["POSITION"]];
-                tinygltf::Accessor& normal_accessor =
-                    model.accessors[p.attributes["NORMAL"]];
-                tinygltf::Accessor& texcoord_accessor =
-                    model.accessors[p.attributes["TEXCOORD_0"]];
-
-                // Place some common requirements to avoid overly complex
-                // implementation of generate_tangent_space
-                if(
-                    p.mode == GL_TRIANGLES &&
-                    position_accessor.componentType == GL_FLOAT &&
-                    normal_accessor.componentType == GL_FLOAT &&
-                    texcoord_accessor.componentType == GL_FLOAT
-                ) {
-                    // Do it the hard way, just because glTF2 decided fuck up
-                    // our day again and sometimes not include tangent data.
-                    use_easy_way = false;
-
-                    std::vector<vec3> position(deindex<vec3>(
-                        model, indices_accessor, position_accessor
-                    ));
-
-                    std::vector<vec3> normal(deindex<vec3>(
-                        model, indices_accessor, normal_accessor
-                    ));
-
-                    std::vector<vec2> texcoord(deindex<vec2>(
-                        model, indices_accessor, texcoord_accessor
-                    ));
-
-                    std::vector<vec4> tangent(indices_accessor.count);
-
-                    generate_tangent_space(
-                        position,
-                        normal,
-                        texcoord,
-                        tangent
-                    );
-
-                    std::string prefix =
-                        mesh.name + "[" + std::to_string(primitive_index) + "]";
-
-                    const gpu_buffer* pos_buf = pool.add_gpu_buffer(
-                        prefix + "[POSITION]",
-                        gpu_buffer::create(
-                            ctx, GL_ARRAY_BUFFER,
-                            position.size() * sizeof(position[0]),
-                            position.data()
-                        )
-                    );
+                repacked_index < repacked.size() &&
+                repacked[repacked_index].p == &p
+            ) r = &repacked[repacked_index++];
 
-                    const gpu_buffer* normal_buf = pool.add_gpu_buffer(
-                        prefix + "[NORMAL]",
-                        gpu_buffer::create(
-                            ctx, GL_ARRAY_BUFFER,
-                            normal.size() * sizeof(normal[0]),
-                            normal.data()
-                        )
-                    );
+            bool use_easy_way = !r;
+            if(r)
+            {
+                std::string prefix =
+                    mesh.name + "[" + std::to_string(primitive_index) + "]";
+
+                size_t vertex_count =
+                    r->packed->get_data().size() / r->packed->get_stride();
+                const gpu_buffer* vertex_buf = pool.add_gpu_buffer(
+                    prefix + "[VERTICES]",
+                    gpu_buffer::create(
+                        ctx, GL_ARRAY_BUFFER, r->packed->take_data(),
+                        GL_STATIC_DRAW, evictable
+                    )
+                );
+                attribs = r->packed->get_attributes(*vertex_buf);
 
-                    const gpu_buffer* tangent_buf = pool.add_gpu_buffer(
-                        prefix + "[TANGENT]",
-                        gpu_buffer::create(
-                            ctx, GL_ARRAY_BUFFER,
-                            tangent.size() * sizeof(tangent[0]),
-                            tangent.data()
-                        )
+                if(r->indices.empty())
+                {
+                    indices_gpu_accessor = get_index_accessor(
+                        pool, model, indices_accessor
                     );
-
-                    const gpu_buffer* uv_buf = pool.add_gpu_buffer(
-                        prefix + "[TEXCOORD_0]",
+                }
+                else
+                {
+                    // Use 16-bit indices when possible, there are rarely more
+                    // vertices than that per primitive.
+                    GLenum index_type = GL_UNSIGNED_INT;
+                    std::vector<uint8_t> index_data;
+                    if(vertex_count <= 0x10000)
+                    {
+                        index_type = GL_UNSIGNED_SHORT;
+                        index_data.resize(
+                            r->indices.size() * sizeof(uint16_t)
+                        );
+                        for(size_t i = 0; i < r->indices.size(); ++i)
+                        {
+                            uint16_t index = r->indices[i];
+                            memcpy(
+                                index_data.data() + i * sizeof(uint16_t),
+                                &index, sizeof(uint16_t)
+                            );
+                        }
+                    }
+                    else
+                    {
+                        index_data.resize(
+                            r->indices.size() * sizeof(uint32_t)
+                        );
+                        memcpy(
+                            index_data.data(), r->indices.data(),
+                            index_data.size()
+                        );
+                    }
+                    r->indices = std::vector<uint32_t>();
+
+                    const gpu_buffer* index_buf = pool.add_gpu_buffer(
+                        prefix + "[INDICES]",
                         gpu_buffer::create(
-                            ctx, GL_ARRAY_BUFFER,
-                            texcoord.size() * sizeof(texcoord[0]),
-                            texcoord.data()
+                            ctx, GL_ELEMENT_ARRAY_BUFFER,
+                            std::move(index_data), GL_STATIC_DRAW, evictable
                         )
                     );
-
-                    // We're unindexed now.
-                    attribs[primitive::POSITION] = gpu_buffer_accessor(
-                        *pos_buf, 3, GL_FLOAT, false, 0, 0
-                    );
-                    attribs[primitive::NORMAL] = gpu_buffer_accessor(
-                        *normal_buf, 3, GL_FLOAT, true, 0, 0
-                    );
-                    attribs[primitive::TANGENT] = gpu_buffer_accessor(
-                        *tangent_buf, 4, GL_FLOAT, true, 0, 0
-                    );
-                    attribs[primitive::UV0] = gpu_buffer_accessor(
-                        *uv_buf, 2, GL_FLOAT, false, 0, 0
+                    indices_gpu_accessor = gpu_buffer_accessor(
+                        *index_buf, 1, index_type, false, 0, 0
                     );
                 }
             }
@@ -739,20 +1107,8 @@ std::unordered_map<std::string, scene_graph> load_gltf(
                     );
                 }
 
-                tinygltf::Accessor& indices_accessor = model.accessors[p.indices];
-
-                tinygltf::BufferView& indices_view =
-                    model.bufferViews[indices_accessor.bufferView];
-                const gpu_buffer* indices_buf =
-                    pool.get_gpu_buffer(indices_view.name);
-
-                indices_gpu_accessor = gpu_buffer_accessor(
-                    *indices_buf,
-                    indices_accessor.type,
-                    indices_accessor.componentType,
-                    indices_accessor.normalized,
-                    indices_accessor.ByteStride(indices_view),
-                    indices_accessor.byteOffset
+                indices_gpu_accessor = get_index_accessor(
+                    pool, model, indices_accessor
                 );
             }
             primitive* prim = pool.add_primitive(
@@ -765,6 +1121,8 @@ std::unordered_map<std::string, scene_graph> load_gltf(
                     attribs
                 )
             );
+            prim->set_bounding_box(get_primitive_bounding_box(model, p));
+            if(r) r->packed->apply(*prim);
 
             m->add_vertex_group(
                 p.material < 0 ?
@@ -24,6 +24,25 @@ namespace
 {
 using namespace lt;
 
+constexpr uniform_handle<vec4> COLOR_FACTOR("input_material.color_factor");
+constexpr uniform_handle<int> COLOR("input_material.color");
+constexpr uniform_handle<float> METALLIC_FACTOR(
+    "input_material.metallic_factor"
+);
+constexpr uniform_handle<float> ROUGHNESS_FACTOR(
+    "input_material.roughness_factor"
+);
+constexpr uniform_handle<int> METALLIC_ROUGHNESS(
+    "input_material.metallic_roughness"
+);
+constexpr uniform_handle<float> NORMAL_FACTOR("input_material.normal_factor");
+constexpr uniform_handle<int> NORMAL("input_material.normal");
+constexpr uniform_handle<float> F0("input_material.f0");
+constexpr uniform_handle<vec3> EMISSION_FACTOR(
+    "input_material.emission_factor"
+);
+constexpr uniform_handle<int> EMISSION("input_material.emission");
+
 void update_def(
     shader::definition_map& def,
     const material::sampler_tex& v,
@@ -63,35 +82,43 @@ void material::update_definitions(shader::definition_map& def) const
     update_def(def, emission_texture, "MATERIAL_EMISSION_TEXTURE");
 }
 
+uint32_t material::get_feature_key() const
+{
+    return (color_texture.first ? 1 : 0) |
+        (metallic_roughness_texture.first ? 2 : 0) |
+        (normal_texture.first ? 4 : 0) |
+        (emission_texture.first ? 8 : 0);
+}
+
 void material::apply(shader* s, unsigned& texture_index) const
 {
-    s->set("input_material.color_factor", color_factor);
+    s->set(COLOR_FACTOR, color_factor);
     if(color_texture.first) s->set(
-        "input_material.color",
+        COLOR,
         color_texture.first->bind(*color_texture.second, texture_index++)
     );
 
-    s->set("input_material.metallic_factor", metallic_factor);
-    s->set("input_material.roughness_factor", roughness_factor);
+    s->set(METALLIC_FACTOR, metallic_factor);
+    s->set(ROUGHNESS_FACTOR, roughness_factor);
     if(metallic_roughness_texture.first) s->set(
-        "input_material.metallic_roughness",
+        METALLIC_ROUGHNESS,
         metallic_roughness_texture.first->bind(
             *metallic_roughness_texture.second,
             texture_index++
         )
     );
 
-    s->set("input_material.normal_factor", normal_factor);
+    s->set(NORMAL_FACTOR, normal_factor);
     if(normal_texture.first) s->set(
-        "input_material.normal",
+        NORMAL,
         normal_texture.first->bind(*normal_texture.second, texture_index++)
     );
 
-    s->set<float>("input_material.f0", 2 * pow((ior-1)/(ior+1), 2));
+    s->set(F0, 2 * pow((ior-1)/(ior+1), 2));
 
-    s->set("input_material.emission_factor", emission_factor);
+    s->set(EMISSION_FACTOR, emission_factor);
     if(emission_texture.first) s->set(
-        "input_material.emission",
+        EMISSION,
         emission_texture.first->bind(*emission_texture.second, texture_index++)
     );
 }
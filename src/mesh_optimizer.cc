@@ -0,0 +1,404 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "mesh_optimizer.hh"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+using namespace lt;
+
+const uint32_t INVALID_INDEX = 0xFFFFFFFFu;
+
+// Parameters of Forsyth's vertex scoring function
+const unsigned CACHE_SIZE = 32;
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+// Size of the FIFO cache used for estimating cache efficiency, roughly that
+// of actual hardware.
+const unsigned FIFO_SIZE = 16;
+
+const uint8_t* get_vertex(const vertex_stream& s, size_t i)
+{
+    return (const uint8_t*)s.data + (s.stride ? s.stride : s.size) * i;
+}
+
+uint64_t hash_vertex(const std::vector<vertex_stream>& streams, size_t i)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for(const vertex_stream& s: streams)
+    {
+        const uint8_t* v = get_vertex(s, i);
+        for(size_t j = 0; j < s.size; ++j)
+        {
+            hash ^= v[j];
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+bool vertex_equal(
+    const std::vector<vertex_stream>& streams,
+    size_t a,
+    size_t b
+){
+    for(const vertex_stream& s: streams)
+    {
+        if(memcmp(get_vertex(s, a), get_vertex(s, b), s.size))
+            return false;
+    }
+    return true;
+}
+
+float vertex_score(int cache_position, unsigned remaining_triangles)
+{
+    if(remaining_triangles == 0) return -1.0f;
+
+    float score = 0.0f;
+    if(cache_position >= 3)
+    {
+        score = powf(
+            1.0f - (cache_position - 3) / float(CACHE_SIZE - 3),
+            CACHE_DECAY_POWER
+        );
+    }
+    else if(cache_position >= 0) score = LAST_TRIANGLE_SCORE;
+
+    return score + VALENCE_BOOST_SCALE *
+        powf(float(remaining_triangles), -VALENCE_BOOST_POWER);
+}
+
+// Simulates a FIFO vertex cache, vertices are cached when the difference of
+// time and their timestamp is at most FIFO_SIZE.
+class fifo_cache
+{
+public:
+    fifo_cache(size_t vertex_count)
+    : timestamps(vertex_count, 0), time(FIFO_SIZE + 1) {}
+
+    void reset() { time += FIFO_SIZE + 1; }
+
+    unsigned misses(const uint32_t* triangle)
+    {
+        unsigned count = 0;
+        for(unsigned i = 0; i < 3; ++i)
+        {
+            uint32_t& stamp = timestamps[triangle[i]];
+            if(time - stamp > FIFO_SIZE)
+            {
+                stamp = time++;
+                count++;
+            }
+        }
+        return count;
+    }
+
+private:
+    std::vector<uint32_t> timestamps;
+    uint32_t time;
+};
+
+}
+
+namespace lt
+{
+
+vertex_stream::vertex_stream(const void* data, size_t size, size_t stride)
+: data(data), size(size), stride(stride)
+{
+}
+
+std::vector<uint32_t> weld_vertices(
+    size_t vertex_count,
+    const std::vector<vertex_stream>& streams,
+    std::vector<uint32_t>& remap
+){
+    std::vector<uint32_t> indices(vertex_count);
+    remap.clear();
+
+    // Open addressing hash table of unique vertices
+    size_t table_size = 1;
+    while(table_size < vertex_count * 2) table_size <<= 1;
+    std::vector<uint32_t> table(table_size, INVALID_INDEX);
+
+    for(size_t i = 0; i < vertex_count; ++i)
+    {
+        size_t slot = hash_vertex(streams, i) & (table_size - 1);
+        while(
+            table[slot] != INVALID_INDEX &&
+            !vertex_equal(streams, remap[table[slot]], i)
+        ) slot = (slot + 1) & (table_size - 1);
+
+        if(table[slot] == INVALID_INDEX)
+        {
+            table[slot] = remap.size();
+            remap.push_back(i);
+        }
+        indices[i] = table[slot];
+    }
+    return indices;
+}
+
+void optimize_vertex_cache(
+    std::vector<uint32_t>& indices,
+    size_t vertex_count
+){
+    size_t triangle_count = indices.size() / 3;
+    if(triangle_count == 0) return;
+
+    // Remaining triangles of each vertex, stored in adjacency starting from
+    // offsets[v].
+    std::vector<uint32_t> remaining(vertex_count, 0);
+    for(uint32_t v: indices) remaining[v]++;
+
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for(size_t v = 0; v < vertex_count; ++v)
+        offsets[v+1] = offsets[v] + remaining[v];
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for(size_t i = 0; i < indices.size(); ++i)
+        adjacency[fill[indices[i]]++] = i / 3;
+
+    std::vector<int> cache_position(vertex_count, -1);
+    std::vector<float> score(vertex_count);
+    for(size_t v = 0; v < vertex_count; ++v)
+        score[v] = vertex_score(-1, remaining[v]);
+
+    std::vector<float> triangle_score(triangle_count);
+    for(size_t t = 0; t < triangle_count; ++t)
+    {
+        const uint32_t* tri = &indices[t*3];
+        triangle_score[t] = score[tri[0]] + score[tri[1]] + score[tri[2]];
+    }
+
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    std::vector<uint32_t> cache, new_cache;
+    cache.reserve(CACHE_SIZE + 3);
+    new_cache.reserve(CACHE_SIZE + 3);
+
+    size_t best = std::max_element(
+        triangle_score.begin(), triangle_score.end()
+    ) - triangle_score.begin();
+    size_t scan = 0;
+
+    while(result.size() < triangle_count * 3)
+    {
+        if(best == INVALID_INDEX)
+        {
+            // Nothing in the cache is usable anymore, so just continue from
+            // the next remaining triangle.
+            while(emitted[scan]) ++scan;
+            best = scan;
+        }
+
+        emitted[best] = true;
+        new_cache.clear();
+        for(unsigned i = 0; i < 3; ++i)
+        {
+            uint32_t v = indices[best*3+i];
+            result.push_back(v);
+
+            uint32_t* begin = &adjacency[offsets[v]];
+            uint32_t* end = begin + remaining[v];
+            *std::find(begin, end, best) = end[-1];
+            remaining[v]--;
+
+            if(std::find(new_cache.begin(), new_cache.end(), v) ==
+                new_cache.end()) new_cache.push_back(v);
+        }
+
+        for(uint32_t v: cache)
+        {
+            if(std::find(new_cache.begin(), new_cache.end(), v) ==
+                new_cache.end()) new_cache.push_back(v);
+        }
+
+        // Update scores of all vertices whose cache position changed,
+        // including those that were pushed out of the cache.
+        for(size_t i = 0; i < new_cache.size(); ++i)
+        {
+            uint32_t v = new_cache[i];
+            cache_position[v] = i < CACHE_SIZE ? int(i) : -1;
+            score[v] = vertex_score(cache_position[v], remaining[v]);
+        }
+
+        best = INVALID_INDEX;
+        float best_score = 0.0f;
+        for(uint32_t v: new_cache)
+        {
+            for(uint32_t j = 0; j < remaining[v]; ++j)
+            {
+                uint32_t t = adjacency[offsets[v] + j];
+                const uint32_t* tri = &indices[t*3];
+                float s = score[tri[0]] + score[tri[1]] + score[tri[2]];
+                triangle_score[t] = s;
+                if(s > best_score)
+                {
+                    best = t;
+                    best_score = s;
+                }
+            }
+        }
+
+        if(new_cache.size() > CACHE_SIZE) new_cache.resize(CACHE_SIZE);
+        cache.swap(new_cache);
+    }
+
+    indices.swap(result);
+}
+
+void optimize_overdraw(
+    std::vector<uint32_t>& indices,
+    const vec3* positions,
+    size_t vertex_count,
+    float threshold
+){
+    size_t triangle_count = indices.size() / 3;
+    if(triangle_count == 0) return;
+
+    // Hard boundaries are triangles that miss the cache entirely, so
+    // reordering there doesn't affect cache efficiency. The first triangle
+    // always starts a cluster, even if it's degenerate and misses less.
+    std::vector<size_t> hard_boundaries;
+    std::vector<unsigned> misses(triangle_count);
+    fifo_cache cache(vertex_count);
+    for(size_t t = 0; t < triangle_count; ++t)
+    {
+        misses[t] = cache.misses(&indices[t*3]);
+        if(misses[t] == 3 || t == 0) hard_boundaries.push_back(t);
+    }
+    hard_boundaries.push_back(triangle_count);
+
+    // Split further where the cluster would be nearly as cache efficient on
+    // its own as the whole hard cluster is.
+    std::vector<size_t> boundaries;
+    for(size_t h = 0; h + 1 < hard_boundaries.size(); ++h)
+    {
+        size_t begin = hard_boundaries[h];
+        size_t end = hard_boundaries[h+1];
+
+        unsigned hard_misses = 0;
+        for(size_t t = begin; t < end; ++t) hard_misses += misses[t];
+        float limit = hard_misses / float(end - begin) * threshold;
+
+        boundaries.push_back(begin);
+        cache.reset();
+        unsigned cluster_misses = 0;
+        for(size_t t = begin; t < end; ++t)
+        {
+            cluster_misses += cache.misses(&indices[t*3]);
+            size_t cluster_size = t + 1 - boundaries.back();
+            if(t + 1 < end && cluster_misses <= limit * cluster_size)
+            {
+                boundaries.push_back(t + 1);
+                cache.reset();
+                cluster_misses = 0;
+            }
+        }
+    }
+    boundaries.push_back(triangle_count);
+
+    // Area-weighted centroids and normals of each cluster
+    size_t cluster_count = boundaries.size() - 1;
+    std::vector<vec3> centroids(cluster_count, vec3(0));
+    std::vector<vec3> normals(cluster_count, vec3(0));
+    vec3 mesh_centroid(0);
+    float mesh_area = 0.0f;
+
+    for(size_t c = 0; c < cluster_count; ++c)
+    {
+        float area = 0.0f;
+        for(size_t t = boundaries[c]; t < boundaries[c+1]; ++t)
+        {
+            vec3 p0 = positions[indices[t*3]];
+            vec3 p1 = positions[indices[t*3+1]];
+            vec3 p2 = positions[indices[t*3+2]];
+            vec3 n = cross(p1 - p0, p2 - p0);
+            float a = length(n);
+
+            centroids[c] += (p0 + p1 + p2) * (a / 3.0f);
+            normals[c] += n;
+            area += a;
+        }
+        mesh_centroid += centroids[c];
+        mesh_area += area;
+        if(area > 0.0f) centroids[c] /= area;
+    }
+    if(mesh_area > 0.0f) mesh_centroid /= mesh_area;
+
+    std::vector<float> keys(cluster_count, 0.0f);
+    for(size_t c = 0; c < cluster_count; ++c)
+    {
+        float len = length(normals[c]);
+        if(len > 0.0f)
+            keys[c] = dot(centroids[c] - mesh_centroid, normals[c] / len);
+    }
+
+    std::vector<size_t> order(cluster_count);
+    for(size_t c = 0; c < cluster_count; ++c) order[c] = c;
+    std::stable_sort(
+        order.begin(),
+        order.end(),
+        [&](size_t a, size_t b){ return keys[a] > keys[b]; }
+    );
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for(size_t c: order)
+    {
+        result.insert(
+            result.end(),
+            indices.begin() + boundaries[c] * 3,
+            indices.begin() + boundaries[c+1] * 3
+        );
+    }
+    assert(result.size() == indices.size());
+    indices.swap(result);
+}
+
+std::vector<uint32_t> optimize_vertex_fetch(
+    std::vector<uint32_t>& indices,
+    size_t vertex_count
+){
+    std::vector<uint32_t> new_index(vertex_count, INVALID_INDEX);
+    std::vector<uint32_t> remap;
+
+    for(uint32_t& i: indices)
+    {
+        if(new_index[i] == INVALID_INDEX)
+        {
+            new_index[i] = remap.size();
+            remap.push_back(i);
+        }
+        i = new_index[i];
+    }
+    return remap;
+}
+
+} // namespace lt
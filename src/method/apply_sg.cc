@@ -50,9 +50,15 @@ apply_sg::apply_sg(
 {
 }
 
+void apply_sg::set_gbuffer(gbuffer& buf)
+{
+    this->buf = &buf;
+}
+
 void apply_sg::execute()
 {
     target_method::execute();
+    gl_state& state = get_context().get_state();
     const auto [min_specular_roughness] = opt;
 
     if(!sg_shader || !has_all_scenes())
@@ -61,13 +67,13 @@ void apply_sg::execute()
     camera* cam = get_scene<camera_scene>()->get_camera();
     if(!cam) return;
 
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_ONE, GL_ONE);
+    state.disable(GL_DEPTH_TEST);
+    state.enable(GL_CULL_FACE);
+    state.enable(GL_BLEND);
+    state.blend_func(GL_ONE, GL_ONE);
 
     // Draw back faces only of the bounding cube
-    glFrontFace(GL_CW);
+    state.front_face(GL_CW);
 
     if(&get_target() == buf && buf->get_indirect_lighting() != nullptr)
         buf->set_draw(gbuffer::DRAW_INDIRECT_LIGHTING);
@@ -117,7 +123,7 @@ void apply_sg::execute()
         s->set("inv_mv", glm::inverse(mv));
         s->set("mvp", vp * m);
 
-        stencil_cull();
+        stencil_cull(state);
         unsigned i = 0;
         while(i < lobes.size())
         {
@@ -156,7 +162,7 @@ void apply_sg::execute()
             i += available_texture_slots;
             // If last iteration, draw to stencil
             if(i >= lobes.size())
-                stencil_draw_cull();
+                stencil_draw_cull(state);
 
             cube.draw();
         }
@@ -164,7 +170,7 @@ void apply_sg::execute()
 
     if(&get_target() == buf) buf->set_draw(gbuffer::DRAW_LIGHTING);
 
-    glFrontFace(GL_CCW);
+    state.front_face(GL_CCW);
 }
 
 } // namespace lt::method
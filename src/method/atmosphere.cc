@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "atmosphere.hh"
+#include "context.hh"
 #include "texture.hh"
 #include "math.hh"
 #include "camera.hh"
@@ -251,15 +252,16 @@ render_atmosphere::render_atmosphere(
 void render_atmosphere::execute()
 {
     target_method::execute();
+    gl_state& state = get_target().get_context().get_state();
     const auto [view_samples, light_samples] = opt;
 
     if(!atmosphere_shader || !depth_buffer || !has_all_scenes()) return;
 
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-    glDisable(GL_STENCIL_TEST);
+    state.disable(GL_DEPTH_TEST);
+    state.enable(GL_CULL_FACE);
+    state.enable(GL_BLEND);
+    state.blend_func(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    state.disable(GL_STENCIL_TEST);
 
     camera* cam = get_scene<camera_scene>()->get_camera();
     if(!cam) return;
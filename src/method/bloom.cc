@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "bloom.hh"
+#include "context.hh"
 #include "resource_pool.hh"
 #include "shader.hh"
 #include "multishader.hh"
@@ -52,16 +53,22 @@ bloom::bloom(
     options_will_update(opt);
 }
 
+void bloom::set_src(texture* src)
+{
+    this->src = src;
+}
+
 void bloom::execute()
 {
+    gl_state& state = get_target().get_context().get_state();
     const auto [threshold, radius, strength, level] = opt;
     if(radius <= 0.0f || strength <= 0.0f || !src)
         return;
 
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_CULL_FACE);
-    glDisable(GL_BLEND);
-    glDisable(GL_STENCIL_TEST);
+    state.disable(GL_DEPTH_TEST);
+    state.disable(GL_CULL_FACE);
+    state.disable(GL_BLEND);
+    state.disable(GL_STENCIL_TEST);
 
     auto tmp1_fb = pool.loan_framebuffer(
         get_target().get_size() >> level,
@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "clear.hh"
+#include "context.hh"
 #include "glheaders.hh"
 
 namespace lt::method
@@ -32,9 +33,10 @@ clear::~clear(){}
 void clear::execute()
 {
     target_method::execute();
+    gl_state& state = get_target().get_context().get_state();
     const auto [color, depth, stencil] = opt;
 
-    glStencilMask(0xFF);
+    state.stencil_mask(0xFF);
     glClearColor(color.r, color.g, color.b, color.a);
     glClearDepth(depth);
     glClearStencil(stencil);
@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "draw_texture.hh"
+#include "context.hh"
 #include "render_target.hh"
 #include "texture.hh"
 #include "resource_pool.hh"
@@ -66,12 +67,13 @@ void draw_texture::set_texture(texture* tex)
 void draw_texture::execute()
 {
     target_method::execute();
+    gl_state& state = get_target().get_context().get_state();
 
     if(!draw_shader || !tex) return;
 
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_BLEND);
-    glDisable(GL_STENCIL_TEST);
+    state.disable(GL_DEPTH_TEST);
+    state.disable(GL_BLEND);
+    state.disable(GL_STENCIL_TEST);
     draw_shader->bind();
 
     draw_shader->set("mvp", transform);
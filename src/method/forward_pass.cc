@@ -30,12 +30,28 @@
 #include "gbuffer.hh"
 #include "shadow_method.hh"
 #include "common_resources.hh"
+#include "culling.hh"
+#include "draw_queue.hh"
+#include "light_buffer.hh"
+#include "light_clusters.hh"
+#include "geometry_batch.hh"
+#include "instanced_object.hh"
+#include "profiler.hh"
 
 namespace
 {
 using namespace lt;
 using namespace lt::method;
 
+constexpr uniform_handle<glm::mat4> MVP("mvp");
+constexpr uniform_handle<glm::mat4> M("m");
+constexpr uniform_handle<glm::mat3> N_M("n_m");
+constexpr uniform_handle<glm::mat4> INV_VIEW("inv_view");
+constexpr uniform_handle<glm::vec3> CAMERA_POS("camera_pos");
+constexpr uniform_handle<glm::mat4> FACE_VPS("face_vps");
+constexpr uniform_handle<int> BEGIN_LAYER_FACE("begin_layer_face");
+constexpr uniform_handle<glm::vec3> AMBIENT("ambient");
+
 void set_light(
     shader* s,
     point_light* light,
@@ -125,6 +141,7 @@ void render_pass(
     multishader* forward_shader,
     bool world_space,
     camera_scene* cameras,
+    const visible_set& visible,
     object_scene* objects,
     const shader::definition_map& common,
     bool potentially_transparent_only,
@@ -161,57 +178,88 @@ void render_pass(
     glm::mat4 v = glm::inverse(inv_view);
     glm::mat4 p = cam->get_projection();
 
-    // Loop objects in scene
-    for(object* obj: objects->get_objects())
-    {
-        const model* mod = obj->get_model();
-        if(!mod) continue;
+    draw_queue queue;
+    queue.build(
+        visible,
+        cam->get_global_position(),
+        forward_shader,
+        common,
+        potentially_transparent_only
+    );
 
-        glm::mat4 m = obj->get_global_transform();
+    queue.execute([&](
+        const draw_queue::command& c,
+        unsigned& texture_index,
+        bool shader_changed
+    ){
+        shader* s = c.s;
+        const glm::mat4& m = c.e->transform;
         glm::mat4 mv = v * m;
-        glm::mat3 n_m(glm::inverseTranspose(world_space ? m : mv));
-        glm::mat4 mvp = p * mv;
 
-        // Loop vertex groups in the object's model
-        for(const model::vertex_group& group: *mod)
-        {
-            if(!group.mat || !group.mesh) continue;
-            // Skip certainly opaque objects if only transparent stuff should be
-            // rendered.
-            if(!group.mat->potentially_transparent() &&
-               potentially_transparent_only) continue;
-
-            shader::definition_map def(common);
-            group.mat->update_definitions(def);
-            group.mesh->update_definitions(def);
+        vertex_group_callback(s, texture_index, m, v, shader_changed);
 
-            shader* s = forward_shader->get(def);
-            s->bind();
+        if(shader_changed)
+        {
+            s->set(INV_VIEW, inv_view);
+            s->set(CAMERA_POS, camera_pos.size(), camera_pos.data());
+        }
 
-            unsigned texture_index = 0;
-            group.mat->apply(s, texture_index);
+        if(cubemap_target)
+        {
+            s->set(MVP, m);
+        }
+        else s->set(MVP, p * mv);
 
-            vertex_group_callback(s, texture_index, m, v);
+        s->set(M, world_space ? m : mv);
+        s->set(N_M, glm::mat3(glm::inverseTranspose(world_space ? m : mv)));
 
-            if(cubemap_target)
-            {
-                s->set("mvp", m);
-            }
-            else s->set("mvp", mvp);
+        for(unsigned i = 0; i < layers; ++i)
+        {
+            s->set(FACE_VPS, 6, face_layer_vps.data() + i*6);
+            s->set(BEGIN_LAYER_FACE, (int)i*6);
+            c.mesh->draw();
+        }
+    });
+
+    // Batches and instances carry their own model transforms, so the
+    // matrices only contain the view.
+    glm::mat4 m(1.0f);
+    glm::mat4 mv = world_space ? m : v;
+    // Batch culls are kept per render target, see cull_objects().
+    auto render_batch = [&](const auto* batch, const auto*... view){
+        for(unsigned i = 0; i < layers; ++i)
+        {
+            batch->execute(
+                forward_shader, common, potentially_transparent_only,
+                [&](shader* s, unsigned& texture_index, bool shader_changed){
+                    vertex_group_callback(
+                        s, texture_index, m, v, shader_changed
+                    );
+
+                    if(shader_changed)
+                    {
+                        s->set(INV_VIEW, inv_view);
+                        s->set(
+                            CAMERA_POS, camera_pos.size(), camera_pos.data()
+                        );
+                        s->set(MVP, cubemap_target ? m : p * mv);
+                        s->set(M, mv);
+                        s->set(N_M, glm::mat3(glm::inverseTranspose(mv)));
+                    }
+
+                    s->set(FACE_VPS, 6, face_layer_vps.data() + i*6);
+                    s->set(BEGIN_LAYER_FACE, (int)i*6);
+                },
+                view...
+            );
+        }
+    };
 
-            s->set("m", world_space ? m : mv);
-            s->set("n_m", n_m);
-            s->set("inv_view", inv_view);
-            s->set("camera_pos", camera_pos.size(), camera_pos.data());
+    for(geometry_batch* batch: objects->get_batches())
+        render_batch(batch, &target);
 
-            for(unsigned i = 0; i < layers; ++i)
-            {
-                s->set("face_vps", 6, face_layer_vps.data() + i*6);
-                s->set("begin_layer_face", (int)i*6);
-                group.mesh->draw();
-            }
-        }
-    }
+    for(instanced_object* obj: objects->get_instanced_objects())
+        render_batch(obj);
 }
 
 template<typename L, typename S>
@@ -220,6 +268,7 @@ void render_shadowed_light(
     shadow_method* met,
     const shader::definition_map& scene_definitions,
     camera_scene* cameras,
+    const visible_set& visible,
     object_scene* objects,
     multishader* forward_shader,
     bool world_space,
@@ -228,16 +277,18 @@ void render_shadowed_light(
     bool potentially_transparent_only
 ){
     render_pass(
-        target, forward_shader, world_space, cameras, objects,
+        target, forward_shader, world_space, cameras, visible, objects,
         scene_definitions, potentially_transparent_only,
         [&](
             shader* s,
             unsigned& texture_index,
             const glm::mat4& m,
-            const glm::mat4& v
+            const glm::mat4& v,
+            bool shader_changed
         ){
             set_shadow(met, s, texture_index, sm, m);
-            set_light(s, light, world_space ? glm::mat4(1) : v);
+            if(shader_changed)
+                set_light(s, light, world_space ? glm::mat4(1) : v);
         }
     );
 }
@@ -250,6 +301,7 @@ void render_shadowed_lights(
     std::vector<bool>& handled_spotlights,
     std::vector<bool>& handled_directional_lights,
     camera_scene* cameras,
+    const visible_set& visible,
     object_scene* objects,
     light_scene* lights,
     shadow_scene* shadows,
@@ -292,7 +344,7 @@ void render_shadowed_lights(
             handled_directional_lights[it - directional_lights.begin()] = true;
 
             render_shadowed_light(
-                target, met, scene_definitions, cameras, objects,
+                target, met, scene_definitions, cameras, visible, objects,
                 forward_shader, world_space, light, sm,
                 potentially_transparent_only
             );
@@ -344,7 +396,7 @@ void render_shadowed_lights(
                 handled_point_lights[point_it - point_lights.begin()] = true;
 
                 render_shadowed_light(
-                    target, met, point_definitions, cameras, objects,
+                    target, met, point_definitions, cameras, visible, objects,
                     forward_shader, world_space, point, sm,
                     potentially_transparent_only
                 );
@@ -354,7 +406,7 @@ void render_shadowed_lights(
                 handled_spotlights[spot_it - spotlights.begin()] = true;
 
                 render_shadowed_light(
-                    target, met, spot_definitions, cameras, objects,
+                    target, met, spot_definitions, cameras, visible, objects,
                     forward_shader, world_space, spot, sm,
                     potentially_transparent_only
                 );
@@ -396,7 +448,7 @@ void render_shadowed_lights(
                 handled_point_lights[point_it - point_lights.begin()] = true;
 
                 render_shadowed_light(
-                    target, met, point_definitions, cameras, objects,
+                    target, met, point_definitions, cameras, visible, objects,
                     forward_shader, world_space, point, sm,
                     potentially_transparent_only
                 );
@@ -406,7 +458,7 @@ void render_shadowed_lights(
                 handled_spotlights[spot_it - spotlights.begin()] = true;
 
                 render_shadowed_light(
-                    target, met, spot_definitions, cameras, objects,
+                    target, met, spot_definitions, cameras, visible, objects,
                     forward_shader, world_space, spot, sm,
                     potentially_transparent_only
                 );
@@ -415,116 +467,6 @@ void render_shadowed_lights(
     }
 }
 
-std::unique_ptr<uniform_block> create_light_block(
-    const std::string& block_name,
-    light_scene* lights,
-    shader* compatible_shader,
-    const std::vector<bool>& handled_point_lights,
-    const std::vector<bool>& handled_spotlights,
-    const std::vector<bool>& handled_directional_lights,
-    const glm::mat4& view
-){
-    unsigned point_light_count = 0;
-    unsigned spotlight_count = 0;
-    unsigned directional_light_count = 0;
-
-    std::unique_ptr<uniform_block> light_block(
-        new uniform_block(compatible_shader->get_block_type(block_name))
-    );
-
-    const std::vector<point_light*>& point_lights = lights->get_point_lights();
-    for(unsigned i = 0; i < point_lights.size(); ++i)
-    {
-        if(handled_point_lights[i]) continue;
-        point_light* l = point_lights[i];
-
-        std::string prefix = "point["+std::to_string(point_light_count)+"].";
-        point_light_count++;
-
-        light_block->set(prefix + "color", l->get_color());
-        light_block->set(
-            prefix + "position",
-            glm::vec3(view * glm::vec4(l->get_global_position(), 1))
-        );
-    }
-
-    const std::vector<spotlight*>& spotlights = lights->get_spotlights();
-    for(unsigned i = 0; i < spotlights.size(); ++i)
-    {
-        if(handled_spotlights[i]) continue;
-        spotlight* l = spotlights[i];
-
-        std::string prefix = "spot["+std::to_string(spotlight_count)+"].";
-        spotlight_count++;
-
-        light_block->set(prefix + "color", l->get_color());
-        light_block->set(
-            prefix + "position",
-            glm::vec3(view * glm::vec4(l->get_global_position(), 1))
-        );
-        light_block->set(
-            prefix + "direction",
-            glm::normalize(glm::vec3(
-                view * glm::vec4(l->get_global_direction(), 0)
-            ))
-        );
-        light_block->set<float>(
-            prefix + "cutoff",
-            cos(glm::radians(l->get_cutoff_angle()))
-        );
-        light_block->set(
-            prefix + "exponent",
-            l->get_falloff_exponent()
-        );
-    }
-
-    const std::vector<directional_light*>& directional_lights =
-        lights->get_directional_lights();
-
-    for(unsigned i = 0; i < directional_lights.size(); ++i)
-    {
-        if(handled_directional_lights[i]) continue;
-        directional_light* l = directional_lights[i];
-
-        std::string prefix =
-            "directional["+std::to_string(directional_light_count)+"].";
-        directional_light_count++;
-
-        light_block->set(
-            prefix + "color",
-            l->get_color()
-        );
-        light_block->set(
-            prefix + "direction",
-            glm::normalize(glm::vec3(
-                view * glm::vec4(l->get_direction(), 0)
-            ))
-        );
-    }
-
-    light_block->set<int>("point_light_count", point_light_count);
-    light_block->set<int>("directional_light_count", directional_light_count);
-    light_block->set<int>("spotlight_count", spotlight_count);
-
-    light_block->upload();
-
-    return light_block;
-}
-
-
-void update_scene_definitions(
-    shader::definition_map& def,
-    light_scene* lights
-){
-    def["MULTIPLE_LIGHTS"];
-    def["MAX_POINT_LIGHT_COUNT"] = std::to_string(
-        next_power_of_two(lights->point_light_count()));
-    def["MAX_DIRECTIONAL_LIGHT_COUNT"] = std::to_string(
-        next_power_of_two(lights->directional_light_count()));
-    def["MAX_SPOTLIGHT_COUNT"] = std::to_string(
-        next_power_of_two(lights->spotlight_count()));
-}
-
 void render_unshadowed_lights(
     render_target& target,
     multishader* forward_shader,
@@ -533,21 +475,49 @@ void render_unshadowed_lights(
     const std::vector<bool>& handled_spotlights,
     const std::vector<bool>& handled_directional_lights,
     camera_scene* cameras,
+    const visible_set& visible,
     object_scene* objects,
     light_scene* lights,
+    light_buffer& light_buf,
+    light_clusters* clusters,
+    float cutoff,
+    gbuffer* gbuf,
     const shader::definition_map& common,
     bool potentially_transparent_only
 ){
     shader::definition_map scene_definitions(common);
-    update_scene_definitions(scene_definitions, lights);
+    scene_definitions["MULTIPLE_LIGHTS"];
 
-    std::unique_ptr<uniform_block> light_block;
+    light_buf.update(
+        lights,
+        world_space ?
+            glm::mat4(1) :
+            glm::inverse(cameras->get_camera()->get_global_transform()),
+        handled_point_lights,
+        handled_spotlights,
+        handled_directional_lights
+    );
+
+    if(clusters)
+    {
+        // Transparent surfaces can be in front of the depth buffer, so only
+        // the opaque pass can skip empty clusters.
+        clusters->build(
+            light_buf,
+            cameras->get_camera(),
+            target.get_size(),
+            cutoff,
+            potentially_transparent_only ? nullptr : gbuf
+        );
+        clusters->update_definitions(scene_definitions);
+    }
 
     render_pass(
         target,
         forward_shader,
         world_space,
         cameras,
+        visible,
         objects,
         scene_definitions,
         potentially_transparent_only,
@@ -555,26 +525,14 @@ void render_unshadowed_lights(
             shader* s,
             unsigned& texture_index,
             const glm::mat4& m,
-            const glm::mat4& v
+            const glm::mat4& v,
+            bool shader_changed
         ){
-            // Generate the light block when the first shader containing it
-            // exists (the structure of the light block can't be known
-            // beforehand)
-            if(!light_block && s->block_exists("Lights"))
-            {
-                light_block = create_light_block(
-                    "Lights",
-                    lights,
-                    s,
-                    handled_point_lights,
-                    handled_spotlights,
-                    handled_directional_lights,
-                    world_space ? glm::mat4(1) : v
-                );
-                light_block->bind(0);
-            }
-            if(light_block) s->set_uniform_block("Lights", 0);
-            s->set("ambient", lights->get_ambient());
+            if(!shader_changed) return;
+
+            light_buf.set(s, 0);
+            if(clusters) clusters->set(s, 1);
+            s->set(AMBIENT, lights->get_ambient());
         }
     );
 }
@@ -584,28 +542,75 @@ void depth_pass(
     multishader* depth_shader,
     bool world_space,
     camera_scene* cameras,
+    const visible_set& visible,
     object_scene* objects,
     light_scene* lights,
     const shader::definition_map& common,
     bool potentially_transparent_only
 ){
     render_pass(
-        target, depth_shader, world_space, cameras, objects, common,
+        target, depth_shader, world_space, cameras, visible, objects, common,
         potentially_transparent_only,
         [&](
             shader* s,
             unsigned& texture_index,
             const glm::mat4& m,
-            const glm::mat4& v
+            const glm::mat4& v,
+            bool shader_changed
         ){
-            s->set("ambient", lights->get_ambient());
+            if(shader_changed) s->set(AMBIENT, lights->get_ambient());
         }
     );
 }
 
+void cull_objects(
+    visible_set& visible,
+    render_target& target,
+    camera_scene* cameras,
+    object_scene* objects
+){
+    bool cubemap_target =
+        target.get_target() == GL_TEXTURE_CUBE_MAP ||
+        target.get_target() == GL_TEXTURE_CUBE_MAP_ARRAY;
+
+    if(!cubemap_target)
+    {
+        camera* cam = cameras->get_camera();
+        glm::mat4 vp =
+            cam->get_projection() * glm::inverse(cam->get_global_transform());
+        visible.update(objects, vp);
+        for(geometry_batch* batch: objects->get_batches())
+            batch->cull(vp, &target);
+        for(instanced_object* obj: objects->get_instanced_objects())
+            obj->cull(vp);
+        return;
+    }
+
+    // Cubemap targets are drawn from all faces of all layers at once, so an
+    // object needs to be visible from any one of them.
+    unsigned layers = min(
+        (unsigned)cameras->camera_count(), target.get_dimensions().z
+    );
+    const std::vector<camera*>& all_cameras = cameras->get_cameras();
+    std::vector<frustum> frustums;
+    frustums.reserve(layers * 6);
+    for(unsigned layer = 0; layer < layers; ++layer)
+        for(unsigned face = 0; face < 6; ++face)
+            frustums.emplace_back(
+                all_cameras[layer]->get_view_projection(face)
+            );
+
+    visible.update(objects, frustums);
+    for(geometry_batch* batch: objects->get_batches())
+        batch->cull(frustums, &target);
+    for(instanced_object* obj: objects->get_instanced_objects())
+        obj->cull(frustums);
+}
+
 void render_forward_pass(
     render_target& target,
     camera_scene* cameras,
+    const visible_set& visible,
     object_scene* objects,
     light_scene* lights,
     shadow_scene* shadows,
@@ -615,13 +620,17 @@ void render_forward_pass(
     bool transmittance,
     stencil_handler& stencil,
     gbuffer* gbuf,
-    multishader* forward_shader
+    multishader* forward_shader,
+    light_buffer& light_buf,
+    light_clusters* clusters,
+    float cutoff
 ){
     camera* cam = cameras->get_camera();
     if(!cam) return;
 
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
+    gl_state& state = target.get_context().get_state();
+    state.enable(GL_DEPTH_TEST);
+    state.enable(GL_CULL_FACE);
 
     std::vector<bool> handled_point_lights(lights->point_light_count(), false);
     std::vector<bool> handled_spotlights(lights->spotlight_count(), false);
@@ -643,8 +652,8 @@ void render_forward_pass(
     );
     common_def["LAYERS"] = std::to_string(layers);
 
-    glDisable(GL_BLEND);
-    glDepthFunc(GL_LEQUAL);
+    state.disable(GL_BLEND);
+    state.depth_func(GL_LEQUAL);
 
     if(gbuf)
     {
@@ -658,39 +667,40 @@ void render_forward_pass(
 
         if(!opaque)
         {
-            glColorMaski(
+            state.color_mask(
                 gbuf->get_lighting_index(),
-                GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE
+                false, false, false, false
             );
         }
 
-        stencil.stencil_draw();
+        stencil.stencil_draw(state);
         // Geometry pass
         depth_pass(
             target,
             forward_shader,
             world_space,
             cameras,
+            visible,
             objects,
             lights,
             geometry_def,
             !opaque
         );
-        stencil.stencil_disable();
+        stencil.stencil_disable(state);
 
         if(!opaque)
         {
-            glColorMaski(
+            state.color_mask(
                 gbuf->get_lighting_index(),
-                GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE
+                true, true, true, true
             );
         }
 
         gbuf->set_draw(gbuffer::DRAW_LIGHTING);
         if(!opaque && transmittance)
         {
-            glEnable(GL_BLEND);
-            glBlendFunci(
+            state.enable(GL_BLEND);
+            state.blend_func(
                 gbuf->get_lighting_index(),
                 GL_ZERO,
                 GL_ONE_MINUS_SRC_ALPHA
@@ -703,6 +713,7 @@ void render_forward_pass(
                 forward_shader,
                 world_space,
                 cameras,
+                visible,
                 objects,
                 lights,
                 geometry_def,
@@ -715,32 +726,34 @@ void render_forward_pass(
         shader::definition_map depth_def(common_def);
         depth_def["APPLY_EMISSION"];
 
-        if(!opaque) glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        if(!opaque) state.color_mask(false, false, false, false);
 
-        stencil.stencil_draw();
+        stencil.stencil_draw(state);
         depth_pass(
             target,
             forward_shader,
             world_space,
             cameras,
+            visible,
             objects,
             lights,
             depth_def,
             !opaque
         );
-        stencil.stencil_disable();
+        stencil.stencil_disable(state);
 
-        if(!opaque) glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        if(!opaque) state.color_mask(true, true, true, true);
 
         if(!opaque && transmittance)
         {
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+            state.enable(GL_BLEND);
+            state.blend_func(GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
             depth_pass(
                 target,
                 forward_shader, 
                 world_space,
                 cameras,
+                visible,
                 objects,
                 lights,
                 depth_def,
@@ -749,8 +762,8 @@ void render_forward_pass(
         }
     }
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+    state.enable(GL_BLEND);
+    state.blend_func(GL_SRC_ALPHA, GL_ONE);
 
     render_shadowed_lights(
         target,
@@ -760,6 +773,7 @@ void render_forward_pass(
         handled_spotlights,
         handled_directional_lights,
         cameras,
+        visible,
         objects,
         lights,
         shadows,
@@ -775,8 +789,13 @@ void render_forward_pass(
         handled_spotlights,
         handled_directional_lights,
         cameras,
+        visible,
         objects,
         lights,
+        light_buf,
+        clusters,
+        cutoff,
+        gbuf,
         common_def,
         !opaque
     );
@@ -800,7 +819,10 @@ forward_pass::forward_pass(
     cubemap_forward_shader(pool.get_shader(
         shader::path{"generic.vert", "forward.frag", "cubemap.geom"})
     ),
-    gbuf(nullptr)
+    gbuf(nullptr),
+    // Two updates per frame, one for opaque and one for transparent objects.
+    light_buf(pool.get_context(), 6),
+    clusters(pool)
 {}
 
 forward_pass::forward_pass(
@@ -818,21 +840,45 @@ forward_pass::~forward_pass() {}
 void forward_pass::execute()
 {
     target_method::execute();
-    const auto [apply_ambient, apply_transmittance, opaque, transparent] = opt;
+    const auto [
+        apply_ambient,
+        apply_transmittance,
+        opaque,
+        transparent,
+        clustered,
+        cutoff
+    ] = opt;
 
     if(!forward_shader || !has_all_scenes())
         return;
 
+    if(!get_scene<camera_scene>()->get_camera()) return;
+
     bool cubemap =
         get_target().get_target() == GL_TEXTURE_CUBE_MAP ||
         get_target().get_target() == GL_TEXTURE_CUBE_MAP_ARRAY;
 
+    object_scene* objects = get_scene<object_scene>();
+
+    visible_set visible;
+    {
+        profiler::scope timing("culling");
+        cull_objects(
+            visible, get_target(), get_scene<camera_scene>(), objects
+        );
+    }
+
+    // Clusters are built in view space, which cubemap targets don't use.
+    light_clusters* used_clusters = clustered && !cubemap ? &clusters : nullptr;
+
     if(opaque)
     {
+        profiler::scope timing("opaque");
         render_forward_pass(
             get_target(),
             get_scene<camera_scene>(),
-            get_scene<object_scene>(),
+            visible,
+            objects,
             get_scene<light_scene>(),
             get_scene<shadow_scene>(),
             cubemap,
@@ -841,16 +887,21 @@ void forward_pass::execute()
             apply_transmittance,
             *this,
             gbuf,
-            cubemap ? cubemap_forward_shader : forward_shader
+            cubemap ? cubemap_forward_shader : forward_shader,
+            light_buf,
+            used_clusters,
+            cutoff
         );
     }
 
     if(transparent)
     {
+        profiler::scope timing("transparent");
         render_forward_pass(
             get_target(),
             get_scene<camera_scene>(),
-            get_scene<object_scene>(),
+            visible,
+            objects,
             get_scene<light_scene>(),
             get_scene<shadow_scene>(),
             cubemap,
@@ -859,7 +910,10 @@ void forward_pass::execute()
             apply_transmittance,
             *this,
             gbuf,
-            cubemap ? cubemap_forward_shader : forward_shader
+            cubemap ? cubemap_forward_shader : forward_shader,
+            light_buf,
+            used_clusters,
+            cutoff
         );
     }
 }
@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "fullscreen_effect.hh"
+#include "context.hh"
 #include "helpers.hh"
 #include "render_target.hh"
 #include "shader.hh"
@@ -39,12 +40,13 @@ fullscreen_effect::~fullscreen_effect() { }
 void fullscreen_effect::execute()
 {
     target_method::execute();
+    gl_state& state = get_target().get_context().get_state();
 
     if(!effect) return;
 
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_BLEND);
-    glDisable(GL_STENCIL_TEST);
+    state.disable(GL_DEPTH_TEST);
+    state.disable(GL_BLEND);
+    state.disable(GL_STENCIL_TEST);
     effect->bind();
 
     quad.draw();
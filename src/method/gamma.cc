@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "gamma.hh"
+#include "context.hh"
 #include "render_target.hh"
 #include "texture.hh"
 #include "sampler.hh"
@@ -43,13 +44,14 @@ gamma::gamma(
 void gamma::execute()
 {
     target_method::execute();
+    gl_state& state = get_target().get_context().get_state();
 
     if(!gamma_shader || !src) return;
 
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
-    glDisable(GL_BLEND);
-    glDisable(GL_STENCIL_TEST);
+    state.disable(GL_DEPTH_TEST);
+    state.enable(GL_CULL_FACE);
+    state.disable(GL_BLEND);
+    state.disable(GL_STENCIL_TEST);
 
     gamma_shader->bind();
     gamma_shader->set("gamma", 1.0f/opt.gamma);
@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "generate_depth_mipmap.hh"
+#include "context.hh"
 #include "primitive.hh"
 #include "common_resources.hh"
 #include "resource_pool.hh"
@@ -56,13 +57,14 @@ generate_depth_mipmap::generate_depth_mipmap(gbuffer& buf, resource_pool& pool)
 void generate_depth_mipmap::execute()
 {
     target_method::execute();
+    gl_state& state = get_target().get_context().get_state();
 
     texture* linear_depth = buf->get_linear_depth();
     if(!min_max_shader || !linear_depth) return;
 
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_STENCIL_TEST);
-    glDisable(GL_BLEND);
+    state.disable(GL_DEPTH_TEST);
+    state.disable(GL_STENCIL_TEST);
+    state.disable(GL_BLEND);
 
     glm::uvec2 size = buf->get_size();
     unsigned mipmap_count = calculate_mipmap_count(size);
@@ -90,13 +92,13 @@ void generate_depth_mipmap::execute()
         min_max_shader->set<bool>("handle_both_edges", (size.x&1)&&(size.y&1));
 
         size = glm::max(size/2u, glm::uvec2(1));
-        glViewport(0,0,size.x,size.y);
+        state.viewport(glm::ivec2(0), size);
         quad.draw();
     }
 
     // Restore original state
     size = buf->get_size();
-    glViewport(0,0,size.x,size.y);
+    state.viewport(glm::ivec2(0), size);
 
     glFramebufferTexture2D(
         GL_FRAMEBUFFER,
@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "geometry_pass.hh"
+#include "context.hh"
 #include "camera.hh"
 #include "model.hh"
 #include "object.hh"
@@ -29,51 +30,71 @@
 #include "shader_pool.hh"
 #include "scene.hh"
 #include "math.hh"
+#include "culling.hh"
+#include "draw_queue.hh"
+#include "geometry_batch.hh"
+#include "instanced_object.hh"
 #include <utility>
 
 namespace
 {
     using namespace lt;
+
+    constexpr uniform_handle<glm::mat4> MVP("mvp");
+    constexpr uniform_handle<glm::mat4> M("m");
+    constexpr uniform_handle<glm::mat3> N_M("n_m");
+    constexpr uniform_handle<glm::vec3> AMBIENT("ambient");
+
+    // 'view' keys the geometry batch culls.
     void depth_pass(
+        const void* view,
         const shader::definition_map& common,
         multishader* geometry_shader,
         camera* cam,
-        object_scene* s,
+        const visible_set& visible,
+        object_scene* objects,
         vec3 ambient = vec3(0)
     ){
         glm::mat4 v = glm::inverse(cam->get_global_transform());
         glm::mat4 p = cam->get_projection();
 
-        for(object* obj: s->get_objects())
-        {
-            const model* mod = obj->get_model();
-            if(!mod) continue;
-
-            glm::mat4 mv = v * obj->get_global_transform();
-            glm::mat3 n_m(glm::inverseTranspose(mv));
-            glm::mat4 mvp = p * mv;
-
-            for(const model::vertex_group& group: *mod)
-            {
-                if(!group.mat || !group.mesh) continue;
-
-                shader::definition_map definitions(common);
-                group.mat->update_definitions(definitions);
-                group.mesh->update_definitions(definitions);
-
-                shader* s = geometry_shader->get(definitions);
-                s->bind();
+        draw_queue queue;
+        queue.build(
+            visible, cam->get_global_position(), geometry_shader, common
+        );
 
-                s->set("mvp", mvp);
-                s->set("m", mv);
-                s->set("n_m", n_m);
-                s->set("ambient", ambient);
+        queue.execute([&](
+            const draw_queue::command& c,
+            unsigned& texture_index,
+            bool shader_changed
+        ){
+            glm::mat4 mv = v * c.e->transform;
+
+            if(shader_changed) c.s->set(AMBIENT, ambient);
+            c.s->set(MVP, p * mv);
+            c.s->set(M, mv);
+            c.s->set(N_M, glm::mat3(glm::inverseTranspose(mv)));
+            c.mesh->draw();
+        });
 
-                unsigned texture_index = 0;
-                group.mat->apply(s, texture_index);
-                group.mesh->draw();
-            }
-        }
+        // Batches and instances carry their own model transforms.
+        auto set_view = [&](
+            shader* s,
+            unsigned& texture_index,
+            bool shader_changed
+        ){
+            if(!shader_changed) return;
+            s->set(AMBIENT, ambient);
+            s->set(MVP, p * v);
+            s->set(M, v);
+            s->set(N_M, glm::mat3(glm::inverseTranspose(v)));
+        };
+
+        for(geometry_batch* batch: objects->get_batches())
+            batch->execute(geometry_shader, common, false, set_view, view);
+
+        for(instanced_object* obj: objects->get_instanced_objects())
+            obj->execute(geometry_shader, common, false, set_view);
     }
 }
 
@@ -96,15 +117,16 @@ geometry_pass::geometry_pass(
 void geometry_pass::execute()
 {
     target_method::execute();
+    gl_state& state = get_target().get_context().get_state();
     if(!geometry_shader || !has_all_scenes())
         return;
 
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LEQUAL);
-    glEnable(GL_CULL_FACE);
-    glDisable(GL_BLEND);
+    state.enable(GL_DEPTH_TEST);
+    state.depth_func(GL_LEQUAL);
+    state.enable(GL_CULL_FACE);
+    state.disable(GL_BLEND);
 
-    stencil_draw();
+    stencil_draw(state);
 
     camera* cam = get_scene<camera_scene>()->get_camera();
     if(!cam) return;
@@ -126,6 +148,16 @@ void geometry_pass::execute()
 
     gbuffer* gbuf = static_cast<gbuffer*>(&get_target());
 
+    glm::mat4 vp =
+        cam->get_projection() * glm::inverse(cam->get_global_transform());
+    object_scene* objects = get_scene<object_scene>();
+
+    visible_set visible;
+    visible.update(objects, vp);
+
+    for(geometry_batch* batch: objects->get_batches()) batch->cull(vp, this);
+    for(instanced_object* obj: objects->get_instanced_objects()) obj->cull(vp);
+
     if(opt.render_transparent)
     {
         // Draw depth first to extract top layer.
@@ -136,17 +168,17 @@ void geometry_pass::execute()
             {"MIN_ALPHA", "0.00390625f"}
         });
 
-        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-        depth_pass(depth_only, geometry_shader, cam, get_scene<object_scene>());
-        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        state.color_mask(false, false, false, false);
+        depth_pass(this, depth_only, geometry_shader, cam, visible, objects);
+        state.color_mask(true, true, true, true);
 
         gbuf->set_draw(gbuffer::DRAW_ALL);
-        glEnable(GL_BLEND);
+        state.enable(GL_BLEND);
         // Don't blend geometry data channels.
-        glBlendFunc(GL_ONE, GL_ZERO);
+        state.blend_func(GL_ONE, GL_ZERO);
 
         // Transmittance
-        glBlendFunci(
+        state.blend_func(
             gbuf->get_lighting_index(),
             GL_ZERO,
             GL_ONE_MINUS_SRC_ALPHA
@@ -158,10 +190,12 @@ void geometry_pass::execute()
     gbuf->update_definitions(common);
 
     depth_pass(
+        this,
         common,
         geometry_shader,
         cam,
-        get_scene<object_scene>(),
+        visible,
+        objects,
         get_scene<light_scene>()->get_ambient()
     );
 
@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "kernel.hh"
+#include "context.hh"
 #include "render_target.hh"
 #include "texture.hh"
 #include "sampler.hh"
@@ -67,13 +68,14 @@ kernel::kernel(
 void kernel::execute()
 {
     target_method::execute();
+    gl_state& state = get_target().get_context().get_state();
 
     if(!kernel_shader || !src) return;
 
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
-    glDisable(GL_BLEND);
-    glDisable(GL_STENCIL_TEST);
+    state.disable(GL_DEPTH_TEST);
+    state.enable(GL_CULL_FACE);
+    state.disable(GL_BLEND);
+    state.disable(GL_STENCIL_TEST);
 
     kernel_shader->bind();
     kernel_shader->set("kernel", opt.kernel);
@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "lighting_pass.hh"
+#include "context.hh"
 #include "multishader.hh"
 #include "camera.hh"
 #include "math.hh"
@@ -26,12 +27,18 @@
 #include "common_resources.hh"
 #include "shadow_map.hh"
 #include "shadow_method.hh"
+#include "light_buffer.hh"
+#include "light_clusters.hh"
 
 namespace 
 {
 using namespace lt;
 using namespace lt::method;
 
+constexpr uniform_handle<glm::mat4> MVP("mvp");
+constexpr uniform_handle<glm::mat4> M("m");
+constexpr uniform_handle<int> LIGHT_INDEX("light_index");
+
 void set_gbuf(shader* s, gbuffer* buf, const camera* cam)
 {
     unsigned start_index = 0;
@@ -251,12 +258,54 @@ void render_shadowed(
     }
 }
 
+// The unshadowed lights are read from the light buffer, so only the index and
+// bounding rectangle change between lights.
+template<typename L>
+void render_unshadowed(
+    gbuffer* buf,
+    multishader* lighting_shader,
+    shader::definition_map definitions,
+    const std::vector<L*>& lights,
+    const std::vector<bool>& handled_lights,
+    const light_buffer& light_buf,
+    const camera* cam,
+    float cutoff,
+    lighting_pass::options::depth_test light_test,
+    const primitive& quad
+){
+    definitions["LIGHT_BUFFER"];
+    shader* s = lighting_shader->get(definitions);
+    s->bind();
+    set_gbuf(s, buf, cam);
+    light_buf.set(s);
+
+    glm::mat4 view = glm::inverse(cam->get_global_transform());
+
+    for(unsigned i = 0; i < lights.size(); ++i)
+    {
+        if(handled_lights[i]) continue;
+
+        L* light = lights[i];
+        glm::vec3 pos = glm::vec3(
+            view * glm::vec4(light->get_global_position(), 1)
+        );
+        if(!set_bounding_rect(s, light, pos, cam, cutoff, light_test))
+            continue;
+
+        s->set(LIGHT_INDEX, (int)i);
+        quad.draw();
+    }
+}
+
 void render_point_lights(
     gbuffer* buf,
     multishader* lighting_shader,
     camera_scene* cameras,
     light_scene* lights,
     shadow_scene* shadows,
+    const light_buffer& light_buf,
+    std::vector<bool>& handled_lights,
+    bool render_unshadowed_lights,
     float cutoff,
     lighting_pass::options::depth_test light_test,
     const primitive& quad,
@@ -264,7 +313,6 @@ void render_point_lights(
     unsigned start_index
 ){
     const std::vector<point_light*>& l = lights->get_point_lights();
-    std::vector<bool> handled_lights(l.size(), false);
 
     shader::definition_map definitions({{"POINT_LIGHT", ""}});
     if(visualize_light_volumes) definitions["VISUALIZE"];
@@ -302,17 +350,11 @@ void render_point_lights(
     );
 
     // Render unshadowed lights
-    shader* s = lighting_shader->get(definitions);
-    s->bind();
-    set_gbuf(s, buf, cam);
-
-    for(unsigned i = 0; i < l.size(); ++i)
-    {
-        if(handled_lights[i]) continue;
-        if(!set_light(s, l[i], cam, cutoff, light_test))
-            continue;
-        quad.draw();
-    }
+    if(!render_unshadowed_lights) return;
+    render_unshadowed(
+        buf, lighting_shader, definitions, l, handled_lights, light_buf,
+        cam, cutoff, light_test, quad
+    );
 }
 
 void render_spotlights(
@@ -321,6 +363,9 @@ void render_spotlights(
     camera_scene* cameras,
     light_scene* lights,
     shadow_scene* shadows,
+    const light_buffer& light_buf,
+    std::vector<bool>& handled_lights,
+    bool render_unshadowed_lights,
     float cutoff,
     lighting_pass::options::depth_test light_test,
     const primitive& quad,
@@ -328,7 +373,6 @@ void render_spotlights(
     unsigned start_index
 ){
     const std::vector<spotlight*>& l = lights->get_spotlights();
-    std::vector<bool> handled_lights(l.size(), false);
 
     shader::definition_map definitions({{"SPOTLIGHT", ""}});
     if(visualize_light_volumes) definitions["VISUALIZE"];
@@ -366,17 +410,11 @@ void render_spotlights(
     );
 
     // Render unshadowed lights
-    shader* s = lighting_shader->get(definitions);
-    s->bind();
-    set_gbuf(s, buf, cam);
-
-    for(unsigned i = 0; i < l.size(); ++i)
-    {
-        if(handled_lights[i]) continue;
-        if(!set_light(s, l[i], cam, cutoff, light_test))
-            continue;
-        quad.draw();
-    }
+    if(!render_unshadowed_lights) return;
+    render_unshadowed(
+        buf, lighting_shader, definitions, l, handled_lights, light_buf,
+        cam, cutoff, light_test, quad
+    );
 }
 
 void render_directional_lights(
@@ -385,6 +423,7 @@ void render_directional_lights(
     camera_scene* cameras,
     light_scene* lights,
     shadow_scene* shadows,
+    const light_buffer& light_buf,
     const primitive& quad,
     unsigned start_index
 ){
@@ -433,18 +472,52 @@ void render_directional_lights(
     }
 
     // Render unshadowed lights
+    definitions["LIGHT_BUFFER"];
     shader* s = lighting_shader->get(definitions);
     s->bind();
     set_gbuf(s, buf, cam);
+    light_buf.set(s);
+
+    glm::mat4 m = glm::mat4(1.0f);
+    s->set(M, m);
+    s->set(MVP, m);
 
     for(unsigned i = 0; i < l.size(); ++i)
     {
         if(handled_lights[i]) continue;
-        if(!set_light(s, l[i], cam)) continue;
+        s->set(LIGHT_INDEX, (int)i);
         quad.draw();
     }
 }
 
+// Unshadowed point lights and spotlights are drawn in a single full-screen
+// pass, where each pixel only evaluates the lights of its cluster.
+void render_clustered_lights(
+    gbuffer* buf,
+    multishader* lighting_shader,
+    const camera* cam,
+    const light_buffer& light_buf,
+    const light_clusters& clusters,
+    const primitive& quad,
+    bool visualize_light_volumes
+){
+    shader::definition_map definitions;
+    clusters.update_definitions(definitions);
+    if(visualize_light_volumes) definitions["VISUALIZE"];
+    quad.update_definitions(definitions);
+
+    shader* s = lighting_shader->get(definitions);
+    s->bind();
+    set_gbuf(s, buf, cam);
+    light_buf.set(s, 0);
+    clusters.set(s, 1);
+
+    glm::mat4 m = glm::mat4(1.0f);
+    s->set(M, m);
+    s->set(MVP, m);
+    quad.draw();
+}
+
 }
 
 namespace lt::method
@@ -462,52 +535,73 @@ lighting_pass::lighting_pass(
         shader::path{"generic.vert", "lighting.frag"}
     )),
     quad(common::ensure_quad_primitive(pool)),
-    fb_sampler(common::ensure_framebuffer_sampler(pool))
+    fb_sampler(common::ensure_framebuffer_sampler(pool)),
+    light_buf(pool.get_context()),
+    clusters(pool)
+{
+}
+
+void lighting_pass::set_gbuffer(gbuffer& buf)
 {
+    this->buf = &buf;
 }
 
 void lighting_pass::execute()
 {
     target_method::execute();
+    gl_state& state = get_target().get_context().get_state();
 
     const auto [
         cutoff,
         light_test,
-        visualize_light_volumes
+        visualize_light_volumes,
+        clustered
     ] = opt;
 
     if(!lighting_shader || !has_all_scenes())
         return;
 
-    glEnable(GL_CULL_FACE);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_ONE, GL_ONE);
+    state.enable(GL_CULL_FACE);
+    state.enable(GL_BLEND);
+    state.blend_func(GL_ONE, GL_ONE);
 
-    stencil_cull();
+    stencil_cull(state);
 
     if(cutoff > 0 && light_test != options::TEST_NONE)
     {
-        glEnable(GL_DEPTH_TEST);
-        glDepthMask(GL_FALSE);
-        if(light_test == options::TEST_FAR) glDepthFunc(GL_GEQUAL);
-        else glDepthFunc(GL_LEQUAL);
+        state.enable(GL_DEPTH_TEST);
+        state.depth_mask(false);
+        if(light_test == options::TEST_FAR) state.depth_func(GL_GEQUAL);
+        else state.depth_func(GL_LEQUAL);
     }
     else
     {
-        glDisable(GL_DEPTH_TEST);
+        state.disable(GL_DEPTH_TEST);
     }
 
     camera* cam = get_scene<camera_scene>()->get_camera();
     if(!cam) return;
 
+    light_scene* lights = get_scene<light_scene>();
+    glm::mat4 view = glm::inverse(cam->get_global_transform());
+    std::vector<bool> handled_point_lights(lights->point_light_count(), false);
+    std::vector<bool> handled_spotlights(lights->spotlight_count(), false);
+
+    // Clusters only contain unshadowed lights, so the light buffer is filled
+    // once the shadowed ones are known.
+    if(!clustered) light_buf.update(lights, view);
+
     unsigned texture_index = 0;
     buf->bind_textures(fb_sampler, texture_index);
 
     render_point_lights(
         buf, lighting_shader,
         get_scene<camera_scene>(),
-        get_scene<light_scene>(),
+        lights,
         get_scene<shadow_scene>(),
+        light_buf,
+        handled_point_lights,
+        !clustered,
         cutoff, light_test,
         quad, visualize_light_volumes,
         texture_index
@@ -516,8 +610,11 @@ void lighting_pass::execute()
     render_spotlights(
         buf, lighting_shader,
         get_scene<camera_scene>(),
-        get_scene<light_scene>(),
+        lights,
         get_scene<shadow_scene>(),
+        light_buf,
+        handled_spotlights,
+        !clustered,
         cutoff, light_test,
         quad, visualize_light_volumes,
         texture_index
@@ -525,17 +622,35 @@ void lighting_pass::execute()
 
     if(cutoff > 0 && light_test != options::TEST_NONE)
     {
-        glDisable(GL_DEPTH_TEST);
-        glDepthFunc(GL_LEQUAL);
-        glDepthMask(GL_TRUE);
+        state.disable(GL_DEPTH_TEST);
+        state.depth_func(GL_LEQUAL);
+        state.depth_mask(true);
+    }
+
+    if(clustered)
+    {
+        light_buf.update(
+            lights, view, handled_point_lights, handled_spotlights
+        );
+        clusters.build(light_buf, cam, get_target().get_size(), cutoff, buf);
+
+        // Building the clusters may have replaced the bound textures.
+        texture_index = 0;
+        buf->bind_textures(fb_sampler, texture_index);
+
+        render_clustered_lights(
+            buf, lighting_shader, cam, light_buf, clusters, quad,
+            visualize_light_volumes
+        );
     }
 
     render_directional_lights(
         buf,
         lighting_shader,
         get_scene<camera_scene>(),
-        get_scene<light_scene>(),
+        lights,
         get_scene<shadow_scene>(),
+        light_buf,
         quad,
         texture_index
     );
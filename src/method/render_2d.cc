@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "render_2d.hh"
+#include "context.hh"
 #include "multishader.hh"
 #include "gbuffer.hh"
 #include "camera.hh"
@@ -34,6 +35,13 @@ namespace
 {
 using namespace lt;
 
+constexpr uniform_handle<mat4> MVP("mvp");
+constexpr uniform_handle<mat4> M("m");
+constexpr uniform_handle<mat3> N_M("n_m");
+constexpr uniform_handle<vec3> AMBIENT("ambient");
+constexpr uniform_handle<vec2> UV_OFFSET("uv_offset");
+constexpr uniform_handle<vec2> UV_SCALE("uv_scale");
+
 inline void apply_default_sampler(material::sampler_tex& st, const sampler* s)
 {
     if(st.second && !st.first) st.first = s;
@@ -75,6 +83,7 @@ render_2d::~render_2d() {}
 void render_2d::execute()
 {
     target_method::execute();
+    gl_state& state = get_target().get_context().get_state();
 
     camera_scene* cs = get_scene<camera_scene>();
     sprite_scene* ss = get_scene<sprite_scene>();
@@ -180,13 +189,13 @@ void render_2d::execute()
     );
 
     // Render sprites
-    glEnable(GL_DEPTH_TEST);
-    glDisable(GL_CULL_FACE);
+    state.enable(GL_DEPTH_TEST);
+    state.disable(GL_CULL_FACE);
 
-    stencil_draw();
+    stencil_draw(state);
 
-    if(!read_depth_buffer) glDepthFunc(GL_ALWAYS);
-    if(!write_buffer_data) glDepthMask(GL_FALSE);
+    if(!read_depth_buffer) state.depth_func(GL_ALWAYS);
+    if(!write_buffer_data) state.depth_mask(false);
 
     shader::definition_map common({
         {"OUTPUT_LIGHTING", ""},
@@ -195,7 +204,7 @@ void render_2d::execute()
 
     if(gbuf && write_buffer_data)
     {
-        glDisable(GL_BLEND);
+        state.disable(GL_BLEND);
         common["MIN_ALPHA"] = "0.5f";
         common["OUTPUT_GEOMETRY"];
         common["APPLY_EMISSION"];
@@ -204,8 +213,8 @@ void render_2d::execute()
     }
     else
     {
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        state.enable(GL_BLEND);
+        state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     }
     quad.update_definitions(common);
 
@@ -215,21 +224,20 @@ void render_2d::execute()
 
     vec3 ambient = ls ? ls->get_ambient() : vec3(0);
 
+    unsigned pass_key = draw_shader->get_pass_key(common);
+
     for(command& cmd: command_buffer)
     {
-        shader::definition_map definitions(common);
-        cmd.mat.update_definitions(definitions);
-
-        shader* s = draw_shader->get(definitions);
+        shader* s = draw_shader->get(pass_key, &cmd.mat, nullptr);
         s->bind();
 
-        s->set("mvp", cmd.mvp);
-        s->set("m", cmd.mv);
-        s->set("n_m", cmd.n_m);
-        s->set("ambient", ambient);
-        s->set("uv_offset", vec2(cmd.uv_bounds));
+        s->set(MVP, cmd.mvp);
+        s->set(M, cmd.mv);
+        s->set(N_M, cmd.n_m);
+        s->set(AMBIENT, ambient);
+        s->set(UV_OFFSET, vec2(cmd.uv_bounds));
         s->set(
-            "uv_scale",
+            UV_SCALE,
             vec2(cmd.uv_bounds.z, cmd.uv_bounds.w)-vec2(cmd.uv_bounds)
         );
 
@@ -238,8 +246,8 @@ void render_2d::execute()
         quad.draw();
     }
 
-    glDepthFunc(GL_LEQUAL);
-    glDepthMask(GL_TRUE);
+    state.depth_func(GL_LEQUAL);
+    state.depth_mask(true);
 
     if(gbuf) gbuf->set_draw(gbuffer::DRAW_LIGHTING);
 }
@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "sao.hh"
+#include "context.hh"
 #include "multishader.hh"
 #include "shader.hh"
 #include "math.hh"
@@ -60,8 +61,14 @@ sao::sao(
     options_will_update(opt, true);
 }
 
+void sao::set_gbuffer(gbuffer& buf)
+{
+    this->buf = &buf;
+}
+
 void sao::execute()
 {
+    gl_state& state = get_context().get_state();
     const auto [radius, samples, bias, intensity] = opt;
     if(!has_all_scenes())
         return;
@@ -75,11 +82,11 @@ void sao::execute()
     texture* depth_tex = buf->get_linear_depth();
     if(!cam || !depth_tex) return;
 
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
-    glDisable(GL_BLEND);
-    glBlendFunc(GL_ONE, GL_ONE);
-    glDisable(GL_STENCIL_TEST);
+    state.disable(GL_DEPTH_TEST);
+    state.enable(GL_CULL_FACE);
+    state.disable(GL_BLEND);
+    state.blend_func(GL_ONE, GL_ONE);
+    state.disable(GL_STENCIL_TEST);
 
     // Distributed AO sample pass
     ao.input().bind();
@@ -124,7 +131,7 @@ void sao::execute()
     quad.draw();
 
     // Apply
-    glEnable(GL_BLEND);
+    state.enable(GL_BLEND);
     ao.swap();
     get_target().bind();
 
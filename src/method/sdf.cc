@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "method/sdf.hh"
+#include "context.hh"
 #include "primitive.hh"
 #include "gbuffer.hh"
 #include "sampler.hh"
@@ -59,6 +60,7 @@ render_sdf::render_sdf(
 void render_sdf::execute()
 {
     target_method::execute();
+    gl_state& state = get_target().get_context().get_state();
     if(!sdf_shader || !has_all_scenes())
         return;
 
@@ -69,12 +71,12 @@ void render_sdf::execute()
         ssrt_brdf_cutoff, ssrt_max_steps, ssrt_thickness
     ] = opt;
 
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LEQUAL);
-    glEnable(GL_CULL_FACE);
-    glDisable(GL_BLEND);
+    state.enable(GL_DEPTH_TEST);
+    state.depth_func(GL_LEQUAL);
+    state.enable(GL_CULL_FACE);
+    state.disable(GL_BLEND);
 
-    stencil_draw();
+    stencil_draw(state);
 
     light_scene* lights = get_scene<light_scene>();
     sdf_scene* sdfs = get_scene<sdf_scene>();
@@ -120,7 +122,7 @@ void render_sdf::execute()
     gbuf->bind();
     gbuf->set_draw(gbuffer::DRAW_ALL_EXCEPT_LINEAR_DEPTH);
 
-    if(!write_depth) glDepthMask(GL_FALSE);
+    if(!write_depth) state.depth_mask(false);
 
     shader* s = NULL;
     uint64_t hash = sdfs->get_hash();
@@ -199,7 +201,7 @@ void render_sdf::execute()
 
     quad.draw();
 
-    if(!write_depth) glDepthMask(GL_TRUE);
+    if(!write_depth) state.depth_mask(true);
     gbuf->set_draw(gbuffer::DRAW_LIGHTING);
 }
 
@@ -17,29 +17,82 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "shadow_msm.hh"
+#include "context.hh"
 #include "resource_pool.hh"
 #include "helpers.hh"
 #include "object.hh"
 #include "camera.hh"
 #include "scene.hh"
 #include "common_resources.hh"
+#include "culling.hh"
+#include "draw_queue.hh"
+#include "geometry_batch.hh"
+#include "instanced_object.hh"
+#include "profiler.hh"
 
 namespace
 {
 using namespace lt;
 using namespace lt::method;
 
+constexpr uniform_handle<glm::mat4> MVP("mvp");
+constexpr uniform_handle<glm::mat4> M("m");
+
+// Variant of a depth shader's definitions for drawing geometry batches.
+shader::definition_map batched(shader::definition_map def)
+{
+    geometry_batch::update_definitions(def);
+    return def;
+}
+
+// Draws the geometry batches and instanced objects with the batched variant
+// 's' of a depth shader. Uniforms other than the transforms must already be
+// set. 'view' keys the batch culls, normally the shadow map being drawn.
+template<typename... Args>
+void draw_batches(
+    object_scene* objects,
+    const void* view,
+    shader* s,
+    const glm::mat4& vp,
+    const Args&... cull_args
+){
+    const std::vector<geometry_batch*>& batches = objects->get_batches();
+    const std::vector<instanced_object*>& instanced =
+        objects->get_instanced_objects();
+    if(batches.empty() && instanced.empty()) return;
+
+    s->set(M, glm::mat4(1.0f));
+    s->set(MVP, vp);
+    s->bind();
+
+    for(geometry_batch* batch: batches)
+    {
+        batch->cull(cull_args..., view);
+        batch->draw(s, view);
+    }
+
+    for(instanced_object* obj: instanced)
+    {
+        obj->cull(cull_args...);
+        obj->draw(s);
+    }
+}
+
 template<typename L>
 void render_single(
     L* msm,
     resource_pool& pool,
     object_scene* objects,
+    visible_set& visible,
+    draw_queue& queue,
     const primitive& quad,
     shader* depth_shader,
+    shader* batched_depth_shader,
     shader* horizontal_blur_shader,
     shader* vertical_blur_shader,
     sampler& moment_sampler
 ){
+    gl_state& state = pool.get_context().get_state();
     texture& moments = msm->get_moments();
     framebuffer& moments_buffer = msm->get_framebuffer();
 
@@ -68,32 +121,26 @@ void render_single(
     }
 
     // Render depth data
-    glEnable(GL_DEPTH_TEST);
+    state.enable(GL_DEPTH_TEST);
 
     target->bind();
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     glm::mat4 vp = msm->get_projection() * msm->get_view();
+    visible.update(objects, vp);
 
-    for(object* obj: objects->get_objects())
+    queue.build(visible, vec3(glm::inverse(msm->get_view())[3]));
+    depth_shader->bind();
+    for(const draw_queue::command& c: queue)
     {
-        const model* mod = obj->get_model();
-        if(!mod) continue;
-
-        glm::mat4 m = obj->get_global_transform();
-        glm::mat4 mvp = vp * m;
-        depth_shader->set("m", m);
-        depth_shader->set("mvp", mvp);
-
-        for(const model::vertex_group& group: *mod)
-        {
-            if(!group.mesh) continue;
-
-            group.mesh->draw();
-        }
+        depth_shader->set(M, c.e->transform);
+        depth_shader->set(MVP, vp * c.e->transform);
+        c.mesh->draw();
     }
 
+    draw_batches(objects, msm, batched_depth_shader, vp, vp);
+
     target->bind(GL_READ_FRAMEBUFFER);
     moments_buffer.bind(GL_DRAW_FRAMEBUFFER);
 
@@ -109,9 +156,11 @@ void render_single(
     unsigned radius = msm->get_radius();
     if(radius == 0) return;
 
+    profiler::scope timing("blur");
+
     vertical_blur_shader->bind();
 
-    glDisable(GL_DEPTH_TEST);
+    state.disable(GL_DEPTH_TEST);
 
     postprocess_buffer->bind();
     vertical_blur_shader->set(
@@ -156,6 +205,21 @@ shadow_msm::shadow_msm(resource_pool& pool, Scene scene)
         {{"VERTEX_POSITION", "0"},
          {"DISCARD_ALPHA", "0.5"}}
     )),
+    batched_depth_shader(pool.get_shader(
+        shader::path{"generic.vert", "shadow/directional_msm.frag"},
+        batched({{"VERTEX_POSITION", "0"},
+                 {"DISCARD_ALPHA", "0.5"}})
+    )),
+    batched_cubemap_depth_shader(pool.get_shader(
+        shader::path{"generic.vert", "shadow/omni_msm.frag", "cubemap.geom"},
+        batched({{"VERTEX_POSITION", "0"},
+                 {"DISCARD_ALPHA", "0.5"}})
+    )),
+    batched_perspective_depth_shader(pool.get_shader(
+        shader::path{"generic.vert", "shadow/omni_msm.frag"},
+        batched({{"VERTEX_POSITION", "0"},
+                 {"DISCARD_ALPHA", "0.5"}})
+    )),
     vertical_blur_shader(pool.get_shader(
         shader::path{"fullscreen.vert", "blur.frag"}, {{"VERTICAL", ""}}
     )),
@@ -258,6 +322,7 @@ void shadow_msm::set_shadow_map_uniforms(
 
 void shadow_msm::execute()
 {
+    gl_state& state = get_context().get_state();
     if(!has_all_scenes()) return;
 
     shadow_scene* shadows = get_scene<shadow_scene>();
@@ -286,16 +351,20 @@ void shadow_msm::execute()
         if(it != perspective.end()) perspective_shadow_maps = &it->second;
     }
 
-    glEnable(GL_CULL_FACE);
-    glDisable(GL_BLEND);
-    glDisable(GL_STENCIL_TEST);
+    state.enable(GL_CULL_FACE);
+    state.disable(GL_BLEND);
+    state.disable(GL_STENCIL_TEST);
     glClearColor(0.0f, 0.63f, 0.0f, 0.63f);
 
+    visible_set visible;
+    draw_queue queue;
+
     if(directional_shadow_maps)
     {
-        depth_shader->bind();
+        profiler::scope timing("directional");
         //TODO: Handle transparency correctly by setting the material.
-        depth_shader->set("input_material.color_factor", glm::vec4(1.0f));
+        for(shader* s: {depth_shader, batched_depth_shader})
+            s->set("input_material.color_factor", glm::vec4(1.0f));
         for(directional_shadow_map* sm: *directional_shadow_maps)
         {
             directional_shadow_map_msm* msm =
@@ -304,8 +373,11 @@ void shadow_msm::execute()
                 msm,
                 pool,
                 objects,
+                visible,
+                queue,
                 quad,
                 depth_shader,
+                batched_depth_shader,
                 horizontal_blur_shader,
                 vertical_blur_shader,
                 moment_sampler
@@ -315,26 +387,32 @@ void shadow_msm::execute()
 
     if(perspective_shadow_maps)
     {
-        perspective_depth_shader->bind();
+        profiler::scope timing("perspective");
         //TODO: Handle transparency correctly by setting the material.
-        perspective_depth_shader->set(
-            "input_material.color_factor",
-            glm::vec4(1.0f)
-        );
+        for(
+            shader* s:
+            {perspective_depth_shader, batched_perspective_depth_shader}
+        ) s->set("input_material.color_factor", glm::vec4(1.0f));
         for(perspective_shadow_map* sm: *perspective_shadow_maps)
         {
             perspective_shadow_map_msm* msm =
                 static_cast<perspective_shadow_map_msm*>(sm);
-            perspective_depth_shader->set("far_plane", msm->get_range().y);
-            perspective_depth_shader->set(
-                "pos", msm->get_light()->get_global_position()
-            );
+            for(
+                shader* s:
+                {perspective_depth_shader, batched_perspective_depth_shader}
+            ){
+                s->set("far_plane", msm->get_range().y);
+                s->set("pos", msm->get_light()->get_global_position());
+            }
             render_single(
                 msm,
                 pool,
                 objects,
+                visible,
+                queue,
                 quad,
                 perspective_depth_shader,
+                batched_perspective_depth_shader,
                 horizontal_blur_shader,
                 vertical_blur_shader,
                 moment_sampler
@@ -344,14 +422,12 @@ void shadow_msm::execute()
 
     if(omni_shadow_maps)
     {
-        glEnable(GL_DEPTH_TEST);
+        profiler::scope timing("omni");
+        state.enable(GL_DEPTH_TEST);
 
-        cubemap_depth_shader->bind();
         //TODO: Handle transparency correctly by setting the material.
-        cubemap_depth_shader->set(
-            "input_material.color_factor",
-            glm::vec4(1.0f)
-        );
+        for(shader* s: {cubemap_depth_shader, batched_cubemap_depth_shader})
+            s->set("input_material.color_factor", glm::vec4(1.0f));
 
         for(omni_shadow_map* sm: *omni_shadow_maps)
         {
@@ -369,28 +445,39 @@ void shadow_msm::execute()
                 proj * msm->get_view(2), proj * msm->get_view(3),
                 proj * msm->get_view(4), proj * msm->get_view(5)
             };
-            cubemap_depth_shader->set("face_vps", 6, face_vps);
-            cubemap_depth_shader->set(
-                "pos", msm->get_light()->get_global_position()
+            for(
+                shader* s:
+                {cubemap_depth_shader, batched_cubemap_depth_shader}
+            ){
+                s->set("face_vps", 6, face_vps);
+                s->set("pos", msm->get_light()->get_global_position());
+                s->set("far_plane", msm->get_range().y);
+            }
+
+            // All six faces together cover the sphere of the shadow range.
+            visible.update(
+                objects,
+                msm->get_light()->get_global_position(),
+                msm->get_range().y
             );
-            cubemap_depth_shader->set("far_plane", msm->get_range().y);
 
-            for(object* obj: objects->get_objects())
+            queue.build(visible, msm->get_light()->get_global_position());
+            cubemap_depth_shader->bind();
+            for(const draw_queue::command& c: queue)
             {
-                const model* mod = obj->get_model();
-                if(!mod) continue;
-
-                glm::mat4 m = obj->get_global_transform();
-                cubemap_depth_shader->set("m", m);
-                cubemap_depth_shader->set("mvp", m);
-
-                for(const model::vertex_group& group: *mod)
-                {
-                    if(!group.mesh) continue;
-
-                    group.mesh->draw();
-                }
+                cubemap_depth_shader->set(M, c.e->transform);
+                cubemap_depth_shader->set(MVP, c.e->transform);
+                c.mesh->draw();
             }
+
+            draw_batches(
+                objects,
+                msm,
+                batched_cubemap_depth_shader,
+                glm::mat4(1.0f),
+                msm->get_light()->get_global_position(),
+                msm->get_range().y
+            );
         }
     }
 }
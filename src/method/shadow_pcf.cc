@@ -17,12 +17,66 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "shadow_pcf.hh"
+#include "context.hh"
 #include "resource_pool.hh"
 #include "helpers.hh"
 #include "object.hh"
 #include "camera.hh"
 #include "scene.hh"
 #include "common_resources.hh"
+#include "culling.hh"
+#include "draw_queue.hh"
+#include "geometry_batch.hh"
+#include "instanced_object.hh"
+
+namespace
+{
+using namespace lt;
+
+constexpr uniform_handle<glm::mat4> MVP("mvp");
+constexpr uniform_handle<glm::mat4> M("m");
+
+// Variant of a depth shader's definitions for drawing geometry batches.
+shader::definition_map batched(shader::definition_map def)
+{
+    geometry_batch::update_definitions(def);
+    return def;
+}
+
+// Draws the geometry batches and instanced objects with the batched variant
+// 's' of a depth shader. Uniforms other than the transforms must already be
+// set. 'view' keys the batch culls, normally the shadow map being drawn.
+template<typename... Args>
+void draw_batches(
+    object_scene* objects,
+    const void* view,
+    shader* s,
+    const glm::mat4& vp,
+    const Args&... cull_args
+){
+    const std::vector<geometry_batch*>& batches = objects->get_batches();
+    const std::vector<instanced_object*>& instanced =
+        objects->get_instanced_objects();
+    if(batches.empty() && instanced.empty()) return;
+
+    s->set(M, glm::mat4(1.0f));
+    s->set(MVP, vp);
+    s->bind();
+
+    for(geometry_batch* batch: batches)
+    {
+        batch->cull(cull_args..., view);
+        batch->draw(s, view);
+    }
+
+    for(instanced_object* obj: instanced)
+    {
+        obj->cull(cull_args...);
+        obj->draw(s);
+    }
+}
+
+}
 
 namespace lt::method
 {
@@ -44,6 +98,21 @@ shadow_pcf::shadow_pcf(resource_pool& pool, Scene scene)
         {{"VERTEX_POSITION", "0"},
          {"DISCARD_ALPHA", "0.5"}}
     )),
+    batched_depth_shader(pool.get_shader(
+        shader::path{"generic.vert", "empty.frag"},
+        batched({{"VERTEX_POSITION", "0"},
+                 {"DISCARD_ALPHA", "0.5"}})
+    )),
+    batched_cubemap_depth_shader(pool.get_shader(
+        shader::path{"generic.vert", "shadow/omni_pcf.frag", "cubemap.geom"},
+        batched({{"VERTEX_POSITION", "0"},
+                 {"DISCARD_ALPHA", "0.5"}})
+    )),
+    batched_perspective_depth_shader(pool.get_shader(
+        shader::path{"generic.vert", "shadow/omni_pcf.frag"},
+        batched({{"VERTEX_POSITION", "0"},
+                 {"DISCARD_ALPHA", "0.5"}})
+    )),
     shadow_noise_2d(
         common::ensure_circular_random_texture(pool, glm::uvec2(512))
     ),
@@ -209,6 +278,7 @@ void shadow_pcf::set_shadow_map_uniforms(
 
 void shadow_pcf::execute()
 {
+    gl_state& state = shadow_sampler.get_context().get_state();
     if(!has_all_scenes()) return;
 
     shadow_scene* shadows = get_scene<shadow_scene>();
@@ -237,10 +307,13 @@ void shadow_pcf::execute()
         if(it != perspective.end()) perspective_shadow_maps = &it->second;
     }
 
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
-    glDisable(GL_BLEND);
-    glDisable(GL_STENCIL_TEST);
+    state.enable(GL_DEPTH_TEST);
+    state.enable(GL_CULL_FACE);
+    state.disable(GL_BLEND);
+    state.disable(GL_STENCIL_TEST);
+
+    visible_set visible;
+    draw_queue queue;
 
     if(directional_shadow_maps)
     {
@@ -256,22 +329,17 @@ void shadow_pcf::execute()
             glClear(GL_DEPTH_BUFFER_BIT);
 
             glm::mat4 vp = pcf->get_projection() * pcf->get_view();
+            visible.update(objects, vp);
 
-            for(object* obj: objects->get_objects())
+            queue.build(visible, vec3(glm::inverse(pcf->get_view())[3]));
+            for(const draw_queue::command& c: queue)
             {
-                const model* mod = obj->get_model();
-                if(!mod) continue;
-
-                glm::mat4 mvp = vp * obj->get_global_transform();
-                depth_shader->set("mvp", mvp);
-
-                for(const model::vertex_group& group: *mod)
-                {
-                    if(!group.mesh) continue;
-
-                    group.mesh->draw();
-                }
+                depth_shader->set(MVP, vp * c.e->transform);
+                c.mesh->draw();
             }
+
+            draw_batches(objects, pcf, batched_depth_shader, vp, vp);
+            depth_shader->bind();
         }
     }
 
@@ -293,28 +361,39 @@ void shadow_pcf::execute()
                 proj * pcf->get_view(2), proj * pcf->get_view(3),
                 proj * pcf->get_view(4), proj * pcf->get_view(5)
             };
-            cubemap_depth_shader->set("face_vps", 6, face_vps);
-            cubemap_depth_shader->set(
-                "pos", pcf->get_light()->get_global_position()
+            for(
+                shader* s:
+                {cubemap_depth_shader, batched_cubemap_depth_shader}
+            ){
+                s->set("face_vps", 6, face_vps);
+                s->set("pos", pcf->get_light()->get_global_position());
+                s->set("far_plane", pcf->get_range().y);
+            }
+
+            // All six faces together cover the sphere of the shadow range.
+            visible.update(
+                objects,
+                pcf->get_light()->get_global_position(),
+                pcf->get_range().y
             );
-            cubemap_depth_shader->set("far_plane", pcf->get_range().y);
 
-            for(object* obj: objects->get_objects())
+            queue.build(visible, pcf->get_light()->get_global_position());
+            for(const draw_queue::command& c: queue)
             {
-                const model* mod = obj->get_model();
-                if(!mod) continue;
-
-                glm::mat4 m = obj->get_global_transform();
-                cubemap_depth_shader->set("m", m);
-                cubemap_depth_shader->set("mvp", m);
-
-                for(const model::vertex_group& group: *mod)
-                {
-                    if(!group.mesh) continue;
-
-                    group.mesh->draw();
-                }
+                cubemap_depth_shader->set(M, c.e->transform);
+                cubemap_depth_shader->set(MVP, c.e->transform);
+                c.mesh->draw();
             }
+
+            draw_batches(
+                objects,
+                pcf,
+                batched_cubemap_depth_shader,
+                glm::mat4(1.0f),
+                pcf->get_light()->get_global_position(),
+                pcf->get_range().y
+            );
+            cubemap_depth_shader->bind();
         }
     }
 
@@ -332,28 +411,28 @@ void shadow_pcf::execute()
 
             glm::mat4 vp = pcf->get_projection() * pcf->get_view();
 
-            perspective_depth_shader->set(
-                "pos", pcf->get_light()->get_global_position()
-            );
-            perspective_depth_shader->set("far_plane", pcf->get_range().y);
-
-            for(object* obj: objects->get_objects())
-            {
-                const model* mod = obj->get_model();
-                if(!mod) continue;
-
-                glm::mat4 m = obj->get_global_transform();
-                glm::mat4 mvp = vp * m;
-                perspective_depth_shader->set("m", m);
-                perspective_depth_shader->set("mvp", mvp);
+            for(
+                shader* s:
+                {perspective_depth_shader, batched_perspective_depth_shader}
+            ){
+                s->set("pos", pcf->get_light()->get_global_position());
+                s->set("far_plane", pcf->get_range().y);
+            }
 
-                for(const model::vertex_group& group: *mod)
-                {
-                    if(!group.mesh) continue;
+            visible.update(objects, vp);
 
-                    group.mesh->draw();
-                }
+            queue.build(visible, pcf->get_light()->get_global_position());
+            for(const draw_queue::command& c: queue)
+            {
+                perspective_depth_shader->set(M, c.e->transform);
+                perspective_depth_shader->set(MVP, vp * c.e->transform);
+                c.mesh->draw();
             }
+
+            draw_batches(
+                objects, pcf, batched_perspective_depth_shader, vp, vp
+            );
+            perspective_depth_shader->bind();
         }
     }
 }
@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "skybox.hh"
+#include "context.hh"
 #include "common_resources.hh"
 #include "scene.hh"
 #include "primitive.hh"
@@ -55,6 +56,7 @@ skybox::skybox(
 void skybox::execute()
 {
     target_method::execute();
+    gl_state& state = get_target().get_context().get_state();
 
     if(!has_all_scenes()) return;
 
@@ -63,11 +65,11 @@ void skybox::execute()
     camera* cam = cs->get_camera();
     if(!skybox || !cam) return;
 
-    glDisable(GL_CULL_FACE);
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_BLEND);
+    state.disable(GL_CULL_FACE);
+    state.disable(GL_DEPTH_TEST);
+    state.disable(GL_BLEND);
 
-    stencil_cull();
+    stencil_cull(state);
 
     GLenum target = get_target().get_target();
     bool cubemap =
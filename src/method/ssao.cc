@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "ssao.hh"
+#include "context.hh"
 #include "multishader.hh"
 #include "shader.hh"
 #include "helpers.hh"
@@ -102,8 +103,14 @@ ssao::ssao(
     options_will_update(opt, true);
 }
 
+void ssao::set_gbuffer(gbuffer& buf)
+{
+    this->buf = &buf;
+}
+
 void ssao::execute()
 {
+    gl_state& state = get_context().get_state();
     const auto [radius, samples, blur_radius, bias] = opt;
 
     if(!has_all_scenes() || radius <= 0.0f)
@@ -117,11 +124,11 @@ void ssao::execute()
     camera* cam = get_scene<camera_scene>()->get_camera();
     if(!cam) return;
 
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
-    glDisable(GL_BLEND);
-    glBlendFunc(GL_ONE, GL_ONE);
-    glDisable(GL_STENCIL_TEST);
+    state.disable(GL_DEPTH_TEST);
+    state.enable(GL_CULL_FACE);
+    state.disable(GL_BLEND);
+    state.blend_func(GL_ONE, GL_ONE);
+    state.disable(GL_STENCIL_TEST);
 
     glm::mat4 p = cam->get_projection();
 
@@ -163,7 +170,7 @@ void ssao::execute()
         quad.draw();
     }
 
-    glEnable(GL_BLEND);
+    state.enable(GL_BLEND);
     ssao_buffer.swap();
     get_target().bind();
 
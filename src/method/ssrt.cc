@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "ssrt.hh"
+#include "context.hh"
 #include "shader.hh"
 #include "helpers.hh"
 #include "gbuffer.hh"
@@ -61,8 +62,14 @@ ssrt::ssrt(
     options_will_update(opt, true);
 }
 
+void ssrt::set_gbuffer(gbuffer& buf)
+{
+    this->buf = &buf;
+}
+
 void ssrt::execute()
 {
+    gl_state& state = get_target().get_context().get_state();
     const auto [
         roughness_cutoff,
         brdf_cutoff,
@@ -84,11 +91,11 @@ void ssrt::execute()
     if(!linear_depth || !lighting || !normal || !material || !color)
         return;
 
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
-    glDisable(GL_BLEND);
-    glBlendFunc(GL_ONE, GL_ONE);
-    stencil_cull();
+    state.disable(GL_DEPTH_TEST);
+    state.enable(GL_CULL_FACE);
+    state.disable(GL_BLEND);
+    state.blend_func(GL_ONE, GL_ONE);
+    stencil_cull(state);
 
     glm::mat4 p = cam->get_projection();
     glm::uvec2 size(get_target().get_size());
@@ -136,7 +143,7 @@ void ssrt::execute()
 
     quad.draw();
 
-    glEnable(GL_BLEND);
+    state.enable(GL_BLEND);
     get_target().bind();
 
     blit_shader->bind();
@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "tonemap.hh"
+#include "context.hh"
 #include "render_target.hh"
 #include "texture.hh"
 #include "resource_pool.hh"
@@ -39,16 +40,22 @@ tonemap::tonemap(
 {
 }
 
+void tonemap::set_src(texture* src)
+{
+    this->src = src;
+}
+
 void tonemap::execute()
 {
     target_method::execute();
+    gl_state& state = get_target().get_context().get_state();
 
     if(!tonemap_shader || !src) return;
 
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
-    glDisable(GL_BLEND);
-    glDisable(GL_STENCIL_TEST);
+    state.disable(GL_DEPTH_TEST);
+    state.enable(GL_CULL_FACE);
+    state.disable(GL_BLEND);
+    state.disable(GL_STENCIL_TEST);
 
     tonemap_shader->bind();
     tonemap_shader->set<float>("exposure", opt.exposure);
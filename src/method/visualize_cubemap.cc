@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "visualize_cubemap.hh"
+#include "context.hh"
 #include "multishader.hh"
 #include "camera.hh"
 #include "helpers.hh"
@@ -149,6 +150,7 @@ visualize_cubemap::visualize_cubemap(
 void visualize_cubemap::execute()
 {
     target_method::execute();
+    gl_state& state = get_target().get_context().get_state();
 
     if(!visualize_shader || !has_all_scenes()) return;
 
@@ -157,15 +159,15 @@ void visualize_cubemap::execute()
 
     if(cubemaps.size() == 0) return;
 
-    glEnable(GL_DEPTH_TEST);
-    glDisable(GL_BLEND);
-    glDisable(GL_STENCIL_TEST);
-    glEnable(GL_CULL_FACE);
+    state.enable(GL_DEPTH_TEST);
+    state.disable(GL_BLEND);
+    state.disable(GL_STENCIL_TEST);
+    state.enable(GL_CULL_FACE);
 
     camera* cam = get_scene<camera_scene>()->get_camera();
     if(!cam) return;
 
-    glFrontFace(GL_CW);
+    state.front_face(GL_CW);
 
     glm::mat4 vp =
         cam->get_projection() * glm::inverse(cam->get_global_transform());
@@ -202,7 +204,7 @@ void visualize_cubemap::execute()
         }
     }
 
-    glFrontFace(GL_CCW);
+    state.front_face(GL_CCW);
 }
 
 } // namespace lt::method
@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "visualize_gbuffer.hh"
+#include "context.hh"
 #include "multishader.hh"
 #include "camera.hh"
 #include "helpers.hh"
@@ -120,15 +121,16 @@ visualize_gbuffer::visualize_gbuffer(
 void visualize_gbuffer::execute()
 {
     target_method::execute();
+    gl_state& state = get_target().get_context().get_state();
 
     const auto [visualizers] = opt;
 
     if(!visualize_shader || visualizers.size() == 0 || !has_all_scenes()) return;
 
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
-    glDisable(GL_BLEND);
-    glDisable(GL_STENCIL_TEST);
+    state.disable(GL_DEPTH_TEST);
+    state.enable(GL_CULL_FACE);
+    state.disable(GL_BLEND);
+    state.disable(GL_STENCIL_TEST);
 
     camera* cam = get_scene<camera_scene>()->get_camera();
     if(!cam) return;
@@ -146,19 +148,19 @@ void visualize_gbuffer::execute()
         glm::uvec2 size = get_target().get_size();
         glm::uvec2 half_size = size/2u;
 
-        glViewport(0, half_size.y, half_size.x, half_size.y);
+        state.viewport(glm::ivec2(0, half_size.y), half_size);
         render_visualizer(buf, visualizers[0], visualize_shader, quad, cam);
 
-        glViewport(half_size.x, half_size.y, half_size.x, half_size.y);
+        state.viewport(glm::ivec2(half_size), half_size);
         render_visualizer(buf, visualizers[1], visualize_shader, quad, cam);
 
-        glViewport(0, 0, half_size.x, half_size.y);
+        state.viewport(glm::ivec2(0), half_size);
         render_visualizer(buf, visualizers[2], visualize_shader, quad, cam);
 
-        glViewport(half_size.x, 0, half_size.x, half_size.y);
+        state.viewport(glm::ivec2(half_size.x, 0), half_size);
         render_visualizer(buf, visualizers[3], visualize_shader, quad, cam);
 
-        glViewport(0, 0, size.x, size.y);
+        state.viewport(glm::ivec2(0), size);
     }
 }
 
@@ -17,10 +17,13 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "model.hh"
+#include "primitive.hh"
 
 namespace lt
 {
 
+model::model(): bounded(false) {}
+
 size_t model::group_count() const
 {
     return groups.size();
@@ -31,11 +34,13 @@ void model::add_vertex_group(
     const primitive* mesh
 ){
     groups.emplace_back(vertex_group{mat, mesh});
+    update_bounds();
 }
 
 void model::remove_vertex_group(size_t i)
 {
     groups.erase(groups.begin() + i);
+    update_bounds();
 }
 
 const model::vertex_group& model::operator[](size_t i) const
@@ -43,6 +48,16 @@ const model::vertex_group& model::operator[](size_t i) const
     return groups[i];
 }
 
+bool model::is_bounded() const
+{
+    return bounded;
+}
+
+const aabb& model::get_bounding_box() const
+{
+    return bounds;
+}
+
 model::iterator model::begin()
 {
     return groups.begin();
@@ -73,4 +88,19 @@ model::const_iterator model::cend() const
     return groups.cend();
 }
 
+void model::update_bounds()
+{
+    bounds = aabb();
+    bounded = groups.size() != 0;
+
+    for(const vertex_group& group: groups)
+    {
+        if(!group.mesh) continue;
+
+        const aabb& mesh_bounds = group.mesh->get_bounding_box();
+        if(mesh_bounds.is_empty()) bounded = false;
+        else bounds.expand(mesh_bounds);
+    }
+}
+
 } // namespace lt
@@ -19,6 +19,8 @@
 #include "multishader.hh"
 #include "helpers.hh"
 #include "shader.hh"
+#include "material.hh"
+#include "primitive.hh"
 #include <boost/filesystem.hpp>
 
 namespace lt
@@ -59,11 +61,17 @@ multishader::multishader(multishader&& other)
 : glresource(other.get_context()),
   source(std::move(other.source)),
   include_path(std::move(other.include_path)),
-  cache(std::move(other.cache))
+  cache(std::move(other.cache)),
+  passes(std::move(other.passes)),
+  pass_keys(std::move(other.pass_keys)),
+  variants(std::move(other.variants))
 {}
 
 void multishader::clear()
 {
+    variants.clear();
+    pass_keys.clear();
+    passes.clear();
     cache.clear();
 }
 
@@ -113,4 +121,58 @@ shader* multishader::get(const shader::definition_map& definitions) const
     return it->second.get();
 }
 
+unsigned multishader::get_pass_key(
+    const shader::definition_map& definitions
+) const
+{
+    auto it = pass_keys.find(definitions);
+    if(it != pass_keys.end()) return it->second;
+
+    unsigned key = passes.size();
+    passes.push_back(definitions);
+    pass_keys.emplace(definitions, key);
+    return key;
+}
+
+shader* multishader::get(
+    unsigned pass_key,
+    const material* mat,
+    const primitive* mesh
+) const
+{
+    variant_key key{
+        pass_key,
+        mat ? mat->get_feature_key() : 0,
+        mesh ? mesh->get_feature_key() : 0
+    };
+
+    auto it = variants.find(key);
+    if(it != variants.end()) return it->second;
+
+    shader::definition_map definitions(passes.at(pass_key));
+    if(mat) mat->update_definitions(definitions);
+    if(mesh) mesh->update_definitions(definitions);
+
+    shader* s = get(definitions);
+    variants.emplace(key, s);
+    return s;
+}
+
+bool multishader::variant_key::operator==(const variant_key& other) const
+{
+    return pass == other.pass && material == other.material &&
+        mesh == other.mesh;
+}
+
+size_t multishader::variant_key_hash::operator()(
+    const variant_key& key
+) const
+{
+    size_t seed = 0;
+    boost::hash_combine(seed, key.pass);
+    boost::hash_combine(seed, key.material);
+    boost::hash_combine(seed, key.mesh);
+    return seed;
+}
+
 } // namespace lt
@@ -25,7 +25,11 @@ object::object(const model* mod, transformable_node* parent)
 : transformable_node(parent), mod(mod) {}
 object::~object() {}
 
-void object::set_model(const model* mod) { this->mod = mod; }
+void object::set_model(const model* mod)
+{
+    this->mod = mod;
+    global_changed();
+}
 const model* object::get_model() const { return mod; }
 
 } // namespace lt
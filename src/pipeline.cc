@@ -18,6 +18,8 @@
 */
 #include "pipeline.hh"
 #include "render_target.hh"
+#include "shader.hh"
+#include "profiler.hh"
 #include <utility>
 #include <stdexcept>
 #include <typeinfo>
@@ -40,32 +42,42 @@ render_target& target_method::get_target()
     return *target;
 }
 
+void target_method::set_target(render_target& target)
+{
+    this->target = &target;
+}
+
 void target_method::execute()
 {
     target->bind();
 }
 
 pipeline::pipeline(const std::vector<pipeline_method*>& methods)
-: methods(methods) {}
+:   methods(methods), shader_compiles(methods.size(), 0),
+    hitch_count(0)
+{}
 
 pipeline::pipeline(pipeline&& other)
-: methods(std::move(other.methods))
+:   methods(std::move(other.methods)),
+    method_names(std::move(other.method_names)),
+    shader_compiles(std::move(other.shader_compiles)),
+    hitch_count(other.hitch_count)
 {}
 
 pipeline::~pipeline() {}
 
 void pipeline::execute()
 {
+    shader_compiles.assign(methods.size(), 0);
+
     for(unsigned i = 0; i < methods.size(); ++i)
     {
-        pipeline_method* method = methods[i];
-        method->execute();
-        if(glGetError() != GL_NO_ERROR)
-            throw std::runtime_error(
-                "Error in pipeline method "
-                + method->get_name() + " index " + std::to_string(i)
-            );
+        unsigned compile_count = shader::get_compile_count();
+        methods[i]->execute();
+        finish_method(i, compile_count);
     }
+
+    if(get_shader_compile_count() != 0) hitch_count++;
 }
 
 void pipeline::execute(std::vector<double>& timing)
@@ -73,22 +85,19 @@ void pipeline::execute(std::vector<double>& timing)
     std::vector<GLuint> queries(methods.size());
     glGenQueries(methods.size(), queries.data());
     timing.resize(methods.size());
+    shader_compiles.assign(methods.size(), 0);
 
     for(unsigned i = 0; i < methods.size(); ++i)
     {
-        pipeline_method* method = methods[i];
-
+        unsigned compile_count = shader::get_compile_count();
         glBeginQuery(GL_TIME_ELAPSED, queries[i]);
-        method->execute();
+        methods[i]->execute();
         glEndQuery(GL_TIME_ELAPSED);
-
-        if(glGetError() != GL_NO_ERROR)
-            throw std::runtime_error(
-                "Error in pipeline method "
-                + method->get_name() + " index " + std::to_string(i)
-            );
+        finish_method(i, compile_count);
     }
 
+    if(get_shader_compile_count() != 0) hitch_count++;
+
     for(unsigned i = 0; i < methods.size(); ++i)
     {
         int time = 0;
@@ -99,6 +108,40 @@ void pipeline::execute(std::vector<double>& timing)
     glDeleteQueries(methods.size(), queries.data());
 }
 
+void pipeline::execute(profiler& prof)
+{
+    if(method_names.size() != methods.size())
+    {
+        method_names.clear();
+        for(pipeline_method* m: methods) method_names.push_back(m->get_name());
+    }
+
+    profiler* prev_active = profiler::get_active();
+    profiler::set_active(&prof);
+    shader_compiles.assign(methods.size(), 0);
+
+    try
+    {
+        for(unsigned i = 0; i < methods.size(); ++i)
+        {
+            unsigned compile_count = shader::get_compile_count();
+            {
+                profiler::scope timing(method_names[i].c_str());
+                methods[i]->execute();
+            }
+            finish_method(i, compile_count);
+        }
+    }
+    catch(...)
+    {
+        profiler::set_active(prev_active);
+        throw;
+    }
+
+    profiler::set_active(prev_active);
+    if(get_shader_compile_count() != 0) hitch_count++;
+}
+
 std::string pipeline::get_name(size_t i) const
 {
     return methods[i]->get_name();
@@ -109,4 +152,32 @@ std::string pipeline::get_name() const
     return "pipeline";
 }
 
+unsigned pipeline::get_shader_compile_count(size_t i) const
+{
+    return shader_compiles[i];
+}
+
+unsigned pipeline::get_shader_compile_count() const
+{
+    unsigned count = 0;
+    for(unsigned compiles: shader_compiles) count += compiles;
+    return count;
+}
+
+unsigned pipeline::get_hitch_count() const
+{
+    return hitch_count;
+}
+
+void pipeline::finish_method(unsigned i, unsigned compile_count)
+{
+    shader_compiles[i] = shader::get_compile_count() - compile_count;
+
+    if(glGetError() != GL_NO_ERROR)
+        throw std::runtime_error(
+            "Error in pipeline method "
+            + methods[i]->get_name() + " index " + std::to_string(i)
+        );
+}
+
 } // namespace lt
@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "primitive.hh"
+#include "context.hh"
 #include <stdexcept>
 #include <string>
 
@@ -25,7 +26,7 @@ namespace lt
 
 gpu_buffer_accessor::gpu_buffer_accessor()
 :   buf(nullptr), components(0), type(GL_INT), normalized(false),
-    stride(0), offset(0)
+    stride(0), offset(0), octahedral(false)
 {
 }
 
@@ -35,9 +36,10 @@ gpu_buffer_accessor::gpu_buffer_accessor(
     GLenum type,
     bool normalized,
     size_t stride,
-    size_t offset
+    size_t offset,
+    bool octahedral
 ):  buf(&buf), components(components), type(type), normalized(normalized),
-    stride(stride), offset(offset)
+    stride(stride), offset(offset), octahedral(octahedral)
 {}
 
 gpu_buffer_accessor::~gpu_buffer_accessor()
@@ -55,6 +57,41 @@ size_t gpu_buffer_accessor::get_element_count() const
     return buf->get_size()/step;
 }
 
+const gpu_buffer* gpu_buffer_accessor::get_buffer() const
+{
+    return buf;
+}
+
+unsigned gpu_buffer_accessor::get_components() const
+{
+    return components;
+}
+
+GLenum gpu_buffer_accessor::get_type() const
+{
+    return type;
+}
+
+bool gpu_buffer_accessor::is_normalized() const
+{
+    return normalized;
+}
+
+size_t gpu_buffer_accessor::get_stride() const
+{
+    return stride;
+}
+
+size_t gpu_buffer_accessor::get_offset() const
+{
+    return offset;
+}
+
+bool gpu_buffer_accessor::is_octahedral() const
+{
+    return octahedral;
+}
+
 void gpu_buffer_accessor::setup_vertex_attrib(unsigned i) const
 {
     if(!is_valid() || buf->get_target() != GL_ARRAY_BUFFER)
@@ -89,7 +126,9 @@ const primitive::attribute primitive::UV2 = {5, "VERTEX_UV2"};
 const primitive::attribute primitive::UV3 = {6, "VERTEX_UV3"};
 
 primitive::primitive(context& ctx)
-: glresource(ctx), vao(0) {}
+:   glresource(ctx), vao(0), feature_key(0), position_scale(1.0f),
+    position_offset(0.0f)
+{}
 
 primitive::primitive(
     context& ctx,
@@ -97,7 +136,8 @@ primitive::primitive(
     GLenum mode,
     const gpu_buffer_accessor& index,
     const std::map<attribute, gpu_buffer_accessor>& attributes
-): glresource(ctx), vao(0)
+):  glresource(ctx), vao(0), feature_key(0), position_scale(1.0f),
+    position_offset(0.0f)
 {
     basic_load(index_count, mode, index, attributes);
 }
@@ -112,6 +152,11 @@ primitive::primitive(primitive&& other)
     mode = other.mode;
     index = other.index;
     attribs = other.attribs;
+    feature_key = other.feature_key;
+    feature_definitions = other.feature_definitions;
+    bounds = other.bounds;
+    position_scale = other.position_scale;
+    position_offset = other.position_offset;
 
     other.vao = 0;
 }
@@ -125,8 +170,29 @@ void primitive::update_definitions(shader::definition_map& def) const
 {
     load();
 
-    for(const auto& pair: attribs)
-        def[pair.first.name] = std::to_string(pair.first.index);
+    for(const auto& pair: feature_definitions)
+        def[pair.first] = pair.second;
+}
+
+uint64_t primitive::get_feature_key() const
+{
+    return feature_key;
+}
+
+size_t primitive::get_index_count() const
+{
+    return index_count;
+}
+
+const gpu_buffer_accessor& primitive::get_index() const
+{
+    return index;
+}
+
+const std::map<primitive::attribute, gpu_buffer_accessor>&
+primitive::get_attributes() const
+{
+    return attribs;
 }
 
 GLuint primitive::get_vao() const
@@ -138,7 +204,9 @@ GLuint primitive::get_vao() const
 void primitive::draw() const
 {
     load();
-    glBindVertexArray(vao);
+    set_position_decode_attributes();
+    gl_state& state = get_context().get_state();
+    state.bind_vertex_array(vao);
     if(index.is_valid())
         glDrawElements(
             mode,
@@ -153,7 +221,32 @@ void primitive::draw() const
             index_count
         );
 
-    glBindVertexArray(0);
+    state.bind_vertex_array(0);
+}
+
+void primitive::draw_instanced(size_t instance_count) const
+{
+    load();
+    set_position_decode_attributes();
+    gl_state& state = get_context().get_state();
+    state.bind_vertex_array(vao);
+    if(index.is_valid())
+        glDrawElementsInstanced(
+            mode,
+            index_count,
+            index.type,
+            (const GLvoid*)index.offset,
+            instance_count
+        );
+    else
+        glDrawArraysInstanced(
+            mode,
+            0,
+            index_count,
+            instance_count
+        );
+
+    state.bind_vertex_array(0);
 }
 
 GLenum primitive::get_mode() const
@@ -161,6 +254,37 @@ GLenum primitive::get_mode() const
     return mode;
 }
 
+void primitive::set_bounding_box(const aabb& bounds)
+{
+    this->bounds = bounds;
+}
+
+const aabb& primitive::get_bounding_box() const
+{
+    return bounds;
+}
+
+void primitive::set_position_decode(vec3 scale, vec3 offset)
+{
+    position_scale = scale;
+    position_offset = offset;
+}
+
+vec3 primitive::get_position_scale() const
+{
+    return position_scale;
+}
+
+vec3 primitive::get_position_offset() const
+{
+    return position_offset;
+}
+
+mat4 primitive::get_position_decode() const
+{
+    return glm::translate(position_offset) * glm::scale(position_scale);
+}
+
 class lazy_primitive: public primitive
 {
 public:
@@ -176,6 +300,7 @@ public:
         this->mode = mode;
         this->index = index;
         this->attribs = attributes;
+        update_feature_key();
     }
 
     ~lazy_primitive() {}
@@ -227,9 +352,11 @@ void primitive::basic_load(
     this->attribs = attributes;
     this->index_count = index_count;
     this->mode = mode;
+    update_feature_key();
 
     glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
+    gl_state& state = get_context().get_state();
+    state.bind_vertex_array(vao);
 
     if(index.is_valid())
     {
@@ -241,7 +368,7 @@ void primitive::basic_load(
         pair.second.buf->link();
         pair.second.setup_vertex_attrib(pair.first.index);
     }
-    glBindVertexArray(0);
+    state.bind_vertex_array(0);
 
     if(glGetError() != GL_NO_ERROR)
         throw std::runtime_error("Failed to create a primitive");
@@ -251,6 +378,7 @@ void primitive::basic_unload() const
 {
     if(vao != 0)
     {
+        get_context().get_state().forget_vertex_array(vao);
         glDeleteVertexArrays(1, &vao);
         vao = 0;
 
@@ -262,4 +390,24 @@ void primitive::basic_unload() const
     }
 }
 
+void primitive::update_feature_key() const
+{
+    feature_definitions.clear();
+    for(const auto& pair: attribs)
+    {
+        feature_definitions[pair.first.name] = std::to_string(pair.first.index);
+        if(pair.second.octahedral)
+            feature_definitions[pair.first.name + "_OCTAHEDRAL"];
+    }
+    feature_key = get_context().get_definitions_id(feature_definitions);
+}
+
+void primitive::set_position_decode_attributes() const
+{
+    // These are not part of the vertex array state, so they must be set for
+    // every draw.
+    glVertexAttrib3fv(POSITION_SCALE_INDEX, glm::value_ptr(position_scale));
+    glVertexAttrib3fv(POSITION_OFFSET_INDEX, glm::value_ptr(position_offset));
+}
+
 } // namespace lt
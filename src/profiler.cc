@@ -0,0 +1,313 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "profiler.hh"
+#include "helpers.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+
+namespace
+{
+using namespace lt;
+
+std::string escape_json(const std::string& str)
+{
+    std::string res;
+    for(char c: str)
+    {
+        if(c == '"' || c == '\\')
+        {
+            res += '\\';
+            res += c;
+        }
+        else if((unsigned char)c < 0x20)
+        {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)c);
+            res += buf;
+        }
+        else res += c;
+    }
+    return res;
+}
+
+profiler::stats calculate_stats(std::vector<double>& samples)
+{
+    profiler::stats s = {0, 0, 0, 0};
+    if(samples.empty()) return s;
+
+    s.last = samples.back();
+    double sum = 0;
+    for(double sample: samples) sum += sample;
+    s.avg = sum / samples.size();
+
+    std::sort(samples.begin(), samples.end());
+    s.min = samples.front();
+    size_t p99 = (size_t)std::ceil(samples.size() * 0.99) - 1;
+    s.p99 = samples[std::min(p99, samples.size() - 1)];
+    return s;
+}
+
+void append_trace_event(
+    std::string& json,
+    const std::string& name,
+    uint64_t start,
+    uint64_t end,
+    unsigned tid
+){
+    char buf[128];
+    snprintf(
+        buf, sizeof(buf),
+        "\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u},\n",
+        start / 1000.0, (end - start) / 1000.0, tid
+    );
+    json += "{\"name\":\"" + escape_json(name) + buf;
+}
+
+}
+
+namespace lt
+{
+
+profiler::scope::scope(const char* name)
+: prof(profiler::get_active())
+{
+    if(prof) prof->begin(name);
+}
+
+profiler::scope::~scope()
+{
+    if(prof) prof->end();
+}
+
+profiler::profiler(context& ctx, unsigned latency, unsigned history)
+:   glresource(ctx), frames(latency + 1), current(0), history(history),
+    start_time(clock::now()), gpu_start_time(0)
+{
+    for(frame& f: frames)
+    {
+        f.last_query = 0;
+        f.pending = false;
+    }
+    glGetInteger64v(GL_TIMESTAMP, &gpu_start_time);
+}
+
+profiler::~profiler()
+{
+    if(get_active() == this) set_active(nullptr);
+    for(frame& f: frames)
+    {
+        if(f.queries.size())
+            glDeleteQueries(f.queries.size(), f.queries.data());
+    }
+}
+
+void profiler::begin(const std::string& name)
+{
+    frame& f = frames[current];
+
+    std::string path = open.empty() ?
+        name : keys[f.events[open.back()].key].path + "/" + name;
+    unsigned key = 0;
+    auto it = key_indices.find(path);
+    if(it == key_indices.end())
+    {
+        key = keys.size();
+        keys.push_back({path, name, (unsigned)open.size()});
+        key_indices.emplace(path, key);
+    }
+    else key = it->second;
+
+    // Queries are kept for reuse, two per event.
+    size_t query = f.events.size() * 2;
+    if(f.queries.size() < query + 2)
+    {
+        f.queries.resize(query + 2);
+        glGenQueries(2, f.queries.data() + query);
+    }
+    glQueryCounter(f.queries[query], GL_TIMESTAMP);
+    f.last_query = query;
+
+    open.push_back(f.events.size());
+    f.events.push_back({key, now(), 0, 0, 0});
+}
+
+void profiler::end()
+{
+    if(open.empty())
+        throw std::runtime_error("Profiler scope ended without beginning");
+
+    frame& f = frames[current];
+    unsigned index = open.back();
+    open.pop_back();
+
+    f.last_query = index * 2 + 1;
+    glQueryCounter(f.queries[f.last_query], GL_TIMESTAMP);
+    f.events[index].cpu_end = now();
+}
+
+void profiler::next_frame()
+{
+    if(!open.empty())
+        throw std::runtime_error("Profiler scopes left open at end of frame");
+
+    frames[current].pending = true;
+    current = (current + 1) % frames.size();
+
+    // Frames are collected in order, starting from the oldest one, which is
+    // the one about to be reused. Its GPU times are dropped if they still
+    // aren't available.
+    for(unsigned i = 0; i < frames.size(); ++i)
+    {
+        frame& f = frames[(current + i) % frames.size()];
+        if(!f.pending) continue;
+
+        GLint available = 1;
+        if(f.events.size())
+        {
+            glGetQueryObjectiv(
+                f.queries[f.last_query],
+                GL_QUERY_RESULT_AVAILABLE,
+                &available
+            );
+        }
+        if(!available && i != 0) break;
+        collect(f, available);
+    }
+}
+
+std::vector<profiler::scope_stats> profiler::get_stats() const
+{
+    std::vector<std::vector<double>> cpu(keys.size()), gpu(keys.size());
+    std::vector<double> cpu_sum(keys.size()), gpu_sum(keys.size());
+    std::vector<bool> cpu_seen(keys.size()), gpu_seen(keys.size());
+
+    for(const std::vector<event>& events: recorded)
+    {
+        std::fill(cpu_sum.begin(), cpu_sum.end(), 0.0);
+        std::fill(gpu_sum.begin(), gpu_sum.end(), 0.0);
+        std::fill(cpu_seen.begin(), cpu_seen.end(), false);
+        std::fill(gpu_seen.begin(), gpu_seen.end(), false);
+
+        for(const event& e: events)
+        {
+            cpu_seen[e.key] = true;
+            cpu_sum[e.key] += (e.cpu_end - e.cpu_start) / 1e6;
+            if(e.gpu_end > e.gpu_start)
+            {
+                gpu_seen[e.key] = true;
+                gpu_sum[e.key] += (e.gpu_end - e.gpu_start) / 1e6;
+            }
+        }
+
+        for(unsigned key = 0; key < keys.size(); ++key)
+        {
+            if(cpu_seen[key]) cpu[key].push_back(cpu_sum[key]);
+            if(gpu_seen[key]) gpu[key].push_back(gpu_sum[key]);
+        }
+    }
+
+    std::vector<scope_stats> res;
+    for(unsigned key = 0; key < keys.size(); ++key)
+    {
+        if(cpu[key].empty()) continue;
+        scope_stats& s = res.emplace_back();
+        s.path = keys[key].path;
+        s.depth = keys[key].depth;
+        s.frames = cpu[key].size();
+        s.cpu = calculate_stats(cpu[key]);
+        s.gpu = calculate_stats(gpu[key]);
+    }
+    return res;
+}
+
+void profiler::write_trace(const std::string& path) const
+{
+    std::string json =
+        "{\"traceEvents\":[\n"
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,"
+        "\"args\":{\"name\":\"CPU\"}},\n"
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,"
+        "\"args\":{\"name\":\"GPU\"}},\n";
+
+    for(const std::vector<event>& events: recorded)
+    {
+        for(const event& e: events)
+        {
+            const std::string& name = keys[e.key].name;
+            append_trace_event(json, name, e.cpu_start, e.cpu_end, 0);
+            if(e.gpu_end > e.gpu_start)
+                append_trace_event(json, name, e.gpu_start, e.gpu_end, 1);
+        }
+    }
+
+    // Drop the trailing comma.
+    json.erase(json.size() - 2);
+    json += "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    if(!write_binary_file(path, (const uint8_t*)json.data(), json.size()))
+        throw std::runtime_error("Unable to write " + path);
+}
+
+profiler* profiler::get_active()
+{
+    return active();
+}
+
+void profiler::set_active(profiler* prof)
+{
+    active() = prof;
+}
+
+profiler*& profiler::active()
+{
+    static profiler* prof = nullptr;
+    return prof;
+}
+
+uint64_t profiler::now() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        clock::now() - start_time
+    ).count();
+}
+
+void profiler::collect(frame& f, bool available)
+{
+    for(size_t i = 0; available && i < f.events.size(); ++i)
+    {
+        event& e = f.events[i];
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(f.queries[i * 2], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(f.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+
+        // The GPU clock may have been reset since the profiler was created.
+        if((int64_t)start < gpu_start_time || end < start) continue;
+        e.gpu_start = start - gpu_start_time;
+        e.gpu_end = end - gpu_start_time;
+    }
+
+    recorded.push_back(f.events);
+    while(recorded.size() > history) recorded.pop_front();
+    f.events.clear();
+    f.pending = false;
+}
+
+} // namespace lt
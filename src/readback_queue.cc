@@ -0,0 +1,462 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "readback_queue.hh"
+#include "render_target.hh"
+#include "framebuffer.hh"
+#include "texture.hh"
+#include "helpers.hh"
+#include "context.hh"
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+using namespace lt;
+
+unsigned format_channel_count(GLenum format)
+{
+    switch(format)
+    {
+    case GL_RED:
+    case GL_RED_INTEGER:
+    case GL_DEPTH_COMPONENT:
+    case GL_STENCIL_INDEX:
+        return 1;
+    case GL_RG:
+    case GL_RG_INTEGER:
+        return 2;
+    case GL_RGB:
+    case GL_RGB_INTEGER:
+        return 3;
+    case GL_RGBA:
+    case GL_RGBA_INTEGER:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+// Packed types like GL_UNSIGNED_INT_24_8 are not supported.
+bool is_plain_type(GLenum type)
+{
+    switch(type)
+    {
+    case GL_UNSIGNED_BYTE:
+    case GL_BYTE:
+    case GL_UNSIGNED_SHORT:
+    case GL_SHORT:
+    case GL_UNSIGNED_INT:
+    case GL_INT:
+    case GL_HALF_FLOAT:
+    case GL_FLOAT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool is_convertible(GLenum format, GLenum type)
+{
+    if(
+        format != GL_RED && format != GL_RG && format != GL_RGB &&
+        format != GL_RGBA && format != GL_DEPTH_COMPONENT
+    ) return false;
+
+    return type == GL_UNSIGNED_BYTE || type == GL_UNSIGNED_SHORT ||
+        type == GL_HALF_FLOAT || type == GL_FLOAT;
+}
+
+float read_component(const uint8_t* src, GLenum type)
+{
+    switch(type)
+    {
+    case GL_UNSIGNED_BYTE:
+        return *src / 255.0f;
+    case GL_UNSIGNED_SHORT:
+        {
+            uint16_t value;
+            memcpy(&value, src, sizeof(value));
+            return value / 65535.0f;
+        }
+    case GL_HALF_FLOAT:
+        {
+            uint16_t value;
+            memcpy(&value, src, sizeof(value));
+            return unpackHalf1x16(value);
+        }
+    default:
+    case GL_FLOAT:
+        {
+            float value;
+            memcpy(&value, src, sizeof(value));
+            return value;
+        }
+    }
+}
+
+// Missing components are filled like GL does, with zero color and full alpha.
+void convert(
+    const uint8_t* src,
+    size_t texels,
+    unsigned channels,
+    GLenum type,
+    readback_queue::conversion conv,
+    std::vector<uint8_t>& dst
+){
+    unsigned type_size = gl_type_sizeof(type);
+    if(conv == readback_queue::RGBA8)
+    {
+        dst.resize(texels * 4);
+        if(type == GL_UNSIGNED_BYTE && channels == 4)
+        {
+            memcpy(dst.data(), src, dst.size());
+            return;
+        }
+    }
+    else dst.resize(texels * 4 * sizeof(float));
+
+    for(size_t i = 0; i < texels; ++i)
+    {
+        vec4 color(0, 0, 0, 1);
+        for(unsigned c = 0; c < channels; ++c)
+            color[c] = read_component(src + c * type_size, type);
+        src += channels * type_size;
+
+        if(conv == readback_queue::RGBA8)
+        {
+            uint32_t packed = packUnorm4x8(color);
+            memcpy(dst.data() + i * 4, &packed, sizeof(packed));
+        }
+        else memcpy(dst.data() + i * sizeof(vec4), &color, sizeof(vec4));
+    }
+}
+
+}
+
+namespace lt
+{
+
+readback_queue::readback_queue(
+    context& ctx,
+    size_t slot_size,
+    unsigned slot_count,
+    unsigned thread_count
+):  glresource(ctx), buf(0), mapping(nullptr), slot_size(slot_size),
+    slots(std::max(slot_count, 1u), FREE), id_counter(0), converting(0),
+    quit(false)
+{
+    size_t size = this->slot_size * slots.size();
+    glGenBuffers(1, &buf);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buf);
+
+    // With a persistent mapping, the background threads can copy the data
+    // out of the slots themselves.
+    if(GLEW_ARB_buffer_storage)
+    {
+        GLbitfield flags =
+            GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_PIXEL_PACK_BUFFER, size, nullptr, flags);
+        mapping = (uint8_t*)glMapBufferRange(
+            GL_PIXEL_PACK_BUFFER, 0, size, flags
+        );
+    }
+    else glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if(glGetError() != GL_NO_ERROR)
+        throw std::runtime_error("Failed to create a readback queue");
+
+    thread_count = std::max(thread_count, 1u);
+    for(unsigned i = 0; i < thread_count; ++i)
+        workers.emplace_back(&readback_queue::worker, this);
+}
+
+readback_queue::~readback_queue()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        // Copies from the mapping must be over before it goes away.
+        done_cv.wait(lock, [&]{ return converting == 0; });
+        quit = true;
+    }
+    job_cv.notify_all();
+    for(std::thread& t: workers) t.join();
+
+    for(request& r: in_flight) glDeleteSync(r.fence);
+
+    if(mapping)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buf);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &buf);
+}
+
+uint64_t readback_queue::read(
+    render_target& target,
+    callback cb,
+    conversion conv,
+    GLenum attachment
+){
+    // The default framebuffer is assumed to be RGBA8.
+    GLenum format = GL_RGBA;
+    GLenum type = GL_UNSIGNED_BYTE;
+    if(framebuffer* fb = dynamic_cast<framebuffer*>(&target))
+    {
+        auto it = fb->get_target_specifications().find(attachment);
+        if(it == fb->get_target_specifications().end())
+            throw std::runtime_error("No such attachment to read back");
+
+        const framebuffer::target_specifier& spec = it->second;
+        GLint internal_format = spec.use_texture ?
+            spec.use_texture->get_internal_format() : spec.format;
+        format = internal_format_to_external_format(internal_format);
+        type = internal_format_compatible_type(internal_format);
+    }
+
+    glm::uvec3 dimensions(target.get_size(), 1);
+    unsigned slot = 0;
+    size_t offset = 0;
+    uint64_t id = begin(
+        format, type, dimensions, std::move(cb), conv, slot, offset
+    );
+    if(!id) return 0;
+
+    target.bind(GL_READ_FRAMEBUFFER);
+    if(target.get_fbo() == 0) glReadBuffer(GL_BACK);
+    else if(
+        attachment != GL_DEPTH_ATTACHMENT &&
+        attachment != GL_DEPTH_STENCIL_ATTACHMENT
+    ) glReadBuffer(attachment);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buf);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(
+        0, 0, dimensions.x, dimensions.y, format, type, (void*)offset
+    );
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    in_flight.back().fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    return id;
+}
+
+uint64_t readback_queue::read(
+    const texture& tex,
+    callback cb,
+    conversion conv,
+    unsigned level
+){
+    GLenum target = tex.get_target();
+    if(
+        target == GL_TEXTURE_CUBE_MAP ||
+        target == GL_TEXTURE_CUBE_MAP_ARRAY ||
+        target == GL_TEXTURE_2D_MULTISAMPLE ||
+        target == GL_TEXTURE_2D_MULTISAMPLE_ARRAY
+    ) throw std::runtime_error("Unsupported texture target for readback");
+
+    glm::uvec3 dimensions = tex.get_dimensions();
+    dimensions.x = std::max(dimensions.x >> level, 1u);
+    dimensions.y = std::max(dimensions.y >> level, 1u);
+    if(!gl_target_is_array(target))
+        dimensions.z = std::max(dimensions.z >> level, 1u);
+
+    GLenum format = tex.get_external_format();
+    GLenum type = tex.get_type();
+    unsigned slot = 0;
+    size_t offset = 0;
+    uint64_t id = begin(
+        format, type, dimensions, std::move(cb), conv, slot, offset
+    );
+    if(!id) return 0;
+
+    get_context().get_state().bind_texture(0, target, tex.get_texture());
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buf);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(target, level, format, type, (void*)offset);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    in_flight.back().fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    return id;
+}
+
+void readback_queue::poll(bool wait)
+{
+    for(auto it = in_flight.begin(); it != in_flight.end();)
+    {
+        request& r = *it;
+        GLenum status = glClientWaitSync(
+            r.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? GL_TIMEOUT_IGNORED : 0
+        );
+        if(status == GL_TIMEOUT_EXPIRED)
+        {
+            ++it;
+            continue;
+        }
+        if(status == GL_WAIT_FAILED)
+            throw std::runtime_error("Failed to wait for a readback");
+        glDeleteSync(r.fence);
+        r.fence = nullptr;
+
+        size_t offset = r.slot * slot_size;
+        if(mapping) r.src = mapping + offset;
+        else
+        {
+            // Copied out right away, so that the slot can be reused.
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, buf);
+            const uint8_t* data = (const uint8_t*)glMapBufferRange(
+                GL_PIXEL_PACK_BUFFER, offset, r.size, GL_MAP_READ_BIT
+            );
+            r.res.data.assign(data, data + r.size);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            r.src = nullptr;
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            slots[r.slot] = mapping ? COPYING : FREE;
+            jobs.push_back(std::move(r));
+        }
+        job_cv.notify_one();
+        it = in_flight.erase(it);
+    }
+
+    std::vector<request> done;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if(wait)
+        {
+            done_cv.wait(lock, [&]{
+                return jobs.empty() && converting == 0;
+            });
+        }
+        done.swap(finished);
+    }
+
+    for(request& r: done)
+    {
+        if(r.cb) r.cb(r.res);
+        else results[r.res.id] = std::move(r.res);
+    }
+}
+
+bool readback_queue::take(uint64_t id, result& res)
+{
+    auto it = results.find(id);
+    if(it == results.end()) return false;
+    res = std::move(it->second);
+    results.erase(it);
+    return true;
+}
+
+size_t readback_queue::get_pending_count() const
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return in_flight.size() + jobs.size() + converting + finished.size();
+}
+
+size_t readback_queue::get_slot_size() const
+{
+    return slot_size;
+}
+
+uint64_t readback_queue::begin(
+    GLenum format,
+    GLenum type,
+    glm::uvec3 dimensions,
+    callback cb,
+    conversion conv,
+    unsigned& slot,
+    size_t& offset
+){
+    unsigned channels = format_channel_count(format);
+    if(!channels || !is_plain_type(type))
+        throw std::runtime_error("Unsupported format for readback");
+    if(conv != NONE && !is_convertible(format, type))
+        throw std::runtime_error("Unsupported format for conversion");
+
+    size_t size = (size_t)dimensions.x * dimensions.y * dimensions.z *
+        channels * gl_type_sizeof(type);
+    if(size > slot_size)
+        throw std::runtime_error("Readback doesn't fit in a slot");
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto it = std::find(slots.begin(), slots.end(), FREE);
+        if(it == slots.end()) return 0;
+        *it = READING;
+        slot = it - slots.begin();
+    }
+    offset = slot * slot_size;
+
+    request& r = in_flight.emplace_back();
+    r.res.id = ++id_counter;
+    r.res.dimensions = dimensions;
+    r.res.format = format;
+    r.res.type = type;
+    r.cb = std::move(cb);
+    r.conv = conv;
+    r.slot = slot;
+    r.size = size;
+    r.fence = nullptr;
+    r.src = nullptr;
+    return r.res.id;
+}
+
+void readback_queue::worker()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for(;;)
+    {
+        job_cv.wait(lock, [&]{ return quit || !jobs.empty(); });
+        if(quit) return;
+
+        request r = std::move(jobs.front());
+        jobs.pop_front();
+        converting++;
+        lock.unlock();
+
+        const uint8_t* src = r.src ? r.src : r.res.data.data();
+        size_t texels = (size_t)r.res.dimensions.x * r.res.dimensions.y *
+            r.res.dimensions.z;
+        if(r.conv != NONE)
+        {
+            std::vector<uint8_t> converted;
+            convert(
+                src, texels, format_channel_count(r.res.format), r.res.type,
+                r.conv, converted
+            );
+            r.res.data = std::move(converted);
+            r.res.format = GL_RGBA;
+            r.res.type = r.conv == RGBA8 ? GL_UNSIGNED_BYTE : GL_FLOAT;
+        }
+        else if(r.src) r.res.data.assign(r.src, r.src + r.size);
+
+        lock.lock();
+        if(r.src) slots[r.slot] = FREE;
+        converting--;
+        finished.push_back(std::move(r));
+        done_cv.notify_all();
+    }
+}
+
+} // namespace lt
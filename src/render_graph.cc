@@ -0,0 +1,397 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "render_graph.hh"
+#include "framebuffer_pool.hh"
+#include "gpu_buffer.hh"
+#include "texture.hh"
+#include "profiler.hh"
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace
+{
+using namespace lt;
+
+GLbitfield access_barrier(render_graph::access how)
+{
+    switch(how)
+    {
+    case render_graph::FRAMEBUFFER:
+        return GL_FRAMEBUFFER_BARRIER_BIT;
+    case render_graph::TEXTURE:
+        return GL_TEXTURE_FETCH_BARRIER_BIT;
+    case render_graph::IMAGE:
+        return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+    case render_graph::STORAGE_BUFFER:
+        return GL_SHADER_STORAGE_BARRIER_BIT;
+    case render_graph::UNIFORM_BUFFER:
+        return GL_UNIFORM_BARRIER_BIT;
+    case render_graph::VERTEX_BUFFER:
+        return GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT |
+            GL_ELEMENT_ARRAY_BARRIER_BIT;
+    }
+    return GL_ALL_BARRIER_BITS;
+}
+
+}
+
+namespace lt
+{
+
+render_graph::pass_context::pass_context(const render_graph& graph)
+: graph(&graph)
+{}
+
+render_target* render_graph::pass_context::get_target(resource_id id) const
+{
+    const resource& res = graph->get_resource(id);
+    switch(res.type)
+    {
+    case TRANSIENT:
+        return res.fb;
+    case IMPORTED_TARGET:
+        return static_cast<render_target*>(res.external);
+    default:
+        return nullptr;
+    }
+}
+
+framebuffer* render_graph::pass_context::get_framebuffer(resource_id id) const
+{
+    return dynamic_cast<framebuffer*>(get_target(id));
+}
+
+texture* render_graph::pass_context::get_texture(
+    resource_id id,
+    GLenum attachment
+) const {
+    const resource& res = graph->get_resource(id);
+    if(res.type == IMPORTED_TEXTURE)
+        return static_cast<texture*>(res.external);
+
+    framebuffer* fb = get_framebuffer(id);
+    return fb ? fb->get_texture_target(attachment) : nullptr;
+}
+
+gpu_buffer* render_graph::pass_context::get_buffer(resource_id id) const
+{
+    const resource& res = graph->get_resource(id);
+    if(res.type != IMPORTED_BUFFER) return nullptr;
+    return static_cast<gpu_buffer*>(res.external);
+}
+
+render_graph::pass::pass(
+    render_graph& graph,
+    const std::string& name,
+    execute_callback cb
+):  graph(&graph), name(name), callback(std::move(cb)), is_compute(false),
+    has_side_effects(false), active(false)
+{}
+
+render_graph::pass& render_graph::pass::read(resource_id id, access how)
+{
+    graph->get_resource(id);
+    reads.push_back({id, how, false});
+    return *this;
+}
+
+render_graph::pass& render_graph::pass::read_optional(
+    resource_id id,
+    access how
+){
+    graph->get_resource(id);
+    reads.push_back({id, how, true});
+    return *this;
+}
+
+render_graph::pass& render_graph::pass::write(resource_id id, access how)
+{
+    graph->get_resource(id);
+    writes.push_back({id, how, false});
+    return *this;
+}
+
+render_graph::pass& render_graph::pass::compute()
+{
+    is_compute = true;
+    return *this;
+}
+
+render_graph::pass& render_graph::pass::side_effects()
+{
+    has_side_effects = true;
+    return *this;
+}
+
+render_graph::pass& render_graph::pass::enable_if(
+    std::function<bool()> condition
+){
+    this->condition = std::move(condition);
+    return *this;
+}
+
+const std::string& render_graph::pass::get_name() const
+{
+    return name;
+}
+
+bool render_graph::pass::is_active() const
+{
+    return active;
+}
+
+render_graph::render_graph(framebuffer_pool& pool)
+: pool(&pool), transient_count(0)
+{}
+
+render_graph::~render_graph()
+{
+    release_all();
+}
+
+render_graph::resource_id render_graph::create_framebuffer(
+    glm::uvec2 size,
+    const framebuffer::target_specification_map& target_specifications,
+    unsigned samples
+){
+    resource_id id = add_resource(TRANSIENT, nullptr, false);
+    resource& res = resources[id];
+    res.size = size;
+    res.target_specifications = target_specifications;
+    res.samples = samples;
+    return id;
+}
+
+render_graph::resource_id render_graph::import(
+    render_target& target,
+    bool output
+){
+    return add_resource(IMPORTED_TARGET, &target, output);
+}
+
+render_graph::resource_id render_graph::import(texture& tex, bool output)
+{
+    return add_resource(IMPORTED_TEXTURE, &tex, output);
+}
+
+render_graph::resource_id render_graph::import(gpu_buffer& buf, bool output)
+{
+    return add_resource(IMPORTED_BUFFER, &buf, output);
+}
+
+void render_graph::set_output(resource_id id, bool output)
+{
+    if(get_resource(id).type == TRANSIENT)
+        throw std::runtime_error(
+            "Transient framebuffers can't be outputs of a render graph"
+        );
+    resources[id].output = output;
+}
+
+render_graph::pass& render_graph::add_pass(
+    const std::string& name,
+    execute_callback cb
+){
+    passes.emplace_back(new pass(*this, name, std::move(cb)));
+    return *passes.back();
+}
+
+render_graph::pass& render_graph::add_method(pipeline_method& method)
+{
+    return add_pass(
+        method.get_name(),
+        [&method](const pass_context&){ method.execute(); }
+    );
+}
+
+render_graph::pass& render_graph::add_method(
+    target_method& method,
+    resource_id target,
+    execute_callback bind_inputs
+){
+    return add_pass(
+        method.get_name(),
+        [&method, target, bind_inputs](const pass_context& ctx){
+            if(bind_inputs) bind_inputs(ctx);
+
+            // Transient targets go back to the pool after the graph has run,
+            // so the method must not keep pointing at them.
+            render_target& prev = method.get_target();
+            render_target* rt = ctx.get_target(target);
+            if(rt) method.set_target(*rt);
+            method.execute();
+            method.set_target(prev);
+        }
+    ).write(target);
+}
+
+void render_graph::execute()
+{
+    cull();
+
+    // Lifetimes of transient framebuffers as the first and last active pass
+    // using them. A transient is only created by an active writer, so reads
+    // of unwritten transients give null.
+    std::vector<int> first(resources.size(), -1);
+    std::vector<int> last(resources.size(), -1);
+    for(unsigned i = 0; i < passes.size(); ++i)
+    {
+        const pass& p = *passes[i];
+        if(!p.active) continue;
+
+        for(const pass::use& w: p.writes)
+        {
+            if(resources[w.id].type != TRANSIENT) continue;
+            if(first[w.id] < 0) first[w.id] = i;
+            last[w.id] = i;
+        }
+
+        for(const pass::use& r: p.reads)
+        {
+            if(first[r.id] >= 0) last[r.id] = i;
+        }
+    }
+
+    transient_count = 0;
+    pass_context ctx(*this);
+    try
+    {
+        for(unsigned i = 0; i < passes.size(); ++i)
+        {
+            pass& p = *passes[i];
+            if(!p.active) continue;
+
+            for(resource_id id = 0; id < resources.size(); ++id)
+            {
+                if(first[id] != (int)i) continue;
+                resource& res = resources[id];
+                res.fb = pool->take(
+                    res.size, res.target_specifications, res.samples
+                );
+                transient_count++;
+            }
+
+            GLbitfield barriers = 0;
+            for(const auto* uses: {&p.reads, &p.writes})
+            {
+                for(const pass::use& u: *uses)
+                {
+                    resource& res = resources[u.id];
+                    GLbitfield bit = access_barrier(u.how);
+                    if((res.synced & bit) == bit) continue;
+                    barriers |= bit;
+                    res.synced |= bit;
+                }
+            }
+            if(barriers) glMemoryBarrier(barriers);
+
+            {
+                profiler::scope timing(p.name.c_str());
+                p.callback(ctx);
+            }
+
+            if(p.is_compute)
+            {
+                for(const pass::use& w: p.writes) resources[w.id].synced = 0;
+            }
+
+            for(resource_id id = 0; id < resources.size(); ++id)
+            {
+                if(last[id] != (int)i || !resources[id].fb) continue;
+                pool->give(resources[id].fb);
+                resources[id].fb = nullptr;
+            }
+        }
+    }
+    catch(...)
+    {
+        release_all();
+        throw;
+    }
+}
+
+unsigned render_graph::get_active_pass_count() const
+{
+    unsigned count = 0;
+    for(const auto& p: passes) if(p->active) count++;
+    return count;
+}
+
+unsigned render_graph::get_transient_framebuffer_count() const
+{
+    return transient_count;
+}
+
+render_graph::resource_id render_graph::add_resource(
+    resource_type type,
+    void* external,
+    bool output
+){
+    resources.push_back({
+        type, output, glm::uvec2(0), {}, 0, external, nullptr,
+        GL_ALL_BARRIER_BITS
+    });
+    return resources.size() - 1;
+}
+
+const render_graph::resource& render_graph::get_resource(resource_id id) const
+{
+    if(id >= resources.size())
+        throw std::runtime_error(
+            "Unknown render graph resource " + std::to_string(id)
+        );
+    return resources[id];
+}
+
+void render_graph::cull()
+{
+    // Walk backwards from the outputs, a pass is needed if a later needed
+    // pass reads something it writes.
+    std::vector<bool> needed(resources.size(), false);
+    for(resource_id id = 0; id < resources.size(); ++id)
+        needed[id] = resources[id].output;
+
+    for(auto it = passes.rbegin(); it != passes.rend(); ++it)
+    {
+        pass& p = **it;
+        p.active = p.has_side_effects;
+        for(const pass::use& w: p.writes)
+            if(needed[w.id]) p.active = true;
+
+        // Only ask the condition of passes that would run otherwise.
+        if(p.active && p.condition) p.active = p.condition();
+        if(!p.active) continue;
+
+        for(const pass::use& r: p.reads)
+            if(!r.optional) needed[r.id] = true;
+    }
+}
+
+void render_graph::release_all()
+{
+    for(resource& res: resources)
+    {
+        if(!res.fb) continue;
+        pool->give(res.fb);
+        res.fb = nullptr;
+    }
+}
+
+} // namespace lt
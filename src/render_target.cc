@@ -17,14 +17,12 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "render_target.hh"
+#include "context.hh"
 #include <stdexcept>
 
 namespace lt
 {
 
-GLint render_target::current_read_fbo = -1;
-GLint render_target::current_write_fbo = -1;
-
 render_target::render_target(context& ctx, GLenum target, glm::uvec3 dimensions)
 : glresource(ctx), fbo(0), target(target), dimensions(dimensions) {}
 
@@ -32,49 +30,19 @@ render_target::~render_target() {}
 
 void render_target::bind(GLenum target)
 {
-    switch(target)
-    {
-    case GL_FRAMEBUFFER:
-        if(fbo != (GLuint)current_read_fbo || fbo != (GLuint)current_write_fbo)
-        {
-            glBindFramebuffer(target, fbo);
-            current_read_fbo = fbo;
-            current_write_fbo = fbo;
-        }
-        break;
-    case GL_READ_FRAMEBUFFER:
-        if(fbo != (GLuint)current_read_fbo)
-        {
-            glBindFramebuffer(target, fbo);
-            current_read_fbo = fbo;
-        }
-        break;
-    case GL_DRAW_FRAMEBUFFER:
-        if(fbo != (GLuint)current_write_fbo)
-        {
-            glBindFramebuffer(target, fbo);
-            current_write_fbo = fbo;
-        }
-        break;
-    default:
-        throw std::runtime_error("Unknown render_target bind target");
-    }
-    glViewport(0, 0, dimensions.x, dimensions.y);
+    gl_state& state = get_context().get_state();
+    state.bind_framebuffer(target, fbo);
+    state.viewport(glm::ivec2(0), glm::uvec2(dimensions));
 }
 
 void render_target::unbind()
 {
-    if(fbo == (GLuint)current_read_fbo)
-    {
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-        current_read_fbo = -1;
-    }
+    gl_state& state = get_context().get_state();
+    if(state.get_framebuffer(GL_READ_FRAMEBUFFER) == (GLint)fbo)
+        state.bind_framebuffer(GL_READ_FRAMEBUFFER, 0);
 
-    if(fbo == (GLuint)current_write_fbo)
-    {
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-        current_write_fbo = -1;
-    }
+    if(state.get_framebuffer(GL_DRAW_FRAMEBUFFER) == (GLint)fbo)
+        state.bind_framebuffer(GL_DRAW_FRAMEBUFFER, 0);
 }
 
 bool render_target::is_bound(GLenum target) const
@@ -82,12 +50,12 @@ bool render_target::is_bound(GLenum target) const
     switch(target)
     {
     case GL_FRAMEBUFFER:
-        return fbo == (GLuint)current_read_fbo &&
-               fbo == (GLuint)current_write_fbo;
+        return (GLint)fbo == get_current_read_fbo() &&
+               (GLint)fbo == get_current_write_fbo();
     case GL_READ_FRAMEBUFFER:
-        return fbo == (GLuint)current_read_fbo;
+        return (GLint)fbo == get_current_read_fbo();
     case GL_DRAW_FRAMEBUFFER:
-        return fbo == (GLuint)current_write_fbo;
+        return (GLint)fbo == get_current_write_fbo();
     default:
         throw std::runtime_error("Unknown render_target unbind target");
     }
@@ -119,18 +87,20 @@ GLuint render_target::get_fbo() const
     return fbo;
 }
 
-GLint render_target::get_current_read_fbo()
+GLint render_target::get_current_read_fbo() const
 {
-    return current_read_fbo;
+    return get_context().get_state().get_framebuffer(GL_READ_FRAMEBUFFER);
 }
 
-GLint render_target::get_current_write_fbo()
+GLint render_target::get_current_write_fbo() const
 {
-    return current_write_fbo;
+    return get_context().get_state().get_framebuffer(GL_DRAW_FRAMEBUFFER);
 }
 
-void render_target::reinstate_current_fbo()
+void render_target::reinstate_current_fbo() const
 {
+    GLint current_read_fbo = get_current_read_fbo();
+    GLint current_write_fbo = get_current_write_fbo();
     if(current_read_fbo != -1)
         glBindFramebuffer(GL_READ_FRAMEBUFFER, current_read_fbo);
 
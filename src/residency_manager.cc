@@ -0,0 +1,733 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "residency_manager.hh"
+#include "texture.hh"
+#include "gpu_buffer.hh"
+#include "primitive.hh"
+#include "context.hh"
+#include "math.hh"
+#include "helpers.hh"
+#include "stb_image.h"
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+using namespace lt;
+
+const size_t MIN_UPLOAD_LIMIT = 1 << 20;
+
+// Decodes the image and generates its mipmaps in prepare(). The texture
+// storage is allocated when loaded, and levels are staged and uploaded
+// smallest first, with the base level following them.
+class streamed_texture: public texture, public streamable
+{
+public:
+    streamed_texture(context& ctx, const std::string& path, bool srgb)
+    :   texture(ctx), path(path), hdr(stbi_is_hdr(path.c_str())),
+        next_level(0), next_row(0)
+    {
+        int w = 0, h = 0, n = 0;
+        if(!stbi_info(path.c_str(), &w, &h, &n))
+            throw std::runtime_error("Unable to read " + path);
+
+        int max_size = (int)ctx[GL_MAX_TEXTURE_SIZE];
+        if(w > max_size || h > max_size)
+            throw std::runtime_error("Texture " + path + " is too large");
+
+        channels = n;
+        this->target = GL_TEXTURE_2D;
+        this->type = hdr ? GL_FLOAT : GL_UNSIGNED_BYTE;
+        this->internal_format = image_internal_format(n, hdr, srgb);
+        this->dimensions = uvec3(w, h, 1);
+        level_count = calculate_mipmap_count(uvec2(w, h));
+    }
+
+    ~streamed_texture()
+    {
+        if(residency_manager* m = get_residency_manager()) m->remove(this);
+    }
+
+    void prepare() const override
+    {
+        int w = 0, h = 0, n = 0;
+        void* data = hdr ?
+            (void*)stbi_loadf(path.c_str(), &w, &h, &n, channels) :
+            (void*)stbi_load(path.c_str(), &w, &h, &n, channels);
+        if(!data) throw std::runtime_error("Unable to read " + path);
+        if(uvec2(w, h) != uvec2(dimensions))
+        {
+            stbi_image_free(data);
+            throw std::runtime_error(path + " changed while streaming");
+        }
+
+        size_t texel_size = channels * (hdr ? sizeof(float) : 1);
+        std::vector<std::vector<uint8_t>> new_levels(level_count);
+        new_levels[0].assign(
+            (uint8_t*)data, (uint8_t*)data + w * h * texel_size
+        );
+        stbi_image_free(data);
+        // Matches the orientation of regular 2D textures.
+        flip_image_rows(new_levels[0].data(), w * texel_size, h);
+
+        if(hdr) generate_mipmap_levels<float>(new_levels, w, h, channels);
+        else generate_mipmap_levels<uint8_t>(new_levels, w, h, channels);
+        levels = std::move(new_levels);
+    }
+
+    size_t upload(staging_ring& staging, bool& done) const override
+    {
+        gl_state& state = get_context().get_state();
+        GLint prev_tex = state.get_texture(0, GL_TEXTURE_2D);
+        state.bind_texture(0, GL_TEXTURE_2D, tex);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        staging.bind();
+
+        // Levels are split into bands of rows that fit in the ring.
+        size_t bytes = 0;
+        while(next_level > 0)
+        {
+            unsigned level = next_level - 1;
+            uvec2 size = max(uvec2(dimensions) >> level, uvec2(1));
+            size_t row_size = levels[level].size() / size.y;
+            unsigned rows = std::min(
+                size.y - next_row,
+                (unsigned)(staging.get_available() / row_size)
+            );
+            size_t offset = 0;
+            if(
+                rows == 0 || !staging.stage(
+                    levels[level].data() + next_row * row_size,
+                    rows * row_size, offset
+                )
+            ) break;
+
+            upload_rows(level, next_row, rows, (const void*)offset);
+            bytes += rows * row_size;
+            next_row += rows;
+            if(next_row == size.y) finish_level(level);
+        }
+
+        staging.unbind();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        if(prev_tex > 0) state.bind_texture(0, GL_TEXTURE_2D, prev_tex);
+
+        done = next_level == 0;
+        if(done) levels.clear();
+        return bytes;
+    }
+
+    size_t get_memory_usage() const override
+    {
+        size_t texel_size = channels * (hdr ? 2 : 1);
+        size_t bytes = 0;
+        for(unsigned level = 0; level < level_count; ++level)
+        {
+            uvec2 size = max(uvec2(dimensions) >> level, uvec2(1));
+            bytes += size.x * size.y * texel_size;
+        }
+        return bytes;
+    }
+
+protected:
+    void load_impl() const override
+    {
+        glGenTextures(1, &tex);
+        gl_state& state = get_context().get_state();
+        GLint prev_tex = state.get_texture(0, GL_TEXTURE_2D);
+        state.bind_texture(0, GL_TEXTURE_2D, tex);
+
+        glTexStorage2D(
+            GL_TEXTURE_2D, level_count, internal_format,
+            dimensions.x, dimensions.y
+        );
+
+        // Grey placeholder in the smallest level until it is uploaded.
+        float grey[4] = {0.5f, 0.5f, 0.5f, 1.0f};
+        glTexSubImage2D(
+            GL_TEXTURE_2D, level_count - 1, 0, 0, 1, 1,
+            internal_format_to_external_format(internal_format), GL_FLOAT,
+            grey
+        );
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level_count-1);
+        if(prev_tex > 0) state.bind_texture(0, GL_TEXTURE_2D, prev_tex);
+        next_level = level_count;
+        next_row = 0;
+
+        if(glGetError() != GL_NO_ERROR)
+            throw std::runtime_error("Failed to create texture " + path);
+
+        if(residency_manager* m = get_residency_manager())
+        {
+            m->request(this);
+            return;
+        }
+
+        // Without a manager, everything is uploaded right away.
+        prepare();
+        state.bind_texture(0, GL_TEXTURE_2D, tex);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        while(next_level > 0)
+        {
+            unsigned level = next_level - 1;
+            uvec2 size = max(uvec2(dimensions) >> level, uvec2(1));
+            upload_rows(level, 0, size.y, levels[level].data());
+            finish_level(level);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        if(prev_tex > 0) state.bind_texture(0, GL_TEXTURE_2D, prev_tex);
+        levels.clear();
+    }
+
+    void unload_impl() const override
+    {
+        if(residency_manager* m = get_residency_manager()) m->cancel(this);
+        levels.clear();
+        basic_unload();
+    }
+
+private:
+    // Expects the texture to be bound.
+    void upload_rows(
+        unsigned level,
+        unsigned first_row,
+        unsigned rows,
+        const void* pixels
+    ) const
+    {
+        uvec2 size = max(uvec2(dimensions) >> level, uvec2(1));
+        glTexSubImage2D(
+            GL_TEXTURE_2D, level, 0, first_row, size.x, rows,
+            internal_format_to_external_format(internal_format), type,
+            pixels
+        );
+    }
+
+    // Expects the texture to be bound.
+    void finish_level(unsigned level) const
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+        std::vector<uint8_t>().swap(levels[level]);
+        next_level = level;
+        next_row = 0;
+    }
+
+    std::string path;
+    bool hdr;
+    unsigned channels;
+    unsigned level_count;
+    mutable std::vector<std::vector<uint8_t>> levels;
+    // Levels from next_level onwards have been uploaded, along with the
+    // rows before next_row of the level before that.
+    mutable unsigned next_level;
+    mutable unsigned next_row;
+};
+
+// Reads the data in prepare() and uploads it all in load_impl(), waiting
+// for prepare() if needed.
+class streamed_gpu_buffer: public gpu_buffer, public streamable
+{
+public:
+    streamed_gpu_buffer(
+        context& ctx,
+        GLenum target,
+        size_t size,
+        std::function<void(uint8_t* data)> read
+    ): gpu_buffer(ctx), reader(std::move(read)), unreported(0)
+    {
+        this->target = target;
+        this->size = size;
+    }
+
+    ~streamed_gpu_buffer()
+    {
+        if(residency_manager* m = get_residency_manager()) m->remove(this);
+    }
+
+    void prepare() const override
+    {
+        std::vector<uint8_t> new_data(size);
+        reader(new_data.data());
+        data = std::move(new_data);
+    }
+
+    // The data was already uploaded by load_impl(), this only reports it.
+    size_t upload(staging_ring&, bool& done) const override
+    {
+        done = true;
+        return std::exchange(unreported, 0);
+    }
+
+    size_t get_memory_usage() const override
+    {
+        return size;
+    }
+
+protected:
+    void load_impl() const override
+    {
+        if(residency_manager* m = get_residency_manager()) m->finish(this);
+        else prepare();
+
+        basic_load(target, size, data.data(), GL_STATIC_DRAW);
+        std::vector<uint8_t>().swap(data);
+        unreported = size;
+    }
+
+    void unload_impl() const override
+    {
+        if(residency_manager* m = get_residency_manager()) m->cancel(this);
+        data.clear();
+        basic_unload();
+    }
+
+private:
+    std::function<void(uint8_t* data)> reader;
+    mutable std::vector<uint8_t> data;
+    mutable size_t unreported;
+};
+
+}
+
+namespace lt
+{
+
+streamable::~streamable() {}
+
+residency_manager::residency_manager(
+    context& ctx,
+    size_t budget,
+    unsigned thread_count
+):  glresource(ctx), budget(budget), usage(0), upload_limit(4 << 20),
+    frame(0), quit(false)
+{
+    thread_count = std::max(thread_count, 1u);
+    for(unsigned i = 0; i < thread_count; ++i)
+        workers.emplace_back(&residency_manager::worker, this);
+}
+
+residency_manager::~residency_manager()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        quit = true;
+    }
+    job_cv.notify_all();
+    for(std::thread& t: workers) t.join();
+
+    for(auto& pair: entries) pair.first->residency = nullptr;
+}
+
+texture* residency_manager::create_texture(
+    const std::string& path,
+    bool srgb
+){
+    texture* tex = new streamed_texture(get_context(), path, srgb);
+    add(tex);
+    return tex;
+}
+
+gpu_buffer* residency_manager::create_gpu_buffer(
+    GLenum target,
+    size_t size,
+    std::function<void(uint8_t* data)> read
+){
+    gpu_buffer* buf = new streamed_gpu_buffer(
+        get_context(), target, size, std::move(read)
+    );
+    add(buf);
+    return buf;
+}
+
+void residency_manager::add(
+    const resource* res,
+    size_t size,
+    const std::vector<const resource*>& dependencies
+){
+    if(res->residency && res->residency != this)
+        throw std::runtime_error(
+            "Resource is already managed by another residency_manager"
+        );
+
+    std::unique_lock<std::mutex> lock(mutex);
+    auto [it, inserted] = entries.try_emplace(res);
+    entry& e = it->second;
+    e.stream = dynamic_cast<const streamable*>(res);
+    e.size = size;
+    e.dependencies = dependencies;
+    if(inserted) e.state = res->is_loaded() ? RESIDENT : IDLE;
+
+    res->residency = this;
+    res->last_use = frame;
+}
+
+void residency_manager::add(const primitive* prim)
+{
+    std::vector<const resource*> dependencies;
+    if(prim->get_index().is_valid())
+        dependencies.push_back(prim->get_index().get_buffer());
+
+    for(const auto& pair: prim->get_attributes())
+    {
+        const gpu_buffer* buf = pair.second.get_buffer();
+        if(std::find(
+            dependencies.begin(), dependencies.end(), buf
+        ) == dependencies.end()) dependencies.push_back(buf);
+    }
+
+    add(static_cast<const resource*>(prim), 0, dependencies);
+}
+
+void residency_manager::remove(const resource* res)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = entries.find(res);
+    if(it == entries.end()) return;
+
+    cancel_locked(lock, res, it->second);
+    entries.erase(res);
+    res->residency = nullptr;
+}
+
+bool residency_manager::contains(const resource* res) const
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return entries.count(res);
+}
+
+void residency_manager::request(const resource* res)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    request_locked(res);
+}
+
+void residency_manager::finish(const resource* res)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = entries.find(res);
+    if(it == entries.end() || !it->second.stream) return;
+
+    entry& e = it->second;
+    done_cv.wait(lock, [&]{ return e.state != PREPARING; });
+
+    if(e.state == IDLE || e.state == QUEUED)
+    {
+        if(e.state == QUEUED)
+            jobs.erase(std::find(jobs.begin(), jobs.end(), res));
+
+        e.state = PREPARING;
+        lock.unlock();
+        try
+        {
+            e.stream->prepare();
+        }
+        catch(...)
+        {
+            lock.lock();
+            e.state = IDLE;
+            done_cv.notify_all();
+            throw;
+        }
+        lock.lock();
+        done_cv.notify_all();
+    }
+    else if(e.error)
+    {
+        std::exception_ptr error = e.error;
+        cancel_locked(lock, res, e);
+        std::rethrow_exception(error);
+    }
+
+    pending.erase(
+        std::remove(pending.begin(), pending.end(), res), pending.end()
+    );
+    finished.erase(
+        std::remove(finished.begin(), finished.end(), res), finished.end()
+    );
+    e.state = RESIDENT;
+}
+
+void residency_manager::cancel(const resource* res)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = entries.find(res);
+    if(it != entries.end()) cancel_locked(lock, res, it->second);
+}
+
+void residency_manager::update()
+{
+    std::exception_ptr error;
+    std::unique_lock<std::mutex> lock(mutex);
+
+    for(const resource* res: finished)
+    {
+        entry& e = entries.at(res);
+        if(e.error)
+        {
+            if(!error) error = e.error;
+            e.error = nullptr;
+            e.state = IDLE;
+        }
+        else pending.push_back(res);
+    }
+    finished.clear();
+
+    if(!staging || staging->get_segment_size() != upload_limit)
+        staging.reset(new staging_ring(get_context(), upload_limit));
+
+    // Loading may finish other pending resources, so the queue can shrink
+    // during this loop.
+    size_t uploaded = 0;
+    for(
+        size_t n = pending.size();
+        n > 0 && pending.size() && uploaded < upload_limit;
+        --n
+    ){
+        const resource* res = pending.front();
+        pending.pop_front();
+        entry& e = entries.at(res);
+
+        bool ready = true;
+        for(const resource* dep: e.dependencies)
+        {
+            if(!is_ready(dep))
+            {
+                ready = false;
+                request_locked(dep);
+            }
+        }
+        if(!ready)
+        {
+            pending.push_back(res);
+            continue;
+        }
+
+        lock.unlock();
+        bool done = true;
+        try
+        {
+            if(!res->is_loaded())
+            {
+                res->load();
+                if(!e.stream) uploaded += e.size;
+            }
+            if(e.stream) uploaded += e.stream->upload(*staging, done);
+        }
+        catch(...)
+        {
+            lock.lock();
+            cancel_locked(lock, res, e);
+            throw;
+        }
+        lock.lock();
+
+        if(done) e.state = RESIDENT;
+        else
+        {
+            // The staging ring is full for this frame.
+            pending.push_front(res);
+            break;
+        }
+    }
+    staging->next_frame();
+
+    usage = 0;
+    for(auto& pair: entries)
+    {
+        if(pair.first->is_loaded())
+            usage += get_memory_usage(pair.second);
+        else if(pair.second.state == RESIDENT)
+            pair.second.state = IDLE;
+    }
+    lock.unlock();
+
+    evict();
+    frame++;
+
+    if(error) std::rethrow_exception(error);
+}
+
+uint64_t residency_manager::get_frame() const
+{
+    return frame;
+}
+
+void residency_manager::set_budget(size_t budget)
+{
+    this->budget = budget;
+}
+
+size_t residency_manager::get_budget() const
+{
+    return budget;
+}
+
+size_t residency_manager::get_usage() const
+{
+    return usage;
+}
+
+void residency_manager::set_upload_limit(size_t upload_limit)
+{
+    this->upload_limit = std::max(upload_limit, MIN_UPLOAD_LIMIT);
+}
+
+size_t residency_manager::get_upload_limit() const
+{
+    return upload_limit;
+}
+
+void residency_manager::worker()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for(;;)
+    {
+        job_cv.wait(lock, [&]{ return quit || !jobs.empty(); });
+        if(quit) return;
+
+        const resource* res = jobs.front();
+        jobs.pop_front();
+        // Entries aren't removed while they are being prepared, so this stays
+        // valid.
+        entry& e = entries.at(res);
+        e.state = PREPARING;
+        lock.unlock();
+
+        std::exception_ptr error;
+        try
+        {
+            e.stream->prepare();
+        }
+        catch(...)
+        {
+            error = std::current_exception();
+        }
+
+        lock.lock();
+        e.error = error;
+        e.state = PENDING;
+        finished.push_back(res);
+        done_cv.notify_all();
+    }
+}
+
+void residency_manager::request_locked(const resource* res)
+{
+    auto it = entries.find(res);
+    if(it == entries.end()) return;
+
+    entry& e = it->second;
+    if(e.state != IDLE) return;
+
+    if(!e.stream && res->is_loaded())
+    {
+        e.state = RESIDENT;
+        return;
+    }
+
+    if(e.stream)
+    {
+        e.state = QUEUED;
+        jobs.push_back(res);
+        job_cv.notify_one();
+    }
+    else
+    {
+        e.state = PENDING;
+        pending.push_back(res);
+    }
+
+    for(const resource* dep: e.dependencies) request_locked(dep);
+}
+
+void residency_manager::cancel_locked(
+    std::unique_lock<std::mutex>& lock,
+    const resource* res,
+    entry& e
+){
+    done_cv.wait(lock, [&]{ return e.state != PREPARING; });
+
+    if(e.state == QUEUED)
+        jobs.erase(std::find(jobs.begin(), jobs.end(), res));
+    pending.erase(
+        std::remove(pending.begin(), pending.end(), res), pending.end()
+    );
+    finished.erase(
+        std::remove(finished.begin(), finished.end(), res), finished.end()
+    );
+    e.state = IDLE;
+    e.error = nullptr;
+}
+
+bool residency_manager::is_ready(const resource* res) const
+{
+    auto it = entries.find(res);
+    if(it == entries.end()) return true;
+    entry_state state = it->second.state;
+    return res->is_loaded() && (state == RESIDENT || state == IDLE);
+}
+
+size_t residency_manager::get_memory_usage(const entry& e) const
+{
+    return e.stream ? e.stream->get_memory_usage() : e.size;
+}
+
+void residency_manager::evict()
+{
+    if(usage <= budget) return;
+
+    std::vector<const resource*> candidates;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for(const auto& pair: entries)
+        {
+            const resource* res = pair.first;
+            if(
+                res->is_loaded() && res->last_use < frame &&
+                pair.second.state != PREPARING
+            ) candidates.push_back(res);
+        }
+    }
+
+    std::sort(
+        candidates.begin(), candidates.end(),
+        [](const resource* a, const resource* b){
+            return a->last_use < b->last_use;
+        }
+    );
+
+    // Unloading may be deferred for linked resources, those don't count.
+    for(const resource* res: candidates)
+    {
+        if(!res->is_loaded()) continue;
+
+        size_t size = get_memory_usage(entries.at(res));
+        res->unload();
+        if(!res->is_loaded())
+        {
+            usage -= std::min(size, usage);
+            cancel(res);
+        }
+        if(usage <= budget) break;
+    }
+}
+
+} // namespace lt
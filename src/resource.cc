@@ -17,15 +17,24 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "resource.hh"
+#include "residency_manager.hh"
 
 namespace lt
 {
 
-resource::resource(): loaded(false), do_unload(false), references(0) {}
-resource::~resource() {}
+resource::resource()
+:   loaded(false), do_unload(false), references(0), residency(nullptr),
+    last_use(0)
+{}
+
+resource::~resource()
+{
+    if(residency) residency->remove(this);
+}
 
 void resource::load() const
 {
+    if(residency) last_use = residency->get_frame();
     if(!loaded)
     {
         load_impl();
@@ -75,6 +84,16 @@ void resource::unlink() const
     }
 }
 
+residency_manager* resource::get_residency_manager() const
+{
+    return residency;
+}
+
+uint64_t resource::get_last_use() const
+{
+    return last_use;
+}
+
 glresource::glresource(context& ctx): ctx(&ctx) {}
 context& glresource::get_context() const { return *ctx; }
 
@@ -110,4 +110,29 @@ void resource_pool::unload_all()
     primitive_pool::unload_all();
 }
 
+resource_pool::memory_usage resource_pool::get_memory_usage() const
+{
+    memory_usage usage = {};
+    for(
+        auto it = texture_pool::cbegin();
+        it != texture_pool::cend();
+        ++it
+    ){
+        usage.texture_count++;
+        usage.texture_cpu_bytes += it->second->get_cpu_memory_usage();
+        usage.texture_gpu_bytes += it->second->get_gpu_memory_usage();
+    }
+
+    for(
+        auto it = gpu_buffer_pool::cbegin();
+        it != gpu_buffer_pool::cend();
+        ++it
+    ){
+        usage.buffer_count++;
+        usage.buffer_cpu_bytes += it->second->get_cpu_memory_usage();
+        usage.buffer_gpu_bytes += it->second->get_gpu_memory_usage();
+    }
+    return usage;
+}
+
 } // namespace lt
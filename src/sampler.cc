@@ -83,6 +83,7 @@ sampler::sampler(
 
 sampler::~sampler()
 {
+    get_context().get_state().forget_sampler(sampler_object);
     glDeleteSamplers(1, &sampler_object);
 }
 
@@ -146,6 +147,11 @@ void sampler::set_lod_bias(GLint lod_bias)
     glSamplerParameteri(sampler_object, GL_TEXTURE_LOD_BIAS, lod_bias);
 }
 
+GLuint sampler::get_sampler() const
+{
+    return sampler_object;
+}
+
 GLint sampler::bind(const texture& tex, unsigned index) const
 {
     return bind(tex.get_texture(), index, tex.get_target());
@@ -153,9 +159,9 @@ GLint sampler::bind(const texture& tex, unsigned index) const
 
 GLint sampler::bind(GLuint tex, unsigned index, GLenum target) const
 {
-    glActiveTexture(GL_TEXTURE0 + index);
-    glBindTexture(target, tex);
-    glBindSampler(index, sampler_object);
+    gl_state& state = get_context().get_state();
+    state.bind_texture(index, target, tex);
+    state.bind_sampler(index, sampler_object);
     return index;
 }
 
@@ -18,6 +18,8 @@
 */
 #include "scene.hh"
 #include "sprite.hh"
+#include "camera.hh"
+#include "object.hh"
 #include "helpers.hh"
 #include "light.hh"
 #include "shadow_map.hh"
@@ -60,26 +62,37 @@ const std::vector<camera*>& camera_scene::get_cameras() const
     return cameras;
 }
 
+void camera_scene::update_transforms()
+{
+    for(camera* cam: cameras) cam->update_global_transform();
+}
+
+void camera_scene::update_impl(duration) { update_transforms(); }
 void camera_scene::clear_impl() { clear_cameras(); }
 
 object_scene::object_scene(std::vector<object*>&& objects)
-: objects(std::move(objects)) {}
+: objects(std::move(objects))
+{
+    for(object* obj: this->objects) bvh.insert(obj);
+}
 
 object_scene::~object_scene() {}
 
 void object_scene::add_object(object* obj)
 {
     sorted_insert(objects, obj);
+    bvh.insert(obj);
 }
 
 void object_scene::remove_object(object* obj)
 {
-    sorted_erase(objects, obj);
+    if(sorted_erase(objects, obj)) bvh.remove(obj);
 }
 
 void object_scene::clear_objects()
 {
     objects.clear();
+    bvh.clear();
 }
 
 size_t object_scene::object_count() const
@@ -90,6 +103,8 @@ size_t object_scene::object_count() const
 void object_scene::set_objects(const std::vector<object*>& objects)
 {
     this->objects = objects;
+    bvh.clear();
+    for(object* obj: objects) bvh.insert(obj);
 }
 
 const std::vector<object*>& object_scene::get_objects() const
@@ -97,9 +112,76 @@ const std::vector<object*>& object_scene::get_objects() const
     return objects;
 }
 
+void object_scene::update_bounds()
+{
+    bvh.refit();
+}
+
+const object_bvh& object_scene::get_bvh() const
+{
+    return bvh;
+}
+
+void object_scene::add_batch(geometry_batch* batch)
+{
+    sorted_insert(batches, batch);
+}
+
+void object_scene::remove_batch(geometry_batch* batch)
+{
+    sorted_erase(batches, batch);
+}
+
+void object_scene::clear_batches()
+{
+    batches.clear();
+}
+
+const std::vector<geometry_batch*>& object_scene::get_batches() const
+{
+    return batches;
+}
+
+void object_scene::add_instanced_object(instanced_object* obj)
+{
+    sorted_insert(instanced_objects, obj);
+}
+
+void object_scene::remove_instanced_object(instanced_object* obj)
+{
+    sorted_erase(instanced_objects, obj);
+}
+
+void object_scene::clear_instanced_objects()
+{
+    instanced_objects.clear();
+}
+
+const std::vector<instanced_object*>&
+object_scene::get_instanced_objects() const
+{
+    return instanced_objects;
+}
+
 void object_scene::add_impl(object* obj) { add_object(obj); }
+void object_scene::add_impl(geometry_batch* batch) { add_batch(batch); }
+void object_scene::add_impl(instanced_object* obj)
+{
+    add_instanced_object(obj);
+}
 void object_scene::remove_impl(object* obj) { remove_object(obj); }
-void object_scene::clear_impl() { clear_objects(); }
+void object_scene::remove_impl(geometry_batch* batch) { remove_batch(batch); }
+void object_scene::remove_impl(instanced_object* obj)
+{
+    remove_instanced_object(obj);
+}
+void object_scene::update_impl(duration) { update_bounds(); }
+void object_scene::clear_impl()
+{
+    clear_objects();
+    clear_batches();
+    clear_instanced_objects();
+}
 
 sprite_scene::sprite_scene(std::vector<sprite*>&& sprites)
 : sprites(std::move(sprites)) {}
@@ -267,6 +349,12 @@ std::vector<light*> light_scene::get_lights() const
     return lights;
 }
 
+void light_scene::update_transforms()
+{
+    for(point_light* pl: point_lights) pl->update_global_transform();
+    for(spotlight* sp: spotlights) sp->update_global_transform();
+}
+
 const std::vector<point_light*>& light_scene::get_point_lights() const
 {
     return point_lights;
@@ -289,6 +377,7 @@ void light_scene::add_impl(spotlight* sp) { add_light(sp); }
 void light_scene::remove_impl(spotlight* sp) { remove_light(sp); }
 void light_scene::add_impl(directional_light* dl) { add_light(dl); }
 void light_scene::remove_impl(directional_light* dl) { remove_light(dl); }
+void light_scene::update_impl(duration) { update_transforms(); }
 void light_scene::clear_impl() { clear_lights(); set_ambient(vec3(0)); }
 
 shadow_scene::shadow_scene() {}
@@ -26,7 +26,8 @@ namespace lt
 scene_graph::scene_graph() { }
 
 scene_graph::scene_graph(scene_graph&& other)
-: objects(std::move(other.objects))
+:   objects(std::move(other.objects)),
+    instanced_objects(std::move(other.instanced_objects))
 {
 }
 
@@ -81,6 +82,39 @@ void scene_graph::add_to_scene(object_scene* scene)
     }
 }
 
+void scene_graph::add_to_scene_instanced(
+    object_scene* scene,
+    context& ctx,
+    size_t min_instances
+){
+    std::unordered_map<
+        const model*,
+        std::vector<const transformable_node*>
+    > instances;
+    for(auto& pair: objects)
+    {
+        const model* mod = pair.second.get_model();
+        if(mod) instances[mod].push_back(&pair.second);
+    }
+
+    for(auto& pair: objects)
+    {
+        const model* mod = pair.second.get_model();
+        if(!mod || instances[mod].size() < min_instances)
+            scene->add_object(&pair.second);
+    }
+
+    for(auto& pair: instances)
+    {
+        if(pair.second.size() < min_instances) continue;
+
+        std::unique_ptr<instanced_object>& obj = instanced_objects[pair.first];
+        if(!obj) obj.reset(new instanced_object(ctx, pair.first));
+        obj->set_instances(pair.second);
+        scene->add_instanced_object(obj.get());
+    }
+}
+
 void scene_graph::merge(const scene_graph& other)
 {
     std::map<
@@ -106,5 +140,15 @@ void scene_graph::merge(const scene_graph& other)
     }
 }
 
+scene_graph::const_iterator scene_graph::begin() const
+{
+    return objects.begin();
+}
+
+scene_graph::const_iterator scene_graph::end() const
+{
+    return objects.end();
+}
+
 } // namespace lt
 
@@ -17,6 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "shader.hh"
+#include "context.hh"
 #include "helpers.hh"
 #include "gpu_buffer.hh"
 #include "texture.hh"
@@ -255,7 +256,7 @@ shader::source::source(const path& p)
 }
 
 
-GLuint shader::current_program = 0;
+unsigned shader::compile_count = 0;
 
 shader::shader(context& ctx): glresource(ctx), program(0) {}
 
@@ -289,6 +290,7 @@ shader::shader(shader&& other)
     other.load();
     program = other.program;
     uniforms = std::move(other.uniforms);
+    uniform_hashes = std::move(other.uniform_hashes);
     uniform_blocks = std::move(other.uniform_blocks);
     storage_blocks = std::move(other.storage_blocks);
     other.program = 0;
@@ -308,17 +310,17 @@ GLuint shader::get_program() const
 void shader::bind() const
 {
     load();
-    if(program != current_program)
-    {
-        glUseProgram(program);
-        current_program = program;
-    }
+    get_context().get_state().use_program(program);
+}
+
+void shader::unbind() const
+{
+    get_context().get_state().use_program(0);
 }
 
-void shader::unbind()
+unsigned shader::get_compile_count()
 {
-    glUseProgram(0);
-    current_program = 0;
+    return compile_count;
 }
 
 void shader::write_binary(const std::string& path) const
@@ -518,6 +520,7 @@ void shader::basic_load(
     if(program) return;
 
     program = glCreateProgram();
+    compile_count++;
 
     bool load_from_source = true;
 
@@ -653,6 +656,17 @@ void shader::populate_uniforms() const
         uniforms[shortened_name] = data;
     }
 
+    for(auto& pair: uniforms)
+    {
+        uniform_data*& entry =
+            uniform_hashes[hash_uniform_name(pair.first.c_str())];
+        if(entry)
+            throw std::runtime_error(
+                "Uniform name hash collision for " + pair.first
+            );
+        entry = &pair.second;
+    }
+
     // Read uniform blocks
     GLuint block_count = 0;
     glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, (GLint*)&block_count);
@@ -750,12 +764,13 @@ void shader::basic_unload() const
 {
     if(program != 0)
     {
-        if(program == current_program)
+        if((GLint)program == get_context().get_state().get_program())
         {
             unbind();
         }
 
         uniforms.clear();
+        uniform_hashes.clear();
         uniform_blocks.clear();
         storage_blocks.clear();
         glDeleteProgram(program);
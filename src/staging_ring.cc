@@ -0,0 +1,147 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "staging_ring.hh"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+
+// Keeps staged rows aligned for the fastest copy paths.
+const size_t STAGING_ALIGNMENT = 16;
+
+}
+
+namespace lt
+{
+
+staging_ring::staging_ring(
+    context& ctx,
+    size_t segment_size,
+    unsigned segment_count
+):  glresource(ctx), buf(0), mapping(nullptr),
+    segment_size(segment_size), segment_count(std::max(segment_count, 1u)),
+    segment(0), used(0), acquired(false)
+{
+    size_t size = this->segment_size * this->segment_count;
+    glGenBuffers(1, &buf);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buf);
+
+    if(GLEW_ARB_buffer_storage)
+    {
+        GLbitfield flags =
+            GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+        mapping = (uint8_t*)glMapBufferRange(
+            GL_PIXEL_UNPACK_BUFFER, 0, size, flags
+        );
+    }
+    else glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    fences.assign(this->segment_count, nullptr);
+
+    if(glGetError() != GL_NO_ERROR)
+        throw std::runtime_error("Failed to create a staging ring");
+}
+
+staging_ring::~staging_ring()
+{
+    for(GLsync fence: fences)
+        if(fence) glDeleteSync(fence);
+
+    // Storage in use by earlier uploads is kept alive by the driver.
+    if(mapping)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buf);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &buf);
+}
+
+bool staging_ring::stage(const void* data, size_t size, size_t& offset)
+{
+    if(!acquire() || size > segment_size - used) return false;
+
+    offset = segment * segment_size + used;
+    if(mapping) memcpy(mapping + offset, data, size);
+    else
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buf);
+        glBufferSubData(GL_PIXEL_UNPACK_BUFFER, offset, size, data);
+    }
+
+    used += (size + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT *
+        STAGING_ALIGNMENT;
+    used = std::min(used, segment_size);
+    return true;
+}
+
+size_t staging_ring::get_available()
+{
+    if(!acquire()) return 0;
+    return segment_size - used;
+}
+
+size_t staging_ring::get_segment_size() const
+{
+    return segment_size;
+}
+
+void staging_ring::bind() const
+{
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buf);
+}
+
+void staging_ring::unbind() const
+{
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void staging_ring::next_frame()
+{
+    if(used)
+    {
+        fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        segment = (segment + 1) % segment_count;
+    }
+    used = 0;
+    acquired = false;
+}
+
+bool staging_ring::acquire()
+{
+    if(acquired) return true;
+
+    GLsync& fence = fences[segment];
+    if(fence)
+    {
+        GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if(status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+            return false;
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+    acquired = true;
+    return true;
+}
+
+} // namespace lt
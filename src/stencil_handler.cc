@@ -17,7 +17,7 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "stencil_handler.hh"
-#include "glheaders.hh"
+#include "gl_state.hh"
 
 namespace lt
 {
@@ -43,32 +43,32 @@ void stencil_handler::set_stencil_ref(unsigned ref)
     this->ref = ref;
 }
 
-void stencil_handler::stencil_disable()
+void stencil_handler::stencil_disable(gl_state& state)
 {
-    glDisable(GL_STENCIL_TEST);
+    state.disable(GL_STENCIL_TEST);
 }
 
-void stencil_handler::stencil_draw()
+void stencil_handler::stencil_draw(gl_state& state)
 {
-    glEnable(GL_STENCIL_TEST);
-    glStencilFunc(GL_ALWAYS, ref, mask);
-    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-    glStencilMask(mask);
+    state.enable(GL_STENCIL_TEST);
+    state.stencil_func(GL_ALWAYS, ref, mask);
+    state.stencil_op(GL_KEEP, GL_KEEP, GL_REPLACE);
+    state.stencil_mask(mask);
 }
 
-void stencil_handler::stencil_cull()
+void stencil_handler::stencil_cull(gl_state& state)
 {
-    glEnable(GL_STENCIL_TEST);
-    glStencilFunc(func, ref, mask);
-    glStencilMask(0x00);
+    state.enable(GL_STENCIL_TEST);
+    state.stencil_func(func, ref, mask);
+    state.stencil_mask(0x00);
 }
 
-void stencil_handler::stencil_draw_cull()
+void stencil_handler::stencil_draw_cull(gl_state& state)
 {
-    glEnable(GL_STENCIL_TEST);
-    glStencilFunc(func, ref, mask);
-    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-    glStencilMask(mask);
+    state.enable(GL_STENCIL_TEST);
+    state.stencil_func(func, ref, mask);
+    state.stencil_op(GL_KEEP, GL_KEEP, GL_REPLACE);
+    state.stencil_mask(mask);
 }
 
 } // namespace lt
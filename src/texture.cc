@@ -19,9 +19,11 @@
 #include "texture.hh"
 #include "context.hh"
 #include "helpers.hh"
+#include "texture_container.hh"
 #include "stb_image.h"
 #include <algorithm>
 #include <cstring>
+#include <memory>
 
 namespace
 {
@@ -36,6 +38,7 @@ unsigned choose_alignment(unsigned line_bytes)
 }
 
 GLuint create_texture_from_data(
+    gl_state& state,
     GLenum target,
     GLenum type,
     glm::uvec3 dims,
@@ -49,10 +52,8 @@ GLuint create_texture_from_data(
 
     GLuint tex = 0;
     glGenTextures(1, &tex);
-    glActiveTexture(GL_TEXTURE0);
-    GLint prev_tex = 0;
-    glGetIntegerv(get_binding_name(target), &prev_tex);
-    glBindTexture(target, tex);
+    GLint prev_tex = state.get_texture(0, target);
+    state.bind_texture(0, target, tex);
 
     unsigned n = internal_format_channel_count(internal_format);
     glPixelStorei(GL_UNPACK_ALIGNMENT, choose_alignment(dims.x * n));
@@ -169,11 +170,79 @@ GLuint create_texture_from_data(
         throw std::runtime_error("Unknown texture target!");
     }
 
-    if(prev_tex != 0) glBindTexture(target, prev_tex);
+    if(prev_tex > 0) state.bind_texture(0, target, prev_tex);
 
     return tex;
 }
 
+// Levels are uploaded as they are, block compressed data can't be flipped
+// like images decoded by stb_image are.
+GLuint create_texture_from_container(
+    gl_state& state,
+    const texture_container& c
+){
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    GLint prev_tex = state.get_texture(0, GL_TEXTURE_2D);
+    state.bind_texture(0, GL_TEXTURE_2D, tex);
+
+    glTexStorage2D(
+        GL_TEXTURE_2D, c.levels.size(), c.internal_format, c.width, c.height
+    );
+
+    // KTX pads rows of uncompressed levels to four bytes.
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    for(unsigned i = 0; i < c.levels.size(); ++i)
+    {
+        unsigned w = std::max(c.width >> i, 1u);
+        unsigned h = std::max(c.height >> i, 1u);
+        if(c.external_format == 0)
+            glCompressedTexSubImage2D(
+                GL_TEXTURE_2D, i, 0, 0, w, h, c.internal_format,
+                c.levels[i].size, c.levels[i].data
+            );
+        else
+            glTexSubImage2D(
+                GL_TEXTURE_2D, i, 0, 0, w, h, c.external_format, c.type,
+                c.levels[i].data
+            );
+    }
+
+    if(prev_tex > 0) state.bind_texture(0, GL_TEXTURE_2D, prev_tex);
+    return tex;
+}
+
+GLuint load_texture_container(
+    const std::string& path,
+    bool srgb,
+    GLenum target,
+    GLint& internal_format,
+    GLenum& type,
+    glm::uvec3& dimensions
+){
+    if(target != GL_TEXTURE_2D)
+        throw std::runtime_error("Only 2D textures can be read from " + path);
+
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    if(!read_binary_file(path, data, size))
+        throw std::runtime_error("Unable to read " + path);
+    std::unique_ptr<uint8_t[]> owner(data);
+
+    texture_container c = parse_texture_container(data, size, srgb);
+    GLuint tex = create_texture_from_container(
+        get_context().get_state(), c
+    );
+
+    if(glGetError() != GL_NO_ERROR)
+        throw std::runtime_error("Failed to create texture from " + path);
+
+    internal_format = c.internal_format;
+    type = c.type ? c.type : GL_UNSIGNED_BYTE;
+    dimensions = glm::uvec3(c.width, c.height, 1);
+    return tex;
+}
+
 GLuint load_texture(
     context& ctx,
     const std::string& path,
@@ -183,12 +252,17 @@ GLuint load_texture(
     GLenum& type,
     glm::uvec3& dimensions
 ){
+    if(is_texture_container_file(path))
+    {
+        return load_texture_container(
+            path, srgb, target, internal_format, type, dimensions
+        );
+    }
+
     int w = 0, h = 0, n = 0;
     bool hdr = stbi_is_hdr(path.c_str());
     void* data = nullptr;
 
-    stbi_set_flip_vertically_on_load(target != GL_TEXTURE_CUBE_MAP);
-
     if(hdr)
     {
         data = stbi_loadf(path.c_str(), &w, &h, &n, 0);
@@ -219,25 +293,13 @@ GLuint load_texture(
             + std::to_string(h) + "."
         );
 
-    switch(n)
-    {
-    case 1:
-        internal_format = hdr ? GL_R16F : GL_R8;
-        break;
-    case 2:
-        internal_format = hdr ? GL_RG16F : GL_RG8;
-        break;
-    case 3:
-        if(srgb) internal_format = GL_SRGB8;
-        else internal_format = hdr ? GL_RGB16F : GL_RGB8;
-        break;
-    case 4:
-        if(srgb) internal_format = GL_SRGB8_ALPHA8;
-        else internal_format = hdr ? GL_RGBA16F : GL_RGBA8;
-        break;
-    }
+    internal_format = image_internal_format(n, hdr, srgb);
+
+    if(target != GL_TEXTURE_CUBE_MAP)
+        flip_image_rows(data, (size_t)w * n * (hdr ? sizeof(float) : 1), h);
 
     GLuint tex = create_texture_from_data(
+        get_context().get_state(),
         target,
         type,
         dimensions,
@@ -381,7 +443,7 @@ size_t texture::get_texel_size() const
 void texture::generate_mipmaps()
 {
     load();
-    glBindTexture(target, tex);
+    get_context().get_state().bind_texture(0, target, tex);
     glGenerateMipmap(target);
 }
 
@@ -433,37 +495,44 @@ public:
         GLenum type,
         unsigned samples,
         GLenum target,
-        size_t data_size,
-        const void* data
-    ): texture(ctx), samples(samples), dimensions(dimensions)
+        std::vector<uint8_t>&& data,
+        bool evictable
+    ):  texture(ctx), samples(samples), data(std::move(data)),
+        evictable(evictable), released(false)
     {
         this->internal_format = internal_format;
         this->type = type;
         this->target = target;
-
-        if(data)
-        {
-            this->data = new uint8_t[data_size];
-            memcpy(this->data, data, data_size);
-        }
+        this->dimensions = dimensions;
     }
 
-    ~data_texture()
+    size_t get_cpu_memory_usage() const override
     {
-        if(data) delete [] (uint8_t*)data;
+        return data.capacity();
     }
 
 protected:
     void load_impl() const override
     {
+        if(released)
+            throw std::runtime_error(
+                "Texture data was released after upload, can't reload"
+            );
+
         basic_load(
             dimensions,
             internal_format,
             type,
             samples,
             target,
-            data
+            data.empty() ? nullptr : data.data()
         );
+
+        if(!evictable)
+        {
+            std::vector<uint8_t>().swap(data);
+            released = true;
+        }
     }
 
     void unload_impl() const override
@@ -473,8 +542,9 @@ protected:
 
 private:
     unsigned samples;
-    glm::uvec3 dimensions;
-    void* data;
+    mutable std::vector<uint8_t> data;
+    bool evictable;
+    mutable bool released;
 };
 
 texture* texture::create(
@@ -487,7 +557,7 @@ texture* texture::create(
     size_t data_size,
     const void* data
 ){
-    return new data_texture(
+    return texture::create(
         ctx, glm::uvec3(size, 1), internal_format, type, samples, target,
         data_size, data
     );
@@ -503,12 +573,135 @@ texture* texture::create(
     size_t data_size,
     const void* data
 ){
+    std::vector<uint8_t> copy;
+    if(data)
+        copy.assign((const uint8_t*)data, (const uint8_t*)data + data_size);
     return new data_texture(
         ctx, dimensions, internal_format, type, samples, target,
-        data_size, data
+        std::move(copy), true
+    );
+}
+
+texture* texture::create(
+    context& ctx,
+    glm::uvec3 dimensions,
+    GLint internal_format,
+    GLenum type,
+    unsigned samples,
+    GLenum target,
+    std::vector<uint8_t>&& data,
+    bool evictable
+){
+    return new data_texture(
+        ctx, dimensions, internal_format, type, samples, target,
+        std::move(data), evictable
     );
 }
 
+class container_texture: public texture
+{
+public:
+    container_texture(
+        context& ctx,
+        std::vector<uint8_t>&& data,
+        bool srgb,
+        bool evictable
+    ):  texture(ctx), data(std::move(data)), srgb(srgb),
+        evictable(evictable), released(false)
+    {
+        // Parsed early to catch errors and to know the format.
+        texture_container c = parse_texture_container(
+            this->data.data(), this->data.size(), srgb
+        );
+        this->internal_format = c.internal_format;
+        this->type = c.type ? c.type : GL_UNSIGNED_BYTE;
+        this->target = GL_TEXTURE_2D;
+        this->dimensions = glm::uvec3(c.width, c.height, 1);
+    }
+
+    size_t get_cpu_memory_usage() const override
+    {
+        return data.capacity();
+    }
+
+protected:
+    void load_impl() const override
+    {
+        if(released)
+            throw std::runtime_error(
+                "Texture data was released after upload, can't reload"
+            );
+
+        tex = create_texture_from_container(
+            get_context().get_state(),
+            parse_texture_container(data.data(), data.size(), srgb)
+        );
+        if(glGetError() != GL_NO_ERROR)
+            throw std::runtime_error("Failed to create a texture from data");
+
+        if(!evictable)
+        {
+            std::vector<uint8_t>().swap(data);
+            released = true;
+        }
+    }
+
+    void unload_impl() const override
+    {
+        basic_unload();
+    }
+
+private:
+    mutable std::vector<uint8_t> data;
+    bool srgb;
+    bool evictable;
+    mutable bool released;
+};
+
+texture* texture::create_from_container(
+    context& ctx,
+    const void* data,
+    size_t size,
+    bool srgb
+){
+    return new container_texture(
+        ctx,
+        std::vector<uint8_t>((const uint8_t*)data, (const uint8_t*)data + size),
+        srgb, true
+    );
+}
+
+texture* texture::create_from_container(
+    context& ctx,
+    std::vector<uint8_t>&& data,
+    bool srgb,
+    bool evictable
+){
+    return new container_texture(ctx, std::move(data), srgb, evictable);
+}
+
+size_t texture::get_cpu_memory_usage() const
+{
+    return 0;
+}
+
+size_t texture::get_gpu_memory_usage() const
+{
+    if(!tex) return 0;
+
+    size_t layers = dimensions.z;
+    if(target == GL_TEXTURE_CUBE_MAP) layers *= 6;
+
+    unsigned block_size = internal_format_block_size(internal_format);
+    if(block_size)
+    {
+        return ((dimensions.x + 3) / 4) * ((dimensions.y + 3) / 4) *
+            layers * block_size;
+    }
+    return (size_t)dimensions.x * dimensions.y * layers *
+        gl_type_sizeof(type) * internal_format_channel_count(internal_format);
+}
+
 void texture::basic_load(
     const std::string& path,
     bool srgb,
@@ -544,6 +737,7 @@ void texture::basic_load(
     if(tex) return;
 
     tex = create_texture_from_data(
+        get_context().get_state(),
         target,
         type,
         dimensions,
@@ -565,6 +759,7 @@ void texture::basic_unload() const
 {
     if(tex != 0)
     {
+        get_context().get_state().forget_texture(tex);
         glDeleteTextures(1, &tex);
         tex = 0;
     }
@@ -0,0 +1,303 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "texture_compression.hh"
+#include "texture_container.hh"
+#include "helpers.hh"
+#include "math.hh"
+#include "stb_image.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+namespace
+{
+using namespace lt;
+
+uint16_t pack_565(vec3 c)
+{
+    c = clamp(c, vec3(0), vec3(255));
+    unsigned r = (unsigned)std::round(c.r * 31.0f / 255.0f);
+    unsigned g = (unsigned)std::round(c.g * 63.0f / 255.0f);
+    unsigned b = (unsigned)std::round(c.b * 31.0f / 255.0f);
+    return r << 11 | g << 5 | b;
+}
+
+vec3 unpack_565(uint16_t c)
+{
+    unsigned r = (c >> 11) & 31;
+    unsigned g = (c >> 5) & 63;
+    unsigned b = c & 31;
+    return vec3(r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2);
+}
+
+void write_le(uint8_t* out, uint64_t value, unsigned bytes)
+{
+    for(unsigned i = 0; i < bytes; ++i) out[i] = value >> (8 * i);
+}
+
+// The endpoints are the extremes of the colors along their principal axis.
+void encode_bc1_block(const vec4* block, uint8_t* out)
+{
+    vec3 mean(0);
+    for(unsigned i = 0; i < 16; ++i) mean += vec3(block[i]);
+    mean /= 16.0f;
+
+    mat3 covariance(0);
+    for(unsigned i = 0; i < 16; ++i)
+    {
+        vec3 d = vec3(block[i]) - mean;
+        covariance += outerProduct(d, d);
+    }
+
+    vec3 axis(1);
+    for(unsigned i = 0; i < 8; ++i)
+    {
+        vec3 next = covariance * axis;
+        float len = length(next);
+        if(len < 1e-6f) break;
+        axis = next / len;
+    }
+
+    float lo = 0.0f, hi = 0.0f;
+    for(unsigned i = 0; i < 16; ++i)
+    {
+        float t = dot(vec3(block[i]) - mean, axis);
+        lo = std::min(lo, t);
+        hi = std::max(hi, t);
+    }
+
+    uint16_t c0 = pack_565(mean + axis * hi);
+    uint16_t c1 = pack_565(mean + axis * lo);
+    // c0 > c1 selects the four color mode.
+    if(c0 < c1) std::swap(c0, c1);
+
+    vec3 palette[4];
+    palette[0] = unpack_565(c0);
+    palette[1] = unpack_565(c1);
+    palette[2] = (2.0f * palette[0] + palette[1]) / 3.0f;
+    palette[3] = (palette[0] + 2.0f * palette[1]) / 3.0f;
+
+    uint32_t indices = 0;
+    if(c0 != c1)
+    {
+        for(unsigned i = 0; i < 16; ++i)
+        {
+            unsigned best = 0;
+            float best_dist = INFINITY;
+            for(unsigned j = 0; j < 4; ++j)
+            {
+                vec3 d = vec3(block[i]) - palette[j];
+                float dist = dot(d, d);
+                if(dist < best_dist)
+                {
+                    best = j;
+                    best_dist = dist;
+                }
+            }
+            indices |= best << (2 * i);
+        }
+    }
+
+    write_le(out, c0, 2);
+    write_le(out + 2, c1, 2);
+    write_le(out + 4, indices, 4);
+}
+
+// Uses the eight value mode between the extremes of the values.
+void encode_bc4_block(const vec4* block, unsigned channel, uint8_t* out)
+{
+    float lo = 255.0f, hi = 0.0f;
+    for(unsigned i = 0; i < 16; ++i)
+    {
+        lo = std::min(lo, block[i][channel]);
+        hi = std::max(hi, block[i][channel]);
+    }
+
+    unsigned a0 = (unsigned)std::round(glm::clamp(hi, 0.0f, 255.0f));
+    unsigned a1 = (unsigned)std::round(glm::clamp(lo, 0.0f, 255.0f));
+
+    float palette[8];
+    palette[0] = a0;
+    palette[1] = a1;
+    for(unsigned i = 1; i < 7; ++i)
+        palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+
+    uint64_t indices = 0;
+    if(a0 != a1)
+    {
+        for(unsigned i = 0; i < 16; ++i)
+        {
+            unsigned best = 0;
+            float best_dist = INFINITY;
+            for(unsigned j = 0; j < 8; ++j)
+            {
+                float dist = std::fabs(block[i][channel] - palette[j]);
+                if(dist < best_dist)
+                {
+                    best = j;
+                    best_dist = dist;
+                }
+            }
+            indices |= (uint64_t)best << (3 * i);
+        }
+    }
+
+    out[0] = a0;
+    out[1] = a1;
+    write_le(out + 2, indices, 6);
+}
+
+unsigned block_size(block_format format)
+{
+    return format == block_format::BC1 || format == block_format::BC4 ?
+        8 : 16;
+}
+
+// Reads the 4x4 block at (bx, by), repeating edge pixels where the block
+// extends past the image.
+void read_block(
+    block_format format,
+    const uint8_t* pixels,
+    unsigned width,
+    unsigned height,
+    unsigned channels,
+    unsigned bx,
+    unsigned by,
+    vec4* block
+){
+    bool grey = channels <= 2 &&
+        (format == block_format::BC1 || format == block_format::BC3);
+
+    for(unsigned y = 0; y < 4; ++y)
+    for(unsigned x = 0; x < 4; ++x)
+    {
+        unsigned px = std::min(bx * 4 + x, width - 1);
+        unsigned py = std::min(by * 4 + y, height - 1);
+        const uint8_t* p = pixels + (py * width + px) * channels;
+
+        vec4 c(0, 0, 0, 255);
+        for(unsigned i = 0; i < std::min(channels, 4u); ++i) c[i] = p[i];
+        if(grey) c = vec4(vec3(p[0]), channels == 2 ? p[1] : 255);
+        block[y * 4 + x] = c;
+    }
+}
+
+}
+
+namespace lt
+{
+
+GLint block_format_to_internal_format(block_format format, bool srgb)
+{
+    switch(format)
+    {
+    case block_format::BC1:
+        return srgb ?
+            GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case block_format::BC3:
+        return srgb ?
+            GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT :
+            GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case block_format::BC4:
+        return GL_COMPRESSED_RED_RGTC1;
+    case block_format::BC5:
+        return GL_COMPRESSED_RG_RGTC2;
+    }
+    throw std::runtime_error("Unknown block format");
+}
+
+std::vector<uint8_t> compress_image(
+    block_format format,
+    const uint8_t* pixels,
+    unsigned width,
+    unsigned height,
+    unsigned channels
+){
+    unsigned blocks_x = (width + 3) / 4;
+    unsigned blocks_y = (height + 3) / 4;
+    unsigned bytes = block_size(format);
+    std::vector<uint8_t> res(blocks_x * blocks_y * bytes);
+
+    parallel_for(blocks_y, [&](size_t by){
+        vec4 block[16];
+        for(unsigned bx = 0; bx < blocks_x; ++bx)
+        {
+            read_block(
+                format, pixels, width, height, channels, bx, by, block
+            );
+            uint8_t* out = res.data() + (by * blocks_x + bx) * bytes;
+            switch(format)
+            {
+            case block_format::BC1:
+                encode_bc1_block(block, out);
+                break;
+            case block_format::BC3:
+                encode_bc4_block(block, 3, out);
+                encode_bc1_block(block, out + 8);
+                break;
+            case block_format::BC4:
+                encode_bc4_block(block, 0, out);
+                break;
+            case block_format::BC5:
+                encode_bc4_block(block, 0, out);
+                encode_bc4_block(block, 1, out + 8);
+                break;
+            }
+        }
+    });
+    return res;
+}
+
+void compress_texture_file(
+    const std::string& input_path,
+    const std::string& output_path,
+    block_format format,
+    bool srgb,
+    bool flip
+){
+    int w = 0, h = 0, n = 0;
+    std::unique_ptr<uint8_t, decltype(&stbi_image_free)> data(
+        stbi_load(input_path.c_str(), &w, &h, &n, 0), stbi_image_free
+    );
+    if(!data) throw std::runtime_error("Unable to read " + input_path);
+    if(flip) flip_image_rows(data.get(), (size_t)w * n, h);
+
+    std::vector<std::vector<uint8_t>> levels(
+        calculate_mipmap_count(uvec2(w, h))
+    );
+    levels[0].assign(data.get(), data.get() + (size_t)w * h * n);
+    generate_mipmap_levels<uint8_t>(levels, w, h, n);
+
+    for(unsigned i = 0; i < levels.size(); ++i)
+    {
+        levels[i] = compress_image(
+            format, levels[i].data(),
+            std::max(w >> i, 1), std::max(h >> i, 1), n
+        );
+    }
+
+    write_ktx(
+        output_path, block_format_to_internal_format(format, srgb), w, h,
+        levels
+    );
+}
+
+} // namespace lt
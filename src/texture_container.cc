@@ -0,0 +1,365 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "texture_container.hh"
+#include "helpers.hh"
+#include "math.hh"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+using namespace lt;
+
+const uint8_t KTX_IDENTIFIER[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+const uint32_t KTX_ENDIANNESS = 0x04030201;
+
+struct ktx_header
+{
+    uint8_t identifier[12];
+    uint32_t endianness;
+    uint32_t gl_type;
+    uint32_t gl_type_size;
+    uint32_t gl_format;
+    uint32_t gl_internal_format;
+    uint32_t gl_base_internal_format;
+    uint32_t pixel_width;
+    uint32_t pixel_height;
+    uint32_t pixel_depth;
+    uint32_t array_elements;
+    uint32_t faces;
+    uint32_t mipmap_levels;
+    uint32_t key_value_bytes;
+};
+
+const uint8_t DDS_MAGIC[4] = {'D', 'D', 'S', ' '};
+const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+const uint32_t DDPF_FOURCC = 0x4;
+const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+const uint32_t DDSCAPS2_VOLUME = 0x200000;
+const uint32_t D3D10_RESOURCE_DIMENSION_TEXTURE2D = 3;
+
+struct dds_header
+{
+    uint32_t size;
+    uint32_t flags;
+    uint32_t height;
+    uint32_t width;
+    uint32_t pitch_or_linear_size;
+    uint32_t depth;
+    uint32_t mipmap_count;
+    uint32_t reserved1[11];
+    uint32_t pf_size;
+    uint32_t pf_flags;
+    uint32_t pf_fourcc;
+    uint32_t pf_rgb_bit_count;
+    uint32_t pf_masks[4];
+    uint32_t caps[4];
+    uint32_t reserved2;
+};
+
+struct dds_header_dx10
+{
+    uint32_t dxgi_format;
+    uint32_t resource_dimension;
+    uint32_t misc_flag;
+    uint32_t array_size;
+    uint32_t misc_flags2;
+};
+
+constexpr uint32_t fourcc(char a, char b, char c, char d)
+{
+    return (uint32_t)a | (uint32_t)b << 8 | (uint32_t)c << 16 |
+        (uint32_t)d << 24;
+}
+
+GLint dds_fourcc_format(uint32_t code)
+{
+    switch(code)
+    {
+    case fourcc('D', 'X', 'T', '1'):
+        return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    case fourcc('D', 'X', 'T', '3'):
+        return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+    case fourcc('D', 'X', 'T', '5'):
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case fourcc('A', 'T', 'I', '1'):
+    case fourcc('B', 'C', '4', 'U'):
+        return GL_COMPRESSED_RED_RGTC1;
+    case fourcc('B', 'C', '4', 'S'):
+        return GL_COMPRESSED_SIGNED_RED_RGTC1;
+    case fourcc('A', 'T', 'I', '2'):
+    case fourcc('B', 'C', '5', 'U'):
+        return GL_COMPRESSED_RG_RGTC2;
+    case fourcc('B', 'C', '5', 'S'):
+        return GL_COMPRESSED_SIGNED_RG_RGTC2;
+    default:
+        return 0;
+    }
+}
+
+GLint dds_dxgi_format(uint32_t dxgi_format)
+{
+    switch(dxgi_format)
+    {
+    case 71: // DXGI_FORMAT_BC1_UNORM
+        return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    case 72: // DXGI_FORMAT_BC1_UNORM_SRGB
+        return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;
+    case 74: // DXGI_FORMAT_BC2_UNORM
+        return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+    case 75: // DXGI_FORMAT_BC2_UNORM_SRGB
+        return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT;
+    case 77: // DXGI_FORMAT_BC3_UNORM
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case 78: // DXGI_FORMAT_BC3_UNORM_SRGB
+        return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+    case 80: // DXGI_FORMAT_BC4_UNORM
+        return GL_COMPRESSED_RED_RGTC1;
+    case 81: // DXGI_FORMAT_BC4_SNORM
+        return GL_COMPRESSED_SIGNED_RED_RGTC1;
+    case 83: // DXGI_FORMAT_BC5_UNORM
+        return GL_COMPRESSED_RG_RGTC2;
+    case 84: // DXGI_FORMAT_BC5_SNORM
+        return GL_COMPRESSED_SIGNED_RG_RGTC2;
+    case 95: // DXGI_FORMAT_BC6H_UF16
+        return GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+    case 96: // DXGI_FORMAT_BC6H_SF16
+        return GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT;
+    case 98: // DXGI_FORMAT_BC7_UNORM
+        return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    case 99: // DXGI_FORMAT_BC7_UNORM_SRGB
+        return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+    default:
+        return 0;
+    }
+}
+
+void check(bool condition, const char* what)
+{
+    if(!condition)
+        throw std::runtime_error(std::string("Invalid texture file: ") + what);
+}
+
+bool fits(size_t offset, size_t size, size_t total)
+{
+    return offset <= total && size <= total - offset;
+}
+
+// Clamps to the full mipmap chain before any level is read, which also keeps
+// the shifts of the level dimensions defined.
+unsigned clamp_level_count(const texture_container& c, uint32_t level_count)
+{
+    check(c.width != 0 && c.height != 0, "empty texture");
+    unsigned max_levels = calculate_mipmap_count(uvec2(c.width, c.height));
+    return std::min(std::max(level_count, 1u), max_levels);
+}
+
+// Bytes that uploading the level reads. Rows of uncompressed levels are
+// padded to four bytes like in KTX.
+size_t expected_level_size(const texture_container& c, unsigned level)
+{
+    size_t w = std::max(c.width >> level, 1u);
+    size_t h = std::max(c.height >> level, 1u);
+    size_t block_size = internal_format_block_size(c.internal_format);
+    if(block_size != 0) return (w + 3) / 4 * ((h + 3) / 4) * block_size;
+
+    size_t row_size = w * internal_format_channel_count(c.external_format) *
+        gl_type_sizeof(c.type);
+    return (row_size + 3) / 4 * 4 * h;
+}
+
+texture_container parse_ktx(const uint8_t* data, size_t size, bool srgb)
+{
+    check(size >= sizeof(ktx_header), "truncated KTX header");
+    ktx_header header;
+    memcpy(&header, data, sizeof(header));
+    check(header.endianness == KTX_ENDIANNESS, "unsupported KTX byte order");
+    check(
+        header.pixel_depth == 0 && header.array_elements == 0 &&
+        header.faces == 1 && header.pixel_height != 0,
+        "only 2D KTX textures are supported"
+    );
+
+    texture_container c;
+    c.internal_format = header.gl_internal_format;
+    c.external_format = header.gl_format;
+    c.type = header.gl_type;
+    c.width = header.pixel_width;
+    c.height = header.pixel_height;
+    if(srgb) c.internal_format = internal_format_to_srgb(c.internal_format);
+
+    check(
+        (c.type == 0) == (internal_format_block_size(c.internal_format) != 0),
+        "unsupported KTX format"
+    );
+
+    size_t offset = sizeof(ktx_header);
+    check(fits(offset, header.key_value_bytes, size), "truncated KTX data");
+    offset += header.key_value_bytes;
+
+    unsigned level_count = clamp_level_count(c, header.mipmap_levels);
+    for(unsigned i = 0; i < level_count; ++i)
+    {
+        uint32_t image_size = 0;
+        check(fits(offset, sizeof(image_size), size), "truncated KTX level");
+        memcpy(&image_size, data + offset, sizeof(image_size));
+        offset += sizeof(image_size);
+        check(fits(offset, image_size, size), "truncated KTX level");
+        check(
+            image_size >= expected_level_size(c, i),
+            "KTX level is smaller than its dimensions"
+        );
+        c.levels.push_back({data + offset, image_size});
+        offset += (image_size + 3) / 4 * 4;
+    }
+    return c;
+}
+
+texture_container parse_dds(const uint8_t* data, size_t size, bool srgb)
+{
+    size_t offset = sizeof(DDS_MAGIC);
+    check(fits(offset, sizeof(dds_header), size), "truncated DDS header");
+    dds_header header;
+    memcpy(&header, data + offset, sizeof(header));
+    offset += sizeof(header);
+
+    check(
+        !(header.caps[1] & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)),
+        "only 2D DDS textures are supported"
+    );
+    check(header.pf_flags & DDPF_FOURCC, "uncompressed DDS is not supported");
+
+    texture_container c;
+    if(header.pf_fourcc == fourcc('D', 'X', '1', '0'))
+    {
+        dds_header_dx10 dx10;
+        check(fits(offset, sizeof(dx10), size), "truncated DDS header");
+        memcpy(&dx10, data + offset, sizeof(dx10));
+        offset += sizeof(dx10);
+        check(
+            dx10.resource_dimension == D3D10_RESOURCE_DIMENSION_TEXTURE2D &&
+            dx10.array_size <= 1,
+            "only 2D DDS textures are supported"
+        );
+        c.internal_format = dds_dxgi_format(dx10.dxgi_format);
+    }
+    else c.internal_format = dds_fourcc_format(header.pf_fourcc);
+
+    check(c.internal_format != 0, "unsupported DDS format");
+    if(srgb) c.internal_format = internal_format_to_srgb(c.internal_format);
+    c.external_format = 0;
+    c.type = 0;
+    c.width = header.width;
+    c.height = header.height;
+
+    unsigned level_count = clamp_level_count(
+        c, header.flags & DDSD_MIPMAPCOUNT ? header.mipmap_count : 1
+    );
+    for(unsigned i = 0; i < level_count; ++i)
+    {
+        size_t level_size = expected_level_size(c, i);
+        check(fits(offset, level_size, size), "truncated DDS level");
+        c.levels.push_back({data + offset, level_size});
+        offset += level_size;
+    }
+    return c;
+}
+
+}
+
+namespace lt
+{
+
+bool is_texture_container(const uint8_t* data, size_t size)
+{
+    return (
+        size >= sizeof(KTX_IDENTIFIER) &&
+        memcmp(data, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) == 0
+    ) || (
+        size >= sizeof(DDS_MAGIC) &&
+        memcmp(data, DDS_MAGIC, sizeof(DDS_MAGIC)) == 0
+    );
+}
+
+bool is_texture_container_file(const std::string& path)
+{
+    FILE* f = fopen(path.c_str(), "rb");
+    if(!f) return false;
+
+    uint8_t magic[sizeof(KTX_IDENTIFIER)];
+    size_t size = fread(magic, 1, sizeof(magic), f);
+    fclose(f);
+    return is_texture_container(magic, size);
+}
+
+texture_container parse_texture_container(
+    const uint8_t* data,
+    size_t size,
+    bool srgb
+){
+    texture_container c;
+    if(size >= sizeof(DDS_MAGIC) && memcmp(data, DDS_MAGIC, 4) == 0)
+        c = parse_dds(data, size, srgb);
+    else c = parse_ktx(data, size, srgb);
+    return c;
+}
+
+void write_ktx(
+    const std::string& path,
+    GLint internal_format,
+    unsigned width,
+    unsigned height,
+    const std::vector<std::vector<uint8_t>>& levels
+){
+    ktx_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+    header.endianness = KTX_ENDIANNESS;
+    header.gl_type_size = 1;
+    header.gl_internal_format = internal_format;
+    header.gl_base_internal_format =
+        internal_format_to_external_format(internal_format);
+    header.pixel_width = width;
+    header.pixel_height = height;
+    header.faces = 1;
+    header.mipmap_levels = levels.size();
+
+    std::vector<uint8_t> file(
+        (const uint8_t*)&header, (const uint8_t*)&header + sizeof(header)
+    );
+    for(const std::vector<uint8_t>& level: levels)
+    {
+        uint32_t image_size = level.size();
+        file.insert(
+            file.end(), (const uint8_t*)&image_size,
+            (const uint8_t*)&image_size + sizeof(image_size)
+        );
+        file.insert(file.end(), level.begin(), level.end());
+        file.resize((file.size() + 3) / 4 * 4, 0);
+    }
+
+    if(!write_binary_file(path, file.data(), file.size()))
+        throw std::runtime_error("Unable to write " + path);
+}
+
+} // namespace lt
@@ -0,0 +1,69 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LT_TEXTURE_CONTAINER_HH
+#define LT_TEXTURE_CONTAINER_HH
+#include "glheaders.hh"
+#include <string>
+#include <vector>
+
+namespace lt
+{
+
+// A 2D texture with all of its mipmap levels, as stored in a KTX or DDS
+// file. The levels point into the data the container was parsed from.
+struct texture_container
+{
+    struct level
+    {
+        const uint8_t* data;
+        size_t size;
+    };
+
+    GLint internal_format;
+    // Both are zero for block compressed formats.
+    GLenum external_format;
+    GLenum type;
+    unsigned width;
+    unsigned height;
+    std::vector<level> levels;
+};
+
+bool is_texture_container(const uint8_t* data, size_t size);
+bool is_texture_container_file(const std::string& path);
+
+// Throws if the data is malformed or contains anything else than a single 2D
+// image. The sRGB variant of the format is used with 'srgb', if there is one.
+texture_container parse_texture_container(
+    const uint8_t* data,
+    size_t size,
+    bool srgb
+);
+
+// Writes a KTX file of a block compressed texture.
+void write_ktx(
+    const std::string& path,
+    GLint internal_format,
+    unsigned width,
+    unsigned height,
+    const std::vector<std::vector<uint8_t>>& levels
+);
+
+} // namespace lt
+
+#endif
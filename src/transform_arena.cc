@@ -0,0 +1,388 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "transform_arena.hh"
+#include "transformable.hh"
+#include <algorithm>
+#include <stdexcept>
+#include <climits>
+#include <type_traits>
+
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LT_TRANSFORM_ARENA_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+using namespace lt;
+
+size_t padded_size(size_t size)
+{
+    return (size + 3) & ~size_t(3);
+}
+
+#ifdef LT_TRANSFORM_ARENA_SSE
+
+// Builds translation * rotation * scaling matrices of four nodes at once.
+// Each register holds one matrix element of all four nodes, so the columns
+// are transposed back into per-node order when stored.
+void compose4(
+    const float* px, const float* py, const float* pz,
+    const float* qx, const float* qy, const float* qz, const float* qw,
+    const float* sx, const float* sy, const float* sz,
+    mat4* out
+){
+    __m128 x = _mm_loadu_ps(qx), y = _mm_loadu_ps(qy);
+    __m128 z = _mm_loadu_ps(qz), w = _mm_loadu_ps(qw);
+    __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+
+    __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y);
+    __m128 zz = _mm_mul_ps(z, z), xy = _mm_mul_ps(x, y);
+    __m128 xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+    __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y);
+    __m128 wz = _mm_mul_ps(w, z);
+
+    __m128 columns[4][4] = {
+        {
+            _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))),
+            _mm_mul_ps(two, _mm_add_ps(xy, wz)),
+            _mm_mul_ps(two, _mm_sub_ps(xz, wy)),
+            _mm_setzero_ps()
+        },
+        {
+            _mm_mul_ps(two, _mm_sub_ps(xy, wz)),
+            _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))),
+            _mm_mul_ps(two, _mm_add_ps(yz, wx)),
+            _mm_setzero_ps()
+        },
+        {
+            _mm_mul_ps(two, _mm_add_ps(xz, wy)),
+            _mm_mul_ps(two, _mm_sub_ps(yz, wx)),
+            _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))),
+            _mm_setzero_ps()
+        },
+        {_mm_loadu_ps(px), _mm_loadu_ps(py), _mm_loadu_ps(pz), one}
+    };
+
+    const float* scaling[3] = {sx, sy, sz};
+    for(unsigned c = 0; c < 4; ++c)
+    {
+        __m128* col = columns[c];
+        if(c < 3)
+        {
+            __m128 s = _mm_loadu_ps(scaling[c]);
+            for(unsigned r = 0; r < 3; ++r) col[r] = _mm_mul_ps(col[r], s);
+        }
+
+        _MM_TRANSPOSE4_PS(col[0], col[1], col[2], col[3]);
+        for(unsigned k = 0; k < 4; ++k)
+            _mm_storeu_ps(&out[k][c].x, col[k]);
+    }
+}
+
+// out = a * b for matrices whose last row is (0, 0, 0, 1).
+void multiply(const mat4& a, const mat4& b, mat4& out)
+{
+    __m128 a0 = _mm_loadu_ps(&a[0].x), a1 = _mm_loadu_ps(&a[1].x);
+    __m128 a2 = _mm_loadu_ps(&a[2].x), a3 = _mm_loadu_ps(&a[3].x);
+    for(unsigned c = 0; c < 4; ++c)
+    {
+        __m128 r = _mm_mul_ps(a0, _mm_set1_ps(b[c].x));
+        r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(b[c].y)));
+        r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(b[c].z)));
+        if(c == 3) r = _mm_add_ps(r, a3);
+        _mm_storeu_ps(&out[c].x, r);
+    }
+}
+
+#else
+
+void compose4(
+    const float* px, const float* py, const float* pz,
+    const float* qx, const float* qy, const float* qz, const float* qw,
+    const float* sx, const float* sy, const float* sz,
+    mat4* out
+){
+    for(unsigned k = 0; k < 4; ++k)
+    {
+        out[k] = glm::translate(vec3(px[k], py[k], pz[k]))
+            * glm::toMat4(quat(qw[k], qx[k], qy[k], qz[k]))
+            * glm::scale(vec3(sx[k], sy[k], sz[k]));
+    }
+}
+
+void multiply(const mat4& a, const mat4& b, mat4& out)
+{
+    out = a * b;
+}
+
+#endif
+
+}
+
+namespace lt
+{
+
+transform_arena::transform_arena()
+: order_outdated(false), any_dirty(false)
+{
+}
+
+transform_arena::~transform_arena()
+{
+    clear();
+}
+
+void transform_arena::add(transformable_node* node)
+{
+    if(node->arena == this) return;
+    if(node->arena)
+        throw std::runtime_error(
+            "Node already belongs to another transform arena"
+        );
+
+    int32_t parent = -1;
+    if(node->parent)
+    {
+        add(node->parent);
+        parent = node->parent->arena_index;
+    }
+    push(node, parent);
+}
+
+void transform_arena::remove(transformable_node* node)
+{
+    if(node->arena != this) return;
+    if(order_outdated) rebuild();
+
+    // Descendants come after their ancestors, so a single pass finds them.
+    std::vector<uint8_t> removed(nodes.size(), 0);
+    removed[node->arena_index] = 1;
+    for(size_t i = node->arena_index; i < nodes.size(); ++i)
+    {
+        if(parents[i] >= 0 && removed[parents[i]]) removed[i] = 1;
+        if(!removed[i]) continue;
+
+        nodes[i]->arena = nullptr;
+        nodes[i]->generation = 0;
+        nodes[i] = nullptr;
+    }
+    order_outdated = true;
+}
+
+void transform_arena::clear()
+{
+    for(transformable_node* node: nodes)
+    {
+        if(!node) continue;
+        node->arena = nullptr;
+        node->generation = 0;
+    }
+
+    for(std::vector<float>* v: {
+        &px, &py, &pz, &qx, &qy, &qz, &qw, &sx, &sy, &sz
+    }) v->clear();
+
+    nodes.clear();
+    parents.clear();
+    dirty.clear();
+    generations.clear();
+    local.clear();
+    world.clear();
+    order_outdated = false;
+    any_dirty = false;
+}
+
+size_t transform_arena::size() const
+{
+    return nodes.size() - std::count(nodes.begin(), nodes.end(), nullptr);
+}
+
+void transform_arena::update()
+{
+    if(order_outdated) rebuild();
+    if(!any_dirty) return;
+
+    update_local();
+
+    // Parents precede their children, so a dirty parent has already been
+    // recomputed when its children are reached.
+    for(size_t i = 0; i < nodes.size(); ++i)
+    {
+        int32_t parent = parents[i];
+        if(parent >= 0 && dirty[parent]) dirty[i] = 1;
+        if(!dirty[i]) continue;
+
+        if(parent >= 0) multiply(world[parent], local[i], world[i]);
+        else world[i] = local[i];
+        generations[i] = transformable_node::next_generation();
+    }
+
+    std::fill(dirty.begin(), dirty.end(), 0);
+    any_dirty = false;
+}
+
+const mat4& transform_arena::get_world(const transformable_node* node)
+{
+    update();
+    return world[node->arena_index];
+}
+
+uint64_t transform_arena::get_generation(const transformable_node* node)
+{
+    update();
+    return generations[node->arena_index];
+}
+
+void transform_arena::set_local(
+    uint32_t index,
+    vec3 position,
+    quat orientation,
+    vec3 scaling
+){
+    px[index] = position.x;
+    py[index] = position.y;
+    pz[index] = position.z;
+    qx[index] = orientation.x;
+    qy[index] = orientation.y;
+    qz[index] = orientation.z;
+    qw[index] = orientation.w;
+    sx[index] = scaling.x;
+    sy[index] = scaling.y;
+    sz[index] = scaling.z;
+    dirty[index] = 1;
+    any_dirty = true;
+}
+
+void transform_arena::reparent(transformable_node* node)
+{
+    int32_t parent = -1;
+    if(node->parent)
+    {
+        add(node->parent);
+        parent = node->parent->arena_index;
+    }
+
+    uint32_t index = node->arena_index;
+    parents[index] = parent;
+    dirty[index] = 1;
+    any_dirty = true;
+    if(parent > (int32_t)index) order_outdated = true;
+}
+
+void transform_arena::push(transformable_node* node, int32_t parent)
+{
+    uint32_t index = nodes.size();
+    nodes.push_back(node);
+    parents.push_back(parent);
+    dirty.push_back(1);
+    generations.push_back(0);
+    world.emplace_back(1.0f);
+
+    size_t padded = padded_size(nodes.size());
+    for(std::vector<float>* v: {&px, &py, &pz, &qx, &qy, &qz})
+        v->resize(padded, 0.0f);
+    for(std::vector<float>* v: {&qw, &sx, &sy, &sz})
+        v->resize(padded, 1.0f);
+    local.resize(padded, mat4(1.0f));
+
+    node->arena = this;
+    node->arena_index = index;
+    set_local(index, node->position, node->orientation, node->scaling);
+}
+
+void transform_arena::rebuild()
+{
+    // Sort the remaining nodes by depth, which puts parents before their
+    // children.
+    size_t count = nodes.size();
+    std::vector<uint32_t> depth(count, UINT_MAX);
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> chain;
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        if(!nodes[i]) continue;
+        order.push_back(i);
+
+        uint32_t j = i;
+        while(depth[j] == UINT_MAX && parents[j] >= 0)
+        {
+            chain.push_back(j);
+            j = parents[j];
+        }
+        if(depth[j] == UINT_MAX) depth[j] = 0;
+        for(; !chain.empty(); chain.pop_back())
+            depth[chain.back()] = depth[parents[chain.back()]] + 1;
+    }
+
+    std::stable_sort(
+        order.begin(),
+        order.end(),
+        [&](uint32_t a, uint32_t b){ return depth[a] < depth[b]; }
+    );
+
+    std::vector<int32_t> remap(count, -1);
+    for(uint32_t i = 0; i < order.size(); ++i) remap[order[i]] = i;
+
+    size_t padded = padded_size(order.size());
+    auto gather = [&](auto& v, size_t size, auto fill){
+        std::remove_reference_t<decltype(v)> sorted(size, fill);
+        for(size_t i = 0; i < order.size(); ++i) sorted[i] = v[order[i]];
+        v.swap(sorted);
+    };
+
+    for(std::vector<float>* v: {&px, &py, &pz, &qx, &qy, &qz})
+        gather(*v, padded, 0.0f);
+    for(std::vector<float>* v: {&qw, &sx, &sy, &sz})
+        gather(*v, padded, 1.0f);
+    gather(local, padded, mat4(1.0f));
+    gather(world, order.size(), mat4(1.0f));
+    gather(nodes, order.size(), (transformable_node*)nullptr);
+    gather(dirty, order.size(), (uint8_t)0);
+    gather(generations, order.size(), (uint64_t)0);
+    gather(parents, order.size(), (int32_t)-1);
+
+    for(uint32_t i = 0; i < order.size(); ++i)
+    {
+        if(parents[i] >= 0) parents[i] = remap[parents[i]];
+        nodes[i]->arena_index = i;
+    }
+    order_outdated = false;
+}
+
+void transform_arena::update_local()
+{
+    for(size_t i = 0; i < nodes.size(); i += 4)
+    {
+        bool changed = false;
+        for(size_t k = i; k < std::min(i + 4, nodes.size()); ++k)
+            changed |= dirty[k] != 0;
+        if(!changed) continue;
+
+        compose4(
+            &px[i], &py[i], &pz[i],
+            &qx[i], &qy[i], &qz[i], &qw[i],
+            &sx[i], &sy[i], &sz[i],
+            &local[i]
+        );
+    }
+}
+
+} // namespace lt
@@ -17,26 +17,59 @@
     along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "transformable.hh"
+#include "transform_arena.hh"
 #include "helpers.hh"
 
 namespace lt
 {
 
+std::atomic<uint64_t> transformable::global_revision(1);
+
 transformable::transformable()
-: orientation(1,0,0,0), position(0), scaling(1)
+:   orientation(1,0,0,0), position(0), scaling(1), revision(1),
+    arena(nullptr), arena_index(0)
 {
 }
 
+// Copies never join the arena of the original.
 transformable::transformable(const transformable& other)
-: orientation(other.orientation), position(other.position),
-  scaling(other.scaling)
+:   orientation(other.orientation), position(other.position),
+    scaling(other.scaling), revision(other.revision), arena(nullptr),
+    arena_index(0)
 {}
 
+transformable& transformable::operator=(const transformable& other)
+{
+    orientation = other.orientation;
+    position = other.position;
+    scaling = other.scaling;
+    local_changed();
+    return *this;
+}
+
+void transformable::local_changed()
+{
+    ++revision;
+    global_changed();
+    if(arena) arena->set_local(arena_index, position, orientation, scaling);
+}
+
+uint64_t transformable::get_global_revision()
+{
+    return global_revision.load(std::memory_order_relaxed);
+}
+
+void transformable::global_changed()
+{
+    global_revision.fetch_add(1, std::memory_order_relaxed);
+}
+
 void transformable::rotate(float angle, glm::vec3 axis, glm::vec3 local_origin)
 {
     glm::quat rotation = glm::angleAxis(glm::radians(angle), axis);
     orientation = glm::normalize(rotation * orientation);
     position += local_origin + rotation * -local_origin;
+    local_changed();
 }
 
 void transformable::rotate(float angle, glm::vec2 local_origin)
@@ -56,21 +89,25 @@ void transformable::rotate_local(
 void transformable::rotate(glm::quat rotation)
 {
     orientation = glm::normalize(rotation * orientation);
+    local_changed();
 }
 
 void transformable::set_orientation(float angle)
 {
     orientation = glm::angleAxis(glm::radians(angle), glm::vec3(0,0,1));
+    local_changed();
 }
 
 void transformable::set_orientation(float angle, glm::vec3 axis)
 {
     orientation = glm::angleAxis(glm::radians(angle), axis);
+    local_changed();
 }
 
 void transformable::set_orientation(glm::quat orientation)
 {
     this->orientation = orientation;
+    local_changed();
 }
 
 void transformable::set_orientation(float pitch, float yaw, float roll)
@@ -82,6 +119,7 @@ void transformable::set_orientation(float pitch, float yaw, float roll)
             glm::radians(roll)
         )
     );
+    local_changed();
 }
 
 glm::quat transformable::get_orientation() const { return orientation; }
@@ -90,11 +128,13 @@ void transformable::translate(glm::vec2 offset)
 {
     this->position.x += offset.x;
     this->position.y += offset.y;
+    local_changed();
 }
 
 void transformable::translate(glm::vec3 offset)
 {
     this->position += offset;
+    local_changed();
 }
 
 void transformable::translate_local(glm::vec2 offset)
@@ -105,22 +145,26 @@ void transformable::translate_local(glm::vec2 offset)
 void transformable::translate_local(glm::vec3 offset)
 {
     this->position += orientation * offset;
+    local_changed();
 }
 
 void transformable::set_position(glm::vec2 position)
 {
     this->position.x = position.x;
     this->position.y = position.y;
+    local_changed();
 }
 
 void transformable::set_position(glm::vec3 position)
 {
     this->position = position;
+    local_changed();
 }
 
 void transformable::set_depth(float depth)
 {
     this->position.z = depth;
+    local_changed();
 }
 
 glm::vec3 transformable::get_position() const { return position; }
@@ -128,34 +172,40 @@ glm::vec3 transformable::get_position() const { return position; }
 void transformable::scale(float scale)
 {
     this->scaling *= scale;
+    local_changed();
 }
 
 void transformable::scale(glm::vec2 scale)
 {
     this->scaling.x *= scale.x;
     this->scaling.y *= scale.y;
+    local_changed();
 }
 
 void transformable::scale(glm::vec3 scale)
 {
     this->scaling *= scale;
+    local_changed();
 }
 
 void transformable::set_scaling(glm::vec2 scaling)
 {
     this->scaling.x = scaling.x;
     this->scaling.y = scaling.y;
+    local_changed();
 }
 
 void transformable::set_scaling(glm::vec3 scaling)
 {
     this->scaling = scaling;
+    local_changed();
 }
 glm::vec3 transformable::get_scaling() const { return scaling; }
 
 void transformable::set_transform(const glm::mat4& transform)
 {
     decompose_matrix(transform, position, scaling, orientation);
+    local_changed();
 }
 
 glm::mat4 transformable::get_transform() const
@@ -175,6 +225,7 @@ void transformable::lookat(
 
     if(angle_limit < 0) orientation = target;
     else orientation = rotate_towards(orientation, target, angle_limit);
+    local_changed();
 }
 
 void transformable::lookat(
@@ -186,14 +237,70 @@ void transformable::lookat(
     lookat(other->position, up, forward, angle_limit);
 }
 
+std::atomic<uint64_t> transformable_node::generation_counter(0);
+
 transformable_node::transformable_node(transformable_node* parent)
-: parent(parent) {}
+:   parent(parent), cached_parent(nullptr), cached_revision(0),
+    cached_parent_generation(0), generation(0), decomposed_generation(0)
+{}
+
+transformable_node::transformable_node(const transformable_node& other)
+:   transformable(other), parent(other.parent), cached_parent(nullptr),
+    cached_revision(0), cached_parent_generation(0), generation(0),
+    decomposed_generation(0)
+{}
+
+transformable_node::~transformable_node()
+{
+    if(arena) arena->remove(this);
+}
+
+transformable_node& transformable_node::operator=(
+    const transformable_node& other
+){
+    transformable::operator=(other);
+    set_parent(other.parent);
+    return *this;
+}
+
+const glm::mat4& transformable_node::get_global_transform() const
+{
+    if(arena) return arena->get_world(this);
+    update_global_transform();
+    return global_transform;
+}
 
-glm::mat4 transformable_node::get_global_transform() const 
+uint64_t transformable_node::get_generation() const
 {
-    return parent ?
-        parent->get_global_transform() * get_transform():
+    if(arena) return arena->get_generation(this);
+    update_global_transform();
+    return generation;
+}
+
+void transformable_node::update_global_transform() const
+{
+    if(arena)
+    {
+        arena->update();
+        return;
+    }
+
+    uint64_t parent_generation = parent ? parent->get_generation() : 0;
+    if(
+        generation != 0 &&
+        cached_revision == revision &&
+        cached_parent == parent &&
+        cached_parent_generation == parent_generation
+    ) return;
+
+    global_transform = parent ?
+        parent->get_global_transform() * get_transform() :
         get_transform();
+
+    cached_revision = revision;
+    cached_parent = parent;
+    cached_parent_generation = parent_generation;
+    generation = next_generation();
 }
 
 glm::vec3 transformable_node::get_global_position() const
@@ -203,17 +310,42 @@ glm::vec3 transformable_node::get_global_position() const
 
 glm::quat transformable_node::get_global_orientation() const
 {
-    return get_matrix_orientation(get_global_transform());
+    update_decomposition();
+    return global_orientation;
 }
 
 glm::vec3 transformable_node::get_global_scaling() const
 {
-    return get_matrix_scaling(get_global_transform());
+    update_decomposition();
+    return global_scaling;
 }
 
 void transformable_node::set_parent(transformable_node* parent)
 {
     this->parent = parent;
+    global_changed();
+    if(arena) arena->reparent(this);
+}
+
+transform_arena* transformable_node::get_arena() const
+{
+    return arena;
+}
+
+uint64_t transformable_node::next_generation()
+{
+    return generation_counter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+void transformable_node::update_decomposition() const
+{
+    const glm::mat4& transform = get_global_transform();
+    uint64_t current = get_generation();
+    if(decomposed_generation == current) return;
+
+    global_orientation = get_matrix_orientation(transform);
+    global_scaling = get_matrix_scaling(transform);
+    decomposed_generation = current;
 }
 
 transformable_node* transformable_node::get_parent() const
@@ -251,6 +383,7 @@ void transformable_node::lookat(
 
     if(angle_limit < 0) orientation = target;
     else orientation = rotate_towards(orientation, target, angle_limit);
+    local_changed();
 }
 
 void transformable_node::lookat(
@@ -0,0 +1,224 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "vertex_packing.hh"
+#include "helpers.hh"
+#include <glm/gtc/packing.hpp>
+#include <cstring>
+
+namespace
+{
+using namespace lt;
+
+vec2 encode_octahedral(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e(n.x, n.y);
+    if(n.z < 0.0f)
+    {
+        vec2 s(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+        e = (1.0f - abs(vec2(e.y, e.x))) * s;
+    }
+    return e;
+}
+
+// Writes a unit vector and its w component in the given encoding.
+void write_unit_vector(
+    uint8_t* dst,
+    vertex_format::unit_vector_encoding encoding,
+    vec4 v,
+    unsigned components
+){
+    switch(encoding)
+    {
+    case vertex_format::FLOAT32:
+        memcpy(dst, &v, components * sizeof(float));
+        break;
+    case vertex_format::SNORM16:
+        {
+            uint64_t packed = packSnorm4x16(v);
+            memcpy(dst, &packed, sizeof(packed));
+        }
+        break;
+    case vertex_format::OCTAHEDRAL:
+        {
+            vec2 e = encode_octahedral(vec3(v));
+            uint32_t packed = packSnorm3x10_1x2(
+                vec4(e, 0.0f, v.w < 0.0f ? -1.0f : 1.0f)
+            );
+            memcpy(dst, &packed, sizeof(packed));
+        }
+        break;
+    }
+}
+
+}
+
+namespace lt
+{
+
+vertex_format::vertex_format(
+    bool quantize_position,
+    unit_vector_encoding normal_encoding,
+    bool half_uv
+):  quantize_position(quantize_position), normal_encoding(normal_encoding),
+    half_uv(half_uv)
+{
+}
+
+packed_vertices::packed_vertices(
+    const vertex_format& format,
+    size_t vertex_count,
+    const vec3* position,
+    const vec3* normal,
+    const vec4* tangent,
+    const vec2* uv
+):  stride(0), position_scale(1.0f), position_offset(0.0f)
+{
+    size_t pos_offset = format.quantize_position ?
+        add_layout(primitive::POSITION, 4, GL_UNSIGNED_SHORT, true) :
+        add_layout(primitive::POSITION, 3, GL_FLOAT, false);
+
+    auto add_unit_vector = [&](const primitive::attribute& attrib, unsigned n){
+        switch(format.normal_encoding)
+        {
+        default:
+        case vertex_format::FLOAT32:
+            return add_layout(attrib, n, GL_FLOAT, false);
+        case vertex_format::SNORM16:
+            return add_layout(attrib, 4, GL_SHORT, true);
+        case vertex_format::OCTAHEDRAL:
+            return add_layout(attrib, 4, GL_INT_2_10_10_10_REV, true, true);
+        }
+    };
+
+    size_t normal_offset = normal ?
+        add_unit_vector(primitive::NORMAL, 3) : 0;
+    size_t tangent_offset = normal && tangent ?
+        add_unit_vector(primitive::TANGENT, 4) : 0;
+    size_t uv_offset = 0;
+    if(uv)
+    {
+        uv_offset = format.half_uv ?
+            add_layout(primitive::UV0, 2, GL_HALF_FLOAT, false) :
+            add_layout(primitive::UV0, 2, GL_FLOAT, false);
+    }
+
+    if(format.quantize_position && vertex_count)
+    {
+        aabb bounds;
+        for(size_t i = 0; i < vertex_count; ++i) bounds.expand(position[i]);
+        position_offset = bounds.get_min();
+        position_scale = bounds.get_max() - bounds.get_min();
+    }
+    vec3 inv_scale(
+        position_scale.x > 0.0f ? 1.0f / position_scale.x : 0.0f,
+        position_scale.y > 0.0f ? 1.0f / position_scale.y : 0.0f,
+        position_scale.z > 0.0f ? 1.0f / position_scale.z : 0.0f
+    );
+
+    data.resize(vertex_count * stride);
+    for(size_t i = 0; i < vertex_count; ++i)
+    {
+        uint8_t* vertex = data.data() + i * stride;
+
+        if(format.quantize_position)
+        {
+            uint64_t packed = packUnorm4x16(
+                vec4((position[i] - position_offset) * inv_scale, 0.0f)
+            );
+            memcpy(vertex + pos_offset, &packed, sizeof(packed));
+        }
+        else memcpy(vertex + pos_offset, &position[i], 12);
+
+        if(normal)
+        {
+            write_unit_vector(
+                vertex + normal_offset, format.normal_encoding,
+                vec4(normal[i], 0.0f), 3
+            );
+        }
+
+        if(normal && tangent)
+        {
+            write_unit_vector(
+                vertex + tangent_offset, format.normal_encoding,
+                tangent[i], 4
+            );
+        }
+
+        if(uv && format.half_uv)
+        {
+            uint32_t packed = packHalf2x16(uv[i]);
+            memcpy(vertex + uv_offset, &packed, sizeof(packed));
+        }
+        else if(uv) memcpy(vertex + uv_offset, &uv[i], sizeof(vec2));
+    }
+}
+
+const std::vector<uint8_t>& packed_vertices::get_data() const
+{
+    return data;
+}
+
+std::vector<uint8_t> packed_vertices::take_data()
+{
+    return std::move(data);
+}
+
+size_t packed_vertices::get_stride() const
+{
+    return stride;
+}
+
+std::map<primitive::attribute, gpu_buffer_accessor>
+packed_vertices::get_attributes(const gpu_buffer& buf) const
+{
+    std::map<primitive::attribute, gpu_buffer_accessor> attributes;
+    for(const layout& l: layouts)
+    {
+        attributes[l.attrib] = gpu_buffer_accessor(
+            buf, l.components, l.type, l.normalized, stride, l.offset,
+            l.octahedral
+        );
+    }
+    return attributes;
+}
+
+void packed_vertices::apply(primitive& prim) const
+{
+    prim.set_position_decode(position_scale, position_offset);
+}
+
+size_t packed_vertices::add_layout(
+    const primitive::attribute& attrib,
+    unsigned components,
+    GLenum type,
+    bool normalized,
+    bool octahedral
+){
+    size_t size = type == GL_INT_2_10_10_10_REV ?
+        4 : components * gl_type_sizeof(type);
+    layouts.push_back(
+        {attrib, components, type, normalized, octahedral, stride}
+    );
+    stride += size;
+    return layouts.back().offset;
+}
+
+} // namespace lt
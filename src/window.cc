@@ -106,9 +106,9 @@ window::window(const params& p)
     context::init_post();
 
     //Enable generic options
-    if(p.srgb) glEnable(GL_FRAMEBUFFER_SRGB);
-    glEnable(GL_MULTISAMPLE);
-    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    if(p.srgb) get_state().enable(GL_FRAMEBUFFER_SRGB);
+    get_state().enable(GL_MULTISAMPLE);
+    get_state().enable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 }
 
 window::~window()
@@ -126,6 +126,7 @@ int window::poll(SDL_Event& event)
 void window::present()
 {
     SDL_GL_SwapWindow(win);
+    get_state().next_frame();
 
     if(last_delta == duration::zero()) frame_timer.lap();
     if(framerate_limit)
@@ -0,0 +1,433 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "littleton/headless_context.hh"
+#include "littleton/loaders.hh"
+#include "littleton/resource_pool.hh"
+#include "littleton/scene_graph.hh"
+#include "littleton/model.hh"
+#include "littleton/material.hh"
+#include "littleton/primitive.hh"
+#include "littleton/texture.hh"
+#include "littleton/sampler.hh"
+#include "littleton/gpu_buffer.hh"
+#include "littleton/gl_state.hh"
+#include "littleton/math.hh"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+using namespace lt;
+
+void print_usage(const char* name)
+{
+    std::cerr
+        << "Usage: " << name << " [--no-verify] input.gltf output" << std::endl
+        << "Bakes the glTF file, then loads the baked file back and compares"
+           " it to the glTF file unless --no-verify is given." << std::endl;
+}
+
+std::vector<std::vector<uint8_t>> read_levels(const texture& tex)
+{
+    gl_state& state = tex.get_context().get_state();
+    state.bind_texture(0, GL_TEXTURE_2D, tex.get_texture());
+    GLint level_count = 0;
+    glGetTexParameteriv(
+        GL_TEXTURE_2D, GL_TEXTURE_IMMUTABLE_LEVELS, &level_count
+    );
+    GLint compressed = 0;
+    glGetTexLevelParameteriv(
+        GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed
+    );
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    std::vector<std::vector<uint8_t>> levels(std::max(level_count, 1));
+    for(unsigned level = 0; level < levels.size(); ++level)
+    {
+        std::vector<uint8_t>& data = levels[level];
+        if(compressed)
+        {
+            GLint size = 0;
+            glGetTexLevelParameteriv(
+                GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size
+            );
+            data.resize(size);
+            glGetCompressedTexImage(GL_TEXTURE_2D, level, data.data());
+        }
+        else
+        {
+            uvec2 size = max(tex.get_size() >> level, uvec2(1));
+            data.resize(size.x * size.y * tex.get_texel_size());
+            glGetTexImage(
+                GL_TEXTURE_2D, level, tex.get_external_format(),
+                tex.get_type(), data.data()
+            );
+        }
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    state.bind_texture(0, GL_TEXTURE_2D, 0);
+    return levels;
+}
+
+// Compares the scenes from load_gltf() to the ones loaded from the baked
+// file, reporting every difference. Shared resources are compared once.
+class scene_comparator
+{
+public:
+    void compare(
+        const std::unordered_map<std::string, scene_graph>& expected,
+        const std::unordered_map<std::string, scene_graph>& baked
+    ){
+        if(expected.size() != baked.size())
+            fail("scenes", "count differs");
+
+        for(const auto& pair: expected)
+        {
+            auto it = baked.find(pair.first);
+            if(it == baked.end()) fail("scene " + pair.first, "missing");
+            else compare("scene " + pair.first, pair.second, it->second);
+        }
+    }
+
+    unsigned get_error_count() const
+    {
+        return errors;
+    }
+
+private:
+    void fail(const std::string& what, const std::string& why)
+    {
+        std::cerr << what << ": " << why << std::endl;
+        errors++;
+    }
+
+    bool first_time(const void* a, const void* b)
+    {
+        return compared.emplace(a, b).second;
+    }
+
+    // Returns true if the comparison should continue.
+    bool compare_null(const std::string& what, const void* a, const void* b)
+    {
+        if(!a != !b) fail(what, "exists in only one of the scenes");
+        return a && b && first_time(a, b);
+    }
+
+    void compare(
+        const std::string& what,
+        const scene_graph& a,
+        const scene_graph& b
+    ){
+        if(
+            std::distance(a.begin(), a.end()) !=
+            std::distance(b.begin(), b.end())
+        ) fail(what, "object count differs");
+
+        for(const auto& pair: a)
+        {
+            std::string obj_what = what + " object " + pair.first;
+            const object* obj = b.get_object(pair.first);
+            if(!obj)
+            {
+                fail(obj_what, "missing");
+                continue;
+            }
+            compare(obj_what, a, pair.second, b, *obj);
+        }
+    }
+
+    void compare(
+        const std::string& what,
+        const scene_graph& graph_a,
+        const object& a,
+        const scene_graph& graph_b,
+        const object& b
+    ){
+        if(a.get_position() != b.get_position())
+            fail(what, "position differs");
+        if(a.get_orientation() != b.get_orientation())
+            fail(what, "orientation differs");
+        if(a.get_scaling() != b.get_scaling())
+            fail(what, "scaling differs");
+        if(
+            get_node_name(graph_a, a.get_parent()) !=
+            get_node_name(graph_b, b.get_parent())
+        ) fail(what, "parent differs");
+
+        compare(what + " model", a.get_model(), b.get_model());
+    }
+
+    static std::string get_node_name(
+        const scene_graph& graph,
+        const transformable_node* node
+    ){
+        if(!node) return "";
+        for(const auto& pair: graph)
+            if(&pair.second == node) return pair.first;
+        // Parents outside of the graph are not baked.
+        return "";
+    }
+
+    void compare(const std::string& what, const model* a, const model* b)
+    {
+        if(!compare_null(what, a, b)) return;
+
+        if(a->group_count() != b->group_count())
+        {
+            fail(what, "vertex group count differs");
+            return;
+        }
+
+        for(size_t i = 0; i < a->group_count(); ++i)
+        {
+            std::string group_what = what + " group " + std::to_string(i);
+            compare(group_what + " material", (*a)[i].mat, (*b)[i].mat);
+            compare(group_what + " primitive", (*a)[i].mesh, (*b)[i].mesh);
+        }
+    }
+
+    void compare(
+        const std::string& what,
+        const material* a,
+        const material* b
+    ){
+        if(!compare_null(what, a, b)) return;
+
+        if(
+            a->color_factor != b->color_factor ||
+            a->metallic_factor != b->metallic_factor ||
+            a->roughness_factor != b->roughness_factor ||
+            a->normal_factor != b->normal_factor ||
+            a->ior != b->ior ||
+            a->emission_factor != b->emission_factor
+        ) fail(what, "factors differ");
+
+        compare(what + " color", a->color_texture, b->color_texture);
+        compare(
+            what + " metallic-roughness",
+            a->metallic_roughness_texture,
+            b->metallic_roughness_texture
+        );
+        compare(what + " normal", a->normal_texture, b->normal_texture);
+        compare(what + " emission", a->emission_texture, b->emission_texture);
+    }
+
+    void compare(
+        const std::string& what,
+        const material::sampler_tex& a,
+        const material::sampler_tex& b
+    ){
+        compare(what + " sampler", a.first, b.first);
+        compare(what + " texture", a.second, b.second);
+    }
+
+    void compare(const std::string& what, const sampler* a, const sampler* b)
+    {
+        if(!compare_null(what, a, b)) return;
+
+        for(GLenum param: {
+            GL_TEXTURE_MAG_FILTER, GL_TEXTURE_MIN_FILTER, GL_TEXTURE_WRAP_S,
+            GL_TEXTURE_COMPARE_MODE
+        }){
+            GLint value_a = 0, value_b = 0;
+            glGetSamplerParameteriv(a->get_sampler(), param, &value_a);
+            glGetSamplerParameteriv(b->get_sampler(), param, &value_b);
+            if(value_a != value_b) fail(what, "parameters differ");
+        }
+    }
+
+    void compare(const std::string& what, const texture* a, const texture* b)
+    {
+        if(!compare_null(what, a, b)) return;
+
+        if(
+            a->get_target() != b->get_target() ||
+            a->get_internal_format() != b->get_internal_format() ||
+            a->get_size() != b->get_size()
+        ){
+            fail(what, "format or size differs");
+            return;
+        }
+
+        std::vector<std::vector<uint8_t>> levels_a = read_levels(*a);
+        std::vector<std::vector<uint8_t>> levels_b = read_levels(*b);
+        if(levels_a.size() != levels_b.size())
+            fail(what, "level count differs");
+        else for(unsigned i = 0; i < levels_a.size(); ++i)
+        {
+            if(levels_a[i] != levels_b[i])
+                fail(what, "level " + std::to_string(i) + " differs");
+        }
+    }
+
+    void compare(
+        const std::string& what,
+        const primitive* a,
+        const primitive* b
+    ){
+        if(!compare_null(what, a, b)) return;
+
+        if(a->get_mode() != b->get_mode()) fail(what, "mode differs");
+        if(a->get_index_count() != b->get_index_count())
+            fail(what, "index count differs");
+        if(
+            a->get_bounding_box().get_min() !=
+                b->get_bounding_box().get_min() ||
+            a->get_bounding_box().get_max() !=
+                b->get_bounding_box().get_max()
+        ) fail(what, "bounding box differs");
+        if(a->get_position_decode() != b->get_position_decode())
+            fail(what, "position decode differs");
+
+        compare(what + " indices", a->get_index(), b->get_index());
+
+        const auto& attribs_a = a->get_attributes();
+        const auto& attribs_b = b->get_attributes();
+        if(attribs_a.size() != attribs_b.size())
+            fail(what, "attribute count differs");
+
+        for(const auto& pair: attribs_a)
+        {
+            std::string attrib_what = what + " " + pair.first.name;
+            auto it = attribs_b.find(pair.first);
+            if(it == attribs_b.end() || it->first.name != pair.first.name)
+                fail(attrib_what, "missing");
+            else compare(attrib_what, pair.second, it->second);
+        }
+    }
+
+    void compare(
+        const std::string& what,
+        const gpu_buffer_accessor& a,
+        const gpu_buffer_accessor& b
+    ){
+        if(a.is_valid() != b.is_valid())
+        {
+            fail(what, "exists in only one of the scenes");
+            return;
+        }
+        if(!a.is_valid()) return;
+
+        if(
+            a.get_components() != b.get_components() ||
+            a.get_type() != b.get_type() ||
+            a.is_normalized() != b.is_normalized() ||
+            a.get_stride() != b.get_stride() ||
+            a.get_offset() != b.get_offset() ||
+            a.is_octahedral() != b.is_octahedral()
+        ) fail(what, "accessor differs");
+
+        compare(what + " buffer", a.get_buffer(), b.get_buffer());
+    }
+
+    void compare(
+        const std::string& what,
+        const gpu_buffer* a,
+        const gpu_buffer* b
+    ){
+        if(!compare_null(what, a, b)) return;
+
+        if(a->get_target() != b->get_target())
+            fail(what, "target differs");
+
+        // Binding element array buffers must not affect any vertex array.
+        a->get_context().get_state().bind_vertex_array(0);
+        if(a->read<uint8_t>() != b->read<uint8_t>())
+            fail(what, "data differs");
+    }
+
+    std::set<std::pair<const void*, const void*>> compared;
+    unsigned errors = 0;
+};
+
+// Returns the number of differences found, or zero when not verifying.
+unsigned bake(const char* input, const char* output, bool verify)
+{
+    headless_context::params params;
+    params.size = uvec2(1);
+    headless_context ctx(params);
+
+    resource_pool gltf_pool(ctx);
+    std::unordered_map<std::string, scene_graph> gltf_scenes =
+        load_gltf(gltf_pool, input);
+    save_baked_scene(gltf_pool, gltf_scenes, output);
+    if(!verify) return 0;
+
+    resource_pool baked_pool(ctx);
+    std::unordered_map<std::string, scene_graph> baked_scenes =
+        load_baked_scene(baked_pool, output);
+
+    scene_comparator comparator;
+    comparator.compare(gltf_scenes, baked_scenes);
+    if(glGetError() != GL_NO_ERROR)
+        throw std::runtime_error("OpenGL error while comparing the scenes");
+    return comparator.get_error_count();
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    bool verify = true;
+    const char* paths[2] = {nullptr, nullptr};
+    unsigned path_count = 0;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(!strcmp(argv[i], "--no-verify")) verify = false;
+        else if(path_count < 2 && argv[i][0] != '-')
+            paths[path_count++] = argv[i];
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(path_count != 2)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        unsigned errors = bake(paths[0], paths[1], verify);
+        if(errors != 0)
+        {
+            std::cerr
+                << errors << " differences between " << paths[0] << " and "
+                << paths[1] << std::endl;
+            return 1;
+        }
+    }
+    catch(const std::runtime_error& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,88 @@
+/*
+    Copyright 2018-2019 Julius Ikkala
+
+    This file is part of Littleton.
+
+    Littleton is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Littleton is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Littleton.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "littleton/texture_compression.hh"
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+
+void print_usage(const char* name)
+{
+    std::cerr
+        << "Usage: " << name
+        << " [--format bc1|bc3|bc4|bc5] [--srgb] [--no-flip]"
+           " input output.ktx" << std::endl
+        << "Use --no-flip for glTF textures." << std::endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    lt::block_format format = lt::block_format::BC1;
+    bool srgb = false;
+    bool flip = true;
+    const char* paths[2] = {nullptr, nullptr};
+    unsigned path_count = 0;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(!strcmp(argv[i], "--format") && i + 1 < argc)
+        {
+            const char* name = argv[++i];
+            if(!strcmp(name, "bc1")) format = lt::block_format::BC1;
+            else if(!strcmp(name, "bc3")) format = lt::block_format::BC3;
+            else if(!strcmp(name, "bc4")) format = lt::block_format::BC4;
+            else if(!strcmp(name, "bc5")) format = lt::block_format::BC5;
+            else
+            {
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+        else if(!strcmp(argv[i], "--srgb")) srgb = true;
+        else if(!strcmp(argv[i], "--no-flip")) flip = false;
+        else if(path_count < 2 && argv[i][0] != '-')
+            paths[path_count++] = argv[i];
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(path_count != 2)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        lt::compress_texture_file(paths[0], paths[1], format, srgb, flip);
+    }
+    catch(const std::runtime_error& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}